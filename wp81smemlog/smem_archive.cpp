@@ -0,0 +1,656 @@
+#include "stdafx.h"
+#include "smem_parse.h"
+#include "smem_chunk.h"
+#include "smem_dump.h"
+#include "smem_capture.h"
+#include "smem_archive.h"
+
+#define ARCHIVE_ID_BITS 13                       // log2 of the slots of the hash table of the dictionary
+#define ARCHIVE_ID_SLOTS (1 << ARCHIVE_ID_BITS)  // Twice SMEM_ARCHIVE_MAX_IDS, the probes stay short
+#define ARCHIVE_VIEW_ALIGN (64 * 1024)           // Allocation granularity, alignment of the file offset of a view
+#define ARCHIVE_BLOCK_ALIGN 8                    // Alignment of the blocks in the file
+#define ARCHIVE_NB_WORDS 3                       // Data words d1, d2 and d3
+
+static_assert(SMEM_ARCHIVE_MAX_IDS * 2 <= ARCHIVE_ID_SLOTS, "the dictionary must fill at most half of its hash table");
+static_assert(sizeof(SmemArchiveHeader) % ARCHIVE_BLOCK_ALIGN == 0, "the columns must start aligned");
+
+static const size_t WORD_OFFSETS[ARCHIVE_NB_WORDS] = {
+	offsetof(SmemLogRecord, d1), offsetof(SmemLogRecord, d2), offsetof(SmemLogRecord, d3)
+};
+
+static __forceinline uint32_t *record_word(SmemLogRecord *rec, size_t offset)
+{
+	return (uint32_t *)((char *)rec + offset);
+}
+
+static __forceinline uint8_t *put_varint(uint8_t *p, uint64_t value)
+{
+	while (value >= 0x80) {
+		*p++ = (uint8_t)(value | 0x80);
+		value >>= 7;
+	}
+	*p++ = (uint8_t)value;
+	return p;
+}
+
+static __forceinline unsigned int varint_size(uint32_t value)
+{
+	unsigned int size = 1;
+	while (value >= 0x80) {
+		value >>= 7;
+		size++;
+	}
+	return size;
+}
+
+// Returns the byte after the varint, NULL if it goes past end or is longer than 64 bits
+static __forceinline const uint8_t *get_varint(const uint8_t *p, const uint8_t *end, uint64_t *value)
+{
+	uint64_t result = 0;
+
+	for (unsigned int shift = 0; p < end && shift < 64; shift += 7) {
+		uint8_t byte = *p++;
+		result |= (uint64_t)(byte & 0x7F) << shift;
+		if (byte < 0x80) {
+			*value = result;
+			return p;
+		}
+	}
+	return NULL;
+}
+
+// Small negative and positive values as small varints
+static __forceinline uint64_t zigzag(int64_t value)
+{
+	return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static __forceinline int64_t unzigzag(uint64_t value)
+{
+	return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+// Empties the block being filled, the header keeps the log index and the clock rate
+static void reset_block(SmemArchiveWriter *writer)
+{
+	SmemArchiveHeader *header = &writer->header;
+
+	header->nb_records = 0;
+	header->nb_dropped = 0;
+	header->size = 0;
+	// Times of a block without any record with an id
+	header->first_time = writer->timebase.last;
+	header->last_time = writer->timebase.last;
+	writer->has_time = FALSE;
+	writer->nb_ids = 0;
+	memset(writer->id_slots, 0, ARCHIVE_ID_SLOTS * sizeof(uint16_t));
+}
+
+bool archive_writer_init(SmemArchiveWriter *writer, uint32_t log_index, uint32_t clock_rate)
+{
+	SmemArchiveHeader *header = &writer->header;
+
+	memset(writer, 0, sizeof(*writer));
+	writer->records = (SmemLogRecord *)malloc(SMEM_ARCHIVE_BLOCK_RECORDS * sizeof(SmemLogRecord));
+	writer->ids = (uint32_t *)malloc(SMEM_ARCHIVE_MAX_IDS * sizeof(uint32_t));
+	writer->id_slots = (uint16_t *)malloc(ARCHIVE_ID_SLOTS * sizeof(uint16_t));
+	writer->indexes = (uint16_t *)malloc(SMEM_ARCHIVE_BLOCK_RECORDS * sizeof(uint16_t));
+	writer->history = (uint32_t *)malloc(SMEM_ARCHIVE_MAX_IDS * sizeof(uint32_t));
+	writer->buffer = (uint8_t *)malloc(SMEM_ARCHIVE_MAX_BLOCK_SIZE);
+	if (writer->records == NULL || writer->ids == NULL || writer->id_slots == NULL
+		|| writer->indexes == NULL || writer->history == NULL || writer->buffer == NULL) {
+		archive_writer_free(writer);
+		return FALSE;
+	}
+
+	header->magic = SMEM_ARCHIVE_MAGIC;
+	header->version = SMEM_ARCHIVE_VERSION;
+	header->log_index = (uint16_t)log_index;
+	header->clock_rate = clock_rate;
+	timebase_init(&writer->timebase, clock_rate);
+	reset_block(writer);
+	return TRUE;
+}
+
+void archive_writer_free(SmemArchiveWriter *writer)
+{
+	free(writer->records);
+	free(writer->ids);
+	free(writer->id_slots);
+	free(writer->indexes);
+	free(writer->history);
+	free(writer->buffer);
+	writer->records = NULL;
+	writer->ids = NULL;
+	writer->id_slots = NULL;
+	writer->indexes = NULL;
+	writer->history = NULL;
+	writer->buffer = NULL;
+}
+
+bool archive_add_record(SmemArchiveWriter *writer, const SmemLogRecord *rec)
+{
+	SmemArchiveHeader *header = &writer->header;
+
+	if (header->nb_records == SMEM_ARCHIVE_BLOCK_RECORDS) {
+		return FALSE;
+	}
+
+	// Index of the id in the dictionary, linear probing
+	unsigned int slot = (rec->id * 2654435761u) >> (32 - ARCHIVE_ID_BITS);
+	while (writer->id_slots[slot] != 0 && writer->ids[writer->id_slots[slot] - 1] != rec->id) {
+		slot = (slot + 1) & (ARCHIVE_ID_SLOTS - 1);
+	}
+	if (writer->id_slots[slot] == 0) {
+		if (writer->nb_ids == SMEM_ARCHIVE_MAX_IDS) {
+			return FALSE;
+		}
+		writer->ids[writer->nb_ids++] = rec->id;
+		writer->id_slots[slot] = (uint16_t)writer->nb_ids;
+	}
+
+	writer->indexes[header->nb_records] = writer->id_slots[slot] - 1;
+	writer->records[header->nb_records++] = *rec;
+
+	// Same times as print_event, which skips the records without id
+	if (rec->id != 0) {
+		uint64_t time = timebase_extend(&writer->timebase, rec->timestamp);
+		if (!writer->has_time) {
+			writer->has_time = TRUE;
+			header->first_time = time;
+		}
+		header->last_time = time;
+	}
+	return TRUE;
+}
+
+// Column of a data word: the encoding giving the fewest bytes
+static uint8_t *encode_words(SmemArchiveWriter *writer, size_t offset, uint8_t *p)
+{
+	unsigned int nb_records = writer->header.nb_records;
+	size_t plain_size = 0;
+	size_t xor_size = 0;
+
+	memset(writer->history, 0, writer->nb_ids * sizeof(uint32_t));
+	for (unsigned int i = 0; i < nb_records; i++) {
+		uint32_t word = *record_word(&writer->records[i], offset);
+		uint32_t *previous = &writer->history[writer->indexes[i]];
+		plain_size += varint_size(word);
+		xor_size += varint_size(word ^ *previous);
+		*previous = word;
+	}
+
+	if (xor_size < plain_size) {
+		*p++ = SMEM_ARCHIVE_XOR;
+		memset(writer->history, 0, writer->nb_ids * sizeof(uint32_t));
+		for (unsigned int i = 0; i < nb_records; i++) {
+			uint32_t word = *record_word(&writer->records[i], offset);
+			uint32_t *previous = &writer->history[writer->indexes[i]];
+			p = put_varint(p, word ^ *previous);
+			*previous = word;
+		}
+	}
+	else {
+		*p++ = SMEM_ARCHIVE_PLAIN;
+		for (unsigned int i = 0; i < nb_records; i++) {
+			p = put_varint(p, *record_word(&writer->records[i], offset));
+		}
+	}
+	return p;
+}
+
+size_t archive_encode_block(SmemArchiveWriter *writer)
+{
+	SmemArchiveHeader *header = &writer->header;
+	const SmemLogRecord *records = writer->records;
+	unsigned int nb_records = header->nb_records;
+	uint8_t *p = writer->buffer + sizeof(SmemArchiveHeader);
+	uint32_t nb_ids = writer->nb_ids;
+
+	// Dictionary
+	memcpy(p, &nb_ids, sizeof(nb_ids));
+	p += sizeof(nb_ids);
+	memcpy(p, writer->ids, nb_ids * sizeof(uint32_t));
+	p += nb_ids * sizeof(uint32_t);
+
+	// Ids
+	for (unsigned int i = 0; i < nb_records; i++) {
+		p = put_varint(p, writer->indexes[i]);
+	}
+
+	// Timestamps, delta of delta
+	if (nb_records > 0) {
+		memcpy(p, &records[0].timestamp, sizeof(uint32_t));
+		p += sizeof(uint32_t);
+	}
+	int64_t delta = 0;
+	for (unsigned int i = 1; i < nb_records; i++) {
+		int64_t next = (int32_t)(records[i].timestamp - records[i - 1].timestamp);
+		p = put_varint(p, zigzag(next - delta));
+		delta = next;
+	}
+
+	for (unsigned int w = 0; w < ARCHIVE_NB_WORDS; w++) {
+		p = encode_words(writer, WORD_OFFSETS[w], p);
+	}
+
+	// The next header starts aligned
+	while ((p - writer->buffer) % ARCHIVE_BLOCK_ALIGN != 0) {
+		*p++ = 0;
+	}
+
+	size_t size = p - writer->buffer;
+	header->size = (uint32_t)(size - sizeof(SmemArchiveHeader));
+	memcpy(writer->buffer, header, sizeof(SmemArchiveHeader));
+
+	writer->stats.nb_records += nb_records;
+	writer->stats.nb_blocks++;
+	writer->stats.size += size;
+	reset_block(writer);
+	return size;
+}
+
+static bool write_block(SmemArchiveWriter *writer)
+{
+	size_t size = archive_encode_block(writer);
+	return fwrite(writer->buffer, size, 1, writer->file) == 1;
+}
+
+bool archive_open(SmemArchiveWriter *writer, const char *path, uint32_t log_index, uint32_t clock_rate)
+{
+	if (!archive_writer_init(writer, log_index, clock_rate)) {
+		return FALSE;
+	}
+	if (fopen_s(&writer->file, path, "wb") != 0) {
+		archive_writer_free(writer);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+bool archive_append(SmemArchiveWriter *writer, const SmemLogRecord *records, size_t nb_records, uint32_t nb_dropped)
+{
+	// The records were dropped before the ones of this read
+	writer->header.nb_dropped += nb_dropped;
+
+	for (size_t i = 0; i < nb_records; i++) {
+		if (!archive_add_record(writer, &records[i])) {
+			// Full block, or its dictionary
+			if (!write_block(writer)) {
+				return FALSE;
+			}
+			archive_add_record(writer, &records[i]);
+		}
+	}
+	return TRUE;
+}
+
+bool archive_close(SmemArchiveWriter *writer)
+{
+	const SmemArchiveHeader *header = &writer->header;
+	bool ok = TRUE;
+
+	if (header->nb_records != 0 || header->nb_dropped != 0) {
+		ok = write_block(writer);
+	}
+	if (fclose(writer->file) != 0) {
+		ok = FALSE;
+	}
+	writer->file = NULL;
+	archive_writer_free(writer);
+	return ok;
+}
+
+bool archive_decode_block(const SmemArchiveHeader *header, SmemLogRecord *records)
+{
+	const uint8_t *p = (const uint8_t *)(header + 1);
+	const uint8_t *end = p + header->size;
+	uint32_t nb_records = header->nb_records;
+	uint32_t ids[SMEM_ARCHIVE_MAX_IDS];
+	uint32_t history[SMEM_ARCHIVE_MAX_IDS];
+	uint32_t nb_ids;
+	uint64_t value;
+
+	// Dictionary
+	if (nb_records > SMEM_ARCHIVE_BLOCK_RECORDS || end - p < (ptrdiff_t)sizeof(nb_ids)) {
+		return FALSE;
+	}
+	memcpy(&nb_ids, p, sizeof(nb_ids));
+	p += sizeof(nb_ids);
+	if (nb_ids > SMEM_ARCHIVE_MAX_IDS || (size_t)(end - p) < nb_ids * sizeof(uint32_t)) {
+		return FALSE;
+	}
+	memcpy(ids, p, nb_ids * sizeof(uint32_t));
+	p += nb_ids * sizeof(uint32_t);
+
+	// The id of a record is its index in the dictionary until the data words are decoded
+	for (uint32_t i = 0; i < nb_records; i++) {
+		p = get_varint(p, end, &value);
+		if (p == NULL || value >= nb_ids) {
+			return FALSE;
+		}
+		records[i].id = (uint32_t)value;
+	}
+
+	// Timestamps
+	if (nb_records > 0) {
+		if (end - p < (ptrdiff_t)sizeof(uint32_t)) {
+			return FALSE;
+		}
+		memcpy(&records[0].timestamp, p, sizeof(uint32_t));
+		p += sizeof(uint32_t);
+	}
+	int64_t delta = 0;
+	for (uint32_t i = 1; i < nb_records; i++) {
+		p = get_varint(p, end, &value);
+		if (p == NULL) {
+			return FALSE;
+		}
+		delta += unzigzag(value);
+		records[i].timestamp = records[i - 1].timestamp + (uint32_t)delta;
+	}
+
+	for (unsigned int w = 0; w < ARCHIVE_NB_WORDS; w++) {
+		size_t offset = WORD_OFFSETS[w];
+
+		if (p >= end || *p > SMEM_ARCHIVE_XOR) {
+			return FALSE;
+		}
+		if (*p++ == SMEM_ARCHIVE_XOR) {
+			memset(history, 0, nb_ids * sizeof(uint32_t));
+			for (uint32_t i = 0; i < nb_records; i++) {
+				p = get_varint(p, end, &value);
+				if (p == NULL) {
+					return FALSE;
+				}
+				uint32_t *previous = &history[records[i].id];
+				*previous ^= (uint32_t)value;
+				*record_word(&records[i], offset) = *previous;
+			}
+		}
+		else {
+			for (uint32_t i = 0; i < nb_records; i++) {
+				p = get_varint(p, end, &value);
+				if (p == NULL) {
+					return FALSE;
+				}
+				*record_word(&records[i], offset) = (uint32_t)value;
+			}
+		}
+	}
+
+	for (uint32_t i = 0; i < nb_records; i++) {
+		records[i].id = ids[records[i].id];
+	}
+	return TRUE;
+}
+
+static bool is_archive_header(const SmemArchiveHeader *header)
+{
+	return header->magic == SMEM_ARCHIVE_MAGIC && header->version == SMEM_ARCHIVE_VERSION
+		&& header->nb_records <= SMEM_ARCHIVE_BLOCK_RECORDS
+		&& header->size <= SMEM_ARCHIVE_MAX_BLOCK_SIZE - sizeof(SmemArchiveHeader)
+		&& header->size % ARCHIVE_BLOCK_ALIGN == 0;
+}
+
+static bool read_first_header(const char *path, SmemArchiveHeader *header)
+{
+	bool archive = FALSE;
+
+	FILE *file = NULL;
+	if (fopen_s(&file, path, "rb") == 0) {
+		archive = fread(header, sizeof(*header), 1, file) == 1 && is_archive_header(header);
+		fclose(file);
+	}
+	return archive;
+}
+
+bool is_archive_file(const char *path)
+{
+	SmemArchiveHeader header;
+
+	return read_first_header(path, &header);
+}
+
+// Maps the next blocks, a block is a chunk
+static unsigned int next_archive_chunks(SmemChunkSource *base, SmemChunk **chunks, unsigned int nb_chunks)
+{
+	SmemArchiveSource *source = (SmemArchiveSource *)base;
+	unsigned int count = 0;
+
+	if (source->view != NULL) {
+		UnmapViewOfFile(source->view);
+		source->view = NULL;
+	}
+	if (source->position >= source->size) {
+		return 0;
+	}
+
+	uint64_t view_offset = source->position & ~(uint64_t)(ARCHIVE_VIEW_ALIGN - 1);
+	uint64_t view_end = source->position + (uint64_t)nb_chunks * SMEM_ARCHIVE_MAX_BLOCK_SIZE;
+	if (view_end > source->size) {
+		view_end = source->size;
+	}
+
+	source->view = (const char *)MapViewOfFile(source->mapping, FILE_MAP_READ,
+		(DWORD)(view_offset >> 32), (DWORD)view_offset, (SIZE_T)(view_end - view_offset));
+	if (source->view == NULL) {
+		fprintf(stderr, "Failed to map %s (error %u)\n", source->path, GetLastError());
+		base->failed = TRUE;
+		return 0;
+	}
+
+	const char *block = source->view + (source->position - view_offset);
+	const char *limit = source->view + (view_end - view_offset);
+	while (count < nb_chunks && block < limit) {
+		const SmemArchiveHeader *header = (const SmemArchiveHeader *)block;
+		size_t available = limit - block;
+
+		if (available < sizeof(SmemArchiveHeader) || !is_archive_header(header)
+			|| available - sizeof(SmemArchiveHeader) < header->size) {
+			if (count == 0) {
+				// A whole block always fits in a view, but at the end of the file
+				fprintf(stderr, "%s: block %llu is not an archive block\n", source->path,
+					(unsigned long long)source->block_index);
+				base->failed = TRUE;
+			}
+			break;
+		}
+
+		chunks[count]->data = block;
+		chunks[count]->size = sizeof(SmemArchiveHeader) + header->size;
+		chunks[count]->nb_dropped = header->nb_dropped;
+		source->position += chunks[count]->size;
+		block += chunks[count]->size;
+		count++;
+	}
+
+	return count;
+}
+
+static void load_archive_chunk(const SmemChunkSource *base, SmemChunk *chunk)
+{
+	const SmemArchiveHeader *header = (const SmemArchiveHeader *)chunk->data;
+
+	if (archive_decode_block(header, chunk->records)) {
+		chunk->nb_records = header->nb_records;
+	}
+	else {
+		chunk->corrupt = TRUE;
+	}
+}
+
+static bool check_archive_chunk(SmemChunkSource *base, const SmemChunk *chunk)
+{
+	SmemArchiveSource *source = (SmemArchiveSource *)base;
+
+	if (chunk->corrupt) {
+		fprintf(stderr, "%s: block %llu is corrupt\n", source->path, (unsigned long long)source->block_index);
+	}
+	source->block_index++;
+	return !chunk->corrupt;
+}
+
+bool archive_source_open(SmemArchiveSource *source, const char *path)
+{
+	SmemArchiveHeader header;
+	LARGE_INTEGER file_size;
+
+	memset(source, 0, sizeof(*source));
+	source->base.next = next_archive_chunks;
+	source->base.load = load_archive_chunk;
+	source->base.check = check_archive_chunk;
+	source->base.max_records = SMEM_ARCHIVE_BLOCK_RECORDS;
+	source->path = path;
+
+	if (!read_first_header(path, &header)) {
+		fprintf(stderr, "%s is not an archive file\n", path);
+		return FALSE;
+	}
+	source->clock_rate = header.clock_rate;
+
+	source->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (source->file == INVALID_HANDLE_VALUE) {
+		fprintf(stderr, "Failed to open %s (error %u)\n", path, GetLastError());
+		return FALSE;
+	}
+	if (!GetFileSizeEx(source->file, &file_size)) {
+		fprintf(stderr, "Failed to get the size of %s (error %u)\n", path, GetLastError());
+		CloseHandle(source->file);
+		return FALSE;
+	}
+	source->size = (uint64_t)file_size.QuadPart;
+
+	source->mapping = CreateFileMappingW(source->file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (source->mapping == NULL) {
+		fprintf(stderr, "Failed to map %s (error %u)\n", path, GetLastError());
+		CloseHandle(source->file);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+void archive_source_close(SmemArchiveSource *source)
+{
+	if (source->view != NULL) {
+		UnmapViewOfFile(source->view);
+	}
+	CloseHandle(source->mapping);
+	CloseHandle(source->file);
+}
+
+int decode_archive_file(const char *path, unsigned int nb_jobs, const SmemFilter *filter, bool verbose, bool json)
+{
+	SmemArchiveSource source;
+
+	if (!archive_source_open(&source, path)) {
+		return EXIT_FAILURE;
+	}
+	int status = decode_chunks(&source.base, nb_jobs, source.clock_rate, filter, verbose, json);
+	archive_source_close(&source);
+	return status;
+}
+
+static bool append_records(void *context, const SmemLogRecord *records, size_t nb_records, uint32_t nb_dropped)
+{
+	return archive_append((SmemArchiveWriter *)context, records, nb_records, nb_dropped);
+}
+
+// Copies the blocks of a capture file, the archive keeps its log index and clock rate
+static bool archive_capture(const char *input, const char *output, SmemArchiveWriter *writer, uint64_t *input_size)
+{
+	SmemCaptureBlock *block = (SmemCaptureBlock *)malloc(sizeof(SmemCaptureBlock));
+	bool opened = FALSE;
+	bool ok = block != NULL;
+
+	FILE *file = NULL;
+	if (fopen_s(&file, input, "rb") != 0) {
+		fprintf(stderr, "Failed to open %s\n", input);
+		ok = FALSE;
+	}
+
+	*input_size = 0;
+	while (ok && fread(block, sizeof(*block), 1, file) == 1) {
+		const SmemCaptureHeader *header = &block->header;
+
+		*input_size += sizeof(*block);
+		if (!opened) {
+			opened = archive_open(writer, output, header->log_index, header->clock_rate);
+			if (!opened) {
+				fprintf(stderr, "Failed to create %s\n", output);
+				ok = FALSE;
+				break;
+			}
+		}
+		if (header->magic != SMEM_CAPTURE_MAGIC || header->nb_records > SMEM_CAPTURE_BLOCK_RECORDS) {
+			fprintf(stderr, "%s: block %llu is not a capture block\n", input,
+				(unsigned long long)(*input_size / sizeof(*block) - 1));
+			ok = FALSE;
+		}
+		else if (!archive_append(writer, block->records, header->nb_records, header->nb_dropped)) {
+			fprintf(stderr, "Failed to write %s\n", output);
+			ok = FALSE;
+		}
+	}
+
+	if (file != NULL) {
+		fclose(file);
+	}
+	free(block);
+	if (opened && !archive_close(writer)) {
+		fprintf(stderr, "Failed to write %s\n", output);
+		ok = FALSE;
+	}
+	return ok && opened;
+}
+
+// Parses a raw dump on several threads and appends its records in the order of the file
+static bool archive_dump(const char *input, const char *output, SmemArchiveWriter *writer, unsigned int nb_jobs,
+	uint32_t log_index, uint32_t clock_rate, uint64_t *input_size)
+{
+	SmemDumpSource source;
+
+	if (!dump_source_open(&source, input)) {
+		return FALSE;
+	}
+	*input_size = source.size;
+	if (!archive_open(writer, output, log_index, clock_rate)) {
+		fprintf(stderr, "Failed to create %s\n", output);
+		dump_source_close(&source);
+		return FALSE;
+	}
+
+	bool ok = copy_chunks(&source.base, nb_jobs, append_records, writer) == EXIT_SUCCESS;
+	dump_source_close(&source);
+	if (!archive_close(writer) || (!ok && !source.base.failed)) {
+		fprintf(stderr, "Failed to write %s\n", output);
+		ok = FALSE;
+	}
+	return ok;
+}
+
+int archive_file(const char *input, const char *output, unsigned int nb_jobs, uint32_t log_index, uint32_t clock_rate)
+{
+	SmemArchiveWriter writer;
+	uint64_t input_size;
+	bool ok;
+
+	if (is_capture_file(input)) {
+		ok = archive_capture(input, output, &writer, &input_size);
+	}
+	else {
+		ok = archive_dump(input, output, &writer, nb_jobs, log_index, clock_rate, &input_size);
+	}
+	if (!ok) {
+		return EXIT_FAILURE;
+	}
+
+	const SmemArchiveStats *stats = &writer.stats;
+	double size = stats->size > 0 ? (double)stats->size : 1.0;
+	printf("%s: %llu records in %llu blocks, %llu bytes, %.2f bytes per record\n", output,
+		(unsigned long long)stats->nb_records, (unsigned long long)stats->nb_blocks, (unsigned long long)stats->size,
+		stats->nb_records > 0 ? stats->size / (double)stats->nb_records : 0.0);
+	printf("Compression ratio: %.1f to %s, %.1f to a raw dump\n", input_size / size, input,
+		stats->nb_records * (SMEM_RAW_LINE_SIZE + 1) / size);
+	return EXIT_SUCCESS;
+}
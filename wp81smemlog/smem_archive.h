@@ -0,0 +1,206 @@
+#pragma once
+
+// Archive: the records in compressed blocks of variable size, one column per field
+#define SMEM_ARCHIVE_MAGIC 0x43524153  // "SARC"
+#define SMEM_ARCHIVE_VERSION 1
+#define SMEM_ARCHIVE_BLOCK_RECORDS 16384
+#define SMEM_ARCHIVE_MAX_IDS 4096       // Distinct ids in a block, a block is closed earlier if more
+// Bound of the size of a block: the varints of an index, a timestamp and 3 words take at most 2, 5 and 3 * 5 bytes
+#define SMEM_ARCHIVE_MAX_BLOCK_SIZE (sizeof(SmemArchiveHeader) + 4 + SMEM_ARCHIVE_MAX_IDS * 4 + 4 + 3 \
+	+ SMEM_ARCHIVE_BLOCK_RECORDS * (2 + 5 + 3 * 5) + 8)
+
+/**
+* @brief Header of a block of an archive file.
+*
+* The columns follow the header:
+* - the id dictionary: its size, then the ids, as 32-bit words,
+* - the ids: the index of each record in the dictionary as a varint,
+* - the timestamps: the first one as a 32-bit word, then the difference between consecutive
+*   deltas as a zigzag varint, 0 when the records come at a steady rate,
+* - d1, d2 and d3: a method byte, then the words as varints, or with the method
+*   SMEM_ARCHIVE_XOR the words xor the previous word of the column with the same id.
+*/
+typedef struct {
+	uint32_t magic;         // SMEM_ARCHIVE_MAGIC
+	uint16_t version;       // SMEM_ARCHIVE_VERSION
+	uint16_t log_index;     // Log read (0 or 1)
+	uint32_t clock_rate;    // Ticks per second of the timestamps
+	uint32_t nb_records;    // Records in the block
+	uint32_t nb_dropped;    // Sum of the nbDropped of the reads which filled the block
+	uint32_t size;          // Bytes of the columns after the header, a multiple of 8
+	uint64_t first_time;    // Extended timestamp of the first record with an id
+	uint64_t last_time;     // Extended timestamp of the last record with an id
+} SmemArchiveHeader;
+
+/**
+* @brief Encoding of a column of data words.
+*/
+typedef enum {
+	SMEM_ARCHIVE_PLAIN,     // The words
+	SMEM_ARCHIVE_XOR        // The words xor the previous word of the same id
+} SmemArchiveMethod;
+
+/**
+* @brief Sizes of the records written in an archive.
+*/
+typedef struct {
+	uint64_t nb_records;
+	uint64_t nb_blocks;
+	uint64_t size;          // Bytes of the blocks
+} SmemArchiveStats;
+
+/**
+* @brief Writer of an archive file.
+*/
+typedef struct {
+	FILE *file;
+	SmemArchiveHeader header;   // Header of the block being filled
+	SmemLogRecord *records;     // Records of the block being filled
+	uint32_t *ids;              // Dictionary of the block
+	uint16_t *id_slots;         // Hash table of the dictionary, index + 1 or 0 when free
+	unsigned int nb_ids;
+	uint16_t *indexes;          // Index in the dictionary of each record of the block
+	uint32_t *history;          // Previous word of each id, while a column is encoded
+	uint8_t *buffer;            // Encoded block, SMEM_ARCHIVE_MAX_BLOCK_SIZE bytes
+	SmemTimebase timebase;      // Extension of the timestamps of the block headers
+	bool has_time;              // TRUE if a record of the block has an id
+	SmemArchiveStats stats;
+} SmemArchiveWriter;
+
+/**
+* @brief Initializes a writer without file, its blocks are encoded with archive_encode_block.
+*
+* @param writer The writer.
+* @param log_index The log read.
+* @param clock_rate Ticks per second of the timestamps.
+* @return FALSE if the memory is missing.
+*/
+bool archive_writer_init(SmemArchiveWriter *writer, uint32_t log_index, uint32_t clock_rate);
+
+/**
+* @brief Releases the memory of a writer.
+*
+* @param writer The writer.
+*/
+void archive_writer_free(SmemArchiveWriter *writer);
+
+/**
+* @brief Adds a record to the block being filled.
+*
+* @param writer The writer.
+* @param rec The record.
+* @return FALSE if the block is full, the record is not added.
+*/
+bool archive_add_record(SmemArchiveWriter *writer, const SmemLogRecord *rec);
+
+/**
+* @brief Encodes the block being filled in the buffer of the writer and empties it.
+*
+* @param writer The writer.
+* @return Size of the block in the buffer, header included.
+*/
+size_t archive_encode_block(SmemArchiveWriter *writer);
+
+/**
+* @brief Creates an archive file.
+*
+* @param writer The writer.
+* @param path The archive file, replaced if it exists.
+* @param log_index The log read.
+* @param clock_rate Ticks per second of the timestamps.
+* @return FALSE if the file cannot be created or the memory is missing.
+*/
+bool archive_open(SmemArchiveWriter *writer, const char *path, uint32_t log_index, uint32_t clock_rate);
+
+/**
+* @brief Appends records to the archive, a block is encoded and written when it is full.
+*
+* @param writer The writer.
+* @param records The records.
+* @param nb_records Number of records.
+* @param nb_dropped Records dropped before them.
+* @return FALSE if a block cannot be written.
+*/
+bool archive_append(SmemArchiveWriter *writer, const SmemLogRecord *records, size_t nb_records, uint32_t nb_dropped);
+
+/**
+* @brief Writes the last block and closes the file.
+*
+* A block is only written once: the records of the block being filled are lost if the
+* tool ends without archive_close.
+*
+* @param writer The writer.
+* @return FALSE if the block cannot be written.
+*/
+bool archive_close(SmemArchiveWriter *writer);
+
+/**
+* @brief Decodes the columns of a block.
+*
+* @param header The header of the block, followed by its columns.
+* @param records Receives the records, room for SMEM_ARCHIVE_BLOCK_RECORDS records.
+* @return FALSE if the block is corrupt.
+*/
+bool archive_decode_block(const SmemArchiveHeader *header, SmemLogRecord *records);
+
+/**
+* @brief Archive file read in chunks of whole blocks.
+*/
+typedef struct {
+	SmemChunkSource base;
+	const char *path;
+	HANDLE file;
+	HANDLE mapping;
+	uint64_t size;
+	uint64_t position;          // Start of the next block
+	const char *view;           // View of the current blocks
+	uint32_t clock_rate;        // Clock rate of the first block
+	uint64_t block_index;       // Index of the next checked block
+} SmemArchiveSource;
+
+/**
+* @brief Opens an archive file as a chunk source, one block per chunk.
+*
+* @param source The source.
+* @param path The archive file.
+* @return FALSE if the file cannot be opened or is not an archive, the error is printed.
+*/
+bool archive_source_open(SmemArchiveSource *source, const char *path);
+
+/**
+* @brief Closes an archive file.
+*
+* @param source The source.
+*/
+void archive_source_close(SmemArchiveSource *source);
+
+/**
+* @brief Tells if a file starts with an archive block.
+*
+* @param path The file.
+*/
+bool is_archive_file(const char *path);
+
+/**
+* @brief Decodes an archive file on several threads, the blocks are decompressed and decoded concurrently.
+*
+* @param path The archive file.
+* @param nb_jobs Number of worker threads.
+* @param filter The records to print (see select_record), NULL for all.
+* @param verbose TRUE to print the raw words in front of each decoded record.
+* @param json TRUE to print each event as a JSON object on its own line (see print_event), without the raw words.
+* @return EXIT_SUCCESS, or EXIT_FAILURE if the file cannot be read or is corrupt.
+*/
+int decode_archive_file(const char *path, unsigned int nb_jobs, const SmemFilter *filter, bool verbose, bool json);
+
+/**
+* @brief Compresses a raw dump or a capture file into an archive, prints the compression ratio.
+*
+* @param input The raw dump or capture file.
+* @param output The archive file.
+* @param nb_jobs Number of worker threads parsing a raw dump.
+* @param log_index The log index written in the archive for a raw dump.
+* @param clock_rate Ticks per second of the timestamps of a raw dump.
+* @return EXIT_SUCCESS, or EXIT_FAILURE on a read or write error.
+*/
+int archive_file(const char *input, const char *output, unsigned int nb_jobs, uint32_t log_index, uint32_t clock_rate);
@@ -0,0 +1,1843 @@
+#include "stdafx.h"
+#include "smem_bench.h"
+#include "smem_parse.h"
+#include "smem_chunk.h"
+#include "smem_filter.h"
+#include "smem_archive.h"
+#include "smem_capture.h"
+#include "smem_stats.h"
+#include "smem_input.h"
+#include "smem_ring.h"
+#include "smem_source.h"
+#include "smem_synth.h"
+#include "smem_poll.h"
+#include "smem_histo.h"
+#include "smem_router.h"
+#include "smem_qmi.h"
+#include "smem_trace.h"
+#include "smem_metrics.h"
+#include "smem_reader.h"
+#include "smem_loss.h"
+#include "smem_pipe.h"
+
+// At least one record of each event base, with payloads accepted by its decoder.
+static const SmemLogRecord BENCH_CORPUS[] = {
+	{ 0x80000000, 0x00001000, 0x00000000, 0x00000000, 0x00000000 }, // DEBUG
+	{ 0x80010034, 0x00001010, 0x00000012, 0x00220010, 0x00000002 }, // ONCRPC (BW compatible QCCI)
+	{ 0x80020000, 0x00001020, 0x00000000, 0x00000000, 0x00000000 }, // SMEM
+	{ 0x80030001, 0x00001030, 0x00000001, 0x00000002, 0x00000003 }, // TMC
+	{ 0x80040002, 0x00001040, 0x00000001, 0x00000002, 0x00000003 }, // TIMETICK
+	{ 0x80060000, 0x00001060, 0x00000000, 0x00000000, 0x00000000 }, // ERR
+	{ 0x80090002, 0x00001090, 0x00000001, 0x00000002, 0x00000003 }, // RPC ROUTER
+	{ 0x800A0000, 0x000010A0, 0x00000000, 0x00000000, 0x00000000 }, // CLKRGM
+	{ 0x800D0000, 0x000010D0, 0x6D656D73, 0x676F6C5F, 0x00632E00 }, // IPC ROUTER ERROR
+	{ 0x900D0000, 0x000010D0, 0x00000000, 0x00000000, 0x00000123 }, // IPC ROUTER ERROR (continuation)
+	{ 0x800D0001, 0x000010D0, 0x0100000A, 0x03000005, 0x01000040 }, // IPC ROUTER TX
+	{ 0x900D0001, 0x000010D0, 0x30727472, 0x00000123, 0x6B736174 }, // IPC ROUTER TX (continuation)
+	{ 0x800E0003, 0x000010E0, 0x00000071, 0x00000063, 0x00000069 }, // QCCI ERROR
+	{ 0x900E0003, 0x000010E0, 0x0000002E, 0x00000063, 0x00000042 }, // QCCI ERROR (continuation)
+	{ 0x800E0004, 0x000010E0, 0x00000012, 0x00220010, 0x00000002 }, // QCCI TX
+	{ 0x900E0004, 0x000010E0, 0x00000001, 0x00000002, 0x00000003 }, // QCCI TX (continuation)
+	{ 0x800F0003, 0x000010F0, 0x00000071, 0x00000063, 0x00000073 }, // QCSI ERROR
+	{ 0x900F0003, 0x000010F0, 0x0000002E, 0x00000063, 0x00000043 }, // QCSI ERROR (continuation)
+	{ 0x800F0005, 0x000010F0, 0x00020012, 0x00220010, 0x00000002 }, // QCSI RX
+	{ 0x80123456, 0x00001123, 0x00000001, 0x00000002, 0x00000003 }  // UNKNOWN
+};
+
+#define BENCH_STREAM_LENGTH 20000
+#define BENCH_ARCHIVE_SIZE ((BENCH_STREAM_LENGTH / SMEM_ARCHIVE_BLOCK_RECORDS + 1) * SMEM_ARCHIVE_MAX_BLOCK_SIZE)
+#define BENCH_CAPTURE_PATH "wp81smemlog_self_test.cap"   // In the current directory, removed after the check
+#define BENCH_CAPTURE_TEXT_PATH "wp81smemlog_self_test.txt"
+#define BENCH_CAPTURE_READ 5                             // Records of a read of the device
+#define BENCH_TRACE_PATH "wp81smemlog_self_test.json"
+
+// Reentrancy check: streams decoded concurrently, one thread and one SmemDecoderState each
+#define BENCH_NB_THREADS 4
+#define BENCH_NB_ROUNDS 10
+
+typedef struct {
+	SmemLogRecord records[BENCH_STREAM_LENGTH];
+	SmemDecoderState state;
+} BenchStream;
+
+#define BENCH_MAX_RESULTS 128
+#define BENCH_MAX_RECORDED (1 << 20)    // Records of a recorded corpus, at most
+
+// A measure, for the comparison of runs
+typedef struct {
+	const char *group;          // What is timed
+	char name[48];              // What it is timed on
+	double value;
+	const char *unit;
+} BenchResult;
+
+// Measures of the run, in the order they are printed
+static BenchResult bench_results[BENCH_MAX_RESULTS];
+static unsigned int bench_nb_results;
+
+static void add_result(const char *group, const char *name, double value, const char *unit)
+{
+	if (bench_nb_results == BENCH_MAX_RESULTS) {
+		return;
+	}
+	BenchResult *result = &bench_results[bench_nb_results++];
+	result->group = group;
+	_snprintf_s(result->name, sizeof(result->name), _TRUNCATE, "%s", name);
+	result->value = value;
+	result->unit = unit;
+}
+
+static double elapsed_ns(const LARGE_INTEGER *start, const LARGE_INTEGER *end, const LARGE_INTEGER *freq)
+{
+	return (double)(end->QuadPart - start->QuadPart) * 1e9 / (double)freq->QuadPart;
+}
+
+// Fills a stream with records of the corpus in a pseudo-random order, specific to the stream
+static void fill_stream(BenchStream *stream, unsigned int seed)
+{
+	uint32_t lcg = seed;
+	uint32_t timestamp = 0xFFFF0000; // Wraps during the stream
+
+	for (unsigned int i = 0; i < BENCH_STREAM_LENGTH; i++) {
+		lcg = lcg * 1103515245 + 12345;
+		stream->records[i] = BENCH_CORPUS[(lcg >> 16) % _countof(BENCH_CORPUS)];
+		timestamp += (lcg >> 8) & 0xFF;
+		stream->records[i].timestamp = timestamp;
+	}
+}
+
+// Streams of the corpus, stream i seeded with seed + i, each with a new decoding state: the
+// fixture of the measures and the checks. NULL if the memory is missing
+static BenchStream *new_streams(unsigned int nb_streams, unsigned int seed)
+{
+	BenchStream *streams = (BenchStream *)malloc(nb_streams * sizeof(BenchStream));
+
+	if (streams == NULL) {
+		printf("Failed to allocate %u streams of the corpus\n", nb_streams);
+		return NULL;
+	}
+	for (unsigned int i = 0; i < nb_streams; i++) {
+		fill_stream(&streams[i], seed + i);
+		decoder_state_init(&streams[i].state, TIMESTAMP_CLOCK_RATE);
+	}
+	return streams;
+}
+
+static void free_streams(BenchStream *streams, unsigned int nb_streams)
+{
+	if (streams == NULL) {
+		return;
+	}
+	for (unsigned int i = 0; i < nb_streams; i++) {
+		decoder_state_free(&streams[i].state);
+	}
+	free(streams);
+}
+
+static void decode_stream(BenchStream *stream)
+{
+	for (unsigned int i = 0; i < BENCH_STREAM_LENGTH; i++) {
+		print_event(&stream->state, &stream->records[i], FALSE, TRUE);
+	}
+}
+
+static DWORD WINAPI decode_stream_thread(LPVOID param)
+{
+	decode_stream((BenchStream *)param);
+	return 0;
+}
+
+// Streams decoded concurrently give the text of their decoding one at a time
+static bool check_reentrancy(void)
+{
+	HANDLE threads[BENCH_NB_THREADS];
+	BenchStream *reference = new_streams(BENCH_NB_THREADS, 1);
+	bool same = reference != NULL;
+
+	for (unsigned int t = 0; same && t < BENCH_NB_THREADS; t++) {
+		decode_stream(&reference[t]);
+	}
+
+	for (unsigned int round = 0; round < BENCH_NB_ROUNDS && same; round++) {
+		BenchStream *concurrent = new_streams(BENCH_NB_THREADS, 1);
+		if (concurrent == NULL) {
+			same = FALSE;
+			break;
+		}
+		for (unsigned int t = 0; t < BENCH_NB_THREADS; t++) {
+			threads[t] = CreateThread(NULL, 0, decode_stream_thread, &concurrent[t], 0, NULL);
+		}
+		WaitForMultipleObjectsEx(BENCH_NB_THREADS, threads, TRUE, INFINITE, FALSE);
+
+		for (unsigned int t = 0; t < BENCH_NB_THREADS; t++) {
+			CloseHandle(threads[t]);
+
+			const SmemOutBuffer *expected = &reference[t].state.out;
+			const SmemOutBuffer *actual = &concurrent[t].state.out;
+			if (actual->size != expected->size || memcmp(actual->data, expected->data, actual->size) != 0) {
+				printf("Stream %u of round %u differs from its single-threaded decoding\n", t, round);
+				same = FALSE;
+			}
+		}
+		free_streams(concurrent, BENCH_NB_THREADS);
+	}
+
+	free_streams(reference, BENCH_NB_THREADS);
+	return same;
+}
+
+// Decoders of the cases of switch_decoder, looked up before it is timed
+static const SmemLogDecoder *switch_targets[12];
+static volatile size_t bench_sink;
+
+// The dispatch of print_record before the registry: a switch on the event base
+static const SmemLogDecoder *switch_decoder(uint32_t id)
+{
+	switch (id & 0x0FFF0000) {
+	case 0x00000000: return switch_targets[0];     // DEBUG
+	case 0x00010000: return switch_targets[1];     // ONCRPC
+	case 0x000E0000: return switch_targets[2];     // QCCI
+	case 0x000F0000: return switch_targets[3];     // QCSI
+	case 0x00020000: return switch_targets[4];     // SMEM
+	case 0x00030000: return switch_targets[5];     // TMC
+	case 0x00040000: return switch_targets[6];     // TIMETICK
+	case 0x00060000: return switch_targets[7];     // ERR
+	case 0x00090000: return switch_targets[8];     // RPC ROUTER
+	case 0x000D0000: return switch_targets[9];     // IPC ROUTER
+	case 0x000A0000: return switch_targets[10];    // CLKRGM
+	default: return switch_targets[11];            // UNKNOWN
+	}
+}
+
+typedef const SmemLogDecoder *(*DecoderLookup)(uint32_t id);
+
+// Selection of the decoder of each record of a stream, by the switch and by the registry, in ns per record.
+// Both are called through a pointer so that neither is inlined in the loop.
+static void bench_dispatch(unsigned int iterations)
+{
+	static const uint32_t SWITCH_BASES[] = { 0x00000000, 0x00010000, 0x000E0000, 0x000F0000, 0x00020000, 0x00030000,
+		0x00040000, 0x00060000, 0x00090000, 0x000D0000, 0x000A0000, 0x00123456 };
+	static const DecoderLookup LOOKUPS[] = { switch_decoder, find_decoder };
+	static const char *LOOKUP_NAMES[] = { "switch", "registry" };
+	LARGE_INTEGER freq, start, end;
+
+	BenchStream *stream = new_streams(1, 1);
+	if (stream == NULL) {
+		return;
+	}
+	for (unsigned int b = 0; b < _countof(SWITCH_BASES); b++) {
+		switch_targets[b] = find_decoder(SWITCH_BASES[b]);
+	}
+
+	QueryPerformanceFrequency(&freq);
+	printf("%-10s %12s\n", "dispatch", "ns/record");
+	for (unsigned int l = 0; l < _countof(LOOKUPS); l++) {
+		volatile DecoderLookup lookup = LOOKUPS[l];
+		size_t sum = 0;
+
+		QueryPerformanceCounter(&start);
+		for (unsigned int i = 0; i < iterations; i++) {
+			for (unsigned int r = 0; r < BENCH_STREAM_LENGTH; r++) {
+				sum += (size_t)lookup(stream->records[r].id);
+			}
+		}
+		QueryPerformanceCounter(&end);
+		bench_sink = sum;
+
+		double ns = elapsed_ns(&start, &end, &freq) / ((double)iterations * BENCH_STREAM_LENGTH);
+		printf("%-10s %12.2f\n", LOOKUP_NAMES[l], ns);
+		add_result("dispatch", LOOKUP_NAMES[l], ns, "ns/record");
+	}
+
+	free_streams(stream, 1);
+}
+
+// Parsing of a raw dump of the corpus, in MB/s
+static void bench_parsers(unsigned int iterations)
+{
+	LARGE_INTEGER freq, start, end;
+	SmemOutBuffer text;
+	SmemParseReport report;
+	SmemParser best = best_parser();
+
+	QueryPerformanceFrequency(&freq);
+	outbuf_init(&text, BENCH_STREAM_LENGTH * (SMEM_RAW_LINE_SIZE + 1));
+	for (unsigned int i = 0; i < BENCH_STREAM_LENGTH; i++) {
+		print_raw_event(&text, BENCH_CORPUS[i % _countof(BENCH_CORPUS)]);
+		emit_char(&text, '\n');
+	}
+
+	SmemLogRecord *records = (SmemLogRecord *)malloc(SMEM_RAW_MAX_RECORDS(text.size) * sizeof(SmemLogRecord));
+	if (records != NULL) {
+		printf("%-10s %12s\n", "parser", "MB/s");
+		for (unsigned int p = SMEM_PARSER_SCALAR; p <= (unsigned int)best; p++) {
+			QueryPerformanceCounter(&start);
+			for (unsigned int i = 0; i < iterations; i++) {
+				parse_raw_dump((SmemParser)p, text.data, text.size, records, &report);
+			}
+			QueryPerformanceCounter(&end);
+
+			double mbs = (double)text.size * iterations / elapsed_ns(&start, &end, &freq) * 1e3;
+			printf("%-10s %12.1f\n", parser_name((SmemParser)p), mbs);
+			add_result("parse_raw_dump", parser_name((SmemParser)p), mbs, "MB/s");
+		}
+		free(records);
+	}
+	outbuf_free(&text);
+}
+
+// Raw lines on which every parser must agree: CRLF, decoded text, malformed lines, last line without end
+static const char PARSE_TEXT[] =
+	"80030003 0001a2b3 00000001 00000002 00000003\n"
+	"800E0003 0001A2B4 DEADBEEF 0000FFFF 12345678\r\n"
+	"\n"
+	"000E0003 0001a2b5 00000001 00000002 00000003 QCCI: TX\n"
+	"000E0003 0001a2b5 0000000g 00000002 00000003\n"            // Not a digit
+	"000E0003-0001a2b5 00000001 00000002 00000003\n"            // Not a separator
+	"000E0003 0001a2b5 00000001 00000002 0000000\n"             // Short
+	"\r\n"
+	"000E0003 0001a2b5 00000001 00000002 00000003x\n"           // Long
+	"000E0003 0001a2b5 00000001 \xc3" "0000002 00000003\n"      // Byte above 0x7F
+	"400E0003 0001a2b6 00000001 00000002 00000003";
+
+static const SmemLogRecord PARSE_RECORDS[] = {
+	{ 0x80030003, 0x0001a2b3, 0x00000001, 0x00000002, 0x00000003 },
+	{ 0x800E0003, 0x0001a2b4, 0xdeadbeef, 0x0000ffff, 0x12345678 },
+	{ 0x000E0003, 0x0001a2b5, 0x00000001, 0x00000002, 0x00000003 },
+	{ 0x400E0003, 0x0001a2b6, 0x00000001, 0x00000002, 0x00000003 }
+};
+
+static const size_t PARSE_MALFORMED[] = { 5, 6, 7, 9, 10 };
+
+#define PARSE_NB_LINES 11
+
+// Each parser the processor supports finds the same records and malformed lines
+static bool check_parsers(void)
+{
+	SmemLogRecord records[SMEM_RAW_MAX_RECORDS(sizeof(PARSE_TEXT) - 1)];
+	SmemParseReport report;
+	bool same = TRUE;
+
+	for (unsigned int p = SMEM_PARSER_SCALAR; p <= (unsigned int)best_parser(); p++) {
+		const char *name = parser_name((SmemParser)p);
+		size_t nb_records = parse_raw_dump((SmemParser)p, PARSE_TEXT, sizeof(PARSE_TEXT) - 1, records, &report);
+
+		if (nb_records != _countof(PARSE_RECORDS) || memcmp(records, PARSE_RECORDS, sizeof(PARSE_RECORDS)) != 0) {
+			printf("The %s parser finds %u records instead of the %u expected\n", name, (unsigned int)nb_records, (unsigned int)_countof(PARSE_RECORDS));
+			same = FALSE;
+		}
+		if (report.nb_lines != PARSE_NB_LINES || report.nb_malformed != _countof(PARSE_MALFORMED)
+			|| memcmp(report.malformed, PARSE_MALFORMED, sizeof(PARSE_MALFORMED)) != 0) {
+			printf("The %s parser reports %u lines, %u malformed, instead of %u and %u\n", name, (unsigned int)report.nb_lines,
+				(unsigned int)report.nb_malformed, PARSE_NB_LINES, (unsigned int)_countof(PARSE_MALFORMED));
+			same = FALSE;
+		}
+	}
+	return same;
+}
+
+// Archives the records of a stream in blocks, at most BENCH_ARCHIVE_SIZE bytes; 0 if the writer cannot be allocated
+static size_t archive_stream(const BenchStream *stream, uint8_t *blocks, unsigned int *nb_blocks)
+{
+	SmemArchiveWriter writer;
+	size_t size = 0;
+
+	if (!archive_writer_init(&writer, 0, TIMESTAMP_CLOCK_RATE)) {
+		printf("Failed to allocate the archive of the stream\n");
+		return 0;
+	}
+	*nb_blocks = 0;
+	for (unsigned int i = 0; i < BENCH_STREAM_LENGTH; i++) {
+		if (!archive_add_record(&writer, &stream->records[i])) {
+			size_t block_size = archive_encode_block(&writer);
+			memcpy(blocks + size, writer.buffer, block_size);
+			size += block_size;
+			(*nb_blocks)++;
+			archive_add_record(&writer, &stream->records[i]);
+		}
+	}
+	size_t block_size = archive_encode_block(&writer);
+	memcpy(blocks + size, writer.buffer, block_size);
+	size += block_size;
+	(*nb_blocks)++;
+	archive_writer_free(&writer);
+	return size;
+}
+
+// Archive of a stream: compression and decoding speed against the raw dump parser
+static void bench_archive(unsigned int iterations)
+{
+	LARGE_INTEGER freq, start, end;
+	SmemOutBuffer text;
+	SmemParseReport report;
+	unsigned int nb_blocks = 0;
+	size_t size = 0;
+
+	BenchStream *stream = new_streams(1, 1);
+	uint8_t *blocks = (uint8_t *)malloc(BENCH_ARCHIVE_SIZE);
+	SmemLogRecord *records = (SmemLogRecord *)malloc(SMEM_RAW_MAX_RECORDS(BENCH_STREAM_LENGTH * (SMEM_RAW_LINE_SIZE + 1)) * sizeof(SmemLogRecord));
+	if (stream == NULL || blocks == NULL || records == NULL) {
+		printf("Failed to allocate the archive of the stream\n");
+	}
+	else {
+		size = archive_stream(stream, blocks, &nb_blocks);
+	}
+	if (size == 0) {
+		free_streams(stream, 1);
+		free(blocks);
+		free(records);
+		return;
+	}
+
+	printf("Archive: %u records in %u bytes, %.2f bytes per record, ratio %.1f to a raw dump\n",
+		BENCH_STREAM_LENGTH, (unsigned int)size, (double)size / BENCH_STREAM_LENGTH,
+		(double)BENCH_STREAM_LENGTH * (SMEM_RAW_LINE_SIZE + 1) / size);
+
+	QueryPerformanceFrequency(&freq);
+	printf("%-10s %12s\n", "reader", "Mrecords/s");
+
+	QueryPerformanceCounter(&start);
+	for (unsigned int i = 0; i < iterations; i++) {
+		size_t offset = 0;
+		for (unsigned int b = 0; b < nb_blocks; b++) {
+			const SmemArchiveHeader *header = (const SmemArchiveHeader *)(blocks + offset);
+			archive_decode_block(header, records);
+			offset += sizeof(SmemArchiveHeader) + header->size;
+		}
+	}
+	QueryPerformanceCounter(&end);
+	double rate = (double)BENCH_STREAM_LENGTH * iterations / elapsed_ns(&start, &end, &freq) * 1e3;
+	printf("%-10s %12.1f\n", "archive", rate);
+	add_result("read_records", "archive", rate, "Mrecords/s");
+
+	outbuf_init(&text, BENCH_STREAM_LENGTH * (SMEM_RAW_LINE_SIZE + 1));
+	for (unsigned int i = 0; i < BENCH_STREAM_LENGTH; i++) {
+		print_raw_event(&text, stream->records[i]);
+		emit_char(&text, '\n');
+	}
+	QueryPerformanceCounter(&start);
+	for (unsigned int i = 0; i < iterations; i++) {
+		parse_raw_dump(best_parser(), text.data, text.size, records, &report);
+	}
+	QueryPerformanceCounter(&end);
+	rate = (double)BENCH_STREAM_LENGTH * iterations / elapsed_ns(&start, &end, &freq) * 1e3;
+	printf("%-10s %12.1f\n", "raw dump", rate);
+	add_result("read_records", "raw dump", rate, "Mrecords/s");
+	outbuf_free(&text);
+
+	free_streams(stream, 1);
+	free(blocks);
+	free(records);
+}
+
+// The archive of a stream decodes back to its records
+static bool check_archive(void)
+{
+	unsigned int nb_blocks = 0;
+	size_t size = 0;
+
+	BenchStream *stream = new_streams(1, 1);
+	uint8_t *blocks = (uint8_t *)malloc(BENCH_ARCHIVE_SIZE);
+	SmemLogRecord *records = (SmemLogRecord *)malloc(SMEM_ARCHIVE_BLOCK_RECORDS * sizeof(SmemLogRecord));
+	if (stream == NULL || blocks == NULL || records == NULL) {
+		printf("Failed to allocate the archive of the stream\n");
+	}
+	else {
+		size = archive_stream(stream, blocks, &nb_blocks);
+	}
+
+	size_t offset = 0;
+	unsigned int nb_records = 0;
+	bool same = size > 0;
+	for (unsigned int b = 0; b < nb_blocks && same; b++) {
+		const SmemArchiveHeader *header = (const SmemArchiveHeader *)(blocks + offset);
+		same = archive_decode_block(header, records)
+			&& memcmp(records, &stream->records[nb_records], header->nb_records * sizeof(SmemLogRecord)) == 0;
+		nb_records += header->nb_records;
+		offset += sizeof(SmemArchiveHeader) + header->size;
+	}
+	same = same && nb_records == BENCH_STREAM_LENGTH;
+
+	free_streams(stream, 1);
+	free(blocks);
+	free(records);
+	return same;
+}
+
+// Records read back from a file, compared with the ones written
+typedef struct {
+	const SmemLogRecord *expected;
+	size_t nb_records;
+	bool same;
+} RecordCheck;
+
+static bool compare_records(void *context, const SmemLogRecord *records, size_t nb_records, uint32_t nb_dropped)
+{
+	RecordCheck *check = (RecordCheck *)context;
+
+	check->same = check->same && nb_records <= BENCH_STREAM_LENGTH - check->nb_records
+		&& memcmp(records, check->expected + check->nb_records, nb_records * sizeof(SmemLogRecord)) == 0;
+	check->nb_records += nb_records;
+	return check->same;
+}
+
+// Writes a stream to BENCH_CAPTURE_PATH as the reads of the device would, the file complete after each read
+static bool write_capture(const BenchStream *stream)
+{
+	SmemCaptureWriter *writer = (SmemCaptureWriter *)malloc(sizeof(SmemCaptureWriter));
+	bool ok = writer != NULL && capture_open(writer, BENCH_CAPTURE_PATH, 0, TIMESTAMP_CLOCK_RATE);
+
+	for (unsigned int i = 0; ok && i < BENCH_STREAM_LENGTH; i += BENCH_CAPTURE_READ) {
+		ok = capture_append(writer, &stream->records[i], BENCH_CAPTURE_READ, 0) && capture_sync(writer);
+	}
+	if (writer != NULL && writer->file != NULL) {
+		ok = capture_close(writer) && ok;
+	}
+	free(writer);
+	return ok;
+}
+
+// Text written to a file from its start, NULL if it cannot be read
+static char *read_back(FILE *file)
+{
+	long size = ftell(file);
+	char *text = size >= 0 ? (char *)malloc(size + 1) : NULL;
+
+	rewind(file);
+	if (text != NULL && fread(text, 1, size, file) == (size_t)size) {
+		text[size] = '\0';
+		return text;
+	}
+	free(text);
+	return NULL;
+}
+
+// JSON lines of the events of BENCH_CAPTURE_PATH in a time window, NULL if it cannot be decoded
+static char *decode_capture_lines(const SmemTimeWindow *window)
+{
+	FILE *file = NULL;
+	char *text = NULL;
+
+	if (fopen_s(&file, BENCH_CAPTURE_TEXT_PATH, "w+b") != 0) {
+		return NULL;
+	}
+	if (decode_capture_file(BENCH_CAPTURE_PATH, window, NULL, FALSE, TRUE, file) == EXIT_SUCCESS) {
+		text = read_back(file);
+	}
+	fclose(file);
+	remove(BENCH_CAPTURE_TEXT_PATH);
+	return text;
+}
+
+// The events of a time window are the ones of the whole capture whose first record falls in it
+static bool check_capture_window(const BenchStream *stream)
+{
+	SmemTimebase timebase;
+	uint64_t since = 0, until = 0;
+
+	// From a first record after a third of the stream, past the blocks read before the window, up to
+	// the record before a first record after two thirds: the continuation records at both ends follow
+	// a first record on the same side of the window
+	timebase_init(&timebase, TIMESTAMP_CLOCK_RATE);
+	uint64_t last = 0;
+	for (unsigned int i = 0; i < BENCH_STREAM_LENGTH && until == 0; i++) {
+		uint64_t time = timebase_extend(&timebase, stream->records[i].timestamp);
+		if ((stream->records[i].id & CONTINUE_MASK) == 0) {
+			if (since == 0 && i >= BENCH_STREAM_LENGTH / 3) since = time;
+			if (i >= 2 * BENCH_STREAM_LENGTH / 3 && time > last) until = last;
+		}
+		last = time;
+	}
+	SmemTimeWindow all = { 0, -1 };
+	SmemTimeWindow window = { (double)since / TIMESTAMP_CLOCK_RATE, (double)until / TIMESTAMP_CLOCK_RATE };
+	// The ticks of decode_capture_file
+	since = (uint64_t)(window.since * TIMESTAMP_CLOCK_RATE);
+	until = (uint64_t)(window.until * TIMESTAMP_CLOCK_RATE);
+
+	char *full = decode_capture_lines(&all);
+	char *part = decode_capture_lines(&window);
+	bool same = full != NULL && part != NULL;
+	size_t at = 0;
+	unsigned int nb_lines = 0;
+	for (char *line = full; same && *line != '\0'; nb_lines++) {
+		char *end = strchr(line, '\n');
+		const char *key = strstr(line, "\"time\":");
+		same = end != NULL && key != NULL && key < end;
+		if (!same) {
+			break;
+		}
+		uint64_t time = (uint64_t)strtod(key + strlen("\"time\":"), NULL);
+		if (time >= since && time <= until) {
+			size_t length = end + 1 - line;
+			same = strncmp(part + at, line, length) == 0;
+			at += length;
+		}
+		line = end + 1;
+	}
+	same = same && at > 0 && part[at] == '\0';
+
+	free(full);
+	free(part);
+	return same;
+}
+
+// The capture file of a stream reads back to its records, and decodes a time window as the whole file
+static bool check_capture(void)
+{
+	BenchStream *stream = new_streams(1, 2);
+	bool same = stream != NULL && write_capture(stream);
+
+	if (same) {
+		RecordCheck check = { stream->records, 0, TRUE };
+		same = read_input_file(BENCH_CAPTURE_PATH, 1, compare_records, &check) == EXIT_SUCCESS
+			&& check.same && check.nb_records == BENCH_STREAM_LENGTH;
+	}
+	if (same && !check_capture_window(stream)) {
+		printf("The events of a time window differ from the ones of the whole capture\n");
+		same = FALSE;
+	}
+	remove(BENCH_CAPTURE_PATH);
+	free_streams(stream, 1);
+	return same;
+}
+
+// Counting of a stream by --stats, in ns per record
+static void bench_stats(unsigned int iterations)
+{
+	LARGE_INTEGER freq, start, end;
+
+	BenchStream *stream = new_streams(1, 1);
+	SmemStats *stats = (SmemStats *)malloc(sizeof(SmemStats));
+	if (stream == NULL || stats == NULL) {
+		printf("Failed to allocate the counters of the stream\n");
+		free_streams(stream, 1);
+		free(stats);
+		return;
+	}
+	stats_init(stats, TIMESTAMP_CLOCK_RATE);
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&start);
+	for (unsigned int i = 0; i < iterations; i++) {
+		stats_add(stats, stream->records, BENCH_STREAM_LENGTH, 0);
+	}
+	QueryPerformanceCounter(&end);
+	double stats_ns = elapsed_ns(&start, &end, &freq) / ((double)iterations * BENCH_STREAM_LENGTH);
+	printf("Stats: %.1f ns/record\n", stats_ns);
+	add_result("stats_add", "synthetic", stats_ns, "ns/record");
+
+	free_streams(stream, 1);
+	free(stats);
+}
+
+// Producers of the polling check, at a steady rate, in bursts or in spikes
+static const SmemPollPhase POLL_IDLE[] = { { 1000, 1 } };
+static const SmemPollPhase POLL_STEADY[] = { { 1000, 400 } };
+static const SmemPollPhase POLL_BUSY[] = { { 1000, 6000 } };
+static const SmemPollPhase POLL_BURSTS[] = { { 2000, 10 }, { 1000, 5000 } };
+static const SmemPollPhase POLL_SPIKES[] = { { 5000, 20 }, { 200, 20000 } };
+
+typedef struct {
+	const char *name;
+	const SmemPollPhase *phases;
+	unsigned int nb_phases;
+	bool fewer_wakeups;         // The adaptive polling must also wake up less often than the fixed one
+} PollProfile;
+
+#define POLL_PROFILE(name, phases, fewer_wakeups) { name, phases, _countof(phases), fewer_wakeups }
+
+static const PollProfile POLL_PROFILES[] = {
+	POLL_PROFILE("idle", POLL_IDLE, TRUE),
+	POLL_PROFILE("steady", POLL_STEADY, TRUE),
+	POLL_PROFILE("busy", POLL_BUSY, FALSE),
+	POLL_PROFILE("bursts", POLL_BURSTS, FALSE),
+	POLL_PROFILE("spikes", POLL_SPIKES, FALSE)
+};
+
+#define BENCH_POLL_DURATION 600000      // Ten simulated minutes
+
+// Fixed 500 ms polling, then adaptive, on a simulated producer
+static void simulate_polling(const PollProfile *profile, SmemPollSimResult results[2])
+{
+	for (unsigned int adaptive = 0; adaptive < 2; adaptive++) {
+		poll_simulate(profile->phases, profile->nb_phases, BENCH_POLL_DURATION, adaptive != 0, &results[adaptive]);
+	}
+}
+
+// Adaptive polling against the fixed 500 ms, on simulated producers
+static void bench_polling(void)
+{
+	printf("%-10s %-10s %10s %10s %10s %10s\n", "producer", "polling", "records", "dropped", "wakeups", "empty");
+	for (unsigned int p = 0; p < _countof(POLL_PROFILES); p++) {
+		SmemPollSimResult results[2];
+
+		simulate_polling(&POLL_PROFILES[p], results);
+		for (unsigned int adaptive = 0; adaptive < 2; adaptive++) {
+			const SmemPollSimResult *result = &results[adaptive];
+			printf("%-10s %-10s %10llu %10llu %10llu %10llu\n", POLL_PROFILES[p].name, adaptive ? "adaptive" : "fixed",
+				(unsigned long long)result->nb_produced, (unsigned long long)result->nb_dropped,
+				(unsigned long long)result->nb_wakeups, (unsigned long long)result->nb_empty_wakeups);
+		}
+	}
+}
+
+// Adaptive polling drops no more records than the fixed one, whatever the producer, and wakes up
+// less often when the producer is idle or steady
+static bool check_polling(void)
+{
+	bool better = TRUE;
+
+	for (unsigned int p = 0; p < _countof(POLL_PROFILES); p++) {
+		SmemPollSimResult results[2];
+
+		simulate_polling(&POLL_PROFILES[p], results);
+		if (results[1].nb_dropped > results[0].nb_dropped) {
+			printf("Adaptive polling drops more records than the fixed one with the %s producer\n", POLL_PROFILES[p].name);
+			better = FALSE;
+		}
+		if (POLL_PROFILES[p].fewer_wakeups && results[1].nb_wakeups >= results[0].nb_wakeups) {
+			printf("Adaptive polling wakes up as often as the fixed one with the %s producer\n", POLL_PROFILES[p].name);
+			better = FALSE;
+		}
+	}
+	return better;
+}
+
+// Line headers of each processor and raw lines of the corpus, in ns per line
+static void bench_lines(unsigned int iterations)
+{
+	static const uint32_t PROC_FLAGS[] = { 0x00000000, 0x40000000, 0x80000000, 0xC0000000 };
+	LARGE_INTEGER freq, start, end;
+	SmemDecoderState state;
+
+	QueryPerformanceFrequency(&freq);
+	decoder_state_init(&state, TIMESTAMP_CLOCK_RATE);
+	printf("%-18s %-10s %12s\n", "printer", "time", "ns/line");
+
+	for (unsigned int ticks = 0; ticks < 2; ticks++) {
+		QueryPerformanceCounter(&start);
+		for (unsigned int i = 0; i < iterations; i++) {
+			outbuf_reset(&state.out);
+			for (unsigned int p = 0; p < _countof(PROC_FLAGS); p++) {
+				print_line_header(&state, PROC_FLAGS[p], (uint64_t)i * 12345, ticks != 0);
+			}
+		}
+		QueryPerformanceCounter(&end);
+		double ns = elapsed_ns(&start, &end, &freq) / ((double)iterations * _countof(PROC_FLAGS));
+		printf("%-18s %-10s %12.1f\n", "print_line_header", ticks ? "ticks" : "seconds", ns);
+		add_result("print_line_header", ticks ? "ticks" : "seconds", ns, "ns/line");
+	}
+
+	QueryPerformanceCounter(&start);
+	for (unsigned int i = 0; i < iterations; i++) {
+		outbuf_reset(&state.out);
+		for (unsigned int r = 0; r < _countof(BENCH_CORPUS); r++) {
+			print_raw_event(&state.out, BENCH_CORPUS[r]);
+		}
+	}
+	QueryPerformanceCounter(&end);
+	double ns = elapsed_ns(&start, &end, &freq) / ((double)iterations * _countof(BENCH_CORPUS));
+	printf("%-18s %-10s %12.1f\n", "print_raw_event", "", ns);
+	add_result("print_raw_event", "corpus", ns, "ns/line");
+
+	decoder_state_free(&state);
+}
+
+// The body of the live read loop on a stream, decoded, raw, verbose and JSON, in ns per record.
+// The text is discarded after each batch as the writer thread would write it.
+static void bench_loop(unsigned int passes, const SmemLogRecord *records, size_t nb_records, uint32_t clock_rate, const char *corpus)
+{
+	static const char *MODES[] = { "decoded", "raw", "verbose", "json" };
+	LARGE_INTEGER freq, start, end;
+	SmemDecoderState state;
+
+	QueryPerformanceFrequency(&freq);
+	for (unsigned int m = 0; m < _countof(MODES); m++) {
+		decoder_state_init(&state, clock_rate);
+		state.json = m == 3;
+		state.verbose = m == 2;
+		QueryPerformanceCounter(&start);
+		for (unsigned int i = 0; i < passes; i++) {
+			for (size_t r = 0; r < nb_records; r += SMEM_PIPE_BATCH_RECORDS) {
+				size_t n = nb_records - r < SMEM_PIPE_BATCH_RECORDS ? nb_records - r : SMEM_PIPE_BATCH_RECORDS;
+				pipe_decode(&state, records + r, (uint32_t)n, m == 1, m == 2);
+				outbuf_reset(&state.out);
+			}
+		}
+		QueryPerformanceCounter(&end);
+		decoder_state_free(&state);
+
+		double ns = elapsed_ns(&start, &end, &freq) / ((double)passes * nb_records);
+		char name[48];
+		printf("%-18s %-10s %12.1f\n", corpus, MODES[m], ns);
+		_snprintf_s(name, sizeof(name), _TRUNCATE, "%s %s", corpus, MODES[m]);
+		add_result("loop", name, ns, "ns/record");
+	}
+}
+
+// Checks the JSON value at p, returns the character after it, NULL if it is not valid JSON
+static const char *check_json_value(const char *p)
+{
+	switch (*p) {
+	case '{':
+	case '[': {
+		bool object = *p == '{';
+		char close = object ? '}' : ']';
+		if (*++p == close) {
+			return p + 1;
+		}
+		for (;;) {
+			if (object && (*p != '"' || (p = check_json_value(p)) == NULL || *p++ != ':')) {
+				return NULL;
+			}
+			if ((p = check_json_value(p)) == NULL) {
+				return NULL;
+			}
+			if (*p == close) {
+				return p + 1;
+			}
+			if (*p++ != ',') {
+				return NULL;
+			}
+		}
+	}
+	case '"':
+		for (p++; *p != '"'; p++) {
+			if ((unsigned char)*p < 0x20) {
+				return NULL;
+			}
+			if (*p == '\\') {
+				p++;
+				if (*p == 'u') {
+					for (unsigned int i = 1; i <= 4; i++) {
+						if (!isxdigit((unsigned char)p[i])) return NULL;
+					}
+					p += 4;
+				}
+				else if (*p == '\0' || strchr("\"\\/bfnrt", *p) == NULL) {
+					return NULL;
+				}
+			}
+		}
+		return p + 1;
+	case 't':
+		return strncmp(p, "true", 4) == 0 ? p + 4 : NULL;
+	case 'f':
+		return strncmp(p, "false", 5) == 0 ? p + 5 : NULL;
+	case 'n':
+		return strncmp(p, "null", 4) == 0 ? p + 4 : NULL;
+	default:
+		// -?(0|[1-9][0-9]*)(.[0-9]+)?
+		if (*p == '-') p++;
+		if (!isdigit((unsigned char)*p)) return NULL;
+		if (*p++ != '0') {
+			while (isdigit((unsigned char)*p)) p++;
+		}
+		if (*p == '.') {
+			if (!isdigit((unsigned char)*++p)) return NULL;
+			while (isdigit((unsigned char)*p)) p++;
+		}
+		return p;
+	}
+}
+
+// Every event of the JSON decoding is an object on a line of its own, as the lines of the text decoding
+static bool check_json_lines(void)
+{
+	BenchStream *stream = new_streams(1, 5);
+	bool ok = stream != NULL;
+	size_t nb_text = 0, nb_json = 0;
+
+	if (!ok) {
+		return FALSE;
+	}
+	decode_stream(stream);
+	flush_events(&stream->state);
+	for (size_t i = 0; i < stream->state.out.size; i++) {
+		nb_text += stream->state.out.data[i] == '\n';
+	}
+	decoder_state_free(&stream->state);
+
+	decoder_state_init(&stream->state, TIMESTAMP_CLOCK_RATE);
+	stream->state.json = TRUE;
+	decode_stream(stream);
+	flush_events(&stream->state);
+	emit_char(&stream->state.out, '\0');
+	for (char *line = stream->state.out.data; ok && *line != '\0'; nb_json++) {
+		char *end = strchr(line, '\n');
+		ok = end != NULL && *line == '{' && check_json_value(line) == end;
+		if (!ok) {
+			break;
+		}
+		// A continuation record alone is an object, its text goes after the last line
+		*end = '\0';
+		nb_json -= strstr(line, "\"continuation\":true") != NULL;
+		line = end + 1;
+	}
+	ok = ok && nb_json == nb_text;
+
+	free_streams(stream, 1);
+	return ok;
+}
+
+typedef struct {
+	SmemLogRecord *records;
+	size_t nb_records;
+} RecordedCorpus;
+
+static bool keep_records(void *context, const SmemLogRecord *records, size_t nb_records, uint32_t nb_dropped)
+{
+	RecordedCorpus *corpus = (RecordedCorpus *)context;
+
+	if (nb_records > BENCH_MAX_RECORDED - corpus->nb_records) {
+		nb_records = BENCH_MAX_RECORDED - corpus->nb_records;
+	}
+	memcpy(corpus->records + corpus->nb_records, records, nb_records * sizeof(SmemLogRecord));
+	corpus->nb_records += nb_records;
+	// Enough to time, the rest of the file is not read
+	return corpus->nb_records < BENCH_MAX_RECORDED;
+}
+
+// Writes a JSON string, escaped
+static void write_json_string(FILE *file, const char *text)
+{
+	fputc('"', file);
+	for (; *text != '\0'; text++) {
+		if ((unsigned char)*text < 0x20) {
+			fprintf(file, "\\u%04x", *text);
+			continue;
+		}
+		if (*text == '"' || *text == '\\') fputc('\\', file);
+		fputc(*text, file);
+	}
+	fputc('"', file);
+}
+
+static bool write_json(const char *path, unsigned int iterations, const char *corpus_path, size_t nb_recorded)
+{
+	FILE *file = NULL;
+	if (fopen_s(&file, path, "w") != 0) {
+		printf("Failed to create %s\n", path);
+		return FALSE;
+	}
+
+	fprintf(file, "{\n  \"iterations\": %u,\n  \"parser\": ", iterations);
+	write_json_string(file, parser_name(best_parser()));
+	fprintf(file, ",\n  \"corpus\": ");
+	if (corpus_path != NULL) {
+		write_json_string(file, corpus_path);
+	}
+	else {
+		fprintf(file, "null");
+	}
+	fprintf(file, ",\n  \"corpus_records\": %llu,\n  \"results\": [", (unsigned long long)nb_recorded);
+	for (unsigned int r = 0; r < bench_nb_results; r++) {
+		const BenchResult *result = &bench_results[r];
+		fprintf(file, "%s\n    { \"group\": ", r > 0 ? "," : "");
+		write_json_string(file, result->group);
+		fprintf(file, ", \"name\": ");
+		write_json_string(file, result->name);
+		fprintf(file, ", \"value\": %.3f, \"unit\": ", result->value);
+		write_json_string(file, result->unit);
+		fprintf(file, " }");
+	}
+	fprintf(file, "\n  ]\n}\n");
+
+	if (fclose(file) != 0) {
+		printf("Failed to write %s\n", path);
+		return FALSE;
+	}
+	printf("Results written to %s\n", path);
+	return TRUE;
+}
+
+int run_bench(unsigned int iterations, const char *corpus_path, unsigned int nb_jobs, uint32_t clock_rate, const char *json_path)
+{
+	LARGE_INTEGER freq, start, end;
+	unsigned int nb_records = _countof(BENCH_CORPUS);
+	SmemDecoderState state;
+	SmemOutBuffer *out = &state.out;
+	RecordedCorpus recorded = { NULL, 0 };
+
+	if (corpus_path != NULL) {
+		recorded.records = (SmemLogRecord *)malloc(BENCH_MAX_RECORDED * sizeof(SmemLogRecord));
+		if (recorded.records == NULL) {
+			printf("Failed to allocate the recorded corpus\n");
+			return EXIT_FAILURE;
+		}
+		// Stopped by keep_records on a long file
+		read_input_file(corpus_path, nb_jobs, keep_records, &recorded);
+		if (recorded.nb_records == 0) {
+			printf("No record in %s\n", corpus_path);
+			free(recorded.records);
+			return EXIT_FAILURE;
+		}
+	}
+
+	bench_nb_results = 0;
+	QueryPerformanceFrequency(&freq);
+	decoder_state_init(&state, TIMESTAMP_CLOCK_RATE);
+
+	printf("%-10s %-10s %12s\n", "id", "decoder", "ns/record");
+
+	for (unsigned int r = 0; r < nb_records; r++) {
+		const SmemLogRecord *rec = &BENCH_CORPUS[r];
+
+		QueryPerformanceCounter(&start);
+		for (unsigned int i = 0; i < iterations; i++) {
+			// The text is discarded: only the decoding and the formatting are measured
+			outbuf_reset(out);
+			print_record(&state, rec);
+		}
+		QueryPerformanceCounter(&end);
+
+		double ns = elapsed_ns(&start, &end, &freq) / iterations;
+		char name[48];
+		printf("0x%08x %-10s %12.1f\n", rec->id, find_decoder(rec->id)->name, ns);
+		_snprintf_s(name, sizeof(name), _TRUNCATE, "0x%08x %s", rec->id, find_decoder(rec->id)->name);
+		add_result("print_record", name, ns, "ns/record");
+	}
+
+	// Whole corpus, so that consecutive records go to different decoders
+	QueryPerformanceCounter(&start);
+	for (unsigned int i = 0; i < iterations; i++) {
+		outbuf_reset(out);
+		for (unsigned int r = 0; r < nb_records; r++) {
+			print_record(&state, &BENCH_CORPUS[r]);
+		}
+	}
+	QueryPerformanceCounter(&end);
+
+	double all_ns = elapsed_ns(&start, &end, &freq) / ((double)iterations * nb_records);
+	printf("%-10s %-10s %12.1f\n", "all", "", all_ns);
+	add_result("print_record", "all", all_ns, "ns/record");
+
+	decoder_state_free(&state);
+
+	bench_dispatch(iterations / 1000 + 1);
+	bench_lines(iterations);
+	// A synthetic stream, then the records of the file, about as many of them
+	BenchStream *stream = new_streams(1, 1);
+	if (stream != NULL) {
+		printf("%-18s %-10s %12s\n", "loop", "mode", "ns/record");
+		bench_loop(iterations / 1000 + 1, stream->records, BENCH_STREAM_LENGTH, TIMESTAMP_CLOCK_RATE, "synthetic");
+		free_streams(stream, 1);
+	}
+	if (recorded.nb_records > 0) {
+		unsigned int passes = (unsigned int)((uint64_t)(iterations / 1000 + 1) * BENCH_STREAM_LENGTH / recorded.nb_records) + 1;
+		bench_loop(passes, recorded.records, recorded.nb_records, input_clock_rate(corpus_path, clock_rate), "recorded");
+		free(recorded.records);
+	}
+
+	bench_parsers(iterations / 1000 + 1);
+	bench_archive(iterations / 1000 + 1);
+	bench_stats(iterations / 1000 + 1);
+	bench_polling();
+
+	if (json_path != NULL && !write_json(json_path, iterations, corpus_path, recorded.nb_records)) {
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+// Tick counts with the text of emit_seconds
+typedef struct {
+	uint32_t clock_rate;
+	uint64_t ticks;
+	const char *text;
+} SecondsCase;
+
+static const SecondsCase SECONDS_CASES[] = {
+	{ SLEEP_CLOCK_RATE, 256, "      0.007813" },           // 7812.5 us, a tie (ticks = 256 mod 512)
+	{ SLEEP_CLOCK_RATE, 768, "      0.023438" },           // 23437.5 us
+	{ SLEEP_CLOCK_RATE, 98305, "      3.000031" },
+	{ HT_TIMER_CLOCK_RATE, 48, "      0.000003" },         // 2.5 us
+	{ HT_TIMER_CLOCK_RATE, 19199999, "      1.000000" }    // Rounded up to the next second
+};
+
+// The microseconds are rounded half away from zero, as the printf of the Visual Studio CRT
+static bool check_seconds(void)
+{
+	SmemTimebase timebase;
+	SmemOutBuffer out;
+	bool same = TRUE;
+
+	outbuf_init(&out, 64);
+	for (unsigned int c = 0; c < _countof(SECONDS_CASES); c++) {
+		const SecondsCase *test = &SECONDS_CASES[c];
+		timebase_init(&timebase, test->clock_rate);
+		outbuf_reset(&out);
+		emit_seconds(&out, &timebase, test->ticks);
+		if (out.size != strlen(test->text) || memcmp(out.data, test->text, out.size) != 0) {
+			printf("%llu ticks at %u Hz are not printed as \"%s\"\n", (unsigned long long)test->ticks, test->clock_rate, test->text);
+			same = FALSE;
+		}
+	}
+	outbuf_free(&out);
+	return same;
+}
+
+// Timestamps extended one after the other by a timebase, with their expected tick counts
+typedef struct {
+	uint32_t timestamp;
+	uint64_t time;
+} ExtendCase;
+
+static const ExtendCase EXTEND_CASES[] = {
+	{ 100, 100 },
+	{ 0xFFFFFF00, 0 },                    // Before tick 0: clamped
+	{ 200, 200 },                         // Still after the first record
+	{ 150, 150 },                         // Out of order between processors
+	{ 0x80000000, 0x80000000 },
+	{ 0xFFFFFFF0, 0xFFFFFFF0 },
+	{ 0x10, 0x100000010ULL },             // Wrap
+	{ 0xFFFFFFF8, 0xFFFFFFF8 }            // Back across the wrap
+};
+
+static bool check_timebase(void)
+{
+	SmemTimebase timebase;
+	bool same = TRUE;
+
+	timebase_init(&timebase, SLEEP_CLOCK_RATE);
+	for (unsigned int c = 0; c < _countof(EXTEND_CASES); c++) {
+		uint64_t time = timebase_extend(&timebase, EXTEND_CASES[c].timestamp);
+		if (time != EXTEND_CASES[c].time) {
+			printf("Timestamp 0x%08x is extended to 0x%llx instead of 0x%llx\n", EXTEND_CASES[c].timestamp,
+				(unsigned long long)time, (unsigned long long)EXTEND_CASES[c].time);
+			same = FALSE;
+		}
+	}
+	return same;
+}
+
+// A QCCI request around a TIMETICK record, then a continuation record without its first record
+static const SmemLogRecord VERBOSE_RECORDS[] = {
+	{ 0xC00E0004, 0x00000100, 0x00000001, 0x0020008E, 0x0000000B },
+	{ 0x00040000, 0x00000108, 0x07FFF800, 0x00000059, 0x0000F566 },
+	{ 0xD00E0004, 0x00000110, 0x00000002, 0x00000020, 0x00000000 },
+	{ 0xD00E0004, 0x00000120, 0x00000002, 0x00000025, 0x00000000 }
+};
+
+// The words of the first record of an event go with its text, printed once the event is complete,
+// the ones of its continuation record on the next line
+static const char VERBOSE_TEXT[] =
+	"00040000 00000108 07FFF800 00000059 0000F566 MODM:       0.008057    TIMETICK: START 0x07fff800 0x00000059 0x0000f566\n"
+	"C00E0004 00000100 00000001 0020008E 0000000B WCNS:       0.007813    QCCI:   TX REQ  Txn:0x1 Msg:0x20 Len:142 svc_id:0xb svc_addr: 0002:0020:0000\n"
+	"D00E0004 00000110 00000002 00000020 00000000\n"
+	"D00E0004 00000120 00000002 00000025 00000000  svc_addr: 0002:0025:0000\n";
+
+static bool check_verbose(void)
+{
+	SmemDecoderState state;
+
+	decoder_state_init(&state, SLEEP_CLOCK_RATE);
+	state.verbose = TRUE;
+	for (unsigned int r = 0; r < _countof(VERBOSE_RECORDS); r++) {
+		print_event(&state, &VERBOSE_RECORDS[r], FALSE, FALSE);
+	}
+	flush_events(&state);
+	bool same = state.out.size == strlen(VERBOSE_TEXT) && memcmp(state.out.data, VERBOSE_TEXT, state.out.size) == 0;
+	if (!same) {
+		printf("Verbose text:\n%.*s", (int)state.out.size, state.out.data);
+	}
+	decoder_state_free(&state);
+	return same;
+}
+
+// Filter expressions with a record and the verdict of filter_match
+typedef struct {
+	const char *text;
+	SmemLogRecord rec;
+	bool match;
+} FilterCase;
+
+static const FilterCase FILTER_CASES[] = {
+	{ "proc=APPS",                            { 0x800D0001, 0, 0, 0, 0 }, TRUE },
+	{ "proc!=APPS",                           { 0x800D0001, 0, 0, 0, 0 }, FALSE },
+	{ "proc!=APPS",                           { 0x400D0002, 0, 0, 0, 0 }, TRUE },
+	{ "base=QCCI & event=4",                  { 0xC00E0004, 0, 0, 0, 0 }, TRUE },
+	{ "base=QCCI & event!=4",                 { 0xC00E0004, 0, 0, 0, 0 }, FALSE },
+	{ "base=qcci",                            { 0x900E0004, 0, 0, 0, 0 }, TRUE },    // Continuation flags are not part of the base
+	{ "base!=QCCI & base!=QCSI",              { 0x800F0005, 0, 0, 0, 0 }, FALSE },
+	{ "base!=QCCI & base!=QCSI",              { 0x800D0001, 0, 0, 0, 0 }, TRUE },
+	{ "base=QCCI & base=QCSI",                { 0x800E0004, 0, 0, 0, 0 }, FALSE },   // A group which cannot match
+	{ "base=QCCI & base=QCSI | proc=APPS",    { 0x800E0004, 0, 0, 0, 0 }, TRUE },
+	{ "proc=MODM & base=TIMETICK | base=QCCI", { 0x800E0005, 0, 0, 0, 0 }, TRUE },   // Second group
+	{ "proc=MODM & base=TIMETICK | base=QCCI", { 0x00040000, 0, 0, 0, 0 }, TRUE },   // First group
+	{ "proc=MODM & base=TIMETICK | base=QCCI", { 0x800D0001, 0, 0, 0, 0 }, FALSE },
+	{ "proc=MODM & base=TIMETICK | base=QCCI", { 0x80040000, 0, 0, 0, 0 }, FALSE },
+	{ "d1=0x39d | d2=5",                      { 0x800E0004, 0, 0x39D, 0, 0 }, TRUE },
+	{ "d1=0x39d | d2=5",                      { 0x800E0004, 0, 1, 5, 0 }, TRUE },
+	{ "d1=0x39d | d2=5",                      { 0x800E0004, 0, 1, 4, 0 }, FALSE },
+	{ "id=0x800E0004 & d3!=0",                { 0x800E0004, 0, 0, 0, 0 }, FALSE }
+};
+
+// Records of a stream with the verdict of select_record for SELECT_FILTER: continuation records follow their first record
+#define SELECT_FILTER "proc=APPS & base=QCCI | d1=7"
+
+static const FilterCase SELECT_CASES[] = {
+	{ NULL, { 0x800E0004, 0x100, 1, 0x00200030, 0x22 }, TRUE },
+	{ NULL, { 0x900E0004, 0x100, 7, 0x25, 0 }, TRUE },
+	{ NULL, { 0x400E0004, 0x110, 2, 0x00200030, 0x22 }, FALSE },
+	{ NULL, { 0x500E0004, 0x110, 7, 0x25, 0 }, FALSE },           // Matches alone, but its first record does not
+	{ NULL, { 0x400D0001, 0x120, 7, 0x03000005, 0x01000040 }, TRUE },
+	{ NULL, { 0x500D0001, 0x120, 0, 0x123, 0 }, TRUE },
+	{ NULL, { 0x800E0005, 0x130, 3, 0x00200030, 0x22 }, TRUE },
+	{ NULL, { 0x400D0002, 0x140, 1, 0x03000005, 0x01000040 }, FALSE },
+	{ NULL, { 0x900E0005, 0x150, 3, 0x25, 0 }, TRUE }             // Its first record is in another slot
+};
+
+// The filters match as documented by filter_compile, select_record keeps the events whole
+static bool check_filter(void)
+{
+	SmemFilter filter;
+	bool same = TRUE;
+
+	for (unsigned int c = 0; c < _countof(FILTER_CASES); c++) {
+		const FilterCase *test = &FILTER_CASES[c];
+		if (!filter_compile(&filter, test->text) || filter_match(&filter, &test->rec) != test->match) {
+			printf("\"%s\" does not %s id 0x%08x\n", test->text, test->match ? "match" : "reject", test->rec.id);
+			same = FALSE;
+		}
+	}
+
+	SmemDecoderState state;
+	decoder_state_init(&state, SLEEP_CLOCK_RATE);
+	same = filter_compile(&filter, SELECT_FILTER) && same;
+	state.filter = &filter;
+	for (unsigned int r = 0; r < _countof(SELECT_CASES); r++) {
+		const SmemLogRecord *rec = &SELECT_CASES[r].rec;
+		bool selected = select_record(&state, rec);
+		if (selected != SELECT_CASES[r].match) {
+			printf("Record %u (id 0x%08x) is not %s\n", r, rec->id, SELECT_CASES[r].match ? "selected" : "skipped");
+			same = FALSE;
+		}
+		// As the decoding loops, which start the events of the records selected
+		if (selected) print_event(&state, rec, FALSE, TRUE);
+	}
+	decoder_state_free(&state);
+	return same;
+}
+
+// Times of the matches reported by a tracker
+typedef struct {
+	unsigned int count;
+	uint64_t start[8];
+	uint64_t end[8];
+} MatchTimes;
+
+static void add_match(MatchTimes *matches, uint64_t start, uint64_t end)
+{
+	if (matches->count < _countof(matches->start)) {
+		matches->start[matches->count] = start;
+		matches->end[matches->count] = end;
+	}
+	matches->count++;
+}
+
+static bool same_matches(const MatchTimes *matches, const uint64_t (*expected)[2], unsigned int count)
+{
+	bool same = matches->count == count;
+
+	for (unsigned int m = 0; same && m < count; m++) {
+		same = matches->start[m] == expected[m][0] && matches->end[m] == expected[m][1];
+	}
+	if (!same) {
+		printf("%u matches:", matches->count);
+		for (unsigned int m = 0; m < matches->count && m < _countof(matches->start); m++) {
+			printf(" %llu-%llu", (unsigned long long)matches->start[m], (unsigned long long)matches->end[m]);
+		}
+		printf("\n");
+	}
+	return same;
+}
+
+// IPC Router messages from 0x01000005 at the sleep clock, the timeout is 327680 ticks
+static const SmemLogRecord ROUTER_RECORDS[] = {
+	{ 0x800D0001, 100, 0x01000005, 0x03000040, 0x01000020 },
+	{ 0x900D0001, 100, 0x01000005, 0x03000040, 0x01000020 },     // Continuation, not a message
+	{ 0x800D0001, 150, 0x01000005, 0x03000040, 0x01000020 },     // Same key
+	{ 0x800D0001, 200, 0x01000005, 0x03000041, 0x01000010 },     // Other destination, never received
+	{ 0x400D0002, 400, 0x01000005, 0x03000040, 0x01000020 },     // Oldest TX first
+	{ 0x400D0002, 500, 0x01000005, 0x03000040, 0x01000020 },
+	{ 0x400D0002, 600, 0x01000005, 0x03000040, 0x01000020 },     // No TX left
+	{ 0x400D0002, 700, 0x01000005, 0x03000041, 0x02000010 },     // Other type
+	{ 0x80090011, 800, 0x01000006, 0x03000042, 0x01000008 },     // BW compatible TX and RX
+	{ 0x40090012, 900, 0x01000006, 0x03000042, 0x01000008 },
+	{ 0x800D0001, 200 + 327680, 0x01000007, 0x03000040, 0x01000000 },  // The TX at 200 still waits
+	{ 0x800D0001, 201 + 327680, 0x01000007, 0x03000040, 0x01000000 }   // but no longer
+};
+
+static const uint64_t ROUTER_MATCHES[][2] = { { 100, 400 }, { 150, 500 }, { 800, 900 } };
+
+static void record_router_match(void *context, const SmemRouterPending *tx, const SmemRouterMessage *rx, uint64_t time)
+{
+	add_match((MatchTimes *)context, tx->time, time);
+}
+
+// TX and RX of the same key match oldest first, the TX without RX are evicted after the timeout
+static bool check_router(void)
+{
+	SmemRouterTracker *tracker = (SmemRouterTracker *)malloc(sizeof(SmemRouterTracker));
+	MatchTimes matches;
+
+	if (tracker == NULL) {
+		return FALSE;
+	}
+	memset(&matches, 0, sizeof(matches));
+	router_tracker_init(tracker, SLEEP_CLOCK_RATE);
+	tracker->on_match = record_router_match;
+	tracker->match_context = &matches;
+	router_tracker_add(tracker, ROUTER_RECORDS, _countof(ROUTER_RECORDS) - 1);
+	bool same = tracker->nb_evicted == 0;
+	if (!same) {
+		printf("Router: TX evicted at the timeout\n");
+	}
+	router_tracker_add(tracker, &ROUTER_RECORDS[_countof(ROUTER_RECORDS) - 1], 1);
+
+	same = same_matches(&matches, ROUTER_MATCHES, _countof(ROUTER_MATCHES)) && same;
+	if (tracker->nb_tx != 6 || tracker->nb_rx != 5 || tracker->nb_matched != 3 || tracker->nb_unmatched_rx != 2 || tracker->nb_evicted != 1) {
+		printf("Router: %llu TX, %llu RX, %llu matched, %llu unmatched, %llu evicted\n",
+			(unsigned long long)tracker->nb_tx, (unsigned long long)tracker->nb_rx, (unsigned long long)tracker->nb_matched,
+			(unsigned long long)tracker->nb_unmatched_rx, (unsigned long long)tracker->nb_evicted);
+		same = FALSE;
+	}
+	if (tracker->latency.count != 3 || tracker->latency.min != 100 || tracker->latency.max != 350) {
+		printf("Router latency: %llu values from %llu to %llu\n", (unsigned long long)tracker->latency.count,
+			(unsigned long long)tracker->latency.min, (unsigned long long)tracker->latency.max);
+		same = FALSE;
+	}
+	free(tracker);
+	return same;
+}
+
+// QCCI requests of the service 0xb at the sleep clock, the timeout is 327680 ticks
+static const SmemLogRecord QMI_RECORDS[] = {
+	{ 0x800E0004, 100, 0x00000001, 0x0020008E, 0x0000000B },
+	{ 0x900E0004, 100, 0x00000001, 0x00000020, 0x00000000 },     // Continuation, not a message
+	{ 0x800E0004, 150, 0x00000001, 0x0020008E, 0x0000000B },     // Same key
+	{ 0x800E0004, 200, 0x00000002, 0x0020008E, 0x0000000B },     // Other transaction, never answered
+	{ 0x800F0004, 300, 0x00000001, 0x0020008E, 0x0000000B },     // Server side
+	{ 0x800E0005, 400, 0x00020001, 0x00200010, 0x0000000B },     // Oldest request first
+	{ 0x800E0005, 500, 0x00020001, 0x00200010, 0x0000000B },
+	{ 0x800E0005, 600, 0x00020001, 0x00200010, 0x0000000B },     // No request left
+	{ 0x800E0005, 700, 0x00020002, 0x00210010, 0x0000000B },     // Other message
+	{ 0x800E0005, 750, 0x00040002, 0x00200010, 0x0000000B },     // Indication
+	{ 0x80010034, 800, 0x00000003, 0x00300010, 0x0000000C },     // BW compatible request and response
+	{ 0x80010035, 900, 0x00020003, 0x00300010, 0x0000000C },
+	{ 0x800E0004, 200 + 327680, 0x00000004, 0x0020008E, 0x0000000B },  // The request at 200 still waits
+	{ 0x800E0004, 201 + 327680, 0x00000005, 0x0020008E, 0x0000000B }   // but no longer
+};
+
+static const uint64_t QMI_MATCHES[][2] = { { 100, 400 }, { 150, 500 }, { 800, 900 } };
+
+static void record_qmi_match(void *context, const SmemQmiPending *request, uint64_t time)
+{
+	add_match((MatchTimes *)context, request->time, time);
+}
+
+// Requests and responses of the same service, transaction and message match oldest first,
+// the requests without response are evicted after the timeout
+static bool check_qmi(void)
+{
+	SmemQmiTracker *tracker = (SmemQmiTracker *)malloc(sizeof(SmemQmiTracker));
+	MatchTimes matches;
+
+	if (tracker == NULL) {
+		return FALSE;
+	}
+	memset(&matches, 0, sizeof(matches));
+	qmi_tracker_init(tracker, SLEEP_CLOCK_RATE);
+	tracker->on_match = record_qmi_match;
+	tracker->match_context = &matches;
+	qmi_tracker_add(tracker, QMI_RECORDS, _countof(QMI_RECORDS) - 1);
+	bool same = tracker->nb_evicted == 0;
+	if (!same) {
+		printf("QMI: request evicted at the timeout\n");
+	}
+	qmi_tracker_add(tracker, &QMI_RECORDS[_countof(QMI_RECORDS) - 1], 1);
+
+	same = same_matches(&matches, QMI_MATCHES, _countof(QMI_MATCHES)) && same;
+	if (tracker->nb_req != 6 || tracker->nb_resp != 5 || tracker->nb_matched != 3 || tracker->nb_unmatched_resp != 2 || tracker->nb_evicted != 1) {
+		printf("QMI: %llu requests, %llu responses, %llu matched, %llu unmatched, %llu evicted\n",
+			(unsigned long long)tracker->nb_req, (unsigned long long)tracker->nb_resp, (unsigned long long)tracker->nb_matched,
+			(unsigned long long)tracker->nb_unmatched_resp, (unsigned long long)tracker->nb_evicted);
+		same = FALSE;
+	}
+	if (tracker->latency.count != 3 || tracker->latency.min != 100 || tracker->latency.max != 350) {
+		printf("QMI latency: %llu values from %llu to %llu\n", (unsigned long long)tracker->latency.count,
+			(unsigned long long)tracker->latency.min, (unsigned long long)tracker->latency.max);
+		same = FALSE;
+	}
+	free(tracker);
+	return same;
+}
+
+#define SYNTH_CHECK_RECORDS 20000
+
+// First records of the default workload with the seed 7, at the sleep clock, from one run to another
+static const SmemLogRecord SYNTH_SEED7_HEAD[] = {
+	{ 0x00040000, 0xFFFF0000, 0x07FFF800, 0x00000025, 0x00005892 },
+	{ 0x400D0001, 0xFFFF0015, 0x02004003, 0x01004002, 0x01010411 },
+	{ 0x500D0001, 0xFFFF0015, 0x30727472, 0x0000118A, 0x6E6C7772 },
+	{ 0x000D0002, 0xFFFF001F, 0x02004003, 0x01004002, 0x01010411 },
+	{ 0x100D0002, 0xFFFF001F, 0x30727472, 0x000074D4, 0x6E6C7772 },
+	{ 0x40030000, 0xFFFF002C, 0x07FFF801, 0x000000C0, 0x00003D6E }
+};
+
+// Reads a whole generated stream, read_size records at a time, then its end
+static bool read_synth_stream(const SmemSynthConfig *config, uint32_t read_size, SmemLogRecord *records)
+{
+	SmemSynthSource source;
+	SmemReadResult result;
+	uint32_t nb_records = 0;
+
+	synth_source_init(&source, SYNTH_CHECK_RECORDS, config);
+	while (nb_records < SYNTH_CHECK_RECORDS) {
+		uint32_t max_records = SYNTH_CHECK_RECORDS - nb_records;
+		if (max_records > read_size) max_records = read_size;
+		if (!source.base.read(&source.base, &records[nb_records], max_records, &result) || result.nb_read == 0) {
+			printf("Synthetic stream ended after %u records\n", nb_records);
+			return FALSE;
+		}
+		nb_records += result.nb_read;
+	}
+	return !source.base.read(&source.base, records, read_size, &result) && !source.base.failed;
+}
+
+// The same seed gives the same records whatever the reads and the run, another seed other
+// records; the timestamps never decrease across their wrap, and the trackers find the RX
+// and responses of the generated TX and requests
+static bool check_synth(void)
+{
+	SmemLogRecord *records = (SmemLogRecord *)malloc(3 * SYNTH_CHECK_RECORDS * sizeof(SmemLogRecord));
+	SmemRouterTracker *router = (SmemRouterTracker *)malloc(sizeof(SmemRouterTracker));
+	SmemQmiTracker *qmi = (SmemQmiTracker *)malloc(sizeof(SmemQmiTracker));
+	SmemSynthConfig config;
+	bool same = records != NULL && router != NULL && qmi != NULL;
+
+	synth_config_init(&config, SLEEP_CLOCK_RATE);
+	same = same && synth_config_parse(&config, "seed=7");
+	same = same && read_synth_stream(&config, 64, records) && read_synth_stream(&config, 7, &records[SYNTH_CHECK_RECORDS]);
+	if (same && memcmp(records, &records[SYNTH_CHECK_RECORDS], SYNTH_CHECK_RECORDS * sizeof(SmemLogRecord)) != 0) {
+		printf("Seed 7 gives other records when read 7 at a time\n");
+		same = FALSE;
+	}
+	if (same && memcmp(records, SYNTH_SEED7_HEAD, sizeof(SYNTH_SEED7_HEAD)) != 0) {
+		printf("Seed 7 gives other records than in an earlier run\n");
+		same = FALSE;
+	}
+	same = same && synth_config_parse(&config, "seed=8") && read_synth_stream(&config, 64, &records[2 * SYNTH_CHECK_RECORDS]);
+	if (same && memcmp(records, &records[2 * SYNTH_CHECK_RECORDS], SYNTH_CHECK_RECORDS * sizeof(SmemLogRecord)) == 0) {
+		printf("Seeds 7 and 8 give the same records\n");
+		same = FALSE;
+	}
+
+	if (same) {
+		SmemTimebase timebase;
+		uint64_t last = 0;
+		timebase_init(&timebase, SLEEP_CLOCK_RATE);
+		for (unsigned int r = 0; r < SYNTH_CHECK_RECORDS; r++) {
+			uint64_t time = timebase_extend(&timebase, records[r].timestamp);
+			if (time < last) {
+				printf("Record %u goes back in time\n", r);
+				same = FALSE;
+				break;
+			}
+			last = time;
+		}
+		if (last >> 32 == 0) {
+			printf("The timestamps do not wrap\n");
+			same = FALSE;
+		}
+
+		router_tracker_init(router, SLEEP_CLOCK_RATE);
+		router_tracker_add(router, records, SYNTH_CHECK_RECORDS);
+		qmi_tracker_init(qmi, SLEEP_CLOCK_RATE);
+		qmi_tracker_add(qmi, records, SYNTH_CHECK_RECORDS);
+		if (router->nb_matched == 0 || router->nb_unmatched_rx != 0 || qmi->nb_matched == 0 || qmi->nb_unmatched_resp != 0) {
+			printf("Synthetic matches: %llu router, %llu unmatched; %llu QMI, %llu unmatched\n",
+				(unsigned long long)router->nb_matched, (unsigned long long)router->nb_unmatched_rx,
+				(unsigned long long)qmi->nb_matched, (unsigned long long)qmi->nb_unmatched_resp);
+			same = FALSE;
+		}
+	}
+	free(qmi);
+	free(router);
+	free(records);
+	return same;
+}
+
+// Reads of a log at the sleep clock: records dropped, then the timestamps of the records read.
+// 100 ms are 3276 ticks, a period 327680 ticks
+typedef struct {
+	uint32_t nb_dropped;
+	unsigned int nb_records;
+	uint32_t timestamps[2];
+} LossRead;
+
+static const LossRead LOSS_READS[] = {
+	{ 0, 2, { 1000, 2000 } },
+	{ 5, 1, { 3000 } },                 // First window
+	{ 0, 2, { 4000, 6276 } },
+	{ 3, 1, { 7000 } },                 // Starts 3276 ticks after the end of the window, merged
+	{ 0, 1, { 10277 } },
+	{ 4, 1, { 11000 } },                // 3277 ticks after, a second window
+	{ 0, 0, { 0 } },                    // Nothing read
+	{ 0, 1, { 1000 + 3 * 327680 + 5 } },  // Ends the first period and skips two without record
+	{ 2, 1, { 1000 + 3 * 327680 + 10 } }
+};
+
+static const char LOSS_TEXT[] =
+	"LOSS: 5 records dropped between 0.061035 s and 0.091553 s\n"
+	"LOSS: 3 records dropped between 0.191528 s and 0.213623 s\n"
+	"LOSS: 4 records dropped between 0.313629 s and 0.335693 s\n"
+	"LOSS RATE: 60.00 % from 0.030518 s to 10.030518 s (12 of 20 records)\n"
+	"LOSS: 2 records dropped between 30.030670 s and 30.030823 s\n";
+
+static bool same_window(const SmemLossWindow *window, uint64_t start, uint64_t end, uint64_t nb_dropped, uint32_t nb_losses)
+{
+	if (window->start == start && window->end == end && window->nb_dropped == nb_dropped && window->nb_losses == nb_losses) {
+		return TRUE;
+	}
+	printf("Loss window from %llu to %llu, %llu records dropped by %u reads\n", (unsigned long long)window->start,
+		(unsigned long long)window->end, (unsigned long long)window->nb_dropped, window->nb_losses);
+	return FALSE;
+}
+
+// The losses closer than SMEM_LOSS_MERGE_GAP make a window, a period counts its records and losses
+static bool check_losses(void)
+{
+	SmemLossTracker *tracker = (SmemLossTracker *)malloc(sizeof(SmemLossTracker));
+	SmemOutBuffer out;
+
+	if (tracker == NULL) {
+		return FALSE;
+	}
+	loss_tracker_init(tracker, SLEEP_CLOCK_RATE);
+	outbuf_init(&out, 512);
+	for (unsigned int r = 0; r < _countof(LOSS_READS); r++) {
+		const LossRead *read = &LOSS_READS[r];
+		SmemLogRecord records[2];
+		memset(records, 0, sizeof(records));
+		for (unsigned int i = 0; i < read->nb_records; i++) {
+			records[i].id = 0x80040000;
+			records[i].timestamp = read->timestamps[i];
+		}
+		loss_tracker_add(tracker, records, read->nb_records, read->nb_dropped, &out, FALSE);
+	}
+
+	bool same = out.size == strlen(LOSS_TEXT) && memcmp(out.data, LOSS_TEXT, out.size) == 0;
+	if (!same) {
+		printf("Loss text:\n%.*s", (int)out.size, out.data);
+	}
+	same = tracker->nb_windows == 2 && same;
+	same = same_window(&tracker->windows[0], 2000, 7000, 8, 2) && same;
+	same = same_window(&tracker->windows[1], 10277, 11000, 4, 1) && same;
+	same = same_window(&tracker->window, 1000 + 3 * 327680 + 5, 1000 + 3 * 327680 + 10, 2, 1) && same;
+	const SmemLossPeriod *period = &tracker->periods[0];
+	if (tracker->nb_periods != 1 || period->start != 1000 || period->nb_records != 8 || period->nb_dropped != 12
+		|| tracker->period.start != 1000 + 3 * 327680 || tracker->period.nb_records != 2 || tracker->period.nb_dropped != 2) {
+		printf("Loss periods: %u, the first from %llu with %llu records and %llu dropped\n", tracker->nb_periods,
+			(unsigned long long)period->start, (unsigned long long)period->nb_records, (unsigned long long)period->nb_dropped);
+		same = FALSE;
+	}
+	if (tracker->nb_records != 10 || tracker->nb_dropped != 14 || tracker->nb_losses != 4) {
+		printf("Losses: %llu records, %llu dropped by %llu reads\n", (unsigned long long)tracker->nb_records,
+			(unsigned long long)tracker->nb_dropped, (unsigned long long)tracker->nb_losses);
+		same = FALSE;
+	}
+	outbuf_free(&out);
+	free(tracker);
+	return same;
+}
+
+// Two reads of a log at the sleep clock: an APPS request answered in the second read, an APPS TX
+// received by MODM in the first one, a WCNS error and a request never answered
+static const SmemLogRecord TRACE_RECORDS[] = {
+	{ 0x800E0004, 0x1000, 0x00000001, 0x0020008E, 0x0000000B },
+	{ 0x900E0004, 0x1000, 0x00000001, 0x00000020, 0x00000000 },
+	{ 0x800D0001, 0x1010, 0x01000005, 0x03000040, 0x01000020 },
+	{ 0x000D0002, 0x1030, 0x01000005, 0x03000040, 0x01000020 },
+	{ 0xC00E0003, 0x1040, 0x00000071, 0x00000063, 0x00000069 },
+	{ 0x800E0004, 0x1050, 0x00000002, 0x0020008E, 0x0000000B },
+	{ 0x800E0005, 0x1080, 0x00020001, 0x00200010, 0x0000000B }
+};
+
+#define TRACE_FIRST_READ 4
+
+static const char TRACE_TEXT[] =
+	"{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+	"{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":3,\"tid\":0,\"args\":{\"name\":\"APPS\"}},\n"
+	"{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":3,\"tid\":1,\"args\":{\"name\":\"QMI\"}},\n"
+	"{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":3,\"tid\":2,\"args\":{\"name\":\"IPC Router\"}},\n"
+	"{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":3,\"tid\":3,\"args\":{\"name\":\"Errors\"}},\n"
+	"{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"MODM\"}},\n"
+	"{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"QMI\"}},\n"
+	"{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"IPC Router\"}},\n"
+	"{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":3,\"args\":{\"name\":\"Errors\"}},\n"
+	"{\"ph\":\"b\",\"cat\":\"router\",\"name\":\"DATA\",\"id\":1,\"pid\":3,\"tid\":2,\"ts\":488.281,\"args\":{\"src_proc\":1,\"src_port\":5,\"dst_proc\":3,\"dst_port\":64,\"len\":32}},\n"
+	"{\"ph\":\"e\",\"cat\":\"router\",\"name\":\"DATA\",\"id\":1,\"pid\":3,\"tid\":2,\"ts\":1464.843},\n"
+	"{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":4,\"tid\":0,\"args\":{\"name\":\"WCNS\"}},\n"
+	"{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":4,\"tid\":1,\"args\":{\"name\":\"QMI\"}},\n"
+	"{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":4,\"tid\":2,\"args\":{\"name\":\"IPC Router\"}},\n"
+	"{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":4,\"tid\":3,\"args\":{\"name\":\"Errors\"}},\n"
+	"{\"ph\":\"i\",\"s\":\"t\",\"cat\":\"error\",\"name\":\"QCCI ERROR\",\"pid\":4,\"tid\":3,\"ts\":1953.125,\"args\":{\"id\":3222142979,\"data\":[113,99,105]}},\n"
+	"{\"ph\":\"b\",\"cat\":\"qmi\",\"name\":\"svc:0xb msg:0x20\",\"id\":1,\"pid\":3,\"tid\":1,\"ts\":0.000,\"args\":{\"svc_id\":11,\"msg\":32,\"txn\":1}},\n"
+	"{\"ph\":\"e\",\"cat\":\"qmi\",\"name\":\"svc:0xb msg:0x20\",\"id\":1,\"pid\":3,\"tid\":1,\"ts\":3906.250}\n"
+	"]}\n";
+
+// A matched request or TX is a span on the track of its sender, an error an instant event
+static bool check_trace(void)
+{
+	SmemTraceWriter *writer = (SmemTraceWriter *)malloc(sizeof(SmemTraceWriter));
+	FILE *file = NULL;
+	char *text = NULL;
+
+	if (writer == NULL || fopen_s(&file, BENCH_TRACE_PATH, "w+b") != 0) {
+		free(writer);
+		return FALSE;
+	}
+	trace_writer_init(writer, file, SLEEP_CLOCK_RATE);
+	trace_writer_add(writer, TRACE_RECORDS, TRACE_FIRST_READ);
+	trace_writer_add(writer, &TRACE_RECORDS[TRACE_FIRST_READ], _countof(TRACE_RECORDS) - TRACE_FIRST_READ);
+	if (trace_writer_finish(writer)) {
+		text = read_back(file);
+	}
+	fclose(file);
+	remove(BENCH_TRACE_PATH);
+
+	bool same = text != NULL && strcmp(text, TRACE_TEXT) == 0;
+	if (text != NULL && !same) {
+		printf("Trace:\n%s", text);
+	}
+	if (writer->nb_qmi_spans != 1 || writer->nb_router_spans != 1 || writer->nb_errors != 1 || writer->qmi.nb_req != 2) {
+		printf("Trace: %llu QMI spans, %llu IPC Router spans, %llu errors, %llu requests\n",
+			(unsigned long long)writer->nb_qmi_spans, (unsigned long long)writer->nb_router_spans,
+			(unsigned long long)writer->nb_errors, (unsigned long long)writer->qmi.nb_req);
+		same = FALSE;
+	}
+	free(text);
+	free(writer);
+	return same;
+}
+
+// Records of an event of each decoder with their line as text, printed without a new line, and
+// as JSON, which ends with its new line
+typedef struct {
+	SmemLogRecord records[2];
+	unsigned int nb_records;
+	const char *text;
+	const char *json;
+} DecoderCase;
+
+static const DecoderCase DECODER_CASES[] = {
+	// DEBUG
+	{ { { 0x80000005, 0x8000, 0x00000001, 0x00000002, 0x00000003 } }, 1,
+		"APPS:       1.000000    id:0x80000005 LOG NOT IMPLEMENTED!",
+		"{\"proc\":\"APPS\",\"time\":32768,\"base\":\"DEBUG\",\"event\":5,\"id\":2147483653,\"data\":[1,2,3]}\n" },
+	// ONCRPC
+	{ { { 0x00010002, 0x8000, 0x00000001, 0x00000002, 0x00000003 } }, 1,
+		"MODM:       1.000000    id:0x00010002 subsys:0x00 LOG NOT IMPLEMENTED!",
+		"{\"proc\":\"MODM\",\"time\":32768,\"base\":\"ONCRPC\",\"event\":2}\n" },
+	// ONCRPC (BW compatible QCCI)
+	{ { { 0x80010034, 0x8000, 0x00000012, 0x00220010, 0x00000002 }, { 0x90010034, 0x8000, 0x00000002, 0x00000020, 0x00000000 } }, 2,
+		"APPS:       1.000000    QCCI:   TX REQ  Txn:0x12 Msg:0x22 Len:16 svc_id:0x2 svc_addr: 0002:0020:0000",
+		"{\"proc\":\"APPS\",\"time\":32768,\"base\":\"ONCRPC\",\"event\":52,\"kind\":\"TX\",\"cntl\":\"REQ\",\"txn\":18,\"msg\":34,\"len\":16,\"svc_id\":2,\"addr\":[2,32,0]}\n" },
+	// QCCI
+	{ { { 0xC00E0004, 0x8000, 0x00000001, 0x0020008E, 0x0000000B }, { 0xD00E0004, 0x8000, 0x00000002, 0x00000020, 0x00000000 } }, 2,
+		"WCNS:       1.000000    QCCI:   TX REQ  Txn:0x1 Msg:0x20 Len:142 svc_id:0xb svc_addr: 0002:0020:0000",
+		"{\"proc\":\"WCNS\",\"time\":32768,\"base\":\"QCCI\",\"event\":4,\"kind\":\"TX\",\"cntl\":\"REQ\",\"txn\":1,\"msg\":32,\"len\":142,\"svc_id\":11,\"addr\":[2,32,0]}\n" },
+	// QCSI
+	{ { { 0x400F0005, 0x8000, 0x00020012, 0x00220010, 0x00000002 }, { 0x500F0005, 0x8000, 0x00000001, 0x00000041, 0x00000000 } }, 2,
+		"QDSP:       1.000000    QCSI:   RX RESP Txn:0x12 Msg:0x22 Len:16 svc_id:0x2 clnt_addr: 0001:0041:0000",
+		"{\"proc\":\"QDSP\",\"time\":32768,\"base\":\"QCSI\",\"event\":5,\"kind\":\"RX\",\"cntl\":\"RESP\",\"txn\":18,\"msg\":34,\"len\":16,\"svc_id\":2,\"addr\":[1,65,0]}\n" },
+	// SMEM
+	{ { { 0x80020001, 0x8000, 0x00000001, 0x00000002, 0x00000003 } }, 1,
+		"APPS:       1.000000    id:0x80020001 LOG NOT IMPLEMENTED!",
+		"{\"proc\":\"APPS\",\"time\":32768,\"base\":\"SMEM\",\"event\":1,\"id\":2147614721,\"data\":[1,2,3]}\n" },
+	// TMC
+	{ { { 0x00030001, 0x8000, 0x00000001, 0x00000002, 0x00000003 } }, 1,
+		"MODM:       1.000000    TMC: GOTO INIT 0x00000001 0x00000002 0x00000003",
+		"{\"proc\":\"MODM\",\"time\":32768,\"base\":\"TMC\",\"event\":1,\"name\":\"GOTO INIT\"}\n" },
+	// TMC (out of its table)
+	{ { { 0x00030007, 0x8000, 0x00000001, 0x00000002, 0x00000003 } }, 1,
+		"MODM:       1.000000    TMC: 00030007    00000001    00000002    00000003",
+		"{\"proc\":\"MODM\",\"time\":32768,\"base\":\"TMC\",\"event\":7}\n" },
+	// TIMETICK
+	{ { { 0x00040000, 0x8000, 0x07FFF800, 0x00000059, 0x0000F566 } }, 1,
+		"MODM:       1.000000    TIMETICK: START 0x07fff800 0x00000059 0x0000f566",
+		"{\"proc\":\"MODM\",\"time\":32768,\"base\":\"TIMETICK\",\"event\":0,\"name\":\"START\"}\n" },
+	// ERR
+	{ { { 0x80060000, 0x8000, 0x00000001, 0x00000002, 0x00000003 } }, 1,
+		"APPS:       1.000000    id:0x80060000 LOG NOT IMPLEMENTED!",
+		"{\"proc\":\"APPS\",\"time\":32768,\"base\":\"ERR\",\"event\":0,\"id\":2147876864,\"data\":[1,2,3]}\n" },
+	// RPC ROUTER
+	{ { { 0x40090005, 0x8000, 0x00000010, 0x00000020, 0x00000030 } }, 1,
+		"QDSP:       1.000000    ROUTER: READ    mid = 00000010    cid = 00000020    tid = 00000030",
+		"{\"proc\":\"QDSP\",\"time\":32768,\"base\":\"ROUTER\",\"event\":5,\"name\":\"MID READ\",\"mid\":16,\"cid\":32,\"tid\":48}\n" },
+	// RPC ROUTER server
+	{ { { 0x40090009, 0x8000, 0x3000000A, 0x00010001, 0x00000030 } }, 1,
+		"QDSP:       1.000000    ROUTER: SERVER PENDING REGISTRATION    prog = 0x3000000a vers=0x00010001 tid = 00000030",
+		"{\"proc\":\"QDSP\",\"time\":32768,\"base\":\"ROUTER\",\"event\":9,\"name\":\"SERVER PENDING\",\"prog\":805306378,\"vers\":65537,\"tid\":48}\n" },
+	// RPC ROUTER (BW compatible IPC Router)
+	{ { { 0x80090011, 0x8000, 0x0100000A, 0x03000005, 0x01000040 }, { 0x90090011, 0x8000, 0x30727472, 0x00000123, 0x6B736174 } }, 2,
+		"APPS:       1.000000    ROUTER: TX 01:00000a -> 03:000005 [DATA] Len:64 <rtr0> TID:00000123,\"task\"",
+		"{\"proc\":\"APPS\",\"time\":32768,\"base\":\"ROUTER\",\"event\":17,\"kind\":\"TX\",\"src_proc\":1,\"src_port\":10,\"dst_proc\":3,\"dst_port\":5,\"msg_type\":\"DATA\",\"len\":64,\"conf_rx\":false,\"iface\":\"rtr0\",\"tid\":291,\"task\":\"task\"}\n" },
+	// IPC ROUTER TX
+	{ { { 0x800D0001, 0x8000, 0x0100000A, 0x03000005, 0x01000040 }, { 0x900D0001, 0x8000, 0x30727472, 0x00000123, 0x6B736174 } }, 2,
+		"APPS:       1.000000    ROUTER: TX 01:00000a -> 03:000005 [DATA] Len:64 <rtr0> TID:00000123,\"task\"",
+		"{\"proc\":\"APPS\",\"time\":32768,\"base\":\"ROUTER\",\"event\":1,\"kind\":\"TX\",\"src_proc\":1,\"src_port\":10,\"dst_proc\":3,\"dst_port\":5,\"msg_type\":\"DATA\",\"len\":64,\"conf_rx\":false,\"iface\":\"rtr0\",\"tid\":291,\"task\":\"task\"}\n" },
+	// IPC ROUTER ERROR
+	{ { { 0x800D0000, 0x8000, 0x6D656D73, 0x676F6C5F, 0x0000632E }, { 0x900D0000, 0x8000, 0x00000000, 0x00000000, 0x00000123 } }, 2,
+		"APPS:       1.000000    ROUTER: ERROR file: \"smem_log.c\" line: 291",
+		"{\"proc\":\"APPS\",\"time\":32768,\"base\":\"ROUTER\",\"event\":0,\"kind\":\"ERROR\",\"file\":\"smem_log.c\",\"line\":291}\n" },
+	// CLKRGM
+	{ { { 0xC00A0002, 0x8000, 0x00000001, 0x00000002, 0x00000003 } }, 1,
+		"WCNS:       1.000000    id:0xc00a0002 LOG NOT IMPLEMENTED!",
+		"{\"proc\":\"WCNS\",\"time\":32768,\"base\":\"CLKRGM\",\"event\":2,\"id\":3221880834,\"data\":[1,2,3]}\n" },
+	// UNKNOWN (base 0x5)
+	{ { { 0x80050001, 0x8000, 0x00000001, 0x00000002, 0x00000003 } }, 1,
+		"APPS:       1.000000    UNKNOWN: 80050001    00000001    00000002    00000003",
+		"{\"proc\":\"APPS\",\"time\":32768,\"base\":\"UNKNOWN\",\"event\":1,\"id\":2147811329,\"data\":[1,2,3]}\n" },
+	// UNKNOWN
+	{ { { 0x80123456, 0x8000, 0x00000001, 0x00000002, 0x00000003 } }, 1,
+		"APPS:       1.000000    UNKNOWN: 80123456    00000001    00000002    00000003",
+		"{\"proc\":\"APPS\",\"time\":32768,\"base\":\"UNKNOWN\",\"event\":13398,\"id\":2148676694,\"data\":[1,2,3]}\n" }
+};
+
+// Decodes the records of a case alone, as text or JSON, and compares them with the expected line
+static bool decode_case(const DecoderCase *test, bool json, const char *expected)
+{
+	SmemDecoderState state;
+
+	decoder_state_init(&state, SLEEP_CLOCK_RATE);
+	state.json = json;
+	for (unsigned int r = 0; r < test->nb_records; r++) {
+		print_event(&state, &test->records[r], FALSE, FALSE);
+	}
+	flush_events(&state);
+	bool same = state.out.size == strlen(expected) && memcmp(state.out.data, expected, state.out.size) == 0;
+	if (!same) {
+		printf("Id 0x%08x gives \"%.*s\"\n", test->records[0].id, (int)state.out.size, state.out.data);
+	}
+	decoder_state_free(&state);
+	return same;
+}
+
+// Each decoder prints its known records as it did
+static bool check_decoders(void)
+{
+	bool same = TRUE;
+
+	for (unsigned int c = 0; c < _countof(DECODER_CASES); c++) {
+		same = decode_case(&DECODER_CASES[c], FALSE, DECODER_CASES[c].text) && same;
+		same = decode_case(&DECODER_CASES[c], TRUE, DECODER_CASES[c].json) && same;
+	}
+	return same;
+}
+
+// Records counted by stats_add, with 3 records dropped before them
+static const SmemLogRecord STATS_RECORDS[] = {
+	{ 0x800E0004, 100, 0x00000001, 0x0020008E, 0x0000000B },
+	{ 0x900E0004, 100, 0x00000002, 0x00000020, 0x00000000 },
+	{ 0x00000000, 0, 0, 0, 0 },                                 // Empty slot
+	{ 0x800D0001, 150, 0x0100000A, 0x03000005, 0x01010040 },     // DATA, confirmation requested
+	{ 0x000D0002, 140, 0x0100000A, 0x03000005, 0x01010040 },     // Logged a little before by another processor
+	{ 0x40090011, 400, 0x0100000A, 0x03000006, 0x02000010 },     // BW compatible HELLO
+	{ 0xC00E0004, 400, 0x00000003, 0x0020008E, 0x0000000B },     // Same event as the first one
+	{ 0x00040000, 410, 0x07FFF800, 0x00000059, 0x0000F566 }
+};
+
+// Count of an event in the table of stats_add, keyed by its id without the flags
+static uint64_t event_count(const SmemStats *stats, uint32_t key)
+{
+	for (unsigned int slot = 0; slot < SMEM_STATS_EVENT_SLOTS; slot++) {
+		if (stats->events[slot].key == key) {
+			return stats->events[slot].count;
+		}
+	}
+	return 0;
+}
+
+// The records are counted by processor, event base and event as print_record classifies them,
+// the IPC Router messages by type as ipc_router_print decodes them
+static bool check_stats(void)
+{
+	SmemStats *stats = (SmemStats *)malloc(sizeof(SmemStats));
+	bool same = TRUE;
+
+	if (stats == NULL) {
+		return FALSE;
+	}
+	stats_init(stats, SLEEP_CLOCK_RATE);
+	stats_add(stats, STATS_RECORDS, _countof(STATS_RECORDS), 3);
+
+	if (stats->nb_records != 7 || stats->nb_continuations != 1 || stats->nb_empty != 1 || stats->nb_dropped != 3
+		|| stats->min_gap != -10 || stats->max_gap != 260) {
+		printf("Stats: %llu records, %llu continuations, %llu empty, %llu dropped, gaps from %lld to %lld\n",
+			(unsigned long long)stats->nb_records, (unsigned long long)stats->nb_continuations,
+			(unsigned long long)stats->nb_empty, (unsigned long long)stats->nb_dropped,
+			(long long)stats->min_gap, (long long)stats->max_gap);
+		same = FALSE;
+	}
+	if (stats->proc[0] != 2 || stats->proc[1] != 1 || stats->proc[2] != 3 || stats->proc[3] != 1
+		|| stats->base[0x4] != 1 || stats->base[0x9] != 1 || stats->base[0xD] != 2 || stats->base[0xE] != 3) {
+		printf("Stats: MODM %llu, QDSP %llu, APPS %llu, WCNS %llu; TIMETICK %llu, RPC ROUTER %llu, IPC ROUTER %llu, QCCI %llu\n",
+			(unsigned long long)stats->proc[0], (unsigned long long)stats->proc[1],
+			(unsigned long long)stats->proc[2], (unsigned long long)stats->proc[3],
+			(unsigned long long)stats->base[0x4], (unsigned long long)stats->base[0x9],
+			(unsigned long long)stats->base[0xD], (unsigned long long)stats->base[0xE]);
+		same = FALSE;
+	}
+	if (stats->nb_events != 5 || event_count(stats, 0x800E0004) != 2 || event_count(stats, 0x800D0002) != 1
+		|| event_count(stats, 0x80090011) != 1) {
+		printf("Stats: %u events, QCCI TX counted %llu times\n", stats->nb_events,
+			(unsigned long long)event_count(stats, 0x800E0004));
+		same = FALSE;
+	}
+	if (stats->router_type[1] != 2 || stats->router_bytes[1] != 0x80 || stats->router_type[2] != 1
+		|| stats->router_bytes[2] != 0x10 || stats->router_conf_rx != 2) {
+		printf("Stats: %llu DATA of %llu bytes, %llu HELLO of %llu bytes, %llu confirmations\n",
+			(unsigned long long)stats->router_type[1], (unsigned long long)stats->router_bytes[1],
+			(unsigned long long)stats->router_type[2], (unsigned long long)stats->router_bytes[2],
+			(unsigned long long)stats->router_conf_rx);
+		same = FALSE;
+	}
+	free(stats);
+	return same;
+}
+
+// Prints the verdict of a check, returns it
+static bool report_check(const char *name, bool passed)
+{
+	printf("%s: %s\n", name, passed ? "OK" : "FAILED");
+	return passed;
+}
+
+int run_self_test(void)
+{
+	char name[48];
+	bool ok = TRUE;
+
+	ok = report_check("Time rounding", check_seconds()) && ok;
+	ok = report_check("Timestamp extension", check_timebase()) && ok;
+	ok = report_check("Decoded lines", check_decoders()) && ok;
+	ok = report_check("Record counters", check_stats()) && ok;
+	ok = report_check("Raw dump parsers", check_parsers()) && ok;
+	ok = report_check("Archive round trip", check_archive()) && ok;
+	ok = report_check("Capture round trip and seek", check_capture()) && ok;
+	ok = report_check("Filter expressions", check_filter()) && ok;
+	ok = report_check("Router matching", check_router()) && ok;
+	ok = report_check("QMI matching", check_qmi()) && ok;
+	ok = report_check("Synthetic stream", check_synth()) && ok;
+	ok = report_check("Loss windows and rates", check_losses()) && ok;
+	ok = report_check("Trace events", check_trace()) && ok;
+	ok = report_check("Adaptive polling", check_polling()) && ok;
+	ok = report_check("JSON lines", check_json_lines()) && ok;
+	ok = report_check("Verbose lines", check_verbose()) && ok;
+	_snprintf_s(name, sizeof(name), _TRUNCATE, "Reentrancy check, %u threads", BENCH_NB_THREADS);
+	ok = report_check(name, check_reentrancy()) && ok;
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
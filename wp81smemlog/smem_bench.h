@@ -0,0 +1,55 @@
+#pragma once
+
+/**
+* @brief Times the record decoders and the raw dump parsers on a synthetic corpus.
+*
+* The decoded text is discarded so that the speed of the console is not
+* measured.
+* The selection of the decoders by the registry (see find_decoder) is timed
+* against the switch on the event base it replaced.
+* The line headers, the raw lines and the body of the live read loop (see
+* pipe_decode) are timed too, the loop on a synthetic stream and on the
+* records of a file when one is given.
+* The archive of a stream is measured against its raw dump.
+* The counting of --stats and the polling (see poll_simulate) are measured too.
+* The measures can be written as JSON, to compare runs across changes.
+*
+* @param iterations Number of times each record of the corpus is decoded.
+* @param corpus_path A raw dump, capture or archive file whose records are timed too, NULL for none.
+* @param nb_jobs Threads loading the file.
+* @param clock_rate Clock rate of the timestamps of a raw dump.
+* @param json_path File receiving the measures as JSON, NULL for none.
+* @return EXIT_SUCCESS, or EXIT_FAILURE if the file cannot be read or the JSON written.
+*/
+int run_bench(unsigned int iterations, const char *corpus_path, unsigned int nb_jobs, uint32_t clock_rate, const char *json_path);
+
+/**
+* @brief Checks the decoding on known values and synthetic streams, printing the verdict of each check.
+*
+* - the times are rounded as the printf of the Visual Studio CRT rounds them;
+* - the timestamps are extended across wraps and never below 0;
+* - each decoder prints known records as the expected text and JSON lines;
+* - the record counters classify the records by processor, event base, event and IPC Router
+*   message type, without decoding them;
+* - every raw dump parser finds the same records and malformed lines, CRLF included;
+* - an archive decodes back to its records, a capture file reads back to its records;
+* - a time window of a capture file prints the events of the whole file which start in it;
+* - the filters compare with = and !=, match one group of an OR, and keep a continuation record
+*   with its first record;
+* - the IPC Router TX and RX of the same key match oldest first, the others count as unmatched
+*   or evicted after the timeout, and so do the QCCI requests and responses;
+* - a synthetic stream depends on its seed only, not on the reads or the run, and its TX
+*   and requests find their RX and responses;
+* - the losses closer than SMEM_LOSS_MERGE_GAP make one window, and each period with losses
+*   gets its loss rate;
+* - a trace pairs a request with its response and a TX with its RX in a span on the track of
+*   the sender, and marks an error with an instant event;
+* - the adaptive polling drops no more records than the fixed one, and wakes up less often
+*   when the log is idle or steady;
+* - each JSON event is a valid object on its own line;
+* - in verbose mode, the words of the records of an event are printed together with its text;
+* - streams decoded concurrently on several threads give the same text as one at a time.
+*
+* @return EXIT_SUCCESS, or EXIT_FAILURE if a check fails.
+*/
+int run_self_test(void);
@@ -0,0 +1,315 @@
+#include "stdafx.h"
+#include "smem_capture.h"
+#include "smem_filter.h"
+
+#define CAPTURE_VIEW_BLOCKS 256          // Blocks mapped at a time while decoding
+#define CAPTURE_VIEW_ALIGN (64 * 1024)   // Allocation granularity, alignment of the file offset of a view
+// Blocks read before a time window, for the events its first continuation records complete
+#define CAPTURE_CONTEXT_BLOCKS 16
+
+static_assert(sizeof(SmemCaptureBlock) == SMEM_CAPTURE_BLOCK_SIZE, "a capture block must fill SMEM_CAPTURE_BLOCK_SIZE bytes");
+
+// Empties the block being filled, the header keeps the log index and the clock rate
+static void reset_block(SmemCaptureWriter *writer)
+{
+	SmemCaptureHeader *header = &writer->block.header;
+
+	header->nb_records = 0;
+	header->nb_dropped = 0;
+	// Times of a block without any record with an id
+	header->first_time = writer->timebase.last;
+	header->last_time = writer->timebase.last;
+	memset(writer->block.records, 0, sizeof(writer->block.records));
+	writer->has_time = FALSE;
+}
+
+static bool write_block(SmemCaptureWriter *writer)
+{
+	return fwrite(&writer->block, sizeof(writer->block), 1, writer->file) == 1;
+}
+
+bool capture_open(SmemCaptureWriter *writer, const char *path, uint32_t log_index, uint32_t clock_rate)
+{
+	SmemCaptureHeader *header = &writer->block.header;
+
+	if (fopen_s(&writer->file, path, "wb") != 0) {
+		return FALSE;
+	}
+
+	memset(&writer->block, 0, sizeof(writer->block));
+	header->magic = SMEM_CAPTURE_MAGIC;
+	header->version = SMEM_CAPTURE_VERSION;
+	header->log_index = (uint16_t)log_index;
+	header->clock_rate = clock_rate;
+	timebase_init(&writer->timebase, clock_rate);
+	reset_block(writer);
+	return TRUE;
+}
+
+bool capture_append(SmemCaptureWriter *writer, const SmemLogRecord *records, unsigned int nb_records, uint32_t nb_dropped)
+{
+	SmemCaptureHeader *header = &writer->block.header;
+
+	// The records were dropped before the ones of this read
+	header->nb_dropped += nb_dropped;
+
+	for (unsigned int i = 0; i < nb_records; i++) {
+		writer->block.records[header->nb_records++] = records[i];
+
+		// Same times as print_event, which skips the records without id
+		if (records[i].id != 0) {
+			uint64_t time = timebase_extend(&writer->timebase, records[i].timestamp);
+			if (!writer->has_time) {
+				writer->has_time = TRUE;
+				header->first_time = time;
+			}
+			header->last_time = time;
+		}
+
+		if (header->nb_records == SMEM_CAPTURE_BLOCK_RECORDS) {
+			if (!write_block(writer)) {
+				return FALSE;
+			}
+			reset_block(writer);
+		}
+	}
+
+	return TRUE;
+}
+
+bool capture_sync(SmemCaptureWriter *writer)
+{
+	const SmemCaptureHeader *header = &writer->block.header;
+
+	if (header->nb_records == 0 && header->nb_dropped == 0) {
+		return TRUE;
+	}
+	if (!write_block(writer) || fflush(writer->file) != 0) {
+		return FALSE;
+	}
+	// Back to the start of the block, written again with the next records
+	return fseek(writer->file, -(long)sizeof(writer->block), SEEK_CUR) == 0;
+}
+
+bool capture_close(SmemCaptureWriter *writer)
+{
+	const SmemCaptureHeader *header = &writer->block.header;
+	bool ok = TRUE;
+
+	if (header->nb_records != 0 || header->nb_dropped != 0) {
+		ok = write_block(writer);
+	}
+	if (fclose(writer->file) != 0) {
+		ok = FALSE;
+	}
+	writer->file = NULL;
+	return ok;
+}
+
+static bool is_capture_header(const SmemCaptureHeader *header)
+{
+	return header->magic == SMEM_CAPTURE_MAGIC && header->version == SMEM_CAPTURE_VERSION
+		&& header->nb_records <= SMEM_CAPTURE_BLOCK_RECORDS;
+}
+
+bool is_capture_file(const char *path)
+{
+	SmemCaptureHeader header;
+	bool capture = FALSE;
+
+	FILE *file = NULL;
+	if (fopen_s(&file, path, "rb") == 0) {
+		capture = fread(&header, sizeof(header), 1, file) == 1 && is_capture_header(&header);
+		fclose(file);
+	}
+	return capture;
+}
+
+// View of the blocks of a capture file
+typedef struct {
+	const char *path;
+	HANDLE mapping;
+	uint64_t nb_blocks;
+	const char *view;
+	uint64_t view_first;    // First block in the view
+	uint64_t view_count;    // Blocks in the view
+} CaptureMap;
+
+// Returns a block, mapping it with the count - 1 next ones if it is not in the view
+static const SmemCaptureBlock *map_block(CaptureMap *map, uint64_t index, uint64_t count)
+{
+	if (map->view != NULL && index >= map->view_first && index < map->view_first + map->view_count) {
+		return (const SmemCaptureBlock *)map->view + (index - map->view_first);
+	}
+
+	if (map->view != NULL) {
+		UnmapViewOfFile(map->view);
+	}
+	if (count > map->nb_blocks - index) {
+		count = map->nb_blocks - index;
+	}
+
+	uint64_t offset = index * SMEM_CAPTURE_BLOCK_SIZE;
+	uint64_t view_offset = offset & ~(uint64_t)(CAPTURE_VIEW_ALIGN - 1);
+	uint64_t view_size = offset - view_offset + count * SMEM_CAPTURE_BLOCK_SIZE;
+	map->view = (const char *)MapViewOfFile(map->mapping, FILE_MAP_READ,
+		(DWORD)(view_offset >> 32), (DWORD)view_offset, (SIZE_T)view_size);
+	if (map->view == NULL) {
+		fprintf(stderr, "Failed to map %s (error %u)\n", map->path, GetLastError());
+		return NULL;
+	}
+	map->view_first = view_offset / SMEM_CAPTURE_BLOCK_SIZE;
+	map->view_count = view_size / SMEM_CAPTURE_BLOCK_SIZE;
+
+	return (const SmemCaptureBlock *)map->view + (index - map->view_first);
+}
+
+// Binary search of the first block whose last record reaches ticks, only the headers are read
+static bool find_block(CaptureMap *map, uint64_t ticks, uint64_t *index)
+{
+	uint64_t low = 0;
+	uint64_t high = map->nb_blocks;
+
+	while (low < high) {
+		uint64_t middle = low + (high - low) / 2;
+		const SmemCaptureBlock *block = map_block(map, middle, 1);
+		if (block == NULL) {
+			return FALSE;
+		}
+		if (block->header.last_time < ticks) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+
+	*index = low;
+	return TRUE;
+}
+
+int decode_capture_file(const char *path, const SmemTimeWindow *window, const SmemFilter *filter, bool verbose, bool json, FILE *output)
+{
+	CaptureMap map;
+	LARGE_INTEGER file_size;
+	SmemDecoderState state;
+	bool ok = TRUE;
+
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		fprintf(stderr, "Failed to open %s (error %u)\n", path, GetLastError());
+		return EXIT_FAILURE;
+	}
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart < SMEM_CAPTURE_BLOCK_SIZE) {
+		fprintf(stderr, "%s is not a capture file\n", path);
+		CloseHandle(file);
+		return EXIT_FAILURE;
+	}
+
+	map.path = path;
+	map.nb_blocks = (uint64_t)file_size.QuadPart / SMEM_CAPTURE_BLOCK_SIZE;
+	map.view = NULL;
+	map.mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (map.mapping == NULL) {
+		fprintf(stderr, "Failed to map %s (error %u)\n", path, GetLastError());
+		CloseHandle(file);
+		return EXIT_FAILURE;
+	}
+
+	const SmemCaptureBlock *block = map_block(&map, 0, 1);
+	if (block == NULL || !is_capture_header(&block->header)) {
+		fprintf(stderr, "%s is not a capture file\n", path);
+		ok = FALSE;
+	}
+
+	if (ok) {
+		uint32_t clock_rate = block->header.clock_rate;
+		uint64_t since = (uint64_t)(window->since * clock_rate);
+		uint64_t until = window->until < 0 ? UINT64_MAX : (uint64_t)(window->until * clock_rate);
+		uint64_t first = 0;
+		bool in_window = FALSE;
+
+		decoder_state_init(&state, clock_rate);
+		state.filter = filter;
+		state.json = json;
+		state.verbose = verbose;
+		if (since > 0) {
+			ok = find_block(&map, since, &first);
+		}
+
+		// Records before the window extend the timestamps and start events, they are not printed
+		uint64_t index = first > CAPTURE_CONTEXT_BLOCKS ? first - CAPTURE_CONTEXT_BLOCKS : 0;
+		if (ok && index > 0) {
+			block = map_block(&map, index, CAPTURE_VIEW_BLOCKS);
+			ok = block != NULL;
+			if (ok) {
+				timebase_resume(&state.timebase, block->header.first_time);
+			}
+		}
+
+		for (; ok && index < map.nb_blocks; index++) {
+			block = map_block(&map, index, CAPTURE_VIEW_BLOCKS);
+			if (block == NULL) {
+				ok = FALSE;
+				break;
+			}
+
+			const SmemCaptureHeader *header = &block->header;
+			if (!is_capture_header(header)) {
+				fprintf(stderr, "%s: block %llu is not a capture block\n", path, (unsigned long long)index);
+				ok = FALSE;
+				break;
+			}
+			if (header->first_time > until) {
+				break;
+			}
+
+			if (verbose && index >= first) {
+				outbuf_flush(&state.out, output);
+				fprintf(output, "Block %llu: index=%u clock=%u nbRecords=%u nbDropped=%u first=%llu last=%llu\n",
+					(unsigned long long)index, header->log_index, header->clock_rate, header->nb_records,
+					header->nb_dropped, (unsigned long long)header->first_time, (unsigned long long)header->last_time);
+			}
+
+			for (unsigned int i = 0; i < header->nb_records; i++) {
+				const SmemLogRecord *record = &block->records[i];
+
+				if (record->id == 0) {
+					// Skipped by print_event
+					continue;
+				}
+
+				// The continuation records go with their first record
+				SmemTimebase next = state.timebase;
+				uint64_t time = timebase_extend(&next, record->timestamp);
+				if ((record->id & CONTINUE_MASK) == 0) {
+					in_window = time >= since && time <= until;
+				}
+				if (!in_window) {
+					skip_record(&state, record);
+					continue;
+				}
+				if (!select_record(&state, record)) {
+					continue;
+				}
+
+				print_event(&state, record, FALSE, !verbose);
+			}
+
+			// One write per block
+			outbuf_flush(&state.out, output);
+		}
+
+		// The events of the window still open are printed without their continuation records
+		flush_events(&state);
+		outbuf_flush(&state.out, output);
+		decoder_state_free(&state);
+	}
+
+	if (map.view != NULL) {
+		UnmapViewOfFile(map.view);
+	}
+	CloseHandle(map.mapping);
+	CloseHandle(file);
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+// Binary capture: the records as read from the driver, in blocks of fixed size
+#define SMEM_CAPTURE_MAGIC 0x50414353  // "SCAP"
+#define SMEM_CAPTURE_VERSION 1
+#define SMEM_CAPTURE_BLOCK_SIZE 4096
+#define SMEM_CAPTURE_BLOCK_RECORDS 202  // (SMEM_CAPTURE_BLOCK_SIZE - header) / 20
+
+/**
+* @brief Header of a block of a capture file.
+*/
+typedef struct {
+	uint32_t magic;         // SMEM_CAPTURE_MAGIC
+	uint16_t version;       // SMEM_CAPTURE_VERSION
+	uint16_t log_index;     // Log read (0 or 1)
+	uint32_t clock_rate;    // Ticks per second of the timestamps
+	uint32_t nb_records;    // Records in the block, SMEM_CAPTURE_BLOCK_RECORDS but in the last block
+	uint32_t nb_dropped;    // Sum of the nbDropped of the reads which filled the block
+	uint32_t reserved;
+	uint64_t first_time;    // Extended timestamp of the first record with an id
+	uint64_t last_time;     // Extended timestamp of the last record with an id
+} SmemCaptureHeader;
+
+/**
+* @brief Block of a capture file.
+*/
+typedef struct {
+	SmemCaptureHeader header;
+	SmemLogRecord records[SMEM_CAPTURE_BLOCK_RECORDS];
+	uint8_t padding[SMEM_CAPTURE_BLOCK_SIZE - sizeof(SmemCaptureHeader) - SMEM_CAPTURE_BLOCK_RECORDS * sizeof(SmemLogRecord)];
+} SmemCaptureBlock;
+
+/**
+* @brief Writer of a capture file.
+*/
+typedef struct {
+	FILE *file;
+	SmemCaptureBlock block;   // Block being filled
+	SmemTimebase timebase;    // Extension of the timestamps of the block headers
+	bool has_time;            // TRUE if a record of the block has an id
+} SmemCaptureWriter;
+
+/**
+* @brief Creates a capture file.
+*
+* @param writer The writer.
+* @param path The capture file, replaced if it exists.
+* @param log_index The log read.
+* @param clock_rate Ticks per second of the timestamps.
+* @return FALSE if the file cannot be created.
+*/
+bool capture_open(SmemCaptureWriter *writer, const char *path, uint32_t log_index, uint32_t clock_rate);
+
+/**
+* @brief Appends the records of one read of the driver.
+*
+* The records are copied as they are, a block is written when it is full.
+*
+* @param writer The writer.
+* @param records The records read.
+* @param nb_records Number of records.
+* @param nb_dropped The nbDropped returned with the records.
+* @return FALSE if a block cannot be written.
+*/
+bool capture_append(SmemCaptureWriter *writer, const SmemLogRecord *records, unsigned int nb_records, uint32_t nb_dropped);
+
+/**
+* @brief Writes the block being filled, so that the file is complete while no record comes.
+*
+* The block is written again at the same place when it is full.
+*
+* @param writer The writer.
+* @return FALSE if the block cannot be written.
+*/
+bool capture_sync(SmemCaptureWriter *writer);
+
+/**
+* @brief Writes the last block and closes the file.
+*
+* @param writer The writer.
+* @return FALSE if the block cannot be written.
+*/
+bool capture_close(SmemCaptureWriter *writer);
+
+/**
+* @brief Tells if a file starts with a capture block.
+*
+* @param path The file.
+*/
+bool is_capture_file(const char *path);
+
+/**
+* @brief Time window of the records to decode, in seconds as printed by print_event.
+*/
+typedef struct {
+	double since;   // 0 from the start of the capture
+	double until;   // Negative up to the end of the capture
+} SmemTimeWindow;
+
+/**
+* @brief Decodes the records of a capture file in a time window with print_event.
+*
+* The file is mapped, the block headers give the extended timestamps of the
+* blocks at a fixed stride: a binary search over them finds the first block of
+* the window without reading the blocks before it.
+*
+* @param path The capture file.
+* @param window The time window.
+* @param filter The records to print (see select_record), NULL for all.
+* @param verbose TRUE to print the block headers and the raw words in front of each decoded record.
+* @param json TRUE to print each event as a JSON object on its own line (see print_event), without the raw words.
+* @param output The file of the text, e.g. stdout.
+* @return EXIT_SUCCESS, or EXIT_FAILURE if the file cannot be read or is not a capture.
+*/
+int decode_capture_file(const char *path, const SmemTimeWindow *window, const SmemFilter *filter, bool verbose, bool json, FILE *output);
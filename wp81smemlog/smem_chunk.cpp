@@ -0,0 +1,312 @@
+#include "stdafx.h"
+#include "smem_parse.h"
+#include "smem_chunk.h"
+#include "smem_filter.h"
+
+// Start of the timebase used to measure the time span of a chunk, never reached by going backward
+#define CHUNK_SPAN_ORIGIN ((uint64_t)1 << 40)
+
+// First records waiting for their continuation record, one per event slot (see event_slot)
+typedef struct {
+	SmemLogRecord head[SMEM_LOG_EVENT_SLOTS];
+	uint64_t time[SMEM_LOG_EVENT_SLOTS];    // Extended timestamp of the first record, from CHUNK_SPAN_ORIGIN while scanning
+	bool open[SMEM_LOG_EVENT_SLOTS];        // TRUE if the first record waits
+	bool set[SMEM_LOG_EVENT_SLOTS];         // TRUE if the records of the chunk change the slot
+} ChunkEvents;
+
+typedef struct {
+	SmemChunk chunk;
+	const SmemChunkSource *source;
+	int64_t span;               // Extended time from the first to the last record
+	uint32_t first_timestamp;   // Timestamp of the first record with an id
+	bool has_time;              // FALSE if no record has an id
+	uint64_t first_time;        // Extended timestamp of the first record with an id
+	ChunkEvents events;         // Events left open at the end of the chunk
+	ChunkEvents prime;          // Events left open before the chunk
+	bool has_head;              // FALSE if no record with an id is a first record
+	SmemLogRecord last_head;    // Last first record of the chunk
+	bool prime_selected;        // TRUE if the last first record before the chunk passes the filter
+	bool verbose;
+	SmemDecoderState state;
+} ChunkJob;
+
+// State carried from a window of chunks to the next one
+typedef struct {
+	SmemTimebase timebase;
+	ChunkEvents events;         // Events left open before the window
+	const SmemFilter *filter;
+	bool selected;              // TRUE if the last first record before the window passes the filter
+} ChunkLink;
+
+// Worker of copy_chunks: loads the records
+static DWORD WINAPI load_chunk_thread(LPVOID param)
+{
+	ChunkJob *job = (ChunkJob *)param;
+
+	job->source->load(job->source, &job->chunk);
+	return 0;
+}
+
+// Worker, first pass: loads the records, finds the open events and measures the time span of the chunk
+static DWORD WINAPI scan_chunk_thread(LPVOID param)
+{
+	ChunkJob *job = (ChunkJob *)param;
+	SmemTimebase timebase;
+
+	job->source->load(job->source, &job->chunk);
+
+	memset(job->events.set, 0, sizeof(job->events.set));
+	job->has_time = FALSE;
+	job->has_head = FALSE;
+	timebase_init(&timebase, job->state.timebase.clock_rate);
+	for (size_t i = 0; i < job->chunk.nb_records; i++) {
+		const SmemLogRecord *rec = &job->chunk.records[i];
+		if (rec->id == 0) {
+			// Skipped by print_event
+			continue;
+		}
+		if (!job->has_time) {
+			job->has_time = TRUE;
+			job->first_timestamp = rec->timestamp;
+			timebase_resume(&timebase, CHUNK_SPAN_ORIGIN + rec->timestamp);
+		}
+		uint64_t time = timebase_extend(&timebase, rec->timestamp);
+
+		// Same slots as assemble_record: a continuation record closes the event of its slot
+		unsigned int slot = event_slot(rec->id);
+		bool head = (rec->id & CONTINUE_MASK) == 0;
+		if (slot < SMEM_LOG_EVENT_SLOTS) {
+			job->events.set[slot] = TRUE;
+			job->events.open[slot] = head && event_size(rec->id) > 1;
+			job->events.head[slot] = *rec;
+			job->events.time[slot] = time;
+		}
+		if (head) {
+			job->has_head = TRUE;
+			job->last_head = *rec;
+		}
+	}
+	job->span = job->has_time ? (int64_t)(timebase.last - CHUNK_SPAN_ORIGIN - job->first_timestamp) : 0;
+
+	return 0;
+}
+
+// Replaces the events of a decoding state by the ones left open before a chunk, nothing is printed
+static void prime_events(SmemDecoderState *state, const ChunkEvents *events, bool newLine_flag)
+{
+	memset(state->events, 0, sizeof(state->events));
+	for (unsigned int s = 0; s < SMEM_LOG_EVENT_SLOTS; s++) {
+		if (events->open[s]) {
+			const SmemLogRecord *head = &events->head[s];
+			bool selected = state->filter == NULL || filter_match(state->filter, head);
+			assemble_record(state, find_decoder(head->id), head, events->time[s], selected, FALSE, newLine_flag);
+		}
+	}
+}
+
+// Worker, second pass: decodes the records, starting from the state the previous chunks leave
+static DWORD WINAPI decode_chunk_thread(LPVOID param)
+{
+	ChunkJob *job = (ChunkJob *)param;
+	SmemDecoderState *state = &job->state;
+
+	// Continuation records at the start of the chunk complete the events left open before it
+	prime_events(state, &job->prime, !job->verbose);
+
+	if (job->has_time) {
+		// The first record extends to first_time
+		timebase_resume(&state->timebase, job->first_time);
+	}
+	state->selected = job->prime_selected;
+
+	for (size_t i = 0; i < job->chunk.nb_records; i++) {
+		const SmemLogRecord *rec = &job->chunk.records[i];
+		if (!select_record(state, rec)) {
+			continue;
+		}
+		print_event(state, rec, FALSE, !job->verbose);
+	}
+
+	return 0;
+}
+
+static void run_chunk_threads(ChunkJob *jobs, unsigned int nb_chunks, LPTHREAD_START_ROUTINE routine)
+{
+	HANDLE threads[SMEM_CHUNK_MAX_JOBS];
+	unsigned int nb_threads = 0;
+
+	if (nb_chunks == 1) {
+		routine(&jobs[0]);
+		return;
+	}
+	for (unsigned int c = 0; c < nb_chunks; c++) {
+		HANDLE thread = CreateThread(NULL, 0, routine, &jobs[c], 0, NULL);
+		if (thread != NULL) {
+			threads[nb_threads++] = thread;
+		}
+		else {
+			// No thread left for this chunk, decoded by the caller instead
+			routine(&jobs[c]);
+		}
+	}
+	if (nb_threads > 0) {
+		WaitForMultipleObjectsEx(nb_threads, threads, TRUE, INFINITE, FALSE);
+	}
+	for (unsigned int t = 0; t < nb_threads; t++) {
+		CloseHandle(threads[t]);
+	}
+}
+
+// Sequential pass between the workers: gives each chunk its first extended timestamp, the events
+// left open before it and the filter verdict its first continuation records follow
+static void link_chunks(ChunkJob *jobs, unsigned int nb_chunks, ChunkLink *link)
+{
+	for (unsigned int c = 0; c < nb_chunks; c++) {
+		ChunkJob *job = &jobs[c];
+
+		if (job->has_time) {
+			job->first_time = timebase_extend(&link->timebase, job->first_timestamp);
+			timebase_resume(&link->timebase, job->first_time + job->span);
+		}
+
+		job->prime = link->events;
+		for (unsigned int s = 0; s < SMEM_LOG_EVENT_SLOTS; s++) {
+			if (job->events.set[s]) {
+				link->events.open[s] = job->events.open[s];
+				link->events.head[s] = job->events.head[s];
+				// From the span of the chunk to the timebase of the file
+				link->events.time[s] = job->first_time + (job->events.time[s] - CHUNK_SPAN_ORIGIN - job->first_timestamp);
+			}
+		}
+
+		job->prime_selected = link->selected;
+		if (job->has_head && link->filter != NULL) {
+			link->selected = filter_match(link->filter, &job->last_head);
+		}
+	}
+}
+
+static void free_jobs(ChunkJob *jobs, unsigned int nb_jobs)
+{
+	for (unsigned int c = 0; jobs != NULL && c < nb_jobs; c++) {
+		free(jobs[c].chunk.records);
+		decoder_state_free(&jobs[c].state);
+	}
+	free(jobs);
+}
+
+// Allocates the jobs and the records of their chunks, NULL if the memory is missing
+static ChunkJob *alloc_jobs(const SmemChunkSource *source, unsigned int nb_jobs, uint32_t clock_rate, const SmemFilter *filter, bool verbose)
+{
+	ChunkJob *jobs = (ChunkJob *)calloc(nb_jobs, sizeof(ChunkJob));
+	bool ok = jobs != NULL;
+
+	for (unsigned int c = 0; ok && c < nb_jobs; c++) {
+		jobs[c].source = source;
+		jobs[c].chunk.records = (SmemLogRecord *)malloc(source->max_records * sizeof(SmemLogRecord));
+		jobs[c].verbose = verbose;
+		decoder_state_init(&jobs[c].state, clock_rate);
+		jobs[c].state.filter = filter;
+		jobs[c].state.verbose = verbose;
+		ok = jobs[c].chunk.records != NULL;
+	}
+	if (!ok) {
+		fprintf(stderr, "Not enough memory for %u jobs\n", nb_jobs);
+		free_jobs(jobs, nb_jobs);
+		return NULL;
+	}
+	return jobs;
+}
+
+// Gets the next chunks of the source, 0 at the end of the file or on a read error
+static unsigned int next_chunks(SmemChunkSource *source, ChunkJob *jobs, unsigned int nb_jobs)
+{
+	SmemChunk *chunks[SMEM_CHUNK_MAX_JOBS];
+
+	for (unsigned int c = 0; c < nb_jobs; c++) {
+		chunks[c] = &jobs[c].chunk;
+		chunks[c]->nb_records = 0;
+		chunks[c]->nb_dropped = 0;
+		chunks[c]->corrupt = FALSE;
+	}
+	return source->next(source, chunks, nb_jobs);
+}
+
+static unsigned int clamp_jobs(unsigned int nb_jobs)
+{
+	if (nb_jobs < 1) nb_jobs = 1;
+	if (nb_jobs > SMEM_CHUNK_MAX_JOBS) nb_jobs = SMEM_CHUNK_MAX_JOBS;
+	return nb_jobs;
+}
+
+int decode_chunks(SmemChunkSource *source, unsigned int nb_jobs, uint32_t clock_rate, const SmemFilter *filter, bool verbose, bool json)
+{
+	nb_jobs = clamp_jobs(nb_jobs);
+
+	ChunkJob *jobs = alloc_jobs(source, nb_jobs, clock_rate, filter, verbose);
+	bool ok = jobs != NULL;
+
+	if (ok) {
+		ChunkLink link;
+		unsigned int nb_chunks;
+
+		for (unsigned int c = 0; c < nb_jobs; c++) {
+			jobs[c].state.json = json;
+		}
+
+		timebase_init(&link.timebase, clock_rate);
+		memset(link.events.open, 0, sizeof(link.events.open));
+		link.filter = filter;
+		link.selected = TRUE;
+
+		while (ok && (nb_chunks = next_chunks(source, jobs, nb_jobs)) > 0) {
+			run_chunk_threads(jobs, nb_chunks, scan_chunk_thread);
+			for (unsigned int c = 0; c < nb_chunks; c++) {
+				if (!source->check(source, &jobs[c].chunk)) {
+					// The chunks before the error are decoded
+					nb_chunks = c;
+					ok = FALSE;
+				}
+			}
+			if (nb_chunks == 0) {
+				break;
+			}
+			link_chunks(jobs, nb_chunks, &link);
+			run_chunk_threads(jobs, nb_chunks, decode_chunk_thread);
+
+			// Output in the order of the file
+			for (unsigned int c = 0; c < nb_chunks; c++) {
+				outbuf_flush(&jobs[c].state.out, stdout);
+			}
+		}
+
+		// The events still open at the end of the file are printed without their continuation records
+		SmemDecoderState *state = &jobs[0].state;
+		prime_events(state, &link.events, !verbose);
+		flush_events(state);
+		outbuf_flush(&state->out, stdout);
+	}
+
+	free_jobs(jobs, nb_jobs);
+	return ok && !source->failed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int copy_chunks(SmemChunkSource *source, unsigned int nb_jobs, SmemRecordSink sink, void *context)
+{
+	nb_jobs = clamp_jobs(nb_jobs);
+
+	ChunkJob *jobs = alloc_jobs(source, nb_jobs, SLEEP_CLOCK_RATE, NULL, FALSE);
+	bool ok = jobs != NULL;
+	unsigned int nb_chunks;
+
+	while (ok && (nb_chunks = next_chunks(source, jobs, nb_jobs)) > 0) {
+		run_chunk_threads(jobs, nb_chunks, load_chunk_thread);
+		for (unsigned int c = 0; ok && c < nb_chunks; c++) {
+			const SmemChunk *chunk = &jobs[c].chunk;
+			ok = source->check(source, chunk) && sink(context, chunk->records, chunk->nb_records, chunk->nb_dropped);
+		}
+	}
+
+	free_jobs(jobs, nb_jobs);
+	return ok && !source->failed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
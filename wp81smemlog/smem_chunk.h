@@ -0,0 +1,73 @@
+#pragma once
+
+#define SMEM_CHUNK_MAX_JOBS 64
+
+/**
+* @brief Part of a file which decodes into records independently of the others.
+*/
+typedef struct {
+	const char *data;            // Bytes of the chunk, in a view of the file
+	size_t size;
+	SmemLogRecord *records;      // Records of the chunk, room for the max_records of the source
+	size_t nb_records;
+	uint32_t nb_dropped;         // Records dropped before the chunk, if the file keeps them
+	SmemParseReport report;      // Lines of a raw dump chunk
+	bool corrupt;                // TRUE if the data cannot be decoded
+} SmemChunk;
+
+typedef struct SmemChunkSource SmemChunkSource;
+
+/**
+* @brief A file cut into chunks.
+*/
+struct SmemChunkSource {
+	// Sets the data of the next chunks, at most nb_chunks; returns the number of chunks, 0 at the end of the file.
+	// The data of the previous chunks is no longer used.
+	unsigned int (*next)(SmemChunkSource *source, SmemChunk **chunks, unsigned int nb_chunks);
+	// Called on the worker threads: turns the data of a chunk into its records
+	void (*load)(const SmemChunkSource *source, SmemChunk *chunk);
+	// Called in the order of the file on the loaded chunks, reports their errors; FALSE to stop
+	bool (*check)(SmemChunkSource *source, const SmemChunk *chunk);
+	size_t max_records;          // Records of a chunk, at most
+	bool failed;                 // Set on a read error
+};
+
+/**
+* @brief Receives the records of a file, in order.
+*
+* @param context The context given to copy_chunks.
+* @param records The records of a chunk.
+* @param nb_records Number of records.
+* @param nb_dropped Records dropped before them.
+* @return FALSE to stop.
+*/
+typedef bool (*SmemRecordSink)(void *context, const SmemLogRecord *records, size_t nb_records, uint32_t nb_dropped);
+
+/**
+* @brief Decodes the chunks of a file on several threads.
+*
+* Each worker loads a chunk and measures its time span and its contexts, a sequential
+* pass gives each chunk its first extended timestamp and the contexts set before it,
+* then the workers decode the chunks with print_event and the text is written in the
+* order of the file: the same text as when the records are decoded one at a time.
+*
+* @param source The chunks.
+* @param nb_jobs Number of worker threads.
+* @param clock_rate Ticks per second of the record timestamps.
+* @param filter The records to print (see select_record), NULL for all.
+* @param verbose TRUE to print the raw words in front of each decoded record.
+* @param json TRUE to print each event as a JSON object on its own line (see print_event), without the raw words.
+* @return EXIT_SUCCESS, or EXIT_FAILURE on a read error or a corrupt chunk.
+*/
+int decode_chunks(SmemChunkSource *source, unsigned int nb_jobs, uint32_t clock_rate, const SmemFilter *filter, bool verbose, bool json);
+
+/**
+* @brief Loads the chunks of a file on several threads and gives their records to a sink, in order.
+*
+* @param source The chunks.
+* @param nb_jobs Number of worker threads.
+* @param sink The sink of the records.
+* @param context The context of the sink.
+* @return EXIT_SUCCESS, or EXIT_FAILURE on a read error, a corrupt chunk or if the sink stops.
+*/
+int copy_chunks(SmemChunkSource *source, unsigned int nb_jobs, SmemRecordSink sink, void *context);
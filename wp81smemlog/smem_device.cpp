@@ -0,0 +1,68 @@
+#include "stdafx.h"
+#include "smem_source.h"
+#include "smem_device.h"
+
+// Gets the SMEM functions and initializes the log buffer of the index, failures are only reported
+static bool start_device(SmemRecordSource *source, bool verbose)
+{
+	SmemDeviceSource *device = (SmemDeviceSource *)source;
+	DWORD bytes = 0;
+
+	// 1) GET FUNCTIONS
+	if (!DeviceIoControl(device->device, IOCTL_MYDRV_GET_FUNCTIONS, NULL, 0, NULL, 0, &bytes, NULL)) {
+		printf("IOCTL_GET_FUNCTIONS failed %u\n", GetLastError());
+	} else if (verbose) {
+		printf("IOCTL_GET_FUNCTIONS succeeded\n");
+	}
+
+	// 2) INIT_LOG_BUFFER
+	uint32_t in_init = device->log_index;
+	uint32_t out_init = 0;
+	if (!DeviceIoControl(device->device, IOCTL_MYDRV_INIT_LOG_BUFFER, &in_init, sizeof(in_init), &out_init, sizeof(out_init), &bytes, NULL)) {
+		printf("IOCTL_INIT_LOG_BUFFER failed %u\n", GetLastError());
+	} else if (verbose) {
+		printf("IOCTL_INIT_LOG_BUFFER returned %d (bytes=%u)\n", (int)out_init, bytes);
+	}
+	return TRUE;
+}
+
+// The device is closed by its owner
+static void stop_device(SmemRecordSource *source)
+{
+}
+
+// 3) READ_LOG_EVENTS
+static bool read_device(SmemRecordSource *source, SmemLogRecord *records, uint32_t max_records, SmemReadResult *result)
+{
+	SmemDeviceSource *device = (SmemDeviceSource *)source;
+	uint32_t in_read[2];
+	uint32_t out_read[28];
+	DWORD bytes = 0;
+
+	in_read[0] = device->log_index;
+	in_read[1] = max_records < SMEM_DEVICE_MAX_READ ? max_records : SMEM_DEVICE_MAX_READ;  // maxNbEntries
+
+	memset(out_read, 0, sizeof(out_read));
+	if (!DeviceIoControl(device->device, IOCTL_MYDRV_READ_LOG_EVENTS, in_read, sizeof(in_read), out_read, sizeof(out_read), &bytes, NULL)) {
+		printf("IOCTL_READ_LOG_EVENTS failed %u\n", GetLastError());
+		source->failed = TRUE;
+		return FALSE;
+	}
+	result->nb_dropped = out_read[0];
+	result->nb_available = out_read[1];
+	// The records follow the three counters, never more than the buffer holds
+	result->nb_read = out_read[2] < in_read[1] ? out_read[2] : in_read[1];
+	memcpy(records, out_read + 3, result->nb_read * sizeof(SmemLogRecord));
+	return TRUE;
+}
+
+void device_source_init(SmemDeviceSource *source, HANDLE device, uint32_t log_index)
+{
+	source->base.start = start_device;
+	source->base.read = read_device;
+	source->base.stop = stop_device;
+	source->base.max_read = SMEM_DEVICE_MAX_READ;
+	source->base.failed = FALSE;
+	source->device = device;
+	source->log_index = log_index;
+}
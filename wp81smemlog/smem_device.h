@@ -0,0 +1,25 @@
+#pragma once
+
+#define IOCTL_MYDRV_GET_FUNCTIONS  CTL_CODE(FILE_DEVICE_UNKNOWN, 0x800, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define IOCTL_MYDRV_INIT_LOG_BUFFER CTL_CODE(FILE_DEVICE_UNKNOWN, 0x801, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define IOCTL_MYDRV_READ_LOG_EVENTS CTL_CODE(FILE_DEVICE_UNKNOWN, 0x802, METHOD_BUFFERED, FILE_ANY_ACCESS)
+
+#define SMEM_DEVICE_MAX_READ 5          // Records of a read: the output buffer holds 28 words
+
+/**
+* @brief Log index of the Wp81SmemLogControlDriver device, read with IOCTL_MYDRV_READ_LOG_EVENTS.
+*/
+typedef struct {
+	SmemRecordSource base;
+	HANDLE device;              // Shared by the sources of both indexes
+	uint32_t log_index;
+} SmemDeviceSource;
+
+/**
+* @brief Initializes the source of a log index of an open device.
+*
+* @param source The source.
+* @param device The device.
+* @param log_index The log read (0 or 1).
+*/
+void device_source_init(SmemDeviceSource *source, HANDLE device, uint32_t log_index);
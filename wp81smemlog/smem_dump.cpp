@@ -0,0 +1,160 @@
+#include "stdafx.h"
+#include "smem_parse.h"
+#include "smem_chunk.h"
+#include "smem_dump.h"
+
+#define DUMP_CHUNK_SIZE (4 * 1024 * 1024) // Bytes of text per chunk
+#define DUMP_LINE_SLACK (64 * 1024)       // Bytes mapped after the chunks, to end the last line
+#define DUMP_VIEW_ALIGN (64 * 1024)       // Allocation granularity, alignment of the file offset of a view
+
+// Maps the next chunks and cuts them after a complete line
+static unsigned int next_dump_chunks(SmemChunkSource *base, SmemChunk **chunks, unsigned int nb_chunks)
+{
+	SmemDumpSource *source = (SmemDumpSource *)base;
+	unsigned int count = 0;
+
+	if (source->view != NULL) {
+		UnmapViewOfFile(source->view);
+		source->view = NULL;
+	}
+	if (source->position >= source->size) {
+		return 0;
+	}
+
+	// View of the next chunks, from an aligned offset
+	uint64_t view_offset = source->position & ~(uint64_t)(DUMP_VIEW_ALIGN - 1);
+	uint64_t view_end = source->position + (uint64_t)nb_chunks * DUMP_CHUNK_SIZE + DUMP_LINE_SLACK;
+	bool last_view = view_end >= source->size;
+	if (last_view) {
+		view_end = source->size;
+	}
+
+	source->view = (const char *)MapViewOfFile(source->mapping, FILE_MAP_READ,
+		(DWORD)(view_offset >> 32), (DWORD)view_offset, (SIZE_T)(view_end - view_offset));
+	if (source->view == NULL) {
+		fprintf(stderr, "Failed to map %s (error %u)\n", source->path, GetLastError());
+		base->failed = TRUE;
+		return 0;
+	}
+
+	const char *text = source->view + (source->position - view_offset);
+	const char *limit = source->view + (view_end - view_offset);
+	while (count < nb_chunks && text < limit) {
+		const char *end = text + DUMP_CHUNK_SIZE;
+
+		if (end >= limit) {
+			// Only at the end of the file, the views go DUMP_LINE_SLACK past the chunks
+			end = limit;
+		}
+		else {
+			const char *eol = (const char *)memchr(end, '\n', limit - end);
+			if (eol != NULL) {
+				end = eol + 1;
+			}
+			else if (last_view) {
+				end = limit;
+			}
+			// else a line longer than DUMP_LINE_SLACK, cut
+		}
+
+		chunks[count]->data = text;
+		chunks[count]->size = end - text;
+		count++;
+		source->position += end - text;
+		text = end;
+	}
+
+	return count;
+}
+
+static void load_dump_chunk(const SmemChunkSource *base, SmemChunk *chunk)
+{
+	const SmemDumpSource *source = (const SmemDumpSource *)base;
+
+	chunk->nb_records = parse_raw_dump(source->parser, chunk->data, chunk->size, chunk->records, &chunk->report);
+}
+
+// Reports the malformed lines with their number in the file
+static bool check_dump_chunk(SmemChunkSource *base, const SmemChunk *chunk)
+{
+	SmemDumpSource *source = (SmemDumpSource *)base;
+
+	for (size_t i = 0; i < chunk->report.nb_malformed && i < SMEM_PARSE_MAX_REPORTED; i++) {
+		if (source->nb_malformed + i < SMEM_PARSE_MAX_REPORTED) {
+			fprintf(stderr, "%s:%llu: malformed line\n", source->path,
+				(unsigned long long)(source->nb_lines + chunk->report.malformed[i]));
+		}
+	}
+	source->nb_malformed += chunk->report.nb_malformed;
+	source->nb_lines += chunk->report.nb_lines;
+	return TRUE;
+}
+
+bool dump_source_open(SmemDumpSource *source, const char *path)
+{
+	LARGE_INTEGER file_size;
+
+	memset(source, 0, sizeof(*source));
+	source->base.next = next_dump_chunks;
+	source->base.load = load_dump_chunk;
+	source->base.check = check_dump_chunk;
+	// A chunk is cut at most DUMP_LINE_SLACK bytes after its size
+	source->base.max_records = SMEM_RAW_MAX_RECORDS(DUMP_CHUNK_SIZE + DUMP_LINE_SLACK);
+	source->path = path;
+	source->parser = best_parser();
+
+	source->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (source->file == INVALID_HANDLE_VALUE) {
+		fprintf(stderr, "Failed to open %s (error %u)\n", path, GetLastError());
+		return FALSE;
+	}
+
+	if (!GetFileSizeEx(source->file, &file_size)) {
+		fprintf(stderr, "Failed to get the size of %s (error %u)\n", path, GetLastError());
+		CloseHandle(source->file);
+		return FALSE;
+	}
+	source->size = (uint64_t)file_size.QuadPart;
+	if (source->size == 0) {
+		// Nothing to map
+		return TRUE;
+	}
+
+	source->mapping = CreateFileMappingW(source->file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (source->mapping == NULL) {
+		fprintf(stderr, "Failed to map %s (error %u)\n", path, GetLastError());
+		CloseHandle(source->file);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+void dump_source_close(SmemDumpSource *source)
+{
+	if (source->nb_malformed > SMEM_PARSE_MAX_REPORTED) {
+		fprintf(stderr, "%s: %llu malformed lines\n", source->path, (unsigned long long)source->nb_malformed);
+	}
+	if (source->view != NULL) {
+		UnmapViewOfFile(source->view);
+	}
+	if (source->mapping != NULL) {
+		CloseHandle(source->mapping);
+	}
+	CloseHandle(source->file);
+}
+
+int decode_dump_file(const char *path, unsigned int nb_jobs, uint32_t clock_rate, const SmemFilter *filter, bool verbose, bool json)
+{
+	SmemDumpSource source;
+
+	if (!dump_source_open(&source, path)) {
+		return EXIT_FAILURE;
+	}
+	int status = decode_chunks(&source.base, nb_jobs, clock_rate, filter, verbose, json);
+	if (source.nb_malformed > 0) {
+		// Decoded all the same, the malformed lines are reported on stderr
+		status = EXIT_FAILURE;
+	}
+	dump_source_close(&source);
+	return status;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+/**
+* @brief Raw dump file read in chunks cut on line boundaries.
+*/
+typedef struct {
+	SmemChunkSource base;
+	const char *path;
+	HANDLE file;
+	HANDLE mapping;             // NULL for an empty file
+	uint64_t size;
+	uint64_t position;          // Start of the next chunk
+	const char *view;           // View of the current chunks
+	SmemParser parser;
+	uint64_t nb_lines;          // Lines of the checked chunks
+	uint64_t nb_malformed;
+} SmemDumpSource;
+
+/**
+* @brief Opens a raw dump file as a chunk source.
+*
+* The dump is made of the lines written by print_raw_event (option -r), the file
+* is mapped a few chunks at a time and the chunks are parsed with best_parser.
+* The malformed lines are reported on stderr with their line number.
+*
+* @param source The source.
+* @param path The dump file.
+* @return FALSE if the file cannot be opened, the error is printed.
+*/
+bool dump_source_open(SmemDumpSource *source, const char *path);
+
+/**
+* @brief Closes a raw dump file, prints the number of malformed lines if they were not all reported.
+*
+* @param source The source.
+*/
+void dump_source_close(SmemDumpSource *source);
+
+/**
+* @brief Decodes a raw dump file on several threads.
+*
+* The chunks are parsed and decoded concurrently by decode_chunks and their text
+* is written in the order of the file, the same as when the records are decoded one at a time.
+*
+* @param path The dump file.
+* @param nb_jobs Number of worker threads.
+* @param clock_rate Ticks per second of the record timestamps.
+* @param filter The records to print (see select_record), NULL for all.
+* @param verbose TRUE to print the raw words in front of each decoded record.
+* @param json TRUE to print each event as a JSON object on its own line (see print_event), without the raw words.
+* @return EXIT_SUCCESS, or EXIT_FAILURE if the file cannot be read or has malformed lines.
+*/
+int decode_dump_file(const char *path, unsigned int nb_jobs, uint32_t clock_rate, const SmemFilter *filter, bool verbose, bool json);
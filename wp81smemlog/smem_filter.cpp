@@ -0,0 +1,270 @@
+#include "stdafx.h"
+#include "smem_filter.h"
+
+#define FILTER_MAX_TOKEN 32
+
+// Words of a record, indexes of SmemFilterTest.word
+#define FILTER_ID_WORD 0
+#define FILTER_D1_WORD 2
+#define FILTER_D2_WORD 3
+#define FILTER_D3_WORD 4
+
+typedef struct {
+	const char *name;
+	uint32_t value;
+} FilterName;
+
+typedef struct {
+	const char *name;
+	uint8_t word;
+	uint32_t mask;
+	unsigned int shift;       // Position of the value in the word
+	const FilterName *names;  // Names of the values, NULL terminated (may be NULL)
+} FilterField;
+
+// Processor flags of print_line_header
+static const FilterName PROC_NAMES[] = {
+	{ "MODM", 0 }, { "QDSP", 1 }, { "APPS", 2 }, { "WCNS", 3 }, { NULL, 0 }
+};
+
+// Event bases of the decoder registry
+static const FilterName BASE_NAMES[] = {
+	{ "DEBUG", 0x0 }, { "ONCRPC", 0x1 }, { "SMEM", 0x2 }, { "TMC", 0x3 }, { "TIMETICK", 0x4 }, { "ERR", 0x6 },
+	{ "RPC_ROUTER", 0x9 }, { "CLKRGM", 0xA }, { "IPC_ROUTER", 0xD }, { "QCCI", 0xE }, { "QCSI", 0xF }, { NULL, 0 }
+};
+
+static const FilterField FILTER_FIELDS[] = {
+	{ "proc",  FILTER_ID_WORD, 0xC0000000, 30, PROC_NAMES },
+	{ "base",  FILTER_ID_WORD, 0x0FFF0000, 16, BASE_NAMES },
+	{ "event", FILTER_ID_WORD, 0x0000FFFF, 0,  NULL },
+	{ "id",    FILTER_ID_WORD, 0xFFFFFFFF, 0,  NULL },
+	{ "d1",    FILTER_D1_WORD, 0xFFFFFFFF, 0,  NULL },
+	{ "d2",    FILTER_D2_WORD, 0xFFFFFFFF, 0,  NULL },
+	{ "d3",    FILTER_D3_WORD, 0xFFFFFFFF, 0,  NULL }
+};
+
+typedef struct {
+	const char *text;
+	const char *p;            // Next character
+	SmemFilter *filter;
+	unsigned int group_start; // First test of the group being parsed
+	bool never;               // TRUE if the group being parsed cannot match
+} FilterParser;
+
+static bool same_name(const char *a, const char *b)
+{
+	while (*a != '\0' && tolower((unsigned char)*a) == tolower((unsigned char)*b)) {
+		a++;
+		b++;
+	}
+	return *a == '\0' && *b == '\0';
+}
+
+static bool is_token_char(char c)
+{
+	return isalnum((unsigned char)c) || c == '_';
+}
+
+static void skip_spaces(FilterParser *parser)
+{
+	while (*parser->p == ' ' || *parser->p == '\t') {
+		parser->p++;
+	}
+}
+
+static bool parse_error(const FilterParser *parser, const char *message)
+{
+	fprintf(stderr, "Invalid filter \"%s\": %s at column %u\n", parser->text, message,
+		(unsigned int)(parser->p - parser->text + 1));
+	return FALSE;
+}
+
+// Reads a name or a number, FALSE if there is none or it is too long
+static bool parse_token(FilterParser *parser, char *token)
+{
+	unsigned int length = 0;
+
+	skip_spaces(parser);
+	while (is_token_char(*parser->p)) {
+		if (length == FILTER_MAX_TOKEN - 1) {
+			return FALSE;
+		}
+		token[length++] = *parser->p++;
+	}
+	token[length] = '\0';
+	return length > 0;
+}
+
+// Adds a test to the group being parsed, merged with a test of the same word when both are equalities
+static bool add_test(FilterParser *parser, const SmemFilterTest *test)
+{
+	SmemFilter *filter = parser->filter;
+
+	if (test->equal) {
+		for (unsigned int t = parser->group_start; t < filter->nb_tests; t++) {
+			SmemFilterTest *other = &filter->tests[t];
+			if (other->word == test->word && other->equal) {
+				if (((other->value ^ test->value) & other->mask & test->mask) != 0) {
+					// Two values for the same bits
+					parser->never = TRUE;
+				}
+				other->mask |= test->mask;
+				other->value |= test->value;
+				return TRUE;
+			}
+		}
+	}
+
+	if (filter->nb_tests == SMEM_FILTER_MAX_TESTS) {
+		return parse_error(parser, "too many terms");
+	}
+	filter->tests[filter->nb_tests++] = *test;
+	return TRUE;
+}
+
+// field ('=' | '!=') value
+static bool parse_term(FilterParser *parser)
+{
+	char token[FILTER_MAX_TOKEN];
+	const FilterField *field = NULL;
+	SmemFilterTest test;
+	uint32_t value;
+
+	if (!parse_token(parser, token)) {
+		return parse_error(parser, "field expected");
+	}
+	for (unsigned int f = 0; f < _countof(FILTER_FIELDS); f++) {
+		if (same_name(FILTER_FIELDS[f].name, token)) {
+			field = &FILTER_FIELDS[f];
+		}
+	}
+	if (field == NULL) {
+		return parse_error(parser, "unknown field");
+	}
+
+	skip_spaces(parser);
+	if (parser->p[0] == '!' && parser->p[1] == '=') {
+		test.equal = FALSE;
+		parser->p += 2;
+	}
+	else if (parser->p[0] == '=') {
+		test.equal = TRUE;
+		parser->p += parser->p[1] == '=' ? 2 : 1;
+	}
+	else {
+		return parse_error(parser, "'=' or '!=' expected");
+	}
+
+	if (!parse_token(parser, token)) {
+		return parse_error(parser, "value expected");
+	}
+	const FilterName *name = field->names;
+	while (name != NULL && name->name != NULL && !same_name(name->name, token)) {
+		name++;
+	}
+	if (name != NULL && name->name != NULL) {
+		value = name->value;
+	}
+	else {
+		char *end;
+		value = strtoul(token, &end, 0);
+		if (*end != '\0') {
+			return parse_error(parser, "unknown value");
+		}
+	}
+	if (value > (field->mask >> field->shift)) {
+		return parse_error(parser, "value out of range");
+	}
+
+	test.word = field->word;
+	test.mask = field->mask;
+	test.value = value << field->shift;
+	return add_test(parser, &test);
+}
+
+bool filter_compile(SmemFilter *filter, const char *text)
+{
+	FilterParser parser;
+
+	memset(filter, 0, sizeof(*filter));
+	parser.text = text;
+	parser.p = text;
+	parser.filter = filter;
+
+	for (;;) {
+		// Group of terms joined by '&'
+		parser.group_start = filter->nb_tests;
+		parser.never = FALSE;
+		for (;;) {
+			if (!parse_term(&parser)) {
+				return FALSE;
+			}
+			skip_spaces(&parser);
+			if (*parser.p != '&') {
+				break;
+			}
+			parser.p++;
+		}
+
+		if (parser.never) {
+			filter->nb_tests = parser.group_start;
+		}
+		else {
+			filter->group_end[filter->nb_groups++] = filter->nb_tests;
+		}
+
+		if (*parser.p == '\0') {
+			return TRUE;
+		}
+		if (*parser.p != '|') {
+			return parse_error(&parser, "'&' or '|' expected");
+		}
+		parser.p++;
+	}
+}
+
+bool filter_match(const SmemFilter *filter, const SmemLogRecord *rec)
+{
+	// In the order of SmemFilterTest.word
+	const uint32_t words[5] = { rec->id, rec->timestamp, rec->d1, rec->d2, rec->d3 };
+	unsigned int t = 0;
+
+	for (unsigned int g = 0; g < filter->nb_groups; g++) {
+		unsigned int end = filter->group_end[g];
+		for (; t < end; t++) {
+			const SmemFilterTest *test = &filter->tests[t];
+			if (((words[test->word] & test->mask) == test->value) != test->equal) {
+				break;
+			}
+		}
+		if (t == end) {
+			return TRUE;
+		}
+		t = end;
+	}
+	return FALSE;
+}
+
+bool select_record(SmemDecoderState *state, const SmemLogRecord *rec)
+{
+	if (state->filter == NULL) {
+		return TRUE;
+	}
+	if (rec->id == 0) {
+		// Skipped by print_event
+		return FALSE;
+	}
+
+	bool selected;
+	if ((rec->id & CONTINUE_MASK) == 0) {
+		state->selected = filter_match(state->filter, rec);
+		selected = state->selected;
+	}
+	else {
+		selected = continuation_selected(state, rec);
+	}
+	if (!selected) {
+		skip_record(state, rec);
+	}
+	return selected;
+}
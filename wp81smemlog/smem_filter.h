@@ -0,0 +1,59 @@
+#pragma once
+
+#define SMEM_FILTER_MAX_TESTS 32
+
+/**
+* @brief Comparison of a word of a record: (word & mask) == value, or != value.
+*/
+typedef struct {
+	uint8_t word;         // Index of the word in the record: 0 for id, 2 to 4 for d1 to d3
+	bool equal;           // FALSE for !=
+	uint32_t mask;
+	uint32_t value;
+} SmemFilterTest;
+
+/**
+* @brief Compiled filter: a record matches if all the tests of one of the groups pass.
+*/
+struct SmemFilter {
+	SmemFilterTest tests[SMEM_FILTER_MAX_TESTS];
+	unsigned int nb_tests;
+	unsigned int group_end[SMEM_FILTER_MAX_TESTS];  // End of the tests of each group
+	unsigned int nb_groups;
+};
+
+/**
+* @brief Compiles a filter expression.
+*
+* The expression is made of terms joined by '&' (and) and '|' (or, binding looser),
+* a term compares a field with '=' or '!=': proc (APPS, QDSP, WCNS, MODM or 0 to 3),
+* base (DEBUG, ONCRPC, SMEM, TMC, TIMETICK, ERR, RPC_ROUTER, CLKRGM, IPC_ROUTER, QCCI,
+* QCSI or a number), event, id, d1, d2 or d3. For example "proc=APPS & base=IPC_ROUTER | base=QCCI".
+* The terms of a group on the same word are merged into one mask and compare.
+*
+* @param filter Receives the compiled filter.
+* @param text The expression.
+* @return FALSE if the expression is invalid, the error is printed.
+*/
+bool filter_compile(SmemFilter *filter, const char *text);
+
+/**
+* @brief Tells if a record matches a filter.
+*
+* @param filter The compiled filter.
+* @param rec The record.
+*/
+bool filter_match(const SmemFilter *filter, const SmemLogRecord *rec);
+
+/**
+* @brief Tells if a record passes the filter of a decoding state, before it is printed.
+*
+* A first record is matched against the filter, its continuation records follow it.
+* A record which does not pass is given to skip_record, so that the next records print
+* the same text as without filter.
+*
+* @param state The decoding state, with its filter (NULL to select every record).
+* @param rec The record.
+* @return TRUE if the record must be printed.
+*/
+bool select_record(SmemDecoderState *state, const SmemLogRecord *rec);
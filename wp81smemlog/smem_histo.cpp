@@ -0,0 +1,88 @@
+#include "stdafx.h"
+#include "smem_histo.h"
+
+// Index of the highest bit set, value > 0
+static unsigned int highest_bit(uint64_t value)
+{
+	unsigned int bit = 0;
+
+	if (value >> 32) { value >>= 32; bit += 32; }
+	if (value >> 16) { value >>= 16; bit += 16; }
+	if (value >> 8) { value >>= 8; bit += 8; }
+	if (value >> 4) { value >>= 4; bit += 4; }
+	if (value >> 2) { value >>= 2; bit += 2; }
+	if (value >> 1) { bit += 1; }
+	return bit;
+}
+
+static unsigned int bucket_index(uint64_t value)
+{
+	if (value < SMEM_HISTO_LINEAR) {
+		return (unsigned int)value;
+	}
+	unsigned int exponent = highest_bit(value);
+	if (exponent >= SMEM_HISTO_MAX_EXPONENT) {
+		return SMEM_HISTO_BUCKETS - 1;
+	}
+	// The 3 bits below the highest one select the sub-bucket
+	return SMEM_HISTO_LINEAR + (exponent - 4) * SMEM_HISTO_SUB_BUCKETS + (unsigned int)((value >> (exponent - 3)) & 7);
+}
+
+static uint64_t bucket_start(unsigned int index)
+{
+	if (index < SMEM_HISTO_LINEAR) {
+		return index;
+	}
+	unsigned int exponent = (index - SMEM_HISTO_LINEAR) / SMEM_HISTO_SUB_BUCKETS + 4;
+	uint64_t sub = (index - SMEM_HISTO_LINEAR) % SMEM_HISTO_SUB_BUCKETS;
+	return (SMEM_HISTO_SUB_BUCKETS + sub) << (exponent - 3);
+}
+
+void histogram_init(SmemHistogram *histo)
+{
+	memset(histo, 0, sizeof(*histo));
+}
+
+void histogram_add(SmemHistogram *histo, uint64_t value)
+{
+	if (histo->count == 0 || value < histo->min) histo->min = value;
+	if (value > histo->max) histo->max = value;
+	histo->count++;
+	histo->sum += value;
+	histo->bucket[bucket_index(value)]++;
+}
+
+void histogram_merge(SmemHistogram *histo, const SmemHistogram *other)
+{
+	if (other->count == 0) {
+		return;
+	}
+	if (histo->count == 0 || other->min < histo->min) histo->min = other->min;
+	if (other->max > histo->max) histo->max = other->max;
+	histo->count += other->count;
+	histo->sum += other->sum;
+	for (unsigned int b = 0; b < SMEM_HISTO_BUCKETS; b++) {
+		histo->bucket[b] += other->bucket[b];
+	}
+}
+
+uint64_t histogram_percentile(const SmemHistogram *histo, double fraction)
+{
+	uint64_t rank = (uint64_t)(fraction * (double)histo->count);
+	uint64_t seen = 0;
+
+	if (histo->count == 0) {
+		return 0;
+	}
+	if (rank >= histo->count) {
+		return histo->max;
+	}
+	for (unsigned int b = 0; b < SMEM_HISTO_BUCKETS; b++) {
+		seen += histo->bucket[b];
+		if (seen > rank) {
+			uint64_t start = bucket_start(b);
+			return start < histo->min ? histo->min : start;
+		}
+	}
+	return histo->max;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+// Log-linear buckets: the values below 16 exactly, then 8 buckets per power of 2 up to 2^40
+#define SMEM_HISTO_LINEAR 16
+#define SMEM_HISTO_SUB_BUCKETS 8
+#define SMEM_HISTO_MAX_EXPONENT 40
+#define SMEM_HISTO_BUCKETS (SMEM_HISTO_LINEAR + (SMEM_HISTO_MAX_EXPONENT - 4) * SMEM_HISTO_SUB_BUCKETS)
+
+/**
+* @brief Histogram of durations in ticks, with a relative error below 1/8.
+*/
+typedef struct {
+	uint32_t bucket[SMEM_HISTO_BUCKETS];
+	uint64_t count;
+	uint64_t sum;
+	uint64_t min;
+	uint64_t max;
+} SmemHistogram;
+
+/**
+* @brief Empties a histogram.
+*/
+void histogram_init(SmemHistogram *histo);
+
+/**
+* @brief Adds a duration to a histogram.
+*
+* @param histo The histogram.
+* @param value The duration in ticks, the values above 2^40 are counted in the last bucket.
+*/
+void histogram_add(SmemHistogram *histo, uint64_t value);
+
+/**
+* @brief Adds the durations of a histogram to another one.
+*
+* @param histo The histogram receiving the durations.
+* @param other The histogram added.
+*/
+void histogram_merge(SmemHistogram *histo, const SmemHistogram *other);
+
+/**
+* @brief Returns the value below which a fraction of the durations fall.
+*
+* @param histo The histogram.
+* @param fraction The fraction, 0.5 for the median.
+* @return The lower bound of the bucket of the percentile, exact below 16 ticks, 0 if the histogram is empty.
+*/
+uint64_t histogram_percentile(const SmemHistogram *histo, double fraction);
@@ -0,0 +1,82 @@
+#include "stdafx.h"
+#include "smem_parse.h"
+#include "smem_chunk.h"
+#include "smem_dump.h"
+#include "smem_capture.h"
+#include "smem_archive.h"
+#include "smem_input.h"
+
+uint32_t input_clock_rate(const char *path, uint32_t clock_rate)
+{
+	if (is_capture_file(path) || is_archive_file(path)) {
+		// Same place in both headers
+		SmemCaptureHeader header;
+		FILE *file = NULL;
+		if (fopen_s(&file, path, "rb") == 0) {
+			if (fread(&header, sizeof(header), 1, file) == 1) {
+				clock_rate = header.clock_rate;
+			}
+			fclose(file);
+		}
+	}
+	return clock_rate;
+}
+
+// Gives the blocks of a capture file to the sink
+static bool read_capture(const char *path, SmemRecordSink sink, void *context)
+{
+	SmemCaptureBlock *block = (SmemCaptureBlock *)malloc(sizeof(SmemCaptureBlock));
+	uint64_t index = 0;
+	bool ok = block != NULL;
+
+	FILE *file = NULL;
+	if (fopen_s(&file, path, "rb") != 0) {
+		fprintf(stderr, "Failed to open %s\n", path);
+		ok = FALSE;
+	}
+
+	while (ok && fread(block, sizeof(*block), 1, file) == 1) {
+		const SmemCaptureHeader *header = &block->header;
+
+		if (header->magic != SMEM_CAPTURE_MAGIC || header->nb_records > SMEM_CAPTURE_BLOCK_RECORDS) {
+			fprintf(stderr, "%s: block %llu is not a capture block\n", path, (unsigned long long)index);
+			ok = FALSE;
+		}
+		else {
+			ok = sink(context, block->records, header->nb_records, header->nb_dropped);
+		}
+		index++;
+	}
+
+	if (file != NULL) {
+		fclose(file);
+	}
+	free(block);
+	return ok;
+}
+
+int read_input_file(const char *path, unsigned int nb_jobs, SmemRecordSink sink, void *context)
+{
+	bool ok;
+
+	if (is_capture_file(path)) {
+		ok = read_capture(path, sink, context);
+	}
+	else if (is_archive_file(path)) {
+		SmemArchiveSource source;
+		ok = archive_source_open(&source, path);
+		if (ok) {
+			ok = copy_chunks(&source.base, nb_jobs, sink, context) == EXIT_SUCCESS;
+			archive_source_close(&source);
+		}
+	}
+	else {
+		SmemDumpSource source;
+		ok = dump_source_open(&source, path);
+		if (ok) {
+			ok = copy_chunks(&source.base, nb_jobs, sink, context) == EXIT_SUCCESS;
+			dump_source_close(&source);
+		}
+	}
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+/**
+* @brief Returns the clock rate of the timestamps of a record file.
+*
+* @param path A raw dump, capture or archive file.
+* @param clock_rate Clock rate of a raw dump, which does not record it.
+* @return The clock rate in the header of a capture or archive, else clock_rate.
+*/
+uint32_t input_clock_rate(const char *path, uint32_t clock_rate);
+
+/**
+* @brief Reads the records of a raw dump, capture or archive file and gives them to a sink, in order.
+*
+* Raw dumps and archives are loaded on several threads (see copy_chunks).
+*
+* @param path The file.
+* @param nb_jobs Threads loading a raw dump or an archive.
+* @param sink The sink of the records.
+* @param context The context of the sink.
+* @return EXIT_SUCCESS, or EXIT_FAILURE if the file cannot be read, the error is printed.
+*/
+int read_input_file(const char *path, unsigned int nb_jobs, SmemRecordSink sink, void *context);
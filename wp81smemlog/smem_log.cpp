@@ -18,7 +18,6 @@
 #define SMEM_LOG_QMI_CSI_EVENT_BASE       0x000F0000
 
 #define LSB_MASK      0x0000ffff
-#define CONTINUE_MASK 0x30000000
 
 /**
 * @brief Prints an unknown log record in a default hex format.
@@ -27,15 +26,100 @@
 * from smem_log.pl. It is used as a final fallback for event IDs
 * that are not recognized by any specialized print function.
 *
+* @param out The buffer receiving the text.
 * @param name The subsystem name (or "UNKNOWN" if determined earlier).
 * @param id The full event ID.
 * @param d1 The first 32-bit data payload.
 * @param d2 The second 32-bit data payload.
 * @param d3 The third 32-bit data payload.
 */
-void default_print(const char *name, uint32_t id, uint32_t d1, uint32_t d2, uint32_t d3)
+void default_print(SmemOutBuffer *out, const char *name, uint32_t id, uint32_t d1, uint32_t d2, uint32_t d3)
 {
-	printf("%s: %08x    %08x    %08x    %08x", name, id, d1, d2, d3);
+	emit_str(out, name);
+	emit_str(out, ": ");
+	emit_hex(out, id, 8);
+	emit_str(out, "    ");
+	emit_hex(out, d1, 8);
+	emit_str(out, "    ");
+	emit_hex(out, d2, 8);
+	emit_str(out, "    ");
+	emit_hex(out, d3, 8);
+}
+
+// "id:0x%08x LOG NOT IMPLEMENTED!" for the event bases not decoded yet.
+static void not_implemented_print(SmemOutBuffer *out, uint32_t id)
+{
+	emit_str(out, "id:0x");
+	emit_hex(out, id, 8);
+	emit_str(out, " LOG NOT IMPLEMENTED!");
+}
+
+// Words of the first record of an event, NULL for a continuation record without first record
+static const uint32_t *first_words(const SmemLogEvent *ev)
+{
+	return (ev->id & CONTINUE_MASK) == 0 ? ev->data : NULL;
+}
+
+// Words of the continuation record of an event, NULL if it did not come
+static const uint32_t *continuation_words(const SmemLogEvent *ev)
+{
+	if ((ev->id & CONTINUE_MASK) != 0) {
+		return ev->data;
+	}
+	return ev->nb_records > 1 ? &ev->data[3] : NULL;
+}
+
+#define JSON_KEY_MAX 16              // Characters of the keys of the JSON events, at most
+
+// ,"<key>": in front of each decoded field of a JSON event, with room for extra bytes of value after it
+static char *put_json_key(SmemOutBuffer *out, const char *key, size_t extra)
+{
+	// The keys are short literals: copied as they are read rather than measured first
+	char *p = outbuf_reserve(out, JSON_KEY_MAX + 4 + extra);
+
+	*p++ = ',';
+	*p++ = '"';
+	while (*key != '\0') {
+		*p++ = *key++;
+	}
+	*p++ = '"';
+	*p++ = ':';
+	return p;
+}
+
+static void json_key(SmemOutBuffer *out, const char *key)
+{
+	out->size = put_json_key(out, key, 0) - out->data;
+}
+
+// Key and value in a single reservation of the buffer
+static void json_uint(SmemOutBuffer *out, const char *key, uint32_t value)
+{
+	out->size = put_udec(put_json_key(out, key, 10), value) - out->data;
+}
+
+// Name from a print table, without the spaces aligning the text: the names need no escape
+static void json_name(SmemOutBuffer *out, const char *key, const char *name)
+{
+	size_t len = strlen(name);
+
+	while (len > 0 && name[len - 1] == ' ') {
+		len--;
+	}
+	char *p = put_json_key(out, key, len + 2);
+	p[0] = '"';
+	memcpy(p + 1, name, len);
+	p[len + 1] = '"';
+	out->size = p + len + 2 - out->data;
+}
+
+// Characters carried by the words of the records, up to the first null
+static void json_text(SmemOutBuffer *out, const char *key, const char *text, size_t len)
+{
+	const char *end = (const char *)memchr(text, '\0', len);
+
+	json_key(out, key);
+	emit_json_str(out, text, end != NULL ? end - text : len);
 }
 
 /**
@@ -45,14 +129,15 @@ void default_print(const char *name, uint32_t id, uint32_t d1, uint32_t d2, uint
 * from smem_log.pl. It formats and prints messages for various
 * debug events, including SMSM, PROXY, and QMUX.
 *
-* @param id The full event ID, including processor and continue flags.
-* @param d1 The first 32-bit data payload.
-* @param d2 The second 32-bit data payload.
-* @param d3 The third 32-bit data payload.
+* @param state The decoding state of the stream.
+* @param dec The decoder registry entry of the event base.
+* @param ev The event, its id includes the processor and continue flags.
 */
-void debug_print(uint32_t id, uint32_t d1, uint32_t d2, uint32_t d3)
+void debug_print(SmemDecoderState *state, const SmemLogDecoder *dec, const SmemLogEvent *ev)
 {
-	printf("id:0x%08x LOG NOT IMPLEMENTED!", id);
+	SmemOutBuffer *out = &state->out;
+
+	not_implemented_print(out, ev->id);
 }
 
 // Tables equivalent to Perl arrays
@@ -70,177 +155,220 @@ const char *QMI_CNTL_PRINT_TABLE[] = {
 	"IND "
 };
 
-// Global error data (persistent between calls)
-static uint32_t QCCI_ERR_DATA1 = '.';
-static uint32_t QCCI_ERR_DATA2 = '.';
-static uint32_t QCCI_ERR_DATA3 = '.';
+// Common part of the QCCI and QCSI TX/RX records: "<prefix><type> <cntl> Txn:0x%x Msg:0x%x Len:%d"
+static void qmi_txn_print(SmemOutBuffer *out, const char *prefix, const char *type, const char *cntl, uint32_t d1, uint32_t d2)
+{
+	emit_str(out, prefix);
+	emit_str(out, type);
+	emit_char(out, ' ');
+	emit_str(out, cntl);
+	emit_str(out, " Txn:0x");
+	emit_hex(out, d1 & 0xFFFF, 0);
+	emit_str(out, " Msg:0x");
+	emit_hex(out, d2 >> 16, 0);
+	emit_str(out, " Len:");
+	emit_udec(out, d2 & 0xFFFF);
+}
+
+// Continuation of the extended QCCI and QCSI TX/RX records: "<prefix>%04x:%04x:%04x"
+static void qmi_addr_print(SmemOutBuffer *out, const char *prefix, uint32_t d1, uint32_t d2, uint32_t d3)
+{
+	emit_str(out, prefix);
+	emit_hex(out, d1, 4);
+	emit_char(out, ':');
+	emit_hex(out, d2, 4);
+	emit_char(out, ':');
+	emit_hex(out, d3, 4);
+}
 
-void qmi_cci_print(uint32_t id, uint32_t d1, uint32_t d2, uint32_t d3)
+void qmi_cci_print(SmemDecoderState *state, const SmemLogDecoder *dec, const SmemLogEvent *ev)
 {
-	uint32_t cont = id & CONTINUE_MASK;
-	id = id & 0xFFFF;
+	SmemOutBuffer *out = &state->out;
+	const uint32_t *first = first_words(ev);
+	const uint32_t *next = continuation_words(ev);
+
+	uint32_t id = ev->id & 0xFFFF;
 
 	if (id == 0x3) {
-		// QCCI ERROR
-		if (cont == 0) {
-			QCCI_ERR_DATA1 = d1;
-			QCCI_ERR_DATA2 = d2;
-			QCCI_ERR_DATA3 = d3;
-		}
-		else {
-			printf("QCCI:   ERROR File = %c%c%c%c%c, Line=%d",
-				(char)QCCI_ERR_DATA1, (char)QCCI_ERR_DATA2, (char)QCCI_ERR_DATA3,
-				(char)d1, (char)d2, d3);
+		// QCCI ERROR, the file name spans the two records
+		if (next != NULL) {
+			// Perl: $QCCI_ERR_DATA1 = $QCCI_ERR_DATA2 = $QCCI_ERR_DATA3 = '.'
+			emit_str(out, "QCCI:   ERROR File = ");
+			emit_char(out, first != NULL ? (char)first[0] : '.');
+			emit_char(out, first != NULL ? (char)first[1] : '.');
+			emit_char(out, first != NULL ? (char)first[2] : '.');
+			emit_char(out, (char)next[0]);
+			emit_char(out, (char)next[1]);
+			emit_str(out, ", Line=");
+			emit_dec(out, (int32_t)next[2]);
 		}
 	}
 	else if (id == 0x0 || id == 0x1) {
 		// Legacy TX and RX
 		const char *type = QMI_PRINT_TABLE[id];
-		const char *cntl = QMI_CNTL_PRINT_TABLE[(d1 >> 16) & 0xFFFF];
-		printf("QCCI:   %s %s Txn:0x%x Msg:0x%x Len:%d",
-			type, cntl,
-			d1 & 0xFFFF,
-			d2 >> 16,
-			d2 & 0xFFFF);
+		const char *cntl = QMI_CNTL_PRINT_TABLE[(ev->data[0] >> 16) & 0xFFFF];
+		qmi_txn_print(out, "QCCI:   ", type, cntl, ev->data[0], ev->data[1]);
 	}
 	else if (id == 0x4 || id == 0x5) {
 		// Extended TX and RX
 		const char *type = QMI_PRINT_TABLE[id - 0x4];
-		const char *cntl = QMI_CNTL_PRINT_TABLE[(d1 >> 16) & 0xFFFF];
-		if (cont == 0) {
-			printf("QCCI:   %s %s Txn:0x%x Msg:0x%x Len:%d svc_id:0x%x",
-				type, cntl,
-				d1 & 0xFFFF,
-				d2 >> 16,
-				d2 & 0xFFFF,
-				d3);
+		if (first != NULL) {
+			const char *cntl = QMI_CNTL_PRINT_TABLE[(first[0] >> 16) & 0xFFFF];
+			qmi_txn_print(out, "QCCI:   ", type, cntl, first[0], first[1]);
+			emit_str(out, " svc_id:0x");
+			emit_hex(out, first[2], 0);
 		}
-		else {
-			printf(" svc_addr: %04x:%04x:%04x", d1, d2, d3);
+		if (next != NULL) {
+			qmi_addr_print(out, " svc_addr: ", next[0], next[1], next[2]);
 		}
 	}
 }
 
-// Global variables
-static char QCSI_ERR_DATA1 = '.';
-static char QCSI_ERR_DATA2 = '.';
-static char QCSI_ERR_DATA3 = '.';
+void qmi_csi_print(SmemDecoderState *state, const SmemLogDecoder *dec, const SmemLogEvent *ev) {
+	SmemOutBuffer *out = &state->out;
+	const uint32_t *first = first_words(ev);
+	const uint32_t *next = continuation_words(ev);
 
-void qmi_csi_print(uint32_t id, uint32_t d1, uint32_t d2, uint32_t d3) {
-	uint32_t cont = id & CONTINUE_MASK;
-	id = id & 0xffff;
+	uint32_t id = ev->id & 0xffff;
 
 	if (id == 0x3) {
-		if (cont == 0) {
-			QCSI_ERR_DATA1 = (char)(d1 & 0xff);
-			QCSI_ERR_DATA2 = (char)(d2 & 0xff);
-			QCSI_ERR_DATA3 = (char)(d3 & 0xff);
-		}
-		else {
-			printf("QCSI:   ERROR File = %c%c%c%c%c, Line=%d",
-				QCSI_ERR_DATA1, QCSI_ERR_DATA2, QCSI_ERR_DATA3,
-				(char)(d1 & 0xff), (char)(d2 & 0xff), d3);
+		if (next != NULL) {
+			emit_str(out, "QCSI:   ERROR File = ");
+			emit_char(out, first != NULL ? (char)(first[0] & 0xff) : '.');
+			emit_char(out, first != NULL ? (char)(first[1] & 0xff) : '.');
+			emit_char(out, first != NULL ? (char)(first[2] & 0xff) : '.');
+			emit_char(out, (char)(next[0] & 0xff));
+			emit_char(out, (char)(next[1] & 0xff));
+			emit_str(out, ", Line=");
+			emit_dec(out, (int32_t)next[2]);
 		}
 	}
 	else if (id == 0x0 || id == 0x1) {
 		const char *type = QMI_PRINT_TABLE[id];
-		uint32_t txn = d1 & 0xffff;
-		uint32_t msg = d2 >> 16;
-		uint32_t len = d2 & 0xffff;
-		const char *ctrl = QMI_CNTL_PRINT_TABLE[(d1 >> 16) % (sizeof(QMI_CNTL_PRINT_TABLE) / sizeof(QMI_CNTL_PRINT_TABLE[0]))];
-		printf("QCSI:   %s %s Txn:0x%x Msg:0x%x Len:%d",
-			type, ctrl, txn, msg, len);
+		const char *ctrl = QMI_CNTL_PRINT_TABLE[(ev->data[0] >> 16) % _countof(QMI_CNTL_PRINT_TABLE)];
+		qmi_txn_print(out, "QCSI:   ", type, ctrl, ev->data[0], ev->data[1]);
 	}
 	else if (id == 0x4 || id == 0x5) {
 		const char *type = QMI_PRINT_TABLE[id - 0x4];
-		uint32_t txn = d1 & 0xffff;
-		uint32_t msg = d2 >> 16;
-		uint32_t len = d2 & 0xffff;
-		const char *ctrl = QMI_CNTL_PRINT_TABLE[(d1 >> 16) % (sizeof(QMI_CNTL_PRINT_TABLE) / sizeof(QMI_CNTL_PRINT_TABLE[0]))];
-		if (cont == 0) {
-			printf("QCSI:   %s %s Txn:0x%x Msg:0x%x Len:%d svc_id:0x%x",
-				type, ctrl, txn, msg, len, d3);
+		if (first != NULL) {
+			const char *ctrl = QMI_CNTL_PRINT_TABLE[(first[0] >> 16) % _countof(QMI_CNTL_PRINT_TABLE)];
+			qmi_txn_print(out, "QCSI:   ", type, ctrl, first[0], first[1]);
+			emit_str(out, " svc_id:0x");
+			emit_hex(out, first[2], 0);
 		}
-		else {
-			printf(" clnt_addr: %04x:%04x:%04x", d1, d2, d3);
+		if (next != NULL) {
+			qmi_addr_print(out, " clnt_addr: ", next[0], next[1], next[2]);
 		}
 	}
 }
 
-// Assume a global buffer for the line header, 
-// as implied by its use in previous functions (e.g., oncrpc_print, smem_print).
-// This must be defined globally in a shared header or source file.
-#define LINE_HEADER_SIZE 256
-char LINE_HEADER[LINE_HEADER_SIZE];
+// Fields of qmi_cci_print and qmi_csi_print
+static void qmi_json(SmemDecoderState *state, const SmemLogDecoder *dec, const SmemLogEvent *ev)
+{
+	SmemOutBuffer *out = &state->out;
+	const uint32_t *first = first_words(ev);
+	const uint32_t *next = continuation_words(ev);
 
-// Global variables defined in the Perl script for time conversion
-#define HT_TIMER_CLOCK_RATE 19200000 // HT Timer
-#define SLEEP_CLOCK_RATE 32768 // Sleep clock
-#define TIMESTAMP_CLOCK_RATE SLEEP_CLOCK_RATE // Windows phone 8.1
+	uint32_t id = ev->id & 0xFFFF;
+
+	if (id == 0x3) {
+		json_name(out, "kind", "ERROR");
+		if (next != NULL) {
+			char file[5] = {
+				first != NULL ? (char)first[0] : '.', first != NULL ? (char)first[1] : '.', first != NULL ? (char)first[2] : '.',
+				(char)next[0], (char)next[1]
+			};
+			json_text(out, "file", file, sizeof(file));
+			json_key(out, "line");
+			emit_dec(out, (int32_t)next[2]);
+		}
+	}
+	else if (id == 0x0 || id == 0x1 || id == 0x4 || id == 0x5) {
+		// The legacy TX and RX are a single record
+		const uint32_t *words = id <= 0x1 ? ev->data : first;
+		json_name(out, "kind", QMI_PRINT_TABLE[id & 0x1]);
+		if (words != NULL) {
+			uint32_t cntl = words[0] >> 16;
+			json_name(out, "cntl", cntl < _countof(QMI_CNTL_PRINT_TABLE) ? QMI_CNTL_PRINT_TABLE[cntl] : "UNK");
+			json_uint(out, "txn", words[0] & 0xFFFF);
+			json_uint(out, "msg", words[1] >> 16);
+			json_uint(out, "len", words[1] & 0xFFFF);
+			if (id >= 0x4) json_uint(out, "svc_id", words[2]);
+		}
+		if (id >= 0x4 && next != NULL) {
+			json_key(out, "addr");
+			emit_char(out, '[');
+			emit_udec(out, next[0]);
+			emit_char(out, ',');
+			emit_udec(out, next[1]);
+			emit_char(out, ',');
+			emit_udec(out, next[2]);
+			emit_char(out, ']');
+		}
+	}
+}
+
+// Name of the processor in the 0xC0000000 bits of a record id
+const char *proc_name(uint32_t proc_flag)
+{
+	switch (proc_flag & 0xC0000000) {
+	case 0x80000000:
+		return "APPS";
+	case 0x40000000:
+		return "QDSP";
+	case 0xC0000000:
+		return "WCNS";
+	default:
+		return "MODM";
+	}
+}
+
+// Tag of the log index of the line, when the records of both indexes are merged
+static void emit_log_index(SmemDecoderState *state)
+{
+	// In verbose mode, the tag goes in front of the words of the record instead (see print_assembled)
+	if (state->log_index >= 0 && !state->verbose) {
+		emit_char(&state->out, '[');
+		emit_udec(&state->out, (uint32_t)state->log_index);
+		emit_str(&state->out, "] ");
+	}
+}
 
 /**
 * @brief Prints the log line header (time and processor/flag info).
 *
 * This function is a C conversion of the 'print_line_header' subroutine.
-* It formats the processor ID and time information and stores it in the
-* global LINE_HEADER buffer.
+* It formats the processor ID and time information into the output buffer.
 *
+* @param state The decoding state of the stream, holding the output buffer and the clock rate.
 * @param proc_flag The 32-bit flag containing the processor identifier (0xC0000000 mask).
-* @param time The timestamp of the log event (relative or absolute).
+* @param time The extended timestamp of the log event (relative or absolute).
 * @param ticks A flag: TRUE (1) if time is displayed in clock ticks, FALSE (0) if displayed in seconds.
 */
-void print_line_header(uint32_t proc_flag, uint32_t time, bool ticks)
+void print_line_header(SmemDecoderState *state, uint32_t proc_flag, uint64_t time, bool ticks)
 {
-	const char *proc_name;
-	double sec_time;
-
-	// Determine the processor name
-	switch (proc_flag) {
-	case 0x80000000:
-		proc_name = "APPS";
-		break;
-	case 0x40000000:
-		proc_name = "QDSP";
-		break;
-	case 0xC0000000:
-		proc_name = "WCNS";
-		break;
-	default:
-		proc_name = "MODM";
-		break;
-	}
+	SmemOutBuffer *out = &state->out;
+	const char *name = proc_name(proc_flag);
 
 	// Determine the time format
 	if (ticks) {
-		// Time is absolute ticks, printed raw
-		int result = _snprintf_s(LINE_HEADER, LINE_HEADER_SIZE, _TRUNCATE, "\n%4s: 0x%08x    ", proc_name, time);
-		// Manually ensure null termination if using _snprintf and buffer was filled
-		if (result >= 0 && (size_t)result >= LINE_HEADER_SIZE) {
-			LINE_HEADER[LINE_HEADER_SIZE - 1] = '\0';
-		}
+		// Time is absolute ticks, printed raw: "\n%4s: 0x%08x    "
+		emit_char(out, '\n');
+		emit_log_index(state);
+		emit_str_width(out, name, 4);
+		emit_str(out, ": 0x");
+		emit_hex64(out, time, 8);
+		emit_str(out, "    ");
 	}
 	else {
-		// Time is in ticks. Convert to seconds (float).
-		// TICKS_PER_SEC is defined and set to 32768.
-
-		if (TIMESTAMP_CLOCK_RATE != 0) {
-			sec_time = (double)time / TIMESTAMP_CLOCK_RATE;
-		}
-		else {
-			// Fallback for division by zero (should not happen if constants are correct)
-			sec_time = (double)time;
-		}
-
-		// Format the output into the global LINE_HEADER buffer
+		// Time is in ticks. Convert to seconds.
 		// Perl: sprintf( "%10.4f %4s ", $sec_time, $proc_name );
-		int result = _snprintf_s(LINE_HEADER, LINE_HEADER_SIZE, _TRUNCATE, "%4s: %14.6f    ", proc_name, sec_time);
-		// Manually ensure null termination if using _snprintf and buffer was filled
-		if (result >= 0 && (size_t)result >= LINE_HEADER_SIZE) {
-			LINE_HEADER[LINE_HEADER_SIZE - 1] = '\0';
-		}
+		emit_log_index(state);
+		emit_str_width(out, name, 4);
+		emit_str(out, ": ");
+		emit_seconds(out, &state->timebase, time);
+		emit_str(out, "    ");
 	}
-
-	printf("%s", LINE_HEADER);
 }
 
 /**
@@ -250,65 +378,97 @@ void print_line_header(uint32_t proc_flag, uint32_t time, bool ticks)
 * from smem_log.pl. It is used by various print functions (like tmc_print)
 * that rely on a simple event ID to name lookup.
 *
-* @param table A null-terminated array of strings (the event names).
-* @param name The subsystem name (e.g., "TMC", "TIMETICK").
-* @param id The full event ID.
-* @param d1 The first 32-bit data payload.
-* @param d2 The second 32-bit data payload.
-* @param d3 The third 32-bit data payload.
+* @param state The decoding state of the stream.
+* @param dec The decoder registry entry holding the subsystem name (e.g., "TMC", "TIMETICK")
+*            and the sized table of event names.
+* @param ev The event, a single record.
 */
-void generic_print(const char **table, const char *name,
-	uint32_t id, uint32_t d1, uint32_t d2, uint32_t d3)
+void generic_print(SmemDecoderState *state, const SmemLogDecoder *dec, const SmemLogEvent *ev)
 {
-	uint32_t event = id & LSB_MASK;
-	const char *cntrl = NULL;
-	unsigned int table_size = 0;
+	SmemOutBuffer *out = &state->out;
+	uint32_t id = ev->id, d1 = ev->data[0], d2 = ev->data[1], d3 = ev->data[2];
 
-	// Calculate the size of the table (it must be null-terminated or size must be passed)
-	// Assuming the table is correctly defined elsewhere and its size can be determined
-	// (e.g., by checking for a NULL entry, or more practically, passing the size).
-	// Since the Perl code implies iteration, we'll try to determine the count here.
-	// In a real C scenario, the size MUST be passed as an argument.
-	// For this conversion, we assume the tables are bounded and indexed 0-N.
-
-	// Safety check: Determine array size for bounds checking (imperfectly, but best effort)
-	// NOTE: This logic is a placeholder; in production C, pass the size explicitly.
-	const char **p = table;
-	while (*p != NULL) {
-		p++;
-		table_size++;
-	}
+	uint32_t event = id & LSB_MASK;
 
-	if (event >= 0 && event < table_size) {
-		cntrl = table[event];
-		printf("%s: %s 0x%08x 0x%08x 0x%08x", name, cntrl, d1, d2, d3);
+	if (event < dec->table_size) {
+		emit_str(out, dec->name);
+		emit_str(out, ": ");
+		emit_str(out, dec->table[event]);
+		emit_str(out, " 0x");
+		emit_hex(out, d1, 8);
+		emit_str(out, " 0x");
+		emit_hex(out, d2, 8);
+		emit_str(out, " 0x");
+		emit_hex(out, d3, 8);
 	}
 	else {
-		default_print(name, id, d1, d2, d3);
+		default_print(out, dec->name, id, d1, d2, d3);
 	}
 }
 
+// Fields of generic_print
+static void generic_json(SmemDecoderState *state, const SmemLogDecoder *dec, const SmemLogEvent *ev)
+{
+	uint32_t event = ev->id & LSB_MASK;
+
+	if (event < dec->table_size) {
+		json_name(&state->out, "name", dec->table[event]);
+	}
+}
+
+/**
+* @brief Prints a record of an event base without a specialized decoder.
+*
+* Registry adapter of default_print, the name of the registry entry
+* is printed in front of the raw payload.
+*/
+void unknown_print(SmemDecoderState *state, const SmemLogDecoder *dec, const SmemLogEvent *ev)
+{
+	SmemOutBuffer *out = &state->out;
+
+	default_print(out, dec->name, ev->id, ev->data[0], ev->data[1], ev->data[2]);
+}
+
 
 /**
 * @brief Prints ONCRPC log messages.
 * C conversion of oncrpc_print.
 */
-void oncrpc_print(uint32_t id, uint32_t d1, uint32_t d2, uint32_t d3) {
+void oncrpc_print(SmemDecoderState *state, const SmemLogDecoder *dec, const SmemLogEvent *ev) {
+	SmemOutBuffer *out = &state->out;
+
+	uint32_t id = ev->id;
 	uint32_t subsys = id & 0xf0;
 
 	if (subsys)
 	{
 		// BW Compatible print for QCCI & QCSI
+			SmemLogEvent qmi = *ev;
+			qmi.id = id & 0xffffff0f;
 			if (subsys == 0x30) {
-				qmi_cci_print(id & 0xffffff0f, d1, d2, d3);
+				qmi_cci_print(state, dec, &qmi);
 			}
 			else {
-				qmi_csi_print(id & 0xffffff0f, d1, d2, d3);
+				qmi_csi_print(state, dec, &qmi);
 			}
 	}
 	else
 	{
-		printf("id:0x%08x subsys:0x%02x LOG NOT IMPLEMENTED!", id, subsys);
+		emit_str(out, "id:0x");
+		emit_hex(out, id, 8);
+		emit_str(out, " subsys:0x");
+		emit_hex(out, subsys, 2);
+		emit_str(out, " LOG NOT IMPLEMENTED!");
+	}
+}
+
+// Fields of oncrpc_print: the BW compatible QCCI and QCSI
+static void oncrpc_json(SmemDecoderState *state, const SmemLogDecoder *dec, const SmemLogEvent *ev)
+{
+	if ((ev->id & 0xf0) != 0) {
+		SmemLogEvent qmi = *ev;
+		qmi.id = ev->id & 0xffffff0f;
+		qmi_json(state, dec, &qmi);
 	}
 }
 
@@ -316,9 +476,11 @@ void oncrpc_print(uint32_t id, uint32_t d1, uint32_t d2, uint32_t d3) {
 * @brief Prints SMEM log messages.
 * C conversion of smem_print.
 */
-void smem_print(uint32_t id, uint32_t d1, uint32_t d2, uint32_t d3)
+void smem_print(SmemDecoderState *state, const SmemLogDecoder *dec, const SmemLogEvent *ev)
 {
-	printf("id:0x%08x LOG NOT IMPLEMENTED!", id);
+	SmemOutBuffer *out = &state->out;
+
+	not_implemented_print(out, ev->id);
 }
 
 
@@ -326,9 +488,11 @@ void smem_print(uint32_t id, uint32_t d1, uint32_t d2, uint32_t d3)
 * @brief Prints Error log messages.
 * C conversion of err_print.
 */
-void err_print(uint32_t id, uint32_t d1, uint32_t d2, uint32_t d3)
+void err_print(SmemDecoderState *state, const SmemLogDecoder *dec, const SmemLogEvent *ev)
 {
-	printf("id:0x%08x LOG NOT IMPLEMENTED!", id);
+	SmemOutBuffer *out = &state->out;
+
+	not_implemented_print(out, ev->id);
 }
 
 
@@ -371,6 +535,13 @@ const char* ROUTER_PRINT_TABLE[] = {
 	"IPC_ROUTER", "IPC_ROUTER", "IPC_ROUTER"
 };
 
+enum IPC_ROUTER_PRINT_TABLE_enum {
+	IPC_ROUTER_ERROR,
+	IPC_ROUTER_TX,
+	IPC_ROUTER_RX,
+	IPC_ROUTER_PRINT_TABLE_SIZE
+};
+
 const char *IPC_ROUTER_PRINT_TABLE[] = {
 	"ERROR",
 	"TX",
@@ -388,94 +559,322 @@ const char *IPC_ROUTER_TYPE_TABLE[] = {
 	"RESUME_TX"
 };
 
-// Variables used for multi-part error printing
-static uint32_t ERR_DATA1, ERR_DATA2, ERR_DATA3;
+// Fields of a TX or RX data message, from its first record
+static void router_message_fields(uint32_t id, uint32_t d1, uint32_t d2, uint32_t d3, SmemRouterMessage *msg)
+{
+	msg->rx = (id & 0xff) == IPC_ROUTER_RX;
+	msg->src = d1;
+	msg->dst = d2;
+	msg->type = (uint8_t)(d3 >> 24);
+	msg->conf_rx = ((d3 >> 16) & 1) != 0;
+	msg->size = (uint16_t)(d3 & 0xFFFF);
+}
+
+bool router_message(const SmemLogRecord *rec, SmemRouterMessage *msg)
+{
+	uint32_t id = rec->id;
+	uint32_t cntl_type = (id >> 8) & 0xff;
+
+	if ((id & CONTINUE_MASK) != 0 || (cntl_type >= 4 && cntl_type <= 7)) {
+		return FALSE;
+	}
+	if ((id & BASE_MASK) == SMEM_LOG_RPC_ROUTER_EVENT_BASE && (id & 0xff) >= IPC_ROUTER1) {
+		// BW compatible IPC Router messages, see rpc_router_print
+		id -= 16;
+	}
+	else if ((id & BASE_MASK) != SMEM_LOG_IPC_ROUTER_EVENT_BASE) {
+		return FALSE;
+	}
+	if ((id & 0xff) != IPC_ROUTER_TX && (id & 0xff) != IPC_ROUTER_RX) {
+		return FALSE;
+	}
+
+	router_message_fields(id, rec->d1, rec->d2, rec->d3, msg);
+	return TRUE;
+}
+
+const char *router_type_name(uint32_t type)
+{
+	return type < _countof(IPC_ROUTER_TYPE_TABLE) ? IPC_ROUTER_TYPE_TABLE[type] : "UNKNOWN";
+}
+
+bool qmi_message(const SmemLogRecord *rec, SmemQmiMessage *msg)
+{
+	uint32_t id = rec->id;
+	uint32_t event = id & LSB_MASK;
+
+	if ((id & CONTINUE_MASK) != 0) {
+		return FALSE;
+	}
+	switch (id & BASE_MASK) {
+	case SMEM_LOG_ONCRPC_EVENT_BASE:
+		// BW compatible QCCI & QCSI, see oncrpc_print
+		if ((id & 0xf0) == 0) {
+			return FALSE;
+		}
+		msg->server = (id & 0xf0) != 0x30;
+		event &= 0xff0f;
+		break;
+	case SMEM_LOG_QMI_CCI_EVENT_BASE:
+		msg->server = FALSE;
+		break;
+	case SMEM_LOG_QMI_CSI_EVENT_BASE:
+		msg->server = TRUE;
+		break;
+	default:
+		return FALSE;
+	}
+	if (event != 0x4 && event != 0x5) {
+		return FALSE;
+	}
+
+	msg->rx = event == 0x5;
+	msg->cntl = (uint16_t)(rec->d1 >> 16);
+	msg->txn = (uint16_t)(rec->d1 & 0xFFFF);
+	msg->msg_id = (uint16_t)(rec->d2 >> 16);
+	msg->len = (uint16_t)(rec->d2 & 0xFFFF);
+	msg->svc_id = rec->d3;
+	return TRUE;
+}
+
+bool error_record(const SmemLogRecord *rec)
+{
+	uint32_t id = rec->id;
+	uint32_t event = id & LSB_MASK;
+
+	if ((id & CONTINUE_MASK) != 0) {
+		return FALSE;
+	}
+	switch (id & BASE_MASK) {
+	case SMEM_LOG_ONCRPC_EVENT_BASE:
+		// BW compatible QCCI & QCSI, see oncrpc_print
+		return (id & 0xf0) != 0 && (event & 0xff0f) == 0x3;
+	case SMEM_LOG_QMI_CCI_EVENT_BASE:
+	case SMEM_LOG_QMI_CSI_EVENT_BASE:
+		return event == 0x3;
+	case SMEM_LOG_RPC_ROUTER_EVENT_BASE:
+		// BW compatible IPC Router, see rpc_router_print
+		return (id & 0xff) == IPC_ROUTER1 + IPC_ROUTER_ERROR;
+	case SMEM_LOG_IPC_ROUTER_EVENT_BASE:
+		return (id & 0xff) == IPC_ROUTER_ERROR;
+	default:
+		return FALSE;
+	}
+}
+
+// IPC Router address "%02x:%06x" of a processor and port packed in a 32-bit payload
+static void router_addr_print(SmemOutBuffer *out, uint32_t addr)
+{
+	emit_hex(out, addr >> 24, 2);
+	emit_char(out, ':');
+	emit_hex(out, addr & 0xFFFFFF, 6);
+}
 
 // Main function equivalent to the Perl sub ipc_router_print
-void ipc_router_print(uint32_t id, uint32_t d1, uint32_t d2, uint32_t d3)
+void ipc_router_print(SmemDecoderState *state, const SmemLogDecoder *dec, const SmemLogEvent *ev)
 {
+	SmemOutBuffer *out = &state->out;
+	const uint32_t *first = first_words(ev);
+	const uint32_t *next = continuation_words(ev);
+
+	uint32_t id = ev->id;
 	uint8_t event = id & 0xff;
 	uint8_t cntl_type = (id >> 8) & 0xff;
+
+	if (event >= IPC_ROUTER_PRINT_TABLE_SIZE) {
+		// Not an IPC Router event, nothing to print
+		return;
+	}
+
 	const char *cntrl = IPC_ROUTER_PRINT_TABLE[event];
 
-	if (strcmp(cntrl, "ERROR") == 0) {
-		if ((id & CONTINUE_MASK) == 0) {
-			// First ERR record
-			printf("ROUTER: ERROR ");
-			ERR_DATA1 = d1;
-			ERR_DATA2 = d2;
-			ERR_DATA3 = d3;
+	if (event == IPC_ROUTER_ERROR) {
+		if (first != NULL) {
+			emit_str(out, "ROUTER: ERROR ");
 		}
-		else {
-			// Second ERR record: reconstruct name
-			char name[64];
-			uint32_t words[5] = { ERR_DATA1, ERR_DATA2, ERR_DATA3, d1, d2 };
+		if (next != NULL) {
+			// The file name spans the two records
+			char name[20];
+			uint32_t words[5] = { first != NULL ? first[0] : 0, first != NULL ? first[1] : 0, first != NULL ? first[2] : 0, next[0], next[1] };
 			memcpy(name, words, sizeof(words));
-			name[sizeof(name) - 1] = '\0';
 			// Trim at first null
-			name[strcspn(name, "\0")] = '\0';
-			printf("file: \"%s\" line: %u", name, d3);
+			const char *end = (const char *)memchr(name, '\0', sizeof(name));
+			emit_str(out, "file: \"");
+			emit_mem(out, name, end != NULL ? end - name : sizeof(name));
+			emit_str(out, "\" line: ");
+			emit_udec(out, next[2]);
 		}
 	}
-	else if (strcmp(cntrl, "TX") == 0 || strcmp(cntrl, "RX") == 0) {
-		if ((id & CONTINUE_MASK) == 0) {
+	else {
+		if (first != NULL) {
+			uint32_t d1 = first[0], d2 = first[1], d3 = first[2];
 			if (cntl_type >= 4 && cntl_type <= 5) {
-				uint32_t src_proc = d1 >> 24;
-				uint32_t src_port = d1 & 0xFFFFFF;
-				printf("ROUTER: %s [%s] (%x,%x) @ %02x:%06x",
-					cntrl, IPC_ROUTER_TYPE_TABLE[cntl_type],
-					d2, d3, src_proc, src_port);
+				emit_str(out, "ROUTER: ");
+				emit_str(out, cntrl);
+				emit_str(out, " [");
+				emit_str(out, IPC_ROUTER_TYPE_TABLE[cntl_type]);
+				emit_str(out, "] (");
+				emit_hex(out, d2, 0);
+				emit_char(out, ',');
+				emit_hex(out, d3, 0);
+				emit_str(out, ") @ ");
+				router_addr_print(out, d1);
 			}
 			else if (cntl_type >= 6 && cntl_type <= 7) {
-				printf("ROUTER: %s *%s* %08x:%08x",
-					cntrl, IPC_ROUTER_TYPE_TABLE[cntl_type],
-					d1, d2);
+				emit_str(out, "ROUTER: ");
+				emit_str(out, cntrl);
+				emit_str(out, " *");
+				emit_str(out, IPC_ROUTER_TYPE_TABLE[cntl_type]);
+				emit_str(out, "* ");
+				emit_hex(out, d1, 8);
+				emit_char(out, ':');
+				emit_hex(out, d2, 8);
 			}
 			else {
-				uint32_t src_proc = d1 >> 24;
-				uint32_t src_port = d1 & 0xFFFFFF;
-				uint32_t dst_proc = d2 >> 24;
-				uint32_t dst_port = d2 & 0xFFFFFF;
-				uint32_t type = d3 >> 24;
-				uint32_t conf_rx = (d3 >> 16) & 1;
-				uint32_t size = d3 & 0xFFFF;
-
-				if (strcmp(cntrl, "TX") == 0) {
-					printf("ROUTER: %s %02x:%06x -> %02x:%06x ",
-						cntrl, src_proc, src_port, dst_proc, dst_port);
+				SmemRouterMessage msg;
+				router_message_fields(id, d1, d2, d3, &msg);
+
+				emit_str(out, "ROUTER: ");
+				emit_str(out, cntrl);
+				emit_char(out, ' ');
+				if (!msg.rx) {
+					router_addr_print(out, msg.src);
+					emit_str(out, " -> ");
+					router_addr_print(out, msg.dst);
 				}
 				else {
-					printf("ROUTER: %s %02x:%06x <- %02x:%06x ",
-						cntrl, dst_proc, dst_port, src_proc, src_port);
+					router_addr_print(out, msg.dst);
+					emit_str(out, " <- ");
+					router_addr_print(out, msg.src);
 				}
 
-				printf("[%s] Len:%u ", IPC_ROUTER_TYPE_TABLE[type], size);
-				if (conf_rx)
-					printf("*CONF_RX* ");
+				emit_str(out, " [");
+				emit_str(out, router_type_name(msg.type));
+				emit_str(out, "] Len:");
+				emit_udec(out, msg.size);
+				emit_char(out, ' ');
+				if (msg.conf_rx)
+					emit_str(out, "*CONF_RX* ");
 			}
 		}
-		else {
+		if (next != NULL) {
 			// Second record for TX/RX
 			char iface[5] = { 0 };
 			char task[5] = { 0 };
-			memcpy(iface, &d1, 4);
-			memcpy(task, &d3, 4);
+			memcpy(iface, &next[0], 4);
+			memcpy(task, &next[2], 4);
 			iface[4] = '\0';
 			task[4] = '\0';
-			printf("<%s> TID:%08x,\"%s\"", iface, d2, task);
+			emit_char(out, '<');
+			emit_str(out, iface);
+			emit_str(out, "> TID:");
+			emit_hex(out, next[1], 8);
+			emit_str(out, ",\"");
+			emit_str(out, task);
+			emit_char(out, '"');
 		}
 	}
 }
 
+// Processor and port of an IPC Router address packed in a 32-bit payload
+static void json_router_addr(SmemOutBuffer *out, const char *proc_key, const char *port_key, uint32_t addr)
+{
+	json_uint(out, proc_key, addr >> 24);
+	json_uint(out, port_key, addr & 0xFFFFFF);
+}
+
+// Fields of ipc_router_print
+static void ipc_router_json(SmemDecoderState *state, const SmemLogDecoder *dec, const SmemLogEvent *ev)
+{
+	SmemOutBuffer *out = &state->out;
+	const uint32_t *first = first_words(ev);
+	const uint32_t *next = continuation_words(ev);
+
+	uint32_t id = ev->id;
+	uint8_t event = id & 0xff;
+	uint8_t cntl_type = (id >> 8) & 0xff;
+
+	if (event >= IPC_ROUTER_PRINT_TABLE_SIZE) {
+		return;
+	}
+	json_name(out, "kind", IPC_ROUTER_PRINT_TABLE[event]);
+
+	if (event == IPC_ROUTER_ERROR) {
+		if (next != NULL) {
+			// The file name spans the two records
+			char name[20];
+			uint32_t words[5] = { first != NULL ? first[0] : 0, first != NULL ? first[1] : 0, first != NULL ? first[2] : 0, next[0], next[1] };
+			memcpy(name, words, sizeof(words));
+			json_text(out, "file", name, sizeof(name));
+			json_uint(out, "line", next[2]);
+		}
+		return;
+	}
+	if (first != NULL) {
+		uint32_t d1 = first[0], d2 = first[1], d3 = first[2];
+		if (cntl_type >= 4 && cntl_type <= 5) {
+			json_name(out, "msg_type", IPC_ROUTER_TYPE_TABLE[cntl_type]);
+			json_uint(out, "service", d2);
+			json_uint(out, "instance", d3);
+			json_router_addr(out, "proc", "port", d1);
+		}
+		else if (cntl_type >= 6 && cntl_type <= 7) {
+			json_name(out, "msg_type", IPC_ROUTER_TYPE_TABLE[cntl_type]);
+			json_uint(out, "proc", d1);
+			json_uint(out, "port", d2);
+		}
+		else {
+			SmemRouterMessage msg;
+			router_message_fields(id, d1, d2, d3, &msg);
+
+			json_router_addr(out, "src_proc", "src_port", msg.src);
+			json_router_addr(out, "dst_proc", "dst_port", msg.dst);
+			json_name(out, "msg_type", router_type_name(msg.type));
+			json_uint(out, "len", msg.size);
+			json_key(out, "conf_rx");
+			emit_str(out, msg.conf_rx ? "true" : "false");
+		}
+	}
+	if (next != NULL) {
+		// Second record for TX/RX
+		json_text(out, "iface", (const char *)&next[0], 4);
+		json_uint(out, "tid", next[1]);
+		json_text(out, "task", (const char *)&next[2], 4);
+	}
+}
+
+// "<prefix>%08x    cid = %08x    tid = %08x" of the RPC Router records
+static void rpc_router_ids_print(SmemOutBuffer *out, const char *prefix, uint32_t d1, uint32_t d2, uint32_t d3)
+{
+	emit_str(out, prefix);
+	emit_hex(out, d1, 8);
+	emit_str(out, "    cid = ");
+	emit_hex(out, d2, 8);
+	emit_str(out, "    tid = ");
+	emit_hex(out, d3, 8);
+}
+
+// "<prefix>0x%08x vers=0x%08x tid = %08x" of the RPC Router server records
+static void rpc_router_server_print(SmemOutBuffer *out, const char *prefix, uint32_t d1, uint32_t d2, uint32_t d3)
+{
+	emit_str(out, prefix);
+	emit_hex(out, d1, 8);
+	emit_str(out, " vers=0x");
+	emit_hex(out, d2, 8);
+	emit_str(out, " tid = ");
+	emit_hex(out, d3, 8);
+}
+
 /**
 * @brief Prints RPC Router log messages.
 * C conversion of rpc_router_print.
 */
-void rpc_router_print(uint32_t id, uint32_t d1, uint32_t d2, uint32_t d3)
+void rpc_router_print(SmemDecoderState *state, const SmemLogDecoder *dec, const SmemLogEvent *ev)
 {
+	SmemOutBuffer *out = &state->out;
+	uint32_t id = ev->id, d1 = ev->data[0], d2 = ev->data[1], d3 = ev->data[2];
+
 	uint32_t event = id & 0xff;
-	uint32_t cntl_type = (id >> 8) & 0xff;
-	
 
 	if (event <= ROUTER_PRINT_TABLE_MAX)
 	{
@@ -485,67 +884,123 @@ void rpc_router_print(uint32_t id, uint32_t d1, uint32_t d2, uint32_t d3)
 		case IPC_ROUTER1:
 		case IPC_ROUTER2:
 		case IPC_ROUTER3:
+		{
 			//Old combination made the IPC Router start at 16,
 			// but the new ones start at 0.
-			ipc_router_print(id - 16, d1, d2, d3);
+			SmemLogEvent router = *ev;
+			router.id = id - 16;
+			ipc_router_print(state, dec, &router);
 			break;
+		}
 
 		case CNF_REQ:
 		case CNF_SNT:
-			printf("ROUTER: %s pid = %08x    cid = %08x    tid = %08x",
-				cntrl, d1, d2, d3);
+			emit_str(out, "ROUTER: ");
+			emit_str(out, cntrl);
+			rpc_router_ids_print(out, " pid = ", d1, d2, d3);
 			break;
 
 		case MID_READ:
-			printf("ROUTER: READ    mid = %08x    cid = %08x    tid = %08x",
-				d1, d2, d3);
+			rpc_router_ids_print(out, "ROUTER: READ    mid = ", d1, d2, d3);
 			break;
 
 		case MID_WRITTEN:
-			printf("ROUTER: WRITTEN mid = %08x    cid = %08x    tid = %08x",
-				d1, d2, d3);
+			rpc_router_ids_print(out, "ROUTER: WRITTEN mid = ", d1, d2, d3);
 			break;
 
 		case MID_CNF_REQ:
-			printf("ROUTER: CNF REQ pid = %08x    cid = %08x    tid = %08x",
-				d1, d2, d3);
+			rpc_router_ids_print(out, "ROUTER: CNF REQ pid = ", d1, d2, d3);
 			break;
 
 		case PING:
-			printf("ROUTER: PING    pid = %08x    cid = %08x    tid = %08x",
-				d1, d2, d3);
+			rpc_router_ids_print(out, "ROUTER: PING    pid = ", d1, d2, d3);
 			break;
 
 		case SERVER_PENDING:
-			printf("ROUTER: SERVER PENDING REGISTRATION    prog = 0x%08x vers=0x%08x tid = %08x",
-				d1, d2, d3);
+			rpc_router_server_print(out, "ROUTER: SERVER PENDING REGISTRATION    prog = 0x", d1, d2, d3);
 			break;
 
 		case SERVER_REGISTERED :
-			printf("ROUTER: PENDING SERVER REGISTERED      prog = 0x%08x vers=0x%08x tid = %08x",
-				d1, d2, d3);
+			rpc_router_server_print(out, "ROUTER: PENDING SERVER REGISTERED      prog = 0x", d1, d2, d3);
 			break;
 
 		default:
-			printf("ROUTER: %s xid = %08x    cid = %08x    tid = %08x",
-				cntrl, d1, d2, d3);
+			emit_str(out, "ROUTER: ");
+			emit_str(out, cntrl);
+			rpc_router_ids_print(out, " xid = ", d1, d2, d3);
 			break;
 		}
 	}
 	else
 	{
 		// Event ID is outside the known table range
-		generic_print(ROUTER_PRINT_TABLE, "ROUTER:   ", id, d1, d2, d3);
+		default_print(out, "ROUTER:   ", id, d1, d2, d3);
+	}
+}
+
+// Fields of rpc_router_print, named after the text of each event
+static void rpc_router_json(SmemDecoderState *state, const SmemLogDecoder *dec, const SmemLogEvent *ev)
+{
+	SmemOutBuffer *out = &state->out;
+	uint32_t id = ev->id, d1 = ev->data[0], d2 = ev->data[1], d3 = ev->data[2];
+
+	uint32_t event = id & 0xff;
+
+	if (event > ROUTER_PRINT_TABLE_MAX) {
+		return;
+	}
+	switch ((ROUTER_PRINT_TABLE_enum)event)
+	{
+	case IPC_ROUTER1:
+	case IPC_ROUTER2:
+	case IPC_ROUTER3:
+	{
+		SmemLogEvent router = *ev;
+		router.id = id - 16;
+		ipc_router_json(state, dec, &router);
+		return;
 	}
+
+	case CNF_REQ:
+	case CNF_SNT:
+	case MID_CNF_REQ:
+	case PING:
+		json_name(out, "name", ROUTER_PRINT_TABLE[event]);
+		json_uint(out, "pid", d1);
+		break;
+
+	case MID_READ:
+	case MID_WRITTEN:
+		json_name(out, "name", ROUTER_PRINT_TABLE[event]);
+		json_uint(out, "mid", d1);
+		break;
+
+	case SERVER_PENDING:
+	case SERVER_REGISTERED:
+		json_name(out, "name", ROUTER_PRINT_TABLE[event]);
+		json_uint(out, "prog", d1);
+		json_uint(out, "vers", d2);
+		json_uint(out, "tid", d3);
+		return;
+
+	default:
+		json_name(out, "name", ROUTER_PRINT_TABLE[event]);
+		json_uint(out, "xid", d1);
+		break;
+	}
+	json_uint(out, "cid", d2);
+	json_uint(out, "tid", d3);
 }
 
 /**
 * @brief Prints Clock Regime log messages.
 * C conversion of clkrgm_print.
 */
-void clkrgm_print(uint32_t id, uint32_t d1, uint32_t d2, uint32_t d3)
+void clkrgm_print(SmemDecoderState *state, const SmemLogDecoder *dec, const SmemLogEvent *ev)
 {
-	printf("id:0x%08x LOG NOT IMPLEMENTED!", id);
+	SmemOutBuffer *out = &state->out;
+
+	not_implemented_print(out, ev->id);
 }
 
 const char* TMC_PRINT_TABLE[] =
@@ -558,73 +1013,300 @@ const char* TIMETICK_PRINT_TABLE[] =
 "GOTO WAIT",
 "GOTO INIT" };
 
+// Index of the registry entry shared by all the event bases without decoder.
+#define SMEM_LOG_UNKNOWN_DECODER 0x10
+
+static_assert(SMEM_LOG_EVENT_SLOTS == 4 * SMEM_LOG_UNKNOWN_DECODER, "one event slot per processor and event base with a decoder");
+
 /**
-* @brief Prints a single SMEM log record based on its event type.
-*
-* This function is a C conversion of the 'print_record' subroutine
-* from smem_log.pl. It determines the event type from the record's ID
-* and calls the appropriate specialized print function.
+* @brief Decoder registry, indexed by the event base ((id & BASE_MASK) >> 16).
 *
-* @param rec A pointer to the SmemLogRecord to be printed.
+* The known event bases all fit below 0x10, every other value of the 12-bit
+* base is decoded by the last entry. The table is fully initialized at compile
+* time: selecting the decoder of a record is a single indexed load.
 */
-void print_record(const SmemLogRecord *rec)
+static const SmemLogDecoder SMEM_LOG_DECODERS[SMEM_LOG_UNKNOWN_DECODER + 1] = {
+	/* SMEM_LOG_DEBUG_EVENT_BASE */      { debug_print,      "DEBUG",    NULL, 0, NULL },
+	/* SMEM_LOG_ONCRPC_EVENT_BASE */     { oncrpc_print,     "ONCRPC",   NULL, 0, oncrpc_json },
+	/* SMEM_LOG_SMEM_EVENT_BASE */       { smem_print,       "SMEM",     NULL, 0, NULL },
+	/* SMEM_LOG_TMC_EVENT_BASE */        { generic_print,    "TMC",      TMC_PRINT_TABLE, _countof(TMC_PRINT_TABLE), generic_json },
+	/* SMEM_LOG_TIMETICK_EVENT_BASE */   { generic_print,    "TIMETICK", TIMETICK_PRINT_TABLE, _countof(TIMETICK_PRINT_TABLE), generic_json },
+	/* 0x00050000 */                     { unknown_print,    "UNKNOWN",  NULL, 0, NULL },
+	/* SMEM_ERR_EVENT_BASE */            { err_print,        "ERR",      NULL, 0, NULL },
+	/* 0x00070000 */                     { unknown_print,    "UNKNOWN",  NULL, 0, NULL },
+	/* 0x00080000 */                     { unknown_print,    "UNKNOWN",  NULL, 0, NULL },
+	/* SMEM_LOG_RPC_ROUTER_EVENT_BASE */ { rpc_router_print, "ROUTER",   ROUTER_PRINT_TABLE, _countof(ROUTER_PRINT_TABLE), rpc_router_json },
+	/* SMEM_LOG_CLKREGIM_EVENT_BASE */   { clkrgm_print,     "CLKRGM",   NULL, 0, NULL },
+	/* 0x000B0000 */                     { unknown_print,    "UNKNOWN",  NULL, 0, NULL },
+	/* 0x000C0000 */                     { unknown_print,    "UNKNOWN",  NULL, 0, NULL },
+	/* SMEM_LOG_IPC_ROUTER_EVENT_BASE */ { ipc_router_print, "ROUTER",   IPC_ROUTER_PRINT_TABLE, _countof(IPC_ROUTER_PRINT_TABLE), ipc_router_json },
+	/* SMEM_LOG_QMI_CCI_EVENT_BASE */    { qmi_cci_print,    "QCCI",     QMI_PRINT_TABLE, _countof(QMI_PRINT_TABLE), qmi_json },
+	/* SMEM_LOG_QMI_CSI_EVENT_BASE */    { qmi_csi_print,    "QCSI",     QMI_PRINT_TABLE, _countof(QMI_PRINT_TABLE), qmi_json },
+	/* SMEM_LOG_UNKNOWN_DECODER */       { unknown_print,    "UNKNOWN",  NULL, 0, NULL }
+};
+
+void decoder_state_init(SmemDecoderState *state, uint32_t clock_rate)
 {
-	// Get the event base ID by masking
-	uint32_t id = rec->id & BASE_MASK;
+	outbuf_init(&state->out, 4096);
+	timebase_init(&state->timebase, clock_rate);
+	state->base_time = 0;
+	state->relative_time = FALSE;
+	state->filter = NULL;
+	state->selected = TRUE;
+	state->log_index = -1;
+	state->json = FALSE;
+	state->verbose = FALSE;
+	memset(state->events, 0, sizeof(state->events));
+}
 
-	switch (id)
-	{
-	case SMEM_LOG_DEBUG_EVENT_BASE:
-		debug_print(rec->id, rec->d1, rec->d2, rec->d3);
-		break;
+void decoder_state_free(SmemDecoderState *state)
+{
+	outbuf_free(&state->out);
+}
+
+const SmemLogDecoder *find_decoder(uint32_t id)
+{
+	uint32_t base = (id & BASE_MASK) >> 16;
+
+	return &SMEM_LOG_DECODERS[base < SMEM_LOG_UNKNOWN_DECODER ? base : SMEM_LOG_UNKNOWN_DECODER];
+}
+
+// Records of a TX, RX or ERROR event of the IPC Router, see ipc_router_print
+static unsigned int router_event_size(uint32_t id)
+{
+	uint32_t event = id & 0xff;
+	uint32_t cntl_type = (id >> 8) & 0xff;
+
+	if (event == IPC_ROUTER_ERROR) {
+		return 2;
+	}
+	if (event == IPC_ROUTER_TX || event == IPC_ROUTER_RX) {
+		// The control messages fit in one record
+		return cntl_type >= 4 && cntl_type <= 7 ? 1 : 2;
+	}
+	return 1;
+}
 
+unsigned int event_size(uint32_t id)
+{
+	uint32_t event = id & LSB_MASK;
+
+	switch (id & BASE_MASK) {
 	case SMEM_LOG_ONCRPC_EVENT_BASE:
-		oncrpc_print(rec->id, rec->d1, rec->d2, rec->d3);
+		// BW compatible QCCI & QCSI, see oncrpc_print
+		if ((id & 0xf0) == 0) {
+			return 1;
+		}
+		event &= 0xff0f;
 		break;
-
+	case SMEM_LOG_RPC_ROUTER_EVENT_BASE:
+		// BW compatible IPC Router, see rpc_router_print
+		event &= 0xff;
+		return event >= IPC_ROUTER1 && event <= IPC_ROUTER3 ? router_event_size(id - 16) : 1;
+	case SMEM_LOG_IPC_ROUTER_EVENT_BASE:
+		return router_event_size(id);
 	case SMEM_LOG_QMI_CCI_EVENT_BASE:
-		qmi_cci_print(rec->id, rec->d1, rec->d2, rec->d3);
-		break;
-
 	case SMEM_LOG_QMI_CSI_EVENT_BASE:
-		qmi_csi_print(rec->id, rec->d1, rec->d2, rec->d3);
 		break;
+	default:
+		return 1;
+	}
 
-	case SMEM_LOG_SMEM_EVENT_BASE:
-		smem_print(rec->id, rec->d1, rec->d2, rec->d3);
-		break;
+	// QCCI and QCSI ERROR, extended TX and RX
+	return event == 0x3 || event == 0x4 || event == 0x5 ? 2 : 1;
+}
 
-	case SMEM_LOG_TMC_EVENT_BASE:
-		generic_print(TMC_PRINT_TABLE, "TMC",
-			rec->id, rec->d1, rec->d2, rec->d3);
-		break;
+unsigned int event_slot(uint32_t id)
+{
+	uint32_t base = (id & BASE_MASK) >> 16;
 
-	case SMEM_LOG_TIMETICK_EVENT_BASE:
-		generic_print(TIMETICK_PRINT_TABLE, "TIMETICK",
-			rec->id, rec->d1, rec->d2, rec->d3);
-		break;
+	return base < SMEM_LOG_UNKNOWN_DECODER ? (id >> 30) * SMEM_LOG_UNKNOWN_DECODER + base : SMEM_LOG_EVENT_SLOTS;
+}
 
-	case SMEM_ERR_EVENT_BASE:
-		err_print(rec->id, rec->d1, rec->d2, rec->d3);
-		break;
+// Copies the words of a record after the ones an event already has
+static void add_event_record(SmemLogEvent *ev, const SmemLogRecord *rec)
+{
+	uint32_t *data = &ev->data[3 * ev->nb_records++];
 
-	case SMEM_LOG_RPC_ROUTER_EVENT_BASE:
-		rpc_router_print(rec->id, rec->d1, rec->d2, rec->d3);
-		break;
+	data[0] = rec->d1;
+	data[1] = rec->d2;
+	data[2] = rec->d3;
+}
 
-	case SMEM_LOG_IPC_ROUTER_EVENT_BASE:
-		ipc_router_print(rec->id, rec->d1, rec->d2, rec->d3);
-		break;
+/**
+* @brief Prints a single SMEM log record based on its event type.
+*
+* This function is a C conversion of the 'print_record' subroutine
+* from smem_log.pl. It determines the event base from the record's ID
+* and calls the decoder registered for it in SMEM_LOG_DECODERS.
+*
+* @param state The decoding state of the stream.
+* @param rec A pointer to the SmemLogRecord to be printed.
+*/
+void print_record(SmemDecoderState *state, const SmemLogRecord *rec)
+{
+	const SmemLogDecoder *dec = find_decoder(rec->id);
+	SmemLogEvent ev;
+
+	ev.id = rec->id;
+	ev.nb_records = 0;
+	ev.size = 1;
+	add_event_record(&ev, rec);
+	dec->handler(state, dec, &ev);
+}
 
-	case SMEM_LOG_CLKREGIM_EVENT_BASE:
-		clkrgm_print(rec->id, rec->d1, rec->d2, rec->d3);
-		break;
+// Prints an event as a JSON object on a line of its own, see print_event
+static void print_json_event(SmemDecoderState *state, const SmemLogDecoder *dec, const SmemLogEvent *ev)
+{
+	SmemOutBuffer *out = &state->out;
+	uint64_t time = ev->time - state->base_time;
+	size_t start = out->size;
+
+	// The comma in front of the first member opens the object
+	json_name(out, "proc", proc_name(ev->id));
+	out->data[start] = '{';
+	if (state->log_index >= 0) {
+		json_uint(out, "index", (uint32_t)state->log_index);
+	}
+	json_key(out, "time");
+	emit_udec64(out, time);
+	json_name(out, "base", dec->name);
+	json_uint(out, "event", ev->id & LSB_MASK);
+	if ((ev->id & CONTINUE_MASK) != 0) {
+		emit_str(out, ",\"continuation\":true");
+	}
+	else if (ev->nb_records < ev->size) {
+		emit_str(out, ",\"partial\":true");
+	}
+	if (dec->json != NULL) {
+		dec->json(state, dec, ev);
+	}
+	else {
+		// Nothing decoded: the record as it is
+		json_uint(out, "id", ev->id);
+		json_key(out, "data");
+		for (unsigned int i = 0; i < 3 * ev->nb_records; i++) {
+			emit_char(out, i == 0 ? '[' : ',');
+			emit_udec(out, ev->data[i]);
+		}
+		emit_char(out, ']');
+	}
+	emit_str(out, "}\n");
+}
 
-	default:
-		// Unknown event base just do "default" print
-		// Perl: default_print( undef, "UNKNOWN", $$rec[0], $$rec[2], ...)
-		default_print("UNKNOWN", rec->id, rec->d1, rec->d2, rec->d3);
-		break;
+// Verbose mode: the words of a record, after the tag of its log index
+static void emit_raw_line(SmemDecoderState *state, const SmemLogRecord *rec)
+{
+	if (state->log_index >= 0) {
+		emit_char(&state->out, '[');
+		emit_udec(&state->out, (uint32_t)state->log_index);
+		emit_str(&state->out, "] ");
+	}
+	print_raw_event(&state->out, *rec);
+}
+
+// Prints an event: a first record starts a line, a continuation record alone goes after the last line
+static void print_assembled(SmemDecoderState *state, const SmemLogDecoder *dec, const SmemLogEvent *ev)
+{
+	if (!ev->selected) {
+		return;
+	}
+	if (state->json) {
+		print_json_event(state, dec, ev);
+		return;
+	}
+	if (state->verbose) {
+		// The text follows the words of the first record
+		emit_raw_line(state, &ev->records[0]);
+		emit_char(&state->out, ' ');
+	}
+	if ((ev->id & CONTINUE_MASK) == 0) {
+		if (ev->new_line) emit_char(&state->out, '\n');
+
+		print_line_header(
+			state,
+			ev->id & 0xC0000000,           // Processor flag (MODM/APPS/Q6)
+			ev->time - state->base_time,   // Relative time
+			ev->ticks                      // Ticks or Seconds flag
+		);
+	}
+	dec->handler(state, dec, ev);
+	if (state->verbose) {
+		// Then the words of the continuation records, a line each
+		emit_char(&state->out, '\n');
+		for (unsigned int i = 1; i < ev->nb_records; i++) {
+			emit_raw_line(state, &ev->records[i]);
+			emit_char(&state->out, '\n');
+		}
+	}
+}
+
+void assemble_record(SmemDecoderState *state, const SmemLogDecoder *dec, const SmemLogRecord *rec,
+	uint64_t time, bool selected, bool ticks_flag, bool newLine_flag)
+{
+	unsigned int slot = event_slot(rec->id);
+	SmemLogEvent *pending = slot < SMEM_LOG_EVENT_SLOTS && state->events[slot].nb_records > 0 ? &state->events[slot] : NULL;
+
+	if ((rec->id & CONTINUE_MASK) != 0 && pending != NULL) {
+		// Next record of the event of the same processor and event base
+		if (state->verbose) pending->records[pending->nb_records] = *rec;
+		add_event_record(pending, rec);
+		if (pending->nb_records == pending->size) {
+			print_assembled(state, dec, pending);
+			pending->nb_records = 0;
+		}
+		return;
+	}
+	if ((rec->id & CONTINUE_MASK) == 0 && pending != NULL) {
+		// Its continuation records never came
+		print_assembled(state, dec, pending);
+		pending->nb_records = 0;
+	}
+
+	SmemLogEvent alone;
+	unsigned int size = (rec->id & CONTINUE_MASK) == 0 ? event_size(rec->id) : 1;
+	SmemLogEvent *ev = size > 1 ? &state->events[slot] : &alone;
+
+	ev->id = rec->id;
+	ev->time = time;
+	ev->nb_records = 0;
+	ev->size = size;
+	ev->selected = selected;
+	ev->ticks = ticks_flag;
+	ev->new_line = newLine_flag;
+	if (state->verbose) ev->records[0] = *rec;
+	add_event_record(ev, rec);
+	if (size == 1) {
+		print_assembled(state, dec, ev);
+	}
+}
+
+bool continuation_selected(const SmemDecoderState *state, const SmemLogRecord *rec)
+{
+	unsigned int slot = event_slot(rec->id);
+
+	if (slot < SMEM_LOG_EVENT_SLOTS && state->events[slot].nb_records > 0) {
+		return state->events[slot].selected;
+	}
+	return state->selected;
+}
+
+void flush_events(SmemDecoderState *state)
+{
+	for (unsigned int slot = 0; slot < SMEM_LOG_EVENT_SLOTS; slot++) {
+		SmemLogEvent *ev = &state->events[slot];
+		if (ev->nb_records > 0) {
+			print_assembled(state, find_decoder(ev->id), ev);
+			ev->nb_records = 0;
+		}
+	}
+}
+
+void skip_record(SmemDecoderState *state, const SmemLogRecord *rec)
+{
+	if (rec->id != 0) {
+		uint64_t time = timebase_extend(&state->timebase, rec->timestamp);
+		assemble_record(state, find_decoder(rec->id), rec, time, FALSE, FALSE, TRUE);
 	}
 }
 
@@ -633,43 +1315,40 @@ void print_record(const SmemLogRecord *rec)
 *
 * C conversion of the log processing loop logic from print_circular_log.
 *
+* @param state The decoding state of the stream (output buffer, timebase and relative time).
 * @param rec The log record to process.
-* @param base_time_ptr Pointer to the current base time (updated if relative_time_ptr is TRUE).
-* @param relative_time_ptr Pointer to the flag indicating if relative time must be set.
 * @param ticks_flag Flag: TRUE if time should be printed in raw ticks, FALSE for seconds.
+* @param newLine_flag Flag: TRUE if print new record on a new line, FALSE for print on the same line.
 */
 void print_event(
+	SmemDecoderState *state,
 	const SmemLogRecord *rec,
-	uint32_t *base_time_ptr,
-	bool *relative_time_ptr,
 	bool ticks_flag,
 	bool newLine_flag)
 {
 	if (rec->id != 0) {
-		if (*relative_time_ptr == TRUE) {
-			*base_time_ptr = rec->timestamp;
-
-			*relative_time_ptr = FALSE;
-		}
-
-		// Check if this is the start of a new log entry (not a continuation event)
-		if ((rec->id & CONTINUE_MASK) == 0) {
-			// Not continuation event, print header
+		uint64_t time = timebase_extend(&state->timebase, rec->timestamp);
 
-			if (newLine_flag) printf("\n");
+		if (state->relative_time == TRUE) {
+			state->base_time = time;
 
-			print_line_header(
-				rec->id & 0xC0000000,          // Processor flag (MODM/APPS/Q6)
-				rec->timestamp - *base_time_ptr,   // Relative time
-				ticks_flag                    // Ticks or Seconds flag
-			);
+			state->relative_time = FALSE;
 		}
 
-		print_record(rec);
+		assemble_record(state, find_decoder(rec->id), rec, time, TRUE, ticks_flag, newLine_flag);
 	}
 }
 
-void print_raw_event(const SmemLogRecord rec)
+void print_raw_event(SmemOutBuffer *out, const SmemLogRecord rec)
 {
-	printf("%08X %08X %08X %08X %08X", rec.id, rec.timestamp, rec.d1, rec.d2, rec.d3);
+	// "%08X %08X %08X %08X %08X"
+	emit_hex_upper(out, rec.id, 8);
+	emit_char(out, ' ');
+	emit_hex_upper(out, rec.timestamp, 8);
+	emit_char(out, ' ');
+	emit_hex_upper(out, rec.d1, 8);
+	emit_char(out, ' ');
+	emit_hex_upper(out, rec.d2, 8);
+	emit_char(out, ' ');
+	emit_hex_upper(out, rec.d3, 8);
 }
@@ -12,22 +12,274 @@ typedef struct {
 	uint32_t d3;         // $$rec[4]
 } SmemLogRecord;
 
+// Flags of the records continuing the previous record of the same event (from smem_log.pl)
+#define CONTINUE_MASK 0x30000000
+
+#define SMEM_LOG_EVENT_RECORDS 2        // Records of the longest event: a first record and a continuation record
+#define SMEM_LOG_EVENT_SLOTS 64         // Events being assembled: one per processor and event base below 0x10
+
+/**
+* @brief Event made of a first record and its continuation records, decoded in one call.
+*/
+typedef struct {
+	uint32_t id;              // Id of the first record, of the continuation record for a continuation without first record
+	uint64_t time;            // Extended timestamp of the first record
+	uint32_t data[3 * SMEM_LOG_EVENT_RECORDS];  // d1, d2 and d3 of each record
+	SmemLogRecord records[SMEM_LOG_EVENT_RECORDS];  // Records received, kept for their words in verbose mode only
+	unsigned int nb_records;  // Records received, 0 for a free slot
+	unsigned int size;        // Records of the complete event (see event_size)
+	bool selected;            // FALSE if the event is assembled but not printed (see skip_record)
+	bool ticks;               // Line layout requested with the first record (see print_event)
+	bool new_line;
+} SmemLogEvent;
+
+typedef struct SmemFilter SmemFilter;
+
+/**
+* @brief Decoding state of one stream of records.
+*
+* Everything a decoder keeps between two records lives here, so that
+* several streams can be decoded at the same time, each on its own thread.
+*/
+typedef struct {
+	SmemOutBuffer out;            // Decoded text of the stream
+	SmemTimebase timebase;        // Extension of the 32-bit timestamps
+	uint64_t base_time;           // Extended base time of the relative times
+	bool relative_time;           // TRUE if the next record sets base_time
+	SmemLogEvent events[SMEM_LOG_EVENT_SLOTS];  // Events waiting for their continuation records (see event_slot)
+	const SmemFilter *filter;     // Records to print, NULL for all (see select_record)
+	bool selected;                // TRUE if the last first record passed the filter
+	int log_index;                // Printed before the line headers when several log indexes are merged, -1 for none
+	bool json;                    // TRUE to print each event as a JSON object on its own line instead of text
+	bool verbose;                 // TRUE to print the words of the records of each event with its text (see print_event)
+} SmemDecoderState;
+
+/**
+* @brief Initializes the decoding state of a stream.
+*
+* @param state The decoding state.
+* @param clock_rate Ticks per second of the record timestamps.
+*/
+void decoder_state_init(SmemDecoderState *state, uint32_t clock_rate);
+
+/**
+* @brief Releases the memory of the decoding state of a stream.
+*/
+void decoder_state_free(SmemDecoderState *state);
+
+typedef struct SmemLogDecoder SmemLogDecoder;
+
 /**
-* @brief Processes a single log record, handles relative time and prints header/record.
+* @brief Signature of the decoders registered for an event base.
+*
+* An event is complete, or is missing its continuation records when the stream
+* has none for it: a decoder prints the parts it received.
+*
+* @param state The decoding state of the stream, holding the buffer receiving the text.
+* @param dec The registry entry of the event base.
+* @param ev The event, its id includes the processor and continue flags.
+*/
+typedef void (*SmemLogHandler)(SmemDecoderState *state, const SmemLogDecoder *dec, const SmemLogEvent *ev);
+
+/**
+* @brief Entry of the decoder registry.
+*/
+struct SmemLogDecoder {
+	SmemLogHandler handler;   // Decoder of the records of the event base
+	const char *name;         // Subsystem name
+	const char **table;       // Event names, indexed by the event ID (may be NULL)
+	unsigned int table_size;  // Number of entries in table
+	SmemLogHandler json;      // Decoded fields of an event as ",name:value" JSON members (may be NULL)
+};
+
+/**
+* @brief Returns the registry entry decoding the event base of a record.
+*
+* @param id The full event ID.
+*/
+const SmemLogDecoder *find_decoder(uint32_t id);
+
+/**
+* @brief Returns the number of records of the event a first record starts.
+*
+* @param id The id of the first record.
+* @return 2 for the events with a continuation record (IPC Router data messages and
+*         errors, extended QCCI and QCSI messages and errors), else 1.
+*/
+unsigned int event_size(uint32_t id);
+
+/**
+* @brief Returns the slot of the decoding state assembling the events of a record.
+*
+* The records of different processors and event bases go to different slots, so
+* that their interleaved first and continuation records are not mixed up.
+*
+* @param id The record id.
+* @return The slot, SMEM_LOG_EVENT_SLOTS for the event bases without a decoder.
+*/
+unsigned int event_slot(uint32_t id);
+
+/**
+* @brief Prints a single SMEM log record as an event of one record (without line header).
+*
+* @param state The decoding state of the stream.
+* @param rec The log record to print.
+*/
+void print_record(SmemDecoderState *state, const SmemLogRecord *rec);
+
+/**
+* @brief Returns the name of the processor of a record: MODM, QDSP, APPS or WCNS.
+*
+* @param proc_flag The processor flag of the record id (0xC0000000 mask).
+*/
+const char *proc_name(uint32_t proc_flag);
+
+/**
+* @brief Fields of an IPC Router TX or RX data message, as printed by ipc_router_print.
+*/
+typedef struct {
+	bool rx;              // FALSE for TX
+	uint32_t src;         // Sending processor and port, proc << 24 | port
+	uint32_t dst;         // Receiving processor and port
+	uint8_t type;         // Message type, see router_type_name
+	bool conf_rx;         // Confirmation of reception requested
+	uint16_t size;        // Length of the message in bytes
+} SmemRouterMessage;
+
+/**
+* @brief Tells if a record is the first record of an IPC Router TX or RX data message, and gets its fields.
+*
+* @param rec The log record.
+* @param msg Receives the fields of the message.
+* @return FALSE for the other records, including the control messages.
+*/
+bool router_message(const SmemLogRecord *rec, SmemRouterMessage *msg);
+
+/**
+* @brief Returns the name of an IPC Router message type: DATA, HELLO, BYE...
+*/
+const char *router_type_name(uint32_t type);
+
+#define SMEM_QMI_REQ 0
+#define SMEM_QMI_RESP 2
+#define SMEM_QMI_IND 4
+
+/**
+* @brief Fields of an extended QCCI or QCSI TX or RX record, as printed by qmi_cci_print and qmi_csi_print.
+*/
+typedef struct {
+	bool server;          // FALSE for QCCI (client), TRUE for QCSI (server)
+	bool rx;              // FALSE for TX
+	uint16_t cntl;        // SMEM_QMI_REQ, SMEM_QMI_RESP or SMEM_QMI_IND
+	uint16_t txn;         // Transaction id
+	uint16_t msg_id;
+	uint16_t len;         // Length of the message in bytes
+	uint32_t svc_id;      // Service id
+} SmemQmiMessage;
+
+/**
+* @brief Tells if a record is the first record of an extended QCCI or QCSI TX or RX, and gets its fields.
+*
+* The legacy TX and RX records have no service id and are not reported.
+*
+* @param rec The log record.
+* @param msg Receives the fields of the message.
+* @return FALSE for the other records.
+*/
+bool qmi_message(const SmemLogRecord *rec, SmemQmiMessage *msg);
+
+/**
+* @brief Tells if a record is the first record of a QCCI, QCSI or IPC Router ERROR event.
+*
+* @param rec The log record.
+*/
+bool error_record(const SmemLogRecord *rec);
+
+/**
+* @brief Prints the header of a record line: log index when merged (see SmemMerge), processor and time.
+*
+* @param state The decoding state of the stream.
+* @param proc_flag The processor flag of the record id (0xC0000000 mask).
+* @param time The extended timestamp of the record, relative to base_time.
+* @param ticks TRUE to print the time in ticks, FALSE in seconds.
+*/
+void print_line_header(SmemDecoderState *state, uint32_t proc_flag, uint64_t time, bool ticks);
+
+/**
+* @brief Adds a record to the events of a decoding state, prints the events it completes.
+*
+* A first record starts the event of its slot, the event left there without its
+* continuation record is printed first. A continuation record completes the event
+* of its slot, or is printed alone after the last line when the slot is empty.
+*
+* @param state The decoding state of the stream.
+* @param dec The registry entry of the event base of the record.
+* @param rec The log record, with an id.
+* @param time The extended timestamp of the record.
+* @param selected FALSE if the event the record starts is not printed (see select_record).
+* @param ticks_flag TRUE if time should be printed in raw ticks, FALSE for seconds.
+* @param newLine_flag TRUE to print the event on a new line.
+*/
+void assemble_record(SmemDecoderState *state, const SmemLogDecoder *dec, const SmemLogRecord *rec,
+	uint64_t time, bool selected, bool ticks_flag, bool newLine_flag);
+
+/**
+* @brief Tells if the event a continuation record completes is printed.
+*
+* @param state The decoding state of the stream.
+* @param rec The continuation record.
+* @return The verdict of the event of its slot, or of the last first record when the slot is empty.
+*/
+bool continuation_selected(const SmemDecoderState *state, const SmemLogRecord *rec);
+
+/**
+* @brief Prints the events still waiting for their continuation records, at the end of a stream.
+*
+* @param state The decoding state of the stream.
+*/
+void flush_events(SmemDecoderState *state);
+
+/**
+* @brief Extends the timebase with a record which is not printed and adds it to the events.
+*
+* The continuation records after it print the same text as without a filter.
+*
+* @param state The decoding state of the stream.
+* @param rec The log record.
+*/
+void skip_record(SmemDecoderState *state, const SmemLogRecord *rec);
+
+/**
+* @brief Processes a single log record, handles relative time and prints the events it completes.
 *
 * C conversion of the log processing loop logic from print_circular_log.
+* The text of an event is printed when its last record arrives (see assemble_record).
+*
+* With state->json, an event is a JSON object on a line of its own whatever the flags:
+* {"proc":"APPS","time":<ticks>,"base":"QCCI","event":<id & 0xffff>, then the fields of the decoder of
+* the base (see SmemLogDecoder.json)}, or "id":<id>,"data":[<d1, d2 and d3 of each record>] for the bases
+* without one. The time is the extended timestamp relative to the first record, whatever ticks_flag. "index" follows "proc" when several log indexes are merged, "continuation":true
+* or "partial":true follow "event" for a continuation record without its first record or an event without its continuation.
+*
+* With state->verbose, the words of each record of an event (see print_raw_event) are held until the event
+* is printed: the text follows the words of its first record, the words of its continuation records come
+* on the next lines, and every line ends. The caller passes newLine_flag FALSE.
 *
+* @param state The decoding state of the stream (output buffer, timebase and relative time).
 * @param rec The log record to process.
-* @param base_time_ptr Pointer to the current base time (updated if relative_time_ptr is TRUE).
-* @param relative_time_ptr Pointer to the flag indicating if relative time must be set.
 * @param ticks_flag Flag: TRUE if time should be printed in raw ticks, FALSE for seconds.
 * @param newLine_flag Flag: TRUE if print new record on a new line, FALSE for print on the same line.
 */
 void print_event(
+	SmemDecoderState *state,
 	const SmemLogRecord *rec,
-	uint32_t *base_time_ptr,
-	bool *relative_time_ptr,
 	bool ticks_flag,
 	bool newLine_flag);
 
-void print_raw_event(const SmemLogRecord rec);
\ No newline at end of file
+/**
+* @brief Prints the five words of a record in hex, the format parsed by smem_log.pl.
+*
+* @param out The buffer receiving the text.
+* @param rec The log record to print.
+*/
+void print_raw_event(SmemOutBuffer *out, const SmemLogRecord rec);
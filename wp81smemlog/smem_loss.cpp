@@ -0,0 +1,173 @@
+#include "stdafx.h"
+#include "smem_loss.h"
+
+void loss_tracker_init(SmemLossTracker *tracker, uint32_t clock_rate)
+{
+	memset(tracker, 0, sizeof(*tracker));
+	timebase_init(&tracker->timebase, clock_rate);
+}
+
+static double ticks_seconds(const SmemLossTracker *tracker, uint64_t ticks)
+{
+	return (double)ticks / (double)tracker->timebase.clock_rate;
+}
+
+// Starts or ends the line as the decoded records do, a JSON object has its new line
+static void emit_line(const SmemLossTracker *tracker, SmemOutBuffer *out, const char *text, bool new_line)
+{
+	if (new_line && !tracker->json) emit_char(out, '\n');
+	emit_str(out, text);
+	if (!new_line && !tracker->json) emit_char(out, '\n');
+}
+
+static void close_window(SmemLossTracker *tracker)
+{
+	if (tracker->window.nb_losses == 0) {
+		return;
+	}
+	if (tracker->nb_windows < SMEM_LOSS_MAX_WINDOWS) {
+		tracker->windows[tracker->nb_windows++] = tracker->window;
+	}
+	else {
+		tracker->nb_other_windows++;
+	}
+	tracker->window.nb_losses = 0;
+}
+
+static void close_period(SmemLossTracker *tracker, SmemOutBuffer *out, bool new_line)
+{
+	const SmemLossPeriod *period = &tracker->period;
+
+	if (period->nb_dropped == 0) {
+		return;
+	}
+	if (tracker->nb_periods < SMEM_LOSS_MAX_PERIODS) {
+		tracker->periods[tracker->nb_periods++] = *period;
+	}
+	else {
+		tracker->nb_other_periods++;
+	}
+	if (out != NULL) {
+		char text[160];
+		_snprintf_s(text, sizeof(text), _TRUNCATE, tracker->json
+			? "{\"loss_rate\":%.2f,\"start\":%.6f,\"end\":%.6f,\"dropped\":%llu,\"records\":%llu}\n"
+			: "LOSS RATE: %.2f %% from %.6f s to %.6f s (%llu of %llu records)",
+			100.0 * (double)period->nb_dropped / (double)(period->nb_records + period->nb_dropped),
+			ticks_seconds(tracker, period->start),
+			ticks_seconds(tracker, period->start + (uint64_t)SMEM_LOSS_PERIOD * tracker->timebase.clock_rate),
+			(unsigned long long)period->nb_dropped, (unsigned long long)(period->nb_records + period->nb_dropped));
+		emit_line(tracker, out, text, new_line);
+	}
+}
+
+// The records dropped since the last record ended before the one at time end
+static void end_loss(SmemLossTracker *tracker, uint64_t end, SmemOutBuffer *out, bool new_line)
+{
+	SmemLossWindow *window = &tracker->window;
+	uint64_t start = tracker->has_time ? tracker->last_time : end;
+
+	if (window->nb_losses > 0 && start <= window->end + (uint64_t)SMEM_LOSS_MERGE_GAP * tracker->timebase.clock_rate / 1000) {
+		window->end = end;
+	}
+	else {
+		close_window(tracker);
+		window->start = start;
+		window->end = end;
+		window->nb_dropped = 0;
+	}
+	window->nb_dropped += tracker->pending;
+	window->nb_losses += tracker->nb_pending;
+	tracker->period.nb_dropped += tracker->pending;
+
+	if (out != NULL) {
+		char text[128];
+		_snprintf_s(text, sizeof(text), _TRUNCATE, tracker->json
+			? "{\"loss\":%llu,\"start\":%.6f,\"end\":%.6f}\n"
+			: "LOSS: %llu records dropped between %.6f s and %.6f s",
+			(unsigned long long)tracker->pending, ticks_seconds(tracker, start), ticks_seconds(tracker, end));
+		emit_line(tracker, out, text, new_line);
+	}
+	tracker->pending = 0;
+	tracker->nb_pending = 0;
+}
+
+void loss_tracker_add(SmemLossTracker *tracker, const SmemLogRecord *records, size_t nb_records, uint32_t nb_dropped,
+	SmemOutBuffer *out, bool new_line)
+{
+	uint64_t period_ticks = (uint64_t)SMEM_LOSS_PERIOD * tracker->timebase.clock_rate;
+
+	if (nb_dropped > 0) {
+		tracker->pending += nb_dropped;
+		tracker->nb_pending++;
+		tracker->nb_dropped += nb_dropped;
+		tracker->nb_losses++;
+	}
+
+	for (size_t i = 0; i < nb_records; i++) {
+		if (records[i].id == 0) {
+			continue;
+		}
+		uint64_t time = timebase_extend(&tracker->timebase, records[i].timestamp);
+
+		if (!tracker->has_time) {
+			tracker->period.start = time;
+		}
+		else if (time >= tracker->period.start + period_ticks) {
+			close_period(tracker, out, new_line);
+			// The periods without record are skipped
+			tracker->period.start += (time - tracker->period.start) / period_ticks * period_ticks;
+			tracker->period.nb_records = 0;
+			tracker->period.nb_dropped = 0;
+		}
+		tracker->period.nb_records++;
+		tracker->nb_records++;
+
+		if (tracker->pending > 0) {
+			end_loss(tracker, time, out, new_line);
+		}
+		tracker->has_time = TRUE;
+		tracker->last_time = time;
+	}
+}
+
+void loss_tracker_print(SmemLossTracker *tracker, FILE *stream)
+{
+	if (tracker->pending > 0) {
+		end_loss(tracker, tracker->last_time, NULL, FALSE);
+	}
+	close_window(tracker);
+	close_period(tracker, NULL, FALSE);
+	tracker->period.nb_dropped = 0;
+
+	if (tracker->nb_dropped == 0) {
+		fprintf(stream, "Losses: none in %llu records\n", (unsigned long long)tracker->nb_records);
+		return;
+	}
+	fprintf(stream, "Losses: %llu records dropped by %llu reads, %.2f %% of %llu records\n",
+		(unsigned long long)tracker->nb_dropped, (unsigned long long)tracker->nb_losses,
+		100.0 * (double)tracker->nb_dropped / (double)(tracker->nb_records + tracker->nb_dropped),
+		(unsigned long long)(tracker->nb_records + tracker->nb_dropped));
+
+	fprintf(stream, "\n%-16s %14s %14s %12s %10s %8s\n", "window", "start s", "end s", "duration ms", "dropped", "reads");
+	for (uint32_t w = 0; w < tracker->nb_windows; w++) {
+		const SmemLossWindow *window = &tracker->windows[w];
+		uint64_t duration = window->end > window->start ? window->end - window->start : 0;
+		fprintf(stream, "%-16u %14.6f %14.6f %12.1f %10llu %8u\n", w + 1,
+			ticks_seconds(tracker, window->start), ticks_seconds(tracker, window->end),
+			ticks_seconds(tracker, duration) * 1000.0, (unsigned long long)window->nb_dropped, window->nb_losses);
+	}
+	if (tracker->nb_other_windows > 0) {
+		fprintf(stream, "%llu other windows\n", (unsigned long long)tracker->nb_other_windows);
+	}
+
+	fprintf(stream, "\n%-16s %14s %10s %10s %8s\n", "period", "start s", "records", "dropped", "loss %");
+	for (uint32_t p = 0; p < tracker->nb_periods; p++) {
+		const SmemLossPeriod *period = &tracker->periods[p];
+		fprintf(stream, "%-16u %14.6f %10llu %10llu %8.2f\n", p + 1, ticks_seconds(tracker, period->start),
+			(unsigned long long)period->nb_records, (unsigned long long)period->nb_dropped,
+			100.0 * (double)period->nb_dropped / (double)(period->nb_records + period->nb_dropped));
+	}
+	if (tracker->nb_other_periods > 0) {
+		fprintf(stream, "%llu other periods with losses\n", (unsigned long long)tracker->nb_other_periods);
+	}
+}
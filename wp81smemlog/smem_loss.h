@@ -0,0 +1,89 @@
+#pragma once
+
+#define SMEM_LOSS_MERGE_GAP 100         // Milliseconds of record time between two losses of the same window, at most
+#define SMEM_LOSS_MAX_WINDOWS 32        // Windows listed in the summary, the first ones
+#define SMEM_LOSS_PERIOD 10             // Seconds of record time of a loss rate
+#define SMEM_LOSS_MAX_PERIODS 64        // Periods with losses listed in the summary, the first ones
+
+/**
+* @brief Records lost around a span of record time.
+*
+* A loss reported by a read happened between the last record before it and the
+* first record after it; the losses closer than SMEM_LOSS_MERGE_GAP make a window.
+*/
+typedef struct {
+	uint64_t start;             // Extended timestamp of the last record before the first loss
+	uint64_t end;               // Extended timestamp of the first record after the last loss
+	uint64_t nb_dropped;
+	uint32_t nb_losses;         // Reads which reported records dropped
+} SmemLossWindow;
+
+/**
+* @brief Records received and lost during a period of SMEM_LOSS_PERIOD seconds of record time.
+*/
+typedef struct {
+	uint64_t start;             // Extended timestamp of the start of the period
+	uint64_t nb_records;
+	uint64_t nb_dropped;
+} SmemLossPeriod;
+
+/**
+* @brief Accounts for the records dropped by the log, in record time.
+*
+* The records are added in the order they are read, each loss before the
+* records read after it. The times are the extended timestamps of the records
+* with an id, a loss waits for the next one to know when it ended.
+*/
+typedef struct {
+	SmemTimebase timebase;
+	bool json;                  // TRUE to print the lines as JSON objects, as the events of a JSON decoding state
+	bool has_time;              // FALSE until a record with an id
+	uint64_t last_time;         // Extended timestamp of the last record with an id
+	uint64_t pending;           // Records dropped, waiting for the next record with an id
+	uint32_t nb_pending;        // Reads of these records
+	uint64_t nb_records;        // Records with an id
+	uint64_t nb_dropped;
+	uint64_t nb_losses;         // Reads which reported records dropped
+	SmemLossWindow window;      // Last window, nb_losses 0 before the first loss
+	SmemLossWindow windows[SMEM_LOSS_MAX_WINDOWS];  // Windows closed
+	uint32_t nb_windows;
+	uint64_t nb_other_windows;  // Windows closed while the table is full
+	SmemLossPeriod period;      // Current period, nb_records 0 before the first record
+	SmemLossPeriod periods[SMEM_LOSS_MAX_PERIODS];  // Periods ended with losses
+	uint32_t nb_periods;
+	uint64_t nb_other_periods;  // Periods with losses ended while the table is full
+} SmemLossTracker;
+
+/**
+* @brief Initializes a tracker.
+*
+* @param tracker The tracker.
+* @param clock_rate Ticks per second of the record timestamps.
+*/
+void loss_tracker_init(SmemLossTracker *tracker, uint32_t clock_rate);
+
+/**
+* @brief Adds the records of a read and the records it reported dropped before them.
+*
+* A line is printed for each loss once its end is known, and a loss rate at
+* the end of each period with losses.
+*
+* @param tracker The tracker.
+* @param records The records read.
+* @param nb_records Number of records.
+* @param nb_dropped Records dropped before these ones.
+* @param out Receives the lines, NULL to print nothing.
+* @param new_line TRUE to start the lines with a new line as print_event, FALSE to end them with it.
+*        A JSON object always ends with its new line: {"loss":<records>,"start":<s>,"end":<s>} or
+*        {"loss_rate":<%>,"start":<s>,"end":<s>,"dropped":<records>,"records":<records>}.
+*/
+void loss_tracker_add(SmemLossTracker *tracker, const SmemLogRecord *records, size_t nb_records, uint32_t nb_dropped,
+	SmemOutBuffer *out, bool new_line);
+
+/**
+* @brief Prints the losses, the loss windows and the loss rates of the periods with losses.
+*
+* @param tracker The tracker, with the losses still waiting for a record closed at the last record.
+* @param stream The stream printed to.
+*/
+void loss_tracker_print(SmemLossTracker *tracker, FILE *stream);
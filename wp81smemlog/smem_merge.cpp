@@ -0,0 +1,275 @@
+#include "stdafx.h"
+#include "smem_parse.h"
+#include "smem_chunk.h"
+#include "smem_input.h"
+#include "smem_filter.h"
+#include "smem_ring.h"
+#include "smem_merge.h"
+
+// Reads a flag written by the other thread
+static bool load_flag(volatile LONG *flag)
+{
+	return InterlockedExchangeAdd(flag, 0) != FALSE;
+}
+
+void merge_init(SmemMerge *merge, unsigned int nb_inputs, uint32_t clock_rate, const SmemFilter *filter, bool raw, bool verbose, bool json)
+{
+	merge->nb_inputs = nb_inputs;
+	merge->raw = raw;
+	merge->verbose = verbose;
+	merge->has_time = FALSE;
+	merge->last_time = 0;
+	outbuf_init(&merge->out, 4096);
+
+	for (unsigned int i = 0; i < nb_inputs; i++) {
+		SmemMergeInput *input = &merge->inputs[i];
+		ring_init(&input->queue, SMEM_MERGE_QUEUE_RECORDS);
+		input->idle = FALSE;
+		input->closed = FALSE;
+		input->nb_dropped = 0;
+		input->has_head = FALSE;
+		decoder_state_init(&input->state, clock_rate);
+		input->state.filter = filter;
+		input->state.json = json;
+		input->state.verbose = verbose;
+		// The raw lines carry the tag themselves (see emit_tag)
+		if (!raw || verbose) input->state.log_index = (int)i;
+	}
+}
+
+void merge_free(SmemMerge *merge)
+{
+	for (unsigned int i = 0; i < merge->nb_inputs; i++) {
+		decoder_state_free(&merge->inputs[i].state);
+	}
+	outbuf_free(&merge->out);
+}
+
+size_t merge_push(SmemMergeInput *input, const SmemLogRecord *records, size_t nb_records)
+{
+	uint32_t slot;
+	size_t room = ring_free(&input->queue, &slot);
+	size_t nb_pushed = nb_records < room ? nb_records : room;
+
+	for (size_t r = 0; r < nb_pushed; r++) {
+		input->records[(slot + r) & (SMEM_MERGE_QUEUE_RECORDS - 1)] = records[r];
+	}
+	ring_push(&input->queue, (uint32_t)nb_pushed);
+	return nb_pushed;
+}
+
+void merge_set_idle(SmemMergeInput *input, bool idle)
+{
+	InterlockedExchange(&input->idle, idle ? TRUE : FALSE);
+}
+
+void merge_close(SmemMergeInput *input)
+{
+	InterlockedExchange(&input->closed, TRUE);
+}
+
+// Finds the time of the record at the head of the queue of an input, FALSE if the queue is empty
+static bool load_head(SmemMerge *merge, SmemMergeInput *input)
+{
+	while (!input->has_head) {
+		uint32_t slot;
+		if (ring_used(&input->queue, &slot) == 0) {
+			return FALSE;
+		}
+		const SmemLogRecord *rec = &input->records[slot];
+		if (rec->id == 0) {
+			// No event, no meaningful timestamp
+			ring_pop(&input->queue, 1);
+			continue;
+		}
+
+		SmemTimebase *timebase = &input->state.timebase;
+		if (!timebase->started && merge->has_time) {
+			// Wraps counted from the records of the other indexes
+			timebase_resume(timebase, merge->last_time);
+		}
+		// Extending the same timestamp again when the record is printed leaves the timebase as it is
+		input->head_time = timebase_extend(timebase, rec->timestamp);
+		input->has_head = TRUE;
+	}
+	return TRUE;
+}
+
+static void emit_tag(SmemOutBuffer *out, unsigned int index)
+{
+	emit_char(out, '[');
+	emit_udec(out, index);
+	emit_str(out, "] ");
+}
+
+// Prints the record at the head of an input, as the loop of main does
+static void print_head(SmemMerge *merge, unsigned int index)
+{
+	SmemMergeInput *input = &merge->inputs[index];
+	SmemDecoderState *state = &input->state;
+	uint32_t slot;
+	ring_used(&input->queue, &slot);
+	SmemLogRecord record = input->records[slot];
+
+	ring_pop(&input->queue, 1);
+	input->has_head = FALSE;
+	merge->has_time = TRUE;
+	merge->last_time = input->head_time;
+
+	// The state prints in the merged buffer, its own one is kept aside
+	SmemOutBuffer own = state->out;
+	state->out = merge->out;
+	if (select_record(state, &record)) {
+		if (merge->verbose) {
+			// The words of the record are printed with the text of its event, behind the tag
+			print_event(state, &record, FALSE, FALSE);
+		}
+		else if (merge->raw) {
+			emit_tag(&state->out, index);
+			print_raw_event(&state->out, record);
+			emit_char(&state->out, '\n');
+		}
+		else {
+			print_event(state, &record, FALSE, TRUE);
+		}
+	}
+	merge->out = state->out;
+	state->out = own;
+}
+
+bool merge_print(SmemMerge *merge)
+{
+	for (;;) {
+		unsigned int oldest = SMEM_MERGE_MAX_INPUTS;
+		unsigned int nb_closed = 0;
+
+		for (unsigned int i = 0; i < merge->nb_inputs; i++) {
+			SmemMergeInput *input = &merge->inputs[i];
+			// The flags are read before the queue: records pushed before closing are not missed
+			bool closed = load_flag(&input->closed);
+			bool idle = load_flag(&input->idle);
+			if (!load_head(merge, input)) {
+				if (closed) {
+					nb_closed++;
+					continue;
+				}
+				if (idle) {
+					continue;
+				}
+				// Its next record may be the oldest one
+				outbuf_flush(&merge->out, stdout);
+				return TRUE;
+			}
+			// Ties go to the lowest index
+			if (oldest == SMEM_MERGE_MAX_INPUTS || input->head_time < merge->inputs[oldest].head_time) {
+				oldest = i;
+			}
+		}
+
+		if (oldest == SMEM_MERGE_MAX_INPUTS) {
+			outbuf_flush(&merge->out, stdout);
+			return nb_closed < merge->nb_inputs;
+		}
+		print_head(merge, oldest);
+	}
+}
+
+void merge_finish(SmemMerge *merge)
+{
+	for (unsigned int i = 0; i < merge->nb_inputs; i++) {
+		SmemDecoderState *state = &merge->inputs[i].state;
+		SmemOutBuffer own = state->out;
+		state->out = merge->out;
+		flush_events(state);
+		merge->out = state->out;
+		state->out = own;
+	}
+	outbuf_flush(&merge->out, stdout);
+}
+
+// Producer of the records of a file
+typedef struct {
+	const char *path;
+	unsigned int nb_jobs;
+	SmemMergeInput *input;
+	int status;
+} MergeFileReader;
+
+// Waits for room in the queue rather than dropping records
+static bool push_records(void *context, const SmemLogRecord *records, size_t nb_records, uint32_t nb_dropped)
+{
+	SmemMergeInput *input = (SmemMergeInput *)context;
+
+	input->nb_dropped += nb_dropped;
+	for (;;) {
+		size_t nb_pushed = merge_push(input, records, nb_records);
+		records += nb_pushed;
+		nb_records -= nb_pushed;
+		if (nb_records == 0) {
+			return TRUE;
+		}
+		Sleep(1);
+	}
+}
+
+static DWORD WINAPI read_file_thread(LPVOID param)
+{
+	MergeFileReader *reader = (MergeFileReader *)param;
+
+	reader->status = read_input_file(reader->path, reader->nb_jobs, push_records, reader->input);
+	merge_close(reader->input);
+	return 0;
+}
+
+int merge_files(const char *const *paths, unsigned int nb_paths, unsigned int nb_jobs, uint32_t clock_rate,
+	const SmemFilter *filter, bool raw, bool verbose, bool json)
+{
+	SmemMerge *merge = (SmemMerge *)malloc(sizeof(SmemMerge));
+	MergeFileReader readers[SMEM_MERGE_MAX_INPUTS];
+	HANDLE threads[SMEM_MERGE_MAX_INPUTS];
+	unsigned int nb_threads = 0;
+	int status = EXIT_SUCCESS;
+
+	if (merge == NULL) {
+		fprintf(stderr, "Not enough memory for the merge\n");
+		return EXIT_FAILURE;
+	}
+	// The files come from the same device and clock
+	merge_init(merge, nb_paths, input_clock_rate(paths[0], clock_rate), filter, raw, verbose, json);
+
+	for (unsigned int i = 0; i < nb_paths; i++) {
+		readers[i].path = paths[i];
+		readers[i].nb_jobs = nb_jobs;
+		readers[i].input = &merge->inputs[i];
+		readers[i].status = EXIT_SUCCESS;
+		if (nb_threads == i && (threads[i] = CreateThread(NULL, 0, read_file_thread, &readers[i], 0, NULL)) != NULL) {
+			nb_threads++;
+		}
+		else {
+			// Merged without this file
+			readers[i].status = EXIT_FAILURE;
+			merge_close(readers[i].input);
+		}
+	}
+	if (nb_threads < nb_paths) {
+		fprintf(stderr, "Failed to create the reader threads (error %u)\n", GetLastError());
+	}
+
+	while (merge_print(merge)) {
+		Sleep(1);
+	}
+	merge_finish(merge);
+
+	if (nb_threads > 0) {
+		WaitForMultipleObjectsEx(nb_threads, threads, TRUE, INFINITE, FALSE);
+	}
+	for (unsigned int i = 0; i < nb_threads; i++) {
+		CloseHandle(threads[i]);
+	}
+	for (unsigned int i = 0; i < nb_paths; i++) {
+		if (readers[i].status != EXIT_SUCCESS) status = EXIT_FAILURE;
+		if (verbose) printf("Index %u: %llu records dropped\n", i, (unsigned long long)merge->inputs[i].nb_dropped);
+	}
+	merge_free(merge);
+	return status;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#define SMEM_MERGE_MAX_INPUTS 2         // Log indexes: SMEM_LOG_EVENTS and SMEM_LOG_POWER_EVENTS
+#define SMEM_MERGE_QUEUE_RECORDS 4096   // Records waiting in the queue of an input, a power of 2
+
+/**
+* @brief Records of one log index waiting to be merged.
+*/
+typedef struct {
+	SmemRing queue;             // Records from the producer thread to the consumer
+	SmemLogRecord records[SMEM_MERGE_QUEUE_RECORDS];
+	volatile LONG idle;         // TRUE while the producer knows no record older than the queued ones
+	volatile LONG closed;       // TRUE once the producer pushed its last record
+	uint64_t nb_dropped;        // Written by the producer, read once it is closed
+	SmemDecoderState state;     // Decoding of the records of the index, its timebase orders them
+	bool has_head;              // TRUE if head_time is the time of the record at the head of the queue
+	uint64_t head_time;
+} SmemMergeInput;
+
+/**
+* @brief Merge of the records of several log indexes in timestamp order.
+*
+* Each index is read by its own thread into the queue of its input, the
+* consumer prints the oldest head record of the inputs, tagged with its index.
+* An empty input holds the merge back until its producer has records again,
+* is idle (nothing available, the other inputs can go on) or is closed.
+*/
+typedef struct {
+	SmemMergeInput inputs[SMEM_MERGE_MAX_INPUTS];
+	unsigned int nb_inputs;
+	SmemOutBuffer out;          // Merged text, the decoding states print into it in turn
+	bool raw;                   // Print the records in hex only
+	bool verbose;               // Print the records in hex then decoded
+	bool has_time;              // TRUE once a record is printed
+	uint64_t last_time;         // Extended timestamp of the last record printed
+} SmemMerge;
+
+/**
+* @brief Initializes a merge, its inputs are open and busy.
+*
+* @param merge The merge.
+* @param nb_inputs Number of log indexes, at most SMEM_MERGE_MAX_INPUTS.
+* @param clock_rate Ticks per second of the record timestamps.
+* @param filter Records to print, NULL for all.
+* @param raw TRUE to print the records in hex only.
+* @param verbose TRUE to print the records in hex then decoded.
+* @param json TRUE to print each event as a JSON object on its own line, tagged with the index of its input.
+*/
+void merge_init(SmemMerge *merge, unsigned int nb_inputs, uint32_t clock_rate, const SmemFilter *filter, bool raw, bool verbose, bool json);
+
+/**
+* @brief Releases the memory of a merge, once its producers are stopped.
+*/
+void merge_free(SmemMerge *merge);
+
+/**
+* @brief Pushes records in the queue of an input, from its producer thread.
+*
+* @param input The input.
+* @param records The records, in the order of the log.
+* @param nb_records Number of records.
+* @return Number of records pushed, less than nb_records when the queue is full.
+*/
+size_t merge_push(SmemMergeInput *input, const SmemLogRecord *records, size_t nb_records);
+
+/**
+* @brief Tells the consumer whether the producer of an input has more records to read.
+*
+* @param input The input.
+* @param idle TRUE when the last read found no record available.
+*/
+void merge_set_idle(SmemMergeInput *input, bool idle);
+
+/**
+* @brief Marks the end of the records of an input, from its producer thread.
+*/
+void merge_close(SmemMergeInput *input);
+
+/**
+* @brief Prints the records whose order is known, then writes the text to stdout.
+*
+* @param merge The merge.
+* @return FALSE once all the inputs are closed and printed.
+*/
+bool merge_print(SmemMerge *merge);
+
+/**
+* @brief Prints the events still waiting for their continuation records, at the end of the merge.
+*/
+void merge_finish(SmemMerge *merge);
+
+/**
+* @brief Decodes raw dump, capture or archive files recorded from different log indexes, merged in timestamp order.
+*
+* The first file is tagged 0, the second one 1.
+*
+* @param paths The files.
+* @param nb_paths Number of files, at most SMEM_MERGE_MAX_INPUTS.
+* @param nb_jobs Threads parsing each raw dump or archive.
+* @param clock_rate Ticks per second of the timestamps of a raw dump.
+* @param filter Records to print, NULL for all.
+* @param raw TRUE to print the records in hex only.
+* @param verbose TRUE to print the records in hex then decoded.
+* @param json TRUE to print each event as a JSON object on its own line, tagged with the index of its input.
+* @return EXIT_SUCCESS, or EXIT_FAILURE if a file cannot be read.
+*/
+int merge_files(const char *const *paths, unsigned int nb_paths, unsigned int nb_jobs, uint32_t clock_rate,
+	const SmemFilter *filter, bool raw, bool verbose, bool json);
@@ -0,0 +1,163 @@
+#include "stdafx.h"
+#include "smem_source.h"
+#include "smem_ring.h"
+#include "smem_histo.h"
+#include "smem_metrics.h"
+
+static void reset_counters(SmemMetricsCounters *counters)
+{
+	histogram_init(&counters->read_time);
+	histogram_init(&counters->read_records);
+	counters->nb_dropped = 0;
+	counters->decode_time = 0;
+	counters->nb_decoded = 0;
+	counters->write_time = 0;
+	counters->nb_writes = 0;
+	counters->nb_bytes = 0;
+}
+
+static void add_counters(SmemMetricsCounters *counters, const SmemMetricsCounters *other)
+{
+	histogram_merge(&counters->read_time, &other->read_time);
+	histogram_merge(&counters->read_records, &other->read_records);
+	counters->nb_dropped += other->nb_dropped;
+	counters->decode_time += other->decode_time;
+	counters->nb_decoded += other->nb_decoded;
+	counters->write_time += other->write_time;
+	counters->nb_writes += other->nb_writes;
+	counters->nb_bytes += other->nb_bytes;
+}
+
+void metrics_init(SmemMetrics *metrics)
+{
+	LARGE_INTEGER freq;
+
+	for (unsigned int s = 0; s < SMEM_METRICS_STAGES; s++) {
+		SmemMetricsChannel *channel = &metrics->channels[s];
+		reset_counters(&channel->counters);
+		channel->last_publish = GetTickCount();
+		ring_init(&channel->ring, SMEM_METRICS_SLOTS);
+	}
+	reset_counters(&metrics->interval);
+	reset_counters(&metrics->total);
+	QueryPerformanceFrequency(&freq);
+	metrics->tick_us = 1000000.0 / (double)freq.QuadPart;
+	metrics->start = GetTickCount();
+	metrics->last_report = metrics->start;
+}
+
+uint64_t metrics_clock(void)
+{
+	LARGE_INTEGER now;
+
+	QueryPerformanceCounter(&now);
+	return (uint64_t)now.QuadPart;
+}
+
+// Hands the counters of a stage to the reporting thread, unless it has not read the previous ones yet
+static void publish(SmemMetricsChannel *channel)
+{
+	DWORD now = GetTickCount();
+	uint32_t slot;
+
+	if (now - channel->last_publish < SMEM_METRICS_PUBLISH || ring_free(&channel->ring, &slot) == 0) {
+		return;
+	}
+	channel->slots[slot] = channel->counters;
+	ring_push(&channel->ring, 1);
+	reset_counters(&channel->counters);
+	channel->last_publish = now;
+}
+
+void metrics_read(SmemMetrics *metrics, uint64_t start, const SmemReadResult *result)
+{
+	SmemMetricsChannel *channel = &metrics->channels[SMEM_METRICS_READER];
+
+	histogram_add(&channel->counters.read_time, metrics_clock() - start);
+	histogram_add(&channel->counters.read_records, result->nb_read);
+	channel->counters.nb_dropped += result->nb_dropped;
+	publish(channel);
+}
+
+void metrics_decode(SmemMetrics *metrics, uint64_t start, uint64_t nb_records)
+{
+	SmemMetricsChannel *channel = &metrics->channels[SMEM_METRICS_DECODER];
+
+	channel->counters.decode_time += metrics_clock() - start;
+	channel->counters.nb_decoded += nb_records;
+	publish(channel);
+}
+
+void metrics_write(SmemMetrics *metrics, uint64_t start, uint64_t nb_bytes)
+{
+	SmemMetricsChannel *channel = &metrics->channels[SMEM_METRICS_WRITER];
+
+	channel->counters.write_time += metrics_clock() - start;
+	channel->counters.nb_writes++;
+	channel->counters.nb_bytes += nb_bytes;
+	publish(channel);
+}
+
+// Adds the publications of the stages to the counters of the interval
+static void gather(SmemMetrics *metrics)
+{
+	for (unsigned int s = 0; s < SMEM_METRICS_STAGES; s++) {
+		SmemMetricsChannel *channel = &metrics->channels[s];
+		uint32_t slot;
+		uint32_t nb_slots = ring_used(&channel->ring, &slot);
+		for (uint32_t i = 0; i < nb_slots; i++) {
+			add_counters(&metrics->interval, &channel->slots[(slot + i) % SMEM_METRICS_SLOTS]);
+		}
+		ring_pop(&channel->ring, nb_slots);
+	}
+}
+
+static void print_counters(const SmemMetrics *metrics, const SmemMetricsCounters *counters, const char *title, DWORD elapsed)
+{
+	const SmemHistogram *read_time = &counters->read_time;
+	const SmemHistogram *records = &counters->read_records;
+	double seconds = (double)(elapsed > 0 ? elapsed : 1) / 1000.0;
+
+	fprintf(stderr, "Metrics %s %.1f s:\n", title, seconds);
+	fprintf(stderr, "  reads:   %llu calls, %.1f/s, %.2f records/call (p50 %llu, max %llu), %llu dropped\n",
+		(unsigned long long)read_time->count, (double)read_time->count / seconds,
+		records->count > 0 ? (double)records->sum / (double)records->count : 0.0,
+		(unsigned long long)histogram_percentile(records, 0.5), (unsigned long long)records->max,
+		(unsigned long long)counters->nb_dropped);
+	fprintf(stderr, "           latency us: p50 %.1f p90 %.1f p99 %.1f max %.1f\n",
+		histogram_percentile(read_time, 0.5) * metrics->tick_us, histogram_percentile(read_time, 0.9) * metrics->tick_us,
+		histogram_percentile(read_time, 0.99) * metrics->tick_us, read_time->max * metrics->tick_us);
+	fprintf(stderr, "  decode:  %llu records, %.0f ns/record\n",
+		(unsigned long long)counters->nb_decoded,
+		counters->nb_decoded > 0 ? counters->decode_time * metrics->tick_us * 1000.0 / (double)counters->nb_decoded : 0.0);
+	fprintf(stderr, "  output:  %llu bytes in %llu writes, %.1f ms writing, %.1f us/write\n",
+		(unsigned long long)counters->nb_bytes, (unsigned long long)counters->nb_writes,
+		counters->write_time * metrics->tick_us / 1000.0,
+		counters->nb_writes > 0 ? counters->write_time * metrics->tick_us / (double)counters->nb_writes : 0.0);
+}
+
+void metrics_update(SmemMetrics *metrics, DWORD now)
+{
+	gather(metrics);
+	if (now - metrics->last_report < SMEM_METRICS_PERIOD) {
+		return;
+	}
+	print_counters(metrics, &metrics->interval, "of the last", now - metrics->last_report);
+	fprintf(stderr, "  dropped: %llu in total\n", (unsigned long long)(metrics->total.nb_dropped + metrics->interval.nb_dropped));
+	add_counters(&metrics->total, &metrics->interval);
+	reset_counters(&metrics->interval);
+	metrics->last_report = now;
+}
+
+void metrics_print_total(SmemMetrics *metrics, DWORD now)
+{
+	gather(metrics);
+	// The threads have stopped: what they could not publish yet
+	for (unsigned int s = 0; s < SMEM_METRICS_STAGES; s++) {
+		add_counters(&metrics->interval, &metrics->channels[s].counters);
+		reset_counters(&metrics->channels[s].counters);
+	}
+	add_counters(&metrics->total, &metrics->interval);
+	reset_counters(&metrics->interval);
+	print_counters(metrics, &metrics->total, "of the whole session,", now - metrics->start);
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#define SMEM_METRICS_PERIOD 5000        // Milliseconds between two reports of a live session
+#define SMEM_METRICS_PUBLISH 100        // Milliseconds between two publications of the counters of a thread
+#define SMEM_METRICS_SLOTS 4            // Publications of a thread waiting for the report, a power of 2
+
+/**
+* @brief Stages of an acquisition, each counted by a single thread.
+*/
+typedef enum {
+	SMEM_METRICS_READER,        // Reads of the source: the IOCTL round trips of the device
+	SMEM_METRICS_DECODER,       // Decoding or counting of the records
+	SMEM_METRICS_WRITER,        // Output: console or file writes
+	SMEM_METRICS_STAGES
+} SmemMetricsStage;
+
+/**
+* @brief Counters of the stages of an acquisition. The durations are in performance counter ticks.
+*/
+typedef struct {
+	SmemHistogram read_time;    // Duration of each read
+	SmemHistogram read_records; // Records returned by each read
+	uint64_t nb_dropped;        // Sum of the nb_dropped of the reads
+	uint64_t decode_time;
+	uint64_t nb_decoded;        // Records decoded
+	uint64_t write_time;
+	uint64_t nb_writes;
+	uint64_t nb_bytes;          // Output written
+} SmemMetricsCounters;
+
+/**
+* @brief Counters of one stage, handed by its thread to the reporting thread through a ring.
+*/
+typedef struct {
+	SmemMetricsCounters counters;   // Since the last publication, written by the thread of the stage only
+	DWORD last_publish;
+	SmemRing ring;
+	SmemMetricsCounters slots[SMEM_METRICS_SLOTS];
+} SmemMetricsChannel;
+
+/**
+* @brief Per-stage timing of an acquisition, for --metrics.
+*
+* The thread of a stage adds to the counters of its channel, without lock, and
+* publishes them every SMEM_METRICS_PUBLISH milliseconds when the ring has room;
+* the reporting thread gathers the publications of all the channels as often
+* and prints them every SMEM_METRICS_PERIOD. A stage keeps counting while its
+* ring is full, nothing is lost. The code measured checks for a NULL SmemMetrics
+* before reading the clock, so that the measures cost a predicted branch when
+* they are off.
+*/
+typedef struct {
+	SmemMetricsChannel channels[SMEM_METRICS_STAGES];
+	SmemMetricsCounters interval;   // Since the last report, of the reporting thread
+	SmemMetricsCounters total;
+	double tick_us;             // Microseconds per performance counter tick
+	DWORD start;                // Time the acquisition started
+	DWORD last_report;
+} SmemMetrics;
+
+/**
+* @brief Initializes the metrics of an acquisition which starts.
+*
+* @param metrics The metrics.
+*/
+void metrics_init(SmemMetrics *metrics);
+
+/**
+* @brief Returns the performance counter, the start of a measure.
+*/
+uint64_t metrics_clock(void);
+
+/**
+* @brief Accounts for a read of the source, from the thread of the reader.
+*
+* @param metrics The metrics.
+* @param start metrics_clock() before the read.
+* @param result The outcome of the read.
+*/
+void metrics_read(SmemMetrics *metrics, uint64_t start, const SmemReadResult *result);
+
+/**
+* @brief Accounts for records decoded, from the thread of the decoder.
+*
+* @param metrics The metrics.
+* @param start metrics_clock() before the decoding.
+* @param nb_records Records decoded.
+*/
+void metrics_decode(SmemMetrics *metrics, uint64_t start, uint64_t nb_records);
+
+/**
+* @brief Accounts for a write of the output, from the thread of the writer.
+*
+* @param metrics The metrics.
+* @param start metrics_clock() before the write.
+* @param nb_bytes Bytes written.
+*/
+void metrics_write(SmemMetrics *metrics, uint64_t start, uint64_t nb_bytes);
+
+/**
+* @brief Gathers the counters published by the stages, from the reporting thread,
+* and prints them on stderr every SMEM_METRICS_PERIOD.
+*
+* Called about every SMEM_METRICS_PUBLISH, so that the rings of the stages keep room.
+*
+* @param metrics The metrics.
+* @param now Current time in milliseconds, e.g. GetTickCount().
+*/
+void metrics_update(SmemMetrics *metrics, DWORD now);
+
+/**
+* @brief Prints the counters of the whole acquisition on stderr, once the threads of the stages have stopped.
+*
+* @param metrics The metrics.
+* @param now Current time in milliseconds.
+*/
+void metrics_print_total(SmemMetrics *metrics, DWORD now);
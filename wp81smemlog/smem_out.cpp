@@ -0,0 +1,215 @@
+#include "stdafx.h"
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+static const char HEX_DIGITS_UPPER[] = "0123456789ABCDEF";
+static const char DEC_PAIRS[] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+void outbuf_init(SmemOutBuffer *out, size_t capacity)
+{
+	out->data = (char *)malloc(capacity);
+	out->size = 0;
+	out->capacity = out->data != NULL ? capacity : 0;
+}
+
+void outbuf_free(SmemOutBuffer *out)
+{
+	free(out->data);
+	out->data = NULL;
+	out->size = 0;
+	out->capacity = 0;
+}
+
+void outbuf_reset(SmemOutBuffer *out)
+{
+	out->size = 0;
+}
+
+void outbuf_flush(SmemOutBuffer *out, FILE *stream)
+{
+	if (out->size > 0) {
+		fwrite(out->data, 1, out->size, stream);
+		fflush(stream);
+		out->size = 0;
+	}
+}
+
+char *outbuf_reserve(SmemOutBuffer *out, size_t size)
+{
+	if (out->size + size > out->capacity) {
+		size_t capacity = out->capacity > 0 ? out->capacity : 256;
+		while (capacity < out->size + size) {
+			capacity *= 2;
+		}
+
+		char *data = (char *)realloc(out->data, capacity);
+		if (data == NULL) {
+			printf("Failed to allocate %u bytes of output buffer\n", (unsigned int)capacity);
+			exit(EXIT_FAILURE);
+		}
+		out->data = data;
+		out->capacity = capacity;
+	}
+
+	return out->data + out->size;
+}
+
+void emit_char(SmemOutBuffer *out, char c)
+{
+	char *p = outbuf_reserve(out, 1);
+	*p = c;
+	out->size++;
+}
+
+void emit_mem(SmemOutBuffer *out, const char *s, size_t len)
+{
+	char *p = outbuf_reserve(out, len);
+	memcpy(p, s, len);
+	out->size += len;
+}
+
+void emit_str(SmemOutBuffer *out, const char *s)
+{
+	emit_mem(out, s, strlen(s));
+}
+
+void emit_str_width(SmemOutBuffer *out, const char *s, unsigned int width)
+{
+	size_t len = strlen(s);
+	size_t pad = len < width ? width - len : 0;
+	char *p = outbuf_reserve(out, pad + len);
+
+	memset(p, ' ', pad);
+	memcpy(p + pad, s, len);
+	out->size += pad + len;
+}
+
+static void emit_hex_digits(SmemOutBuffer *out, uint32_t value, unsigned int width, const char *digits)
+{
+	// Number of significant digits (at least one, like printf)
+	unsigned int nb_digits = 1;
+	while (nb_digits < 8 && (value >> (4 * nb_digits)) != 0) {
+		nb_digits++;
+	}
+	if (nb_digits < width) {
+		nb_digits = width;
+	}
+
+	char *p = outbuf_reserve(out, nb_digits);
+	for (unsigned int i = nb_digits; i > 0; i--) {
+		// Shifting a 32-bit value by 32 or more is undefined, padding digits are zeros
+		unsigned int shift = 4 * (nb_digits - i);
+		p[i - 1] = shift < 32 ? digits[(value >> shift) & 0xf] : '0';
+	}
+	out->size += nb_digits;
+}
+
+void emit_hex(SmemOutBuffer *out, uint32_t value, unsigned int width)
+{
+	emit_hex_digits(out, value, width, HEX_DIGITS);
+}
+
+void emit_hex64(SmemOutBuffer *out, uint64_t value, unsigned int width)
+{
+	uint32_t high = (uint32_t)(value >> 32);
+
+	if (high == 0) {
+		emit_hex(out, (uint32_t)value, width);
+	}
+	else {
+		emit_hex(out, high, width > 8 ? width - 8 : 0);
+		emit_hex(out, (uint32_t)value, 8);
+	}
+}
+
+void emit_hex_upper(SmemOutBuffer *out, uint32_t value, unsigned int width)
+{
+	emit_hex_digits(out, value, width, HEX_DIGITS_UPPER);
+}
+
+// Writes the len last decimal digits of a value before end, two digits per division
+static void dec_digits(char *end, uint32_t value, unsigned int len)
+{
+	for (; len >= 2; len -= 2) {
+		unsigned int pair = 2 * (value % 100);
+		value /= 100;
+		*--end = DEC_PAIRS[pair + 1];
+		*--end = DEC_PAIRS[pair];
+	}
+	if (len > 0) {
+		*--end = (char)('0' + value % 10);
+	}
+}
+
+char *put_udec(char *p, uint32_t value)
+{
+	unsigned int len = 1;
+	for (uint32_t bound = 10; len < 10 && value >= bound; bound *= 10) {
+		len++;
+	}
+
+	dec_digits(p + len, value, len);
+	return p + len;
+}
+
+void emit_udec(SmemOutBuffer *out, uint32_t value)
+{
+	char *p = outbuf_reserve(out, 10);
+
+	out->size = put_udec(p, value) - out->data;
+}
+
+void emit_dec(SmemOutBuffer *out, int32_t value)
+{
+	if (value < 0) {
+		emit_char(out, '-');
+		// Negate in unsigned arithmetic, INT32_MIN has no positive counterpart
+		emit_udec(out, 0u - (uint32_t)value);
+	}
+	else {
+		emit_udec(out, (uint32_t)value);
+	}
+}
+
+void emit_udec64(SmemOutBuffer *out, uint64_t value)
+{
+	if (value <= 0xFFFFFFFF) {
+		// 32-bit divisions are much cheaper on ARM
+		emit_udec(out, (uint32_t)value);
+		return;
+	}
+
+	// A single 64-bit division: the 9 last digits are printed from 32 bits
+	emit_udec64(out, value / 1000000000);
+	dec_digits(outbuf_reserve(out, 9) + 9, (uint32_t)(value % 1000000000), 9);
+	out->size += 9;
+}
+
+void emit_json_str(SmemOutBuffer *out, const char *s, size_t len)
+{
+	// Worst case: every byte as \u00XX
+	char *p = outbuf_reserve(out, 2 + 6 * len);
+	char *start = p;
+
+	*p++ = '"';
+	for (size_t i = 0; i < len; i++) {
+		unsigned char c = (unsigned char)s[i];
+		if (c >= 0x20 && c < 0x7f && c != '"' && c != '\\') {
+			*p++ = (char)c;
+		}
+		else if (c == '"' || c == '\\') {
+			*p++ = '\\';
+			*p++ = (char)c;
+		}
+		else {
+			memcpy(p, "\\u00", 4);
+			p[4] = HEX_DIGITS[c >> 4];
+			p[5] = HEX_DIGITS[c & 0xf];
+			p += 6;
+		}
+	}
+	*p++ = '"';
+	out->size += p - start;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+/**
+* @brief Growable text buffer receiving the decoded records.
+*
+* The decoders append their text with the emitters below instead of printf,
+* the buffer is written out once per batch of records by outbuf_flush.
+*/
+typedef struct {
+	char *data;
+	size_t size;      // Number of bytes used
+	size_t capacity;  // Number of bytes allocated
+} SmemOutBuffer;
+
+/**
+* @brief Allocates the buffer.
+*
+* @param out The buffer.
+* @param capacity Initial capacity in bytes, the buffer grows when needed.
+*/
+void outbuf_init(SmemOutBuffer *out, size_t capacity);
+
+/**
+* @brief Releases the memory of the buffer.
+*/
+void outbuf_free(SmemOutBuffer *out);
+
+/**
+* @brief Discards the content of the buffer, keeping its memory.
+*/
+void outbuf_reset(SmemOutBuffer *out);
+
+/**
+* @brief Writes the content of the buffer to a stream with a single write, then resets the buffer.
+*
+* @param out The buffer.
+* @param stream The destination stream.
+*/
+void outbuf_flush(SmemOutBuffer *out, FILE *stream);
+
+/**
+* @brief Makes room for at least size more bytes and returns where to write them.
+*
+* The caller must then add the number of bytes actually written to out->size.
+*/
+char *outbuf_reserve(SmemOutBuffer *out, size_t size);
+
+// Equivalent of printf("%c").
+void emit_char(SmemOutBuffer *out, char c);
+
+// Equivalent of printf("%s").
+void emit_str(SmemOutBuffer *out, const char *s);
+
+// Appends len bytes, which may contain null characters.
+void emit_mem(SmemOutBuffer *out, const char *s, size_t len);
+
+// Equivalent of printf("%*s"): right-justified in a field of width characters.
+void emit_str_width(SmemOutBuffer *out, const char *s, unsigned int width);
+
+// Equivalent of printf("%0<width>x"), width 0 being printf("%x").
+void emit_hex(SmemOutBuffer *out, uint32_t value, unsigned int width);
+
+// Equivalent of printf("%0<width>llx").
+void emit_hex64(SmemOutBuffer *out, uint64_t value, unsigned int width);
+
+// Equivalent of printf("%0<width>X").
+void emit_hex_upper(SmemOutBuffer *out, uint32_t value, unsigned int width);
+
+// Equivalent of printf("%u").
+void emit_udec(SmemOutBuffer *out, uint32_t value);
+
+// printf("%u") at p, in room reserved by the caller (10 bytes at most), returns the end of the digits.
+char *put_udec(char *p, uint32_t value);
+
+// Equivalent of printf("%d").
+void emit_dec(SmemOutBuffer *out, int32_t value);
+
+// Equivalent of printf("%llu").
+void emit_udec64(SmemOutBuffer *out, uint64_t value);
+
+// JSON string of len bytes, between quotes: the quotes, backslashes and control
+// characters are escaped, the bytes above 0x7e too, read as Latin-1, so that the text stays ASCII.
+void emit_json_str(SmemOutBuffer *out, const char *s, size_t len);
@@ -0,0 +1,260 @@
+#include "stdafx.h"
+#include "smem_parse.h"
+
+#if defined(_M_IX86) || defined(_M_X64)
+#define SMEM_PARSE_X86
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+// Parses the 44 characters of a record, FALSE if they are not 5 words of 8 hexadecimal digits
+typedef bool (*ParseLine)(const char *line, SmemLogRecord *rec);
+
+static const char *PARSER_NAMES[SMEM_NB_PARSERS] = { "scalar", "SSE2", "AVX2" };
+
+static int hex_digit(char c)
+{
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	return -1;
+}
+
+static __forceinline bool parse_line_scalar(const char *line, SmemLogRecord *rec)
+{
+	uint32_t words[5];
+
+	for (unsigned int w = 0; w < _countof(words); w++) {
+		uint32_t value = 0;
+		for (unsigned int i = 0; i < 8; i++) {
+			int digit = hex_digit(*line++);
+			if (digit < 0) {
+				return FALSE;
+			}
+			value = (value << 4) | (uint32_t)digit;
+		}
+		if (w < _countof(words) - 1 && *line++ != ' ') {
+			return FALSE;
+		}
+		words[w] = value;
+	}
+
+	rec->id = words[0];
+	rec->timestamp = words[1];
+	rec->d1 = words[2];
+	rec->d2 = words[3];
+	rec->d3 = words[4];
+	return TRUE;
+}
+
+#ifdef SMEM_PARSE_X86
+
+// The 8 digits of a word are loaded in a 64-bit lane: the separators are checked apart
+static __forceinline bool has_separators(const char *line)
+{
+	return line[8] == ' ' && line[17] == ' ' && line[26] == ' ' && line[35] == ' ';
+}
+
+// Characters in [0-9A-Fa-f] (bytes above 0x7F are negative and fail the signed compares)
+static __forceinline __m128i is_hex_sse2(__m128i c)
+{
+	__m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+	__m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+	__m128i letter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+	return _mm_or_si128(digit, letter);
+}
+
+// Value of hexadecimal digits: low 4 bits, plus 9 for the letters
+static __forceinline __m128i nibbles_sse2(__m128i c)
+{
+	__m128i letter = _mm_cmpeq_epi8(_mm_and_si128(c, _mm_set1_epi8(0x40)), _mm_set1_epi8(0x40));
+	return _mm_add_epi8(_mm_and_si128(c, _mm_set1_epi8(0x0F)), _mm_and_si128(letter, _mm_set1_epi8(9)));
+}
+
+// Packs the 8 nibbles of each 64-bit lane, most significant first, into the low 32 bits of the lane
+static __forceinline __m128i pack_words_sse2(__m128i x)
+{
+	x = _mm_and_si128(_mm_or_si128(_mm_slli_epi64(x, 4), _mm_srli_epi64(x, 8)), _mm_set1_epi16(0x00FF));
+	x = _mm_and_si128(_mm_or_si128(_mm_slli_epi64(x, 8), _mm_srli_epi64(x, 16)), _mm_set1_epi32(0x0000FFFF));
+	return _mm_or_si128(_mm_slli_epi64(x, 16), _mm_srli_epi64(x, 32));
+}
+
+static __forceinline bool parse_line_sse2(const char *line, SmemLogRecord *rec)
+{
+	__m128i c0 = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)line), _mm_loadl_epi64((const __m128i *)(line + 9)));
+	__m128i c1 = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)(line + 18)), _mm_loadl_epi64((const __m128i *)(line + 27)));
+	__m128i c2 = _mm_loadl_epi64((const __m128i *)(line + 36));
+
+	// The upper half of c2 is zero, not hexadecimal
+	int digits = _mm_movemask_epi8(is_hex_sse2(c0)) & _mm_movemask_epi8(is_hex_sse2(c1))
+		& (_mm_movemask_epi8(is_hex_sse2(c2)) | 0xFF00);
+	if (digits != 0xFFFF || !has_separators(line)) {
+		return FALSE;
+	}
+
+	c0 = pack_words_sse2(nibbles_sse2(c0));
+	c1 = pack_words_sse2(nibbles_sse2(c1));
+	c2 = pack_words_sse2(nibbles_sse2(c2));
+
+	// id, timestamp, d1 and d2 in one store
+	_mm_storeu_si128((__m128i *)rec, _mm_unpacklo_epi64(
+		_mm_shuffle_epi32(c0, _MM_SHUFFLE(3, 1, 2, 0)), _mm_shuffle_epi32(c1, _MM_SHUFFLE(3, 1, 2, 0))));
+	rec->d3 = (uint32_t)_mm_cvtsi128_si32(c2);
+	return TRUE;
+}
+
+static __forceinline __m256i is_hex_avx2(__m256i c)
+{
+	__m256i lower = _mm256_or_si256(c, _mm256_set1_epi8(0x20));
+	__m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), c));
+	__m256i letter = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('f' + 1), lower));
+	return _mm256_or_si256(digit, letter);
+}
+
+static __forceinline __m256i nibbles_avx2(__m256i c)
+{
+	__m256i letter = _mm256_cmpeq_epi8(_mm256_and_si256(c, _mm256_set1_epi8(0x40)), _mm256_set1_epi8(0x40));
+	return _mm256_add_epi8(_mm256_and_si256(c, _mm256_set1_epi8(0x0F)), _mm256_and_si256(letter, _mm256_set1_epi8(9)));
+}
+
+static __forceinline __m256i pack_words_avx2(__m256i x)
+{
+	x = _mm256_and_si256(_mm256_or_si256(_mm256_slli_epi64(x, 4), _mm256_srli_epi64(x, 8)), _mm256_set1_epi16(0x00FF));
+	x = _mm256_and_si256(_mm256_or_si256(_mm256_slli_epi64(x, 8), _mm256_srli_epi64(x, 16)), _mm256_set1_epi32(0x0000FFFF));
+	return _mm256_or_si256(_mm256_slli_epi64(x, 16), _mm256_srli_epi64(x, 32));
+}
+
+// The first 4 words in one register, the last one as with SSE2
+static __forceinline bool parse_line_avx2(const char *line, SmemLogRecord *rec)
+{
+	__m128i c0 = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)line), _mm_loadl_epi64((const __m128i *)(line + 9)));
+	__m128i c1 = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)(line + 18)), _mm_loadl_epi64((const __m128i *)(line + 27)));
+	__m256i c = _mm256_inserti128_si256(_mm256_castsi128_si256(c0), c1, 1);
+	__m128i c2 = _mm_loadl_epi64((const __m128i *)(line + 36));
+
+	if (_mm256_movemask_epi8(is_hex_avx2(c)) != -1 || (_mm_movemask_epi8(is_hex_sse2(c2)) & 0xFF) != 0xFF
+		|| !has_separators(line)) {
+		return FALSE;
+	}
+
+	c = pack_words_avx2(nibbles_avx2(c));
+	c2 = pack_words_sse2(nibbles_sse2(c2));
+
+	// id, timestamp, d1 and d2 in one store
+	c = _mm256_permutevar8x32_epi32(c, _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7));
+	_mm_storeu_si128((__m128i *)rec, _mm256_castsi256_si128(c));
+	rec->d3 = (uint32_t)_mm_cvtsi128_si32(c2);
+	return TRUE;
+}
+
+static bool cpu_has_avx2(void)
+{
+	int info[4];
+
+	__cpuid(info, 0);
+	if (info[0] < 7) {
+		return FALSE;
+	}
+	// AVX and OSXSAVE, then the OS must save the YMM registers
+	__cpuid(info, 1);
+	if ((info[2] & (1 << 28)) == 0 || (info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6) {
+		return FALSE;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+}
+
+static bool cpu_has_sse2(void)
+{
+	int info[4];
+
+	__cpuid(info, 1);
+	return (info[3] & (1 << 26)) != 0;
+}
+
+#endif
+
+SmemParser best_parser(void)
+{
+#ifdef SMEM_PARSE_X86
+	if (cpu_has_avx2()) {
+		return SMEM_PARSER_AVX2;
+	}
+	if (cpu_has_sse2()) {
+		return SMEM_PARSER_SSE2;
+	}
+#endif
+	return SMEM_PARSER_SCALAR;
+}
+
+const char *parser_name(SmemParser parser)
+{
+	return parser < SMEM_NB_PARSERS ? PARSER_NAMES[parser] : "unknown";
+}
+
+// The loop of every parser, parse_line is a constant once inlined
+static __forceinline size_t parse_lines(ParseLine parse_line, const char *text, size_t size, SmemLogRecord *records, SmemParseReport *report)
+{
+	const char *line = text;
+	const char *end = text + size;
+	size_t nb_records = 0;
+	size_t nb_lines = 0;
+	size_t nb_malformed = 0;
+
+	while (line < end) {
+		const char *eol;
+		size_t length;
+
+		nb_lines++;
+		if (end - line > SMEM_RAW_LINE_SIZE && line[SMEM_RAW_LINE_SIZE] == '\n'
+			&& parse_line(line, &records[nb_records])) {
+			// Usual raw line, no need to look for its end
+			nb_records++;
+			line += SMEM_RAW_LINE_SIZE + 1;
+			continue;
+		}
+
+		eol = (const char *)memchr(line, '\n', end - line);
+		if (eol == NULL) {
+			eol = end;
+		}
+		length = eol - line;
+		if (length > 0 && line[length - 1] == '\r') {
+			length--;
+		}
+
+		if (length == 0) {
+			// Empty line
+		}
+		else if ((length == SMEM_RAW_LINE_SIZE || (length > SMEM_RAW_LINE_SIZE && line[SMEM_RAW_LINE_SIZE] == ' '))
+			&& parse_line(line, &records[nb_records])) {
+			nb_records++;
+		}
+		else {
+			if (nb_malformed < SMEM_PARSE_MAX_REPORTED) {
+				report->malformed[nb_malformed] = nb_lines;
+			}
+			nb_malformed++;
+		}
+
+		line = eol + 1;
+	}
+
+	report->nb_lines = nb_lines;
+	report->nb_malformed = nb_malformed;
+	return nb_records;
+}
+
+size_t parse_raw_dump(SmemParser parser, const char *text, size_t size, SmemLogRecord *records, SmemParseReport *report)
+{
+	switch (parser) {
+#ifdef SMEM_PARSE_X86
+	case SMEM_PARSER_AVX2:
+		return parse_lines(parse_line_avx2, text, size, records, report);
+	case SMEM_PARSER_SSE2:
+		return parse_lines(parse_line_sse2, text, size, records, report);
+#endif
+	default:
+		return parse_lines(parse_line_scalar, text, size, records, report);
+	}
+}
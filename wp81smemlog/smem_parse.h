@@ -0,0 +1,55 @@
+#pragma once
+
+// Length of a line written by print_raw_event, without end of line
+#define SMEM_RAW_LINE_SIZE 44
+// Upper bound of the number of records in size bytes of text
+#define SMEM_RAW_MAX_RECORDS(size) ((size) / (SMEM_RAW_LINE_SIZE + 1) + 1)
+// Malformed lines kept by a SmemParseReport
+#define SMEM_PARSE_MAX_REPORTED 16
+
+/**
+* @brief Implementations of the parser of the raw dumps.
+*/
+typedef enum {
+	SMEM_PARSER_SCALAR,
+	SMEM_PARSER_SSE2,
+	SMEM_PARSER_AVX2,
+	SMEM_NB_PARSERS
+} SmemParser;
+
+/**
+* @brief Lines found by parse_raw_dump.
+*/
+typedef struct {
+	size_t nb_lines;                                // Lines in the text
+	size_t nb_malformed;                            // Lines which are neither a record nor empty
+	size_t malformed[SMEM_PARSE_MAX_REPORTED];      // Numbers, from 1, of the first malformed lines
+} SmemParseReport;
+
+/**
+* @brief Returns the fastest parser the processor supports.
+*
+* SSE2 and AVX2 are detected with cpuid on x86 and x64, other processors use the scalar parser.
+*/
+SmemParser best_parser(void);
+
+/**
+* @brief Returns the name of a parser ("scalar", "SSE2" or "AVX2").
+*/
+const char *parser_name(SmemParser parser);
+
+/**
+* @brief Parses the lines written by print_raw_event back to records.
+*
+* A record line is 5 words of 8 hexadecimal digits separated by a space, which may be
+* followed by a space and the decoded text (verbose mode) and ends with "\n" or "\r\n".
+* Empty lines are skipped, the other lines are counted as malformed.
+*
+* @param parser The implementation, supported by the processor (see best_parser).
+* @param text The lines.
+* @param size Size of the text, in bytes.
+* @param records Receives the records, room for SMEM_RAW_MAX_RECORDS(size) records.
+* @param report Receives the number of lines and the malformed lines.
+* @return The number of records.
+*/
+size_t parse_raw_dump(SmemParser parser, const char *text, size_t size, SmemLogRecord *records, SmemParseReport *report);
@@ -0,0 +1,307 @@
+#include "stdafx.h"
+#include "smem_filter.h"
+#include "smem_ring.h"
+#include "smem_source.h"
+#include "smem_poll.h"
+#include "smem_histo.h"
+#include "smem_metrics.h"
+#include "smem_reader.h"
+#include "smem_loss.h"
+#include "smem_pipe.h"
+
+// Reads a flag written by the other thread
+static bool load_flag(volatile LONG *flag)
+{
+	return InterlockedExchangeAdd(flag, 0) != FALSE;
+}
+
+// Sleeps longer as a ring stays full or empty, up to SMEM_PIPE_MAX_WAIT
+static void back_off(DWORD *wait)
+{
+	Sleep(*wait);
+	if (*wait < SMEM_PIPE_MAX_WAIT) *wait *= 2;
+}
+
+// Reader: the next read goes straight into the batch being filled, a new one once the decoder freed it
+static SmemLogRecord *reserve_batch(SmemReadLoop *loop, uint32_t *max_records)
+{
+	SmemPipeline *pipe = (SmemPipeline *)loop->context;
+	DWORD wait = SMEM_PIPE_MIN_WAIT;
+	uint32_t slot;
+
+	if (pipe->batch == NULL) {
+		while (ring_free(&pipe->batch_ring, &slot) == 0) {
+			if (!load_flag(pipe->running)) {
+				return NULL;
+			}
+			// The decoder is behind, the log keeps the records meanwhile
+			pipe->reader.nb_stalls++;
+			back_off(&wait);
+		}
+		pipe->batch = &pipe->batches[slot];
+		pipe->batch->nb_records = 0;
+		pipe->batch->nb_dropped = 0;
+		pipe->batch->drop_at = 0;
+	}
+
+	uint32_t room = SMEM_PIPE_BATCH_RECORDS - pipe->batch->nb_records;
+	if (room < *max_records) *max_records = room;
+	return pipe->batch->records + pipe->batch->nb_records;
+}
+
+static bool push_batch(SmemReadLoop *loop, SmemLogRecord *records, const SmemReadResult *result)
+{
+	SmemPipeline *pipe = (SmemPipeline *)loop->context;
+	SmemPipeBatch *batch = pipe->batch;
+
+	pipe->reader.nb_items++;
+	pipe->reader.nb_records += result->nb_read;
+	pipe->nb_dropped += result->nb_dropped;
+	// A later loss of the same batch is placed with the first one
+	if (result->nb_dropped > 0 && batch->nb_dropped == 0) batch->drop_at = batch->nb_records;
+	batch->nb_records += result->nb_read;
+	batch->nb_dropped += result->nb_dropped;
+
+	// A batch goes when the next read may not fit or when the log is empty
+	if (batch->nb_records + pipe->source->max_read > SMEM_PIPE_BATCH_RECORDS || (result->nb_available == 0 && batch->nb_records > 0)) {
+		ring_push(&pipe->batch_ring, 1);
+		pipe->batch = NULL;
+	}
+	return TRUE;
+}
+
+static DWORD WINAPI reader_thread(LPVOID param)
+{
+	SmemPipeline *pipe = (SmemPipeline *)param;
+
+	read_loop_run(&pipe->reader_loop);
+	if (pipe->batch != NULL && pipe->batch->nb_records > 0) {
+		ring_push(&pipe->batch_ring, 1);
+	}
+	InterlockedExchange(&pipe->reader_done, TRUE);
+	return 0;
+}
+
+void pipe_decode(SmemDecoderState *state, const SmemLogRecord *records, uint32_t nb_records, bool raw, bool verbose)
+{
+	for (uint32_t i = 0; i < nb_records; i++) {
+		SmemLogRecord record = records[i];
+		if (!select_record(state, &record)) {
+			continue;
+		}
+
+		if (verbose) {
+			// The words of the record are printed with the text of its event
+			print_event(state, &record, FALSE, FALSE);
+		}
+		else if (raw) {
+			print_raw_event(&state->out, record);
+			emit_char(&state->out, '\n');
+		}
+		else {
+			print_event(state, &record, FALSE, TRUE);
+		}
+	}
+}
+
+// Hands the text of the decoding state to the writer, waiting for a free buffer
+static void push_text(SmemPipeline *pipe)
+{
+	DWORD wait = SMEM_PIPE_MIN_WAIT;
+	uint32_t slot;
+
+	while (ring_free(&pipe->text_ring, &slot) == 0) {
+		// The writer is behind
+		pipe->decoder.nb_stalls++;
+		back_off(&wait);
+	}
+	// The empty buffer of the slot becomes the one of the decoding state
+	SmemOutBuffer text = pipe->texts[slot];
+	pipe->texts[slot] = pipe->state.out;
+	pipe->state.out = text;
+	pipe->decoder.nb_bytes += pipe->texts[slot].size;
+	ring_push(&pipe->text_ring, 1);
+}
+
+// Decodes the records of a batch, with the line of its loss between the records before and after it
+static void decode_batch(SmemPipeline *pipe, const SmemPipeBatch *batch)
+{
+	// The hex lines of -r stay a raw dump
+	SmemOutBuffer *out = pipe->raw ? NULL : &pipe->state.out;
+	uint32_t at = batch->drop_at;
+
+	pipe_decode(&pipe->state, batch->records, at, pipe->raw, pipe->verbose);
+	loss_tracker_add(&pipe->loss, batch->records, at, 0, out, !pipe->verbose);
+	loss_tracker_add(&pipe->loss, batch->records + at, batch->nb_records - at, batch->nb_dropped, out, !pipe->verbose);
+	pipe_decode(&pipe->state, batch->records + at, batch->nb_records - at, pipe->raw, pipe->verbose);
+}
+
+static DWORD WINAPI decoder_thread(LPVOID param)
+{
+	SmemPipeline *pipe = (SmemPipeline *)param;
+	DWORD wait = SMEM_PIPE_MIN_WAIT;
+
+	for (;;) {
+		// The flag is read before the ring: the batches pushed before it are not missed
+		bool done = load_flag(&pipe->reader_done);
+		uint32_t slot;
+		if (ring_used(&pipe->batch_ring, &slot) == 0) {
+			// Nothing more for now, the text waits no longer
+			if (pipe->state.out.size > 0) push_text(pipe);
+			if (done) break;
+			pipe->decoder.nb_idle++;
+			back_off(&wait);
+			continue;
+		}
+		wait = SMEM_PIPE_MIN_WAIT;
+
+		const SmemPipeBatch *batch = &pipe->batches[slot];
+		uint64_t start = pipe->metrics != NULL ? metrics_clock() : 0;
+		decode_batch(pipe, batch);
+		if (pipe->metrics != NULL) metrics_decode(pipe->metrics, start, batch->nb_records);
+		pipe->decoder.nb_items++;
+		pipe->decoder.nb_records += batch->nb_records;
+		ring_pop(&pipe->batch_ring, 1);
+		if (pipe->state.out.size >= SMEM_PIPE_TEXT_SIZE) push_text(pipe);
+	}
+
+	// Events still waiting for their continuation records
+	flush_events(&pipe->state);
+	if (pipe->state.out.size > 0) push_text(pipe);
+	InterlockedExchange(&pipe->decoder_done, TRUE);
+	return 0;
+}
+
+static DWORD WINAPI writer_thread(LPVOID param)
+{
+	SmemPipeline *pipe = (SmemPipeline *)param;
+	DWORD wait = SMEM_PIPE_MIN_WAIT;
+
+	for (;;) {
+		bool done = load_flag(&pipe->decoder_done);
+		uint32_t slot;
+		if (ring_used(&pipe->text_ring, &slot) == 0) {
+			if (done) break;
+			pipe->writer.nb_idle++;
+			back_off(&wait);
+			continue;
+		}
+		wait = SMEM_PIPE_MIN_WAIT;
+
+		SmemOutBuffer *text = &pipe->texts[slot];
+		pipe->writer.nb_items++;
+		pipe->writer.nb_bytes += text->size;
+		uint32_t size = text->size;
+		uint64_t start = pipe->metrics != NULL ? metrics_clock() : 0;
+		// Keeps the memory of the buffer for the decoder
+		outbuf_flush(text, pipe->output);
+		if (pipe->metrics != NULL) metrics_write(pipe->metrics, start, size);
+		ring_pop(&pipe->text_ring, 1);
+	}
+	return 0;
+}
+
+static double average_used(const SmemRing *ring)
+{
+	return ring->nb_pushes > 0 ? (double)ring->used_sum / (double)ring->nb_pushes : 0.0;
+}
+
+void pipe_print_stats(const SmemPipeline *pipe)
+{
+	printf("Reader:  %llu reads, %llu records, %llu dropped by the log, %llu stalls\n",
+		(unsigned long long)pipe->reader.nb_items, (unsigned long long)pipe->reader.nb_records,
+		(unsigned long long)pipe->nb_dropped, (unsigned long long)pipe->reader.nb_stalls);
+	printf("Decoder: %llu batches, %llu records, %llu bytes, %llu stalls, %llu waits\n",
+		(unsigned long long)pipe->decoder.nb_items, (unsigned long long)pipe->decoder.nb_records,
+		(unsigned long long)pipe->decoder.nb_bytes, (unsigned long long)pipe->decoder.nb_stalls,
+		(unsigned long long)pipe->decoder.nb_idle);
+	printf("Writer:  %llu writes, %llu bytes, %llu waits\n",
+		(unsigned long long)pipe->writer.nb_items, (unsigned long long)pipe->writer.nb_bytes,
+		(unsigned long long)pipe->writer.nb_idle);
+	printf("Batches: %.1f of %u used on average, %u at most\n",
+		average_used(&pipe->batch_ring), pipe->batch_ring.size, pipe->batch_ring.max_used);
+	printf("Texts:   %.1f of %u used on average, %u at most\n",
+		average_used(&pipe->text_ring), pipe->text_ring.size, pipe->text_ring.max_used);
+	poll_print_stats(&pipe->reader_loop.poll);
+}
+
+int pipe_run(SmemRecordSource *source, volatile LONG *running, uint32_t clock_rate,
+	const SmemFilter *filter, bool raw, bool verbose, bool json, SmemMetrics *metrics)
+{
+	SmemPipeline *pipe = (SmemPipeline *)malloc(sizeof(SmemPipeline));
+	HANDLE threads[3];
+
+	if (pipe == NULL) {
+		fprintf(stderr, "Not enough memory for the pipeline\n");
+		return EXIT_FAILURE;
+	}
+	memset(pipe, 0, sizeof(*pipe));
+	pipe->source = source;
+	pipe->running = running;
+	pipe->output = stdout;
+	pipe->raw = raw;
+	pipe->verbose = verbose;
+	pipe->metrics = metrics;
+	decoder_state_init(&pipe->state, clock_rate);
+	pipe->state.filter = filter;
+	pipe->state.json = json;
+	pipe->state.verbose = verbose;
+	loss_tracker_init(&pipe->loss, clock_rate);
+	pipe->loss.json = json;
+	pipe->reader_loop.source = source;
+	pipe->reader_loop.running = running;
+	pipe->reader_loop.metrics = metrics;
+	pipe->reader_loop.reserve = reserve_batch;
+	pipe->reader_loop.consume = push_batch;
+	pipe->reader_loop.context = pipe;
+	ring_init(&pipe->batch_ring, SMEM_PIPE_BATCHES);
+	ring_init(&pipe->text_ring, SMEM_PIPE_TEXTS);
+	for (unsigned int t = 0; t < SMEM_PIPE_TEXTS; t++) {
+		outbuf_init(&pipe->texts[t], SMEM_PIPE_TEXT_SIZE);
+	}
+
+	// Each stage ends once the previous one is done
+	LPTHREAD_START_ROUTINE stages[3] = { writer_thread, decoder_thread, reader_thread };
+	unsigned int nb_threads = 0;
+	while (nb_threads < 3 && (threads[nb_threads] = CreateThread(NULL, 0, stages[nb_threads], pipe, 0, NULL)) != NULL) {
+		nb_threads++;
+	}
+	bool started = nb_threads == 3;
+	if (!started) {
+		fprintf(stderr, "Failed to create the pipeline threads (error %u)\n", GetLastError());
+		InterlockedExchange(running, FALSE);
+		// The stages which did start end with the records already read
+		InterlockedExchange(&pipe->reader_done, TRUE);
+		if (nb_threads < 2) InterlockedExchange(&pipe->decoder_done, TRUE);
+	}
+	// Reports from this thread while the stages run
+	while (started && metrics != NULL && WaitForMultipleObjectsEx(3, threads, TRUE, SMEM_METRICS_PUBLISH, FALSE) == WAIT_TIMEOUT) {
+		metrics_update(metrics, GetTickCount());
+	}
+	if (nb_threads > 0) {
+		WaitForMultipleObjectsEx(nb_threads, threads, TRUE, INFINITE, FALSE);
+	}
+	for (unsigned int t = 0; t < nb_threads; t++) {
+		CloseHandle(threads[t]);
+	}
+	if (metrics != NULL) {
+		metrics_print_total(metrics, GetTickCount());
+	}
+
+	if (verbose) {
+		pipe_print_stats(pipe);
+	}
+	if (pipe->loss.nb_dropped > 0 || verbose) {
+		// The decoded lines start with their new line, the last one is still open
+		if (!raw && !verbose && !json) printf("\n");
+		// The hex lines of -r and the JSON lines stay parseable
+		loss_tracker_print(&pipe->loss, raw || json ? stderr : stdout);
+	}
+	int status = started && !source->failed ? EXIT_SUCCESS : EXIT_FAILURE;
+	for (unsigned int t = 0; t < SMEM_PIPE_TEXTS; t++) {
+		outbuf_free(&pipe->texts[t]);
+	}
+	decoder_state_free(&pipe->state);
+	free(pipe);
+	return status;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#define SMEM_PIPE_BATCHES 256           // Batches of records from the reader to the decoder, a power of 2
+#define SMEM_PIPE_BATCH_RECORDS 64      // Records of a batch, at most
+#define SMEM_PIPE_TEXTS 16              // Buffers of text from the decoder to the writer, a power of 2
+#define SMEM_PIPE_TEXT_SIZE 16384       // Text of a buffer after which it is written out
+#define SMEM_PIPE_MIN_WAIT 1            // Milliseconds before looking again at a full or empty ring, doubled at each look
+#define SMEM_PIPE_MAX_WAIT 32
+
+/**
+* @brief Records read from the source in a row.
+*/
+typedef struct {
+	uint32_t nb_records;
+	uint32_t nb_dropped;        // Sum of the nb_dropped of the reads
+	uint32_t drop_at;           // Records read before the first read which reported records dropped
+	SmemLogRecord records[SMEM_PIPE_BATCH_RECORDS];
+} SmemPipeBatch;
+
+/**
+* @brief Counters of a stage of the pipeline, written by its thread and read once it has stopped.
+*/
+typedef struct {
+	uint64_t nb_items;          // Reads (reader), batches (decoder) or writes (writer)
+	uint64_t nb_records;        // Records read or decoded
+	uint64_t nb_bytes;          // Text decoded or written
+	uint64_t nb_stalls;         // Waits for room in the ring to the next stage
+	uint64_t nb_idle;           // Waits for data in the ring from the previous stage
+} SmemPipeStage;
+
+/**
+* @brief Three-stage pipeline: the reader, decoder and writer threads, linked by lock-free rings.
+*
+* The reader only copies the records of the source into batches, so that a slow
+* console delays the decoding and the writing but not the reads: the records
+* pile up in the rings instead of being dropped by the log.
+* A stage stalls when the ring to the next one is full and waits when the ring
+* from the previous one is empty, without ever losing a record it holds.
+*/
+typedef struct {
+	SmemRecordSource *source;
+	volatile LONG *running;     // Read until it turns FALSE (Ctrl-C) or the source ends
+	FILE *output;
+	bool raw;                   // Print the records in hex only
+	bool verbose;               // Print the records in hex then decoded
+	SmemDecoderState state;     // Decoding state of the decoder thread
+	SmemLossTracker loss;       // Records dropped by the log, tracked by the decoder thread
+	SmemRing batch_ring;        // From the reader to the decoder
+	SmemPipeBatch batches[SMEM_PIPE_BATCHES];
+	SmemRing text_ring;         // From the decoder to the writer
+	SmemOutBuffer texts[SMEM_PIPE_TEXTS];
+	volatile LONG reader_done;  // TRUE once the reader pushed its last batch
+	volatile LONG decoder_done; // TRUE once the decoder pushed its last text
+	uint64_t nb_dropped;        // Sum of the nb_dropped of the reads
+	SmemReadLoop reader_loop;   // Reads of the reader thread, and their scheduler
+	SmemPipeBatch *batch;       // Filled by the reader, NULL until it has a free slot
+	SmemMetrics *metrics;       // Timing of the stages, NULL when off
+	SmemPipeStage reader;
+	SmemPipeStage decoder;
+	SmemPipeStage writer;
+} SmemPipeline;
+
+/**
+* @brief Reads a source, decodes and writes its records on three threads until the source ends or *running turns FALSE.
+*
+* @param source The source of the records.
+* @param running Flag cleared to stop reading, the records read are still written.
+* @param clock_rate Ticks per second of the record timestamps.
+* @param filter Records to print, NULL for all.
+* @param raw TRUE to print the records in hex only.
+* @param verbose TRUE to print the records in hex then decoded, and the counters of the stages and of the polling at the end.
+*        Each loss is printed inline unless raw, and the losses are summarized at the end when records were dropped or in verbose.
+* @param json TRUE to print each event and each loss as a JSON object on its own line, the summary of the losses on stderr.
+* @param metrics Timing of the read, decode and write stages, reported every SMEM_METRICS_PERIOD and at the end; NULL when off.
+* @return EXIT_SUCCESS, or EXIT_FAILURE on a read error, without memory or without the threads.
+*/
+int pipe_run(SmemRecordSource *source, volatile LONG *running, uint32_t clock_rate,
+	const SmemFilter *filter, bool raw, bool verbose, bool json, SmemMetrics *metrics);
+
+/**
+* @brief Decodes records into the text of a decoding state, as the decoder thread does.
+*
+* @param state The decoding state of the stream.
+* @param records The records.
+* @param nb_records Number of records.
+* @param raw TRUE to print the records in hex only.
+* @param verbose TRUE to print the records in hex then decoded, with state->verbose set (see print_event).
+*/
+void pipe_decode(SmemDecoderState *state, const SmemLogRecord *records, uint32_t nb_records, bool raw, bool verbose);
+
+/**
+* @brief Prints the counters of the stages, the occupancy of the rings and the decisions of the polling.
+*
+* @param pipe The pipeline, stopped.
+*/
+void pipe_print_stats(const SmemPipeline *pipe);
@@ -0,0 +1,166 @@
+#include "stdafx.h"
+#include "smem_source.h"
+#include "smem_poll.h"
+
+#define POLL_FIXED_INTERVAL 500         // Sleep of the former read loops
+#define POLL_SIM_MAX_READ 5             // As the device
+
+void poll_init(SmemPollScheduler *poll, uint32_t max_read)
+{
+	memset(poll, 0, sizeof(*poll));
+	poll->max_read = max_read;
+	poll->read_size = max_read;
+	poll->interval = SMEM_POLL_MIN_INTERVAL;
+	poll->target = SMEM_POLL_MAX_TARGET;
+	poll->min_used = SMEM_POLL_MAX_INTERVAL;
+}
+
+// Interval for the log to fill up to the target at the rate seen
+static DWORD next_interval(const SmemPollScheduler *poll)
+{
+	DWORD interval = SMEM_POLL_MAX_INTERVAL;
+
+	if (poll->rate * SMEM_POLL_MAX_INTERVAL > poll->target) {
+		interval = (DWORD)(poll->target / poll->rate);
+	}
+	// A single quiet wakeup does not tell the burst is over
+	if (interval > poll->interval * 2) interval = poll->interval * 2;
+	if (interval < SMEM_POLL_MIN_INTERVAL) interval = SMEM_POLL_MIN_INTERVAL;
+	if (interval > SMEM_POLL_MAX_INTERVAL) interval = SMEM_POLL_MAX_INTERVAL;
+	return interval;
+}
+
+DWORD poll_next(SmemPollScheduler *poll, const SmemReadResult *result, DWORD now)
+{
+	poll->nb_reads++;
+	poll->nb_records += result->nb_read;
+	poll->nb_dropped += result->nb_dropped;
+	poll->cycle_records += result->nb_read;
+	poll->cycle_dropped += result->nb_dropped;
+
+	if (result->nb_available > 0) {
+		// Drained at once, no more than what is left
+		poll->read_size = result->nb_available < poll->max_read ? result->nb_available : poll->max_read;
+		return 0;
+	}
+
+	// The log is empty: the records of the cycle give the rate of the producer
+	if (poll->has_start) {
+		DWORD elapsed = now - poll->cycle_start;
+		double sample = (double)(poll->cycle_records + poll->cycle_dropped) / (double)(elapsed > 0 ? elapsed : 1);
+		if (sample > poll->rate || elapsed >= SMEM_POLL_DECAY) {
+			poll->rate = sample;
+		}
+		else {
+			// Bursts come back: the rate falls no faster than over SMEM_POLL_DECAY
+			poll->rate -= (poll->rate - sample) * elapsed / SMEM_POLL_DECAY;
+		}
+
+		poll->nb_wakeups++;
+		if (poll->cycle_records == 0 && poll->cycle_dropped == 0) poll->nb_empty_wakeups++;
+		if (poll->cycle_dropped > 0) {
+			poll->nb_drop_wakeups++;
+			poll->target /= 2;
+			if (poll->target < SMEM_POLL_MIN_TARGET) poll->target = SMEM_POLL_MIN_TARGET;
+		}
+		else {
+			poll->target += poll->target / 8;
+			if (poll->target > SMEM_POLL_MAX_TARGET) poll->target = SMEM_POLL_MAX_TARGET;
+		}
+	}
+
+	DWORD interval = next_interval(poll);
+	if (interval < poll->interval) poll->nb_faster++;
+	if (interval > poll->interval) poll->nb_slower++;
+	poll->interval = interval;
+	if (interval < poll->min_used) poll->min_used = interval;
+	if (interval > poll->max_used) poll->max_used = interval;
+	poll->sleep_sum += interval;
+
+	poll->has_start = TRUE;
+	poll->cycle_start = now;
+	poll->cycle_records = 0;
+	poll->cycle_dropped = 0;
+	// Whatever came in meanwhile
+	poll->read_size = poll->max_read;
+	return interval;
+}
+
+void poll_print_stats(const SmemPollScheduler *poll)
+{
+	printf("Polling: %llu wakeups, %llu found the log empty, %llu found records dropped\n",
+		(unsigned long long)poll->nb_wakeups, (unsigned long long)poll->nb_empty_wakeups,
+		(unsigned long long)poll->nb_drop_wakeups);
+	printf("         %llu reads, %llu records, %llu dropped\n",
+		(unsigned long long)poll->nb_reads, (unsigned long long)poll->nb_records,
+		(unsigned long long)poll->nb_dropped);
+	printf("         interval %u ms (%u to %u ms), %llu shortened, %llu lengthened, %llu ms asleep\n",
+		poll->interval, poll->max_used > 0 ? poll->min_used : poll->interval, poll->max_used,
+		(unsigned long long)poll->nb_faster, (unsigned long long)poll->nb_slower,
+		(unsigned long long)poll->sleep_sum);
+	printf("         rate %.1f records/s, target %u records\n", poll->rate * 1000.0, poll->target);
+}
+
+void poll_simulate(const SmemPollPhase *phases, unsigned int nb_phases, DWORD duration, bool adaptive, SmemPollSimResult *result)
+{
+	SmemPollScheduler poll;
+	uint32_t used = 0;          // Records in the log
+	uint32_t dropped = 0;       // Records dropped since the last read
+	uint32_t fraction = 0;      // Thousandths of a record produced
+	unsigned int phase = 0;
+	DWORD phase_end = phases[0].duration;
+	DWORD now = 0;
+	DWORD wakeup = 0;
+	bool first = TRUE;          // First read of a wakeup
+
+	memset(result, 0, sizeof(*result));
+	poll_init(&poll, POLL_SIM_MAX_READ);
+
+	while (now < duration) {
+		// The producer runs until the wakeup
+		for (; now < wakeup && now < duration; now++) {
+			if (now >= phase_end) {
+				phase = (phase + 1) % nb_phases;
+				phase_end += phases[phase].duration;
+			}
+			fraction += phases[phase].rate;
+			uint32_t produced = fraction / 1000;
+			fraction %= 1000;
+			result->nb_produced += produced;
+			if (used + produced > SMEM_POLL_SIM_CAPACITY) {
+				dropped += used + produced - SMEM_POLL_SIM_CAPACITY;
+				used = SMEM_POLL_SIM_CAPACITY;
+			}
+			else {
+				used += produced;
+			}
+		}
+
+		SmemReadResult read;
+		uint32_t size = adaptive ? poll.read_size : POLL_SIM_MAX_READ;
+		read.nb_read = used < size ? used : size;
+		used -= read.nb_read;
+		read.nb_dropped = dropped;
+		read.nb_available = used;
+		dropped = 0;
+		result->nb_reads++;
+		result->nb_read += read.nb_read;
+		result->nb_dropped += read.nb_dropped;
+		if (first && read.nb_read == 0 && read.nb_dropped == 0) result->nb_empty_wakeups++;
+
+		DWORD sleep;
+		if (adaptive) {
+			sleep = poll_next(&poll, &read, now);
+		}
+		else {
+			sleep = read.nb_available == 0 ? POLL_FIXED_INTERVAL : 0;
+		}
+		first = sleep > 0;
+		if (sleep > 0) {
+			result->nb_wakeups++;
+			wakeup = now + sleep;
+		}
+	}
+	// Not reported by a read yet
+	result->nb_dropped += dropped;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#define SMEM_POLL_MIN_INTERVAL 5        // Milliseconds between two wakeups, at least
+#define SMEM_POLL_MAX_INTERVAL 1000     // And at most, when the log stays empty
+#define SMEM_POLL_DECAY 16000           // Milliseconds for the rate seen to fall to a lower one
+#define SMEM_POLL_MIN_TARGET 32         // Records the log should hold at a wakeup, lowered on each drop
+#define SMEM_POLL_MAX_TARGET 500        // A quarter of the 2000 records of an SMEM log
+#define SMEM_POLL_SIM_CAPACITY 2000     // Records of the simulated log
+
+/**
+* @brief Chooses when to read the log again and how many records to ask for.
+*
+* The log is drained at each wakeup, then the scheduler sleeps for the time the
+* log takes to fill up to a target at the rate seen so far. The rate follows a
+* rise at once and a fall over SMEM_POLL_DECAY, so that a burst shortens the
+* interval on the next wakeup and keeps it short while bursts come back.
+* Each wakeup which finds records dropped halves the target, each one without
+* drop raises it by an eighth.
+* The counters are written by the reading thread and read once it has stopped.
+*/
+typedef struct {
+	uint32_t max_read;          // Records of a read, at most
+	uint32_t read_size;         // Records to ask for on the next read
+	DWORD interval;             // Milliseconds of the next sleep
+	uint32_t target;            // Records the log should hold at the next wakeup
+	double rate;                // Records per millisecond, read or dropped
+	bool has_start;
+	DWORD cycle_start;          // Time the last sleep began
+	uint32_t cycle_records;     // Records read since then
+	uint32_t cycle_dropped;     // Records dropped since then
+	// Decisions
+	uint64_t nb_reads;
+	uint64_t nb_records;
+	uint64_t nb_dropped;
+	uint64_t nb_wakeups;
+	uint64_t nb_empty_wakeups;  // Wakeups which found the log empty
+	uint64_t nb_drop_wakeups;   // Wakeups which found records dropped
+	uint64_t nb_faster;         // Intervals shortened
+	uint64_t nb_slower;         // Intervals lengthened
+	uint64_t sleep_sum;         // Milliseconds asleep
+	DWORD min_used;             // Shortest and longest intervals slept
+	DWORD max_used;
+} SmemPollScheduler;
+
+/**
+* @brief A span of a simulated producer at a steady rate.
+*/
+typedef struct {
+	DWORD duration;             // Milliseconds
+	uint32_t rate;              // Records per second
+} SmemPollPhase;
+
+/**
+* @brief Outcome of polling a simulated log.
+*/
+typedef struct {
+	uint64_t nb_produced;
+	uint64_t nb_read;
+	uint64_t nb_dropped;
+	uint64_t nb_wakeups;
+	uint64_t nb_empty_wakeups;
+	uint64_t nb_reads;
+} SmemPollSimResult;
+
+/**
+* @brief Initializes a scheduler, for a first read at once.
+*
+* @param poll The scheduler.
+* @param max_read Records of a read of the source, at most.
+*/
+void poll_init(SmemPollScheduler *poll, uint32_t max_read);
+
+/**
+* @brief Accounts for a read and returns the milliseconds to sleep before the next one.
+*
+* @param poll The scheduler.
+* @param result The outcome of the read.
+* @param now Current time in milliseconds, e.g. GetTickCount().
+* @return 0 while the log holds records, then the interval until the next wakeup.
+*         The next read asks for poll->read_size records.
+*/
+DWORD poll_next(SmemPollScheduler *poll, const SmemReadResult *result, DWORD now);
+
+/**
+* @brief Prints the decisions of a scheduler.
+*
+* @param poll The scheduler, its thread stopped.
+*/
+void poll_print_stats(const SmemPollScheduler *poll);
+
+/**
+* @brief Polls a simulated log of SMEM_POLL_SIM_CAPACITY records, in simulated time.
+*
+* The producer repeats its phases until the end, the records it writes into a
+* full log are dropped. Reads take no time.
+*
+* @param phases The phases of the producer.
+* @param nb_phases Number of phases.
+* @param duration Milliseconds simulated.
+* @param adaptive TRUE to poll with a scheduler, FALSE every 500 ms with full reads as before.
+* @param result Receives the counters.
+*/
+void poll_simulate(const SmemPollPhase *phases, unsigned int nb_phases, DWORD duration, bool adaptive, SmemPollSimResult *result);
@@ -0,0 +1,321 @@
+// smem_posix.cpp : the Win32 calls of smem_posix.h over POSIX, built by the Makefile only.
+
+#include "stdafx.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <map>
+
+#define SMEM_POSIX_NAME_MAX 256
+
+// A file or a mapping holds a descriptor, a thread the state waited by WaitForMultipleObjectsEx
+typedef struct {
+	bool is_thread;
+	int fd;
+	char name[SMEM_POSIX_NAME_MAX];     // Shared memory object created by CreateFileMappingW, unlinked by CloseHandle
+	pthread_t thread;
+	LPTHREAD_START_ROUTINE start;
+	LPVOID parameter;
+	bool ended;
+	bool joined;
+} SmemPosixObject;
+
+// Signaled when a thread ends
+static pthread_mutex_t threads_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t thread_ended = PTHREAD_COND_INITIALIZER;
+
+// munmap needs the length of a view
+static pthread_mutex_t views_lock = PTHREAD_MUTEX_INITIALIZER;
+static std::map<LPCVOID, size_t> views;
+
+static PHANDLER_ROUTINE console_handler;
+
+int fopen_s(FILE **file, const char *path, const char *mode)
+{
+	*file = fopen(path, mode);
+	return *file == NULL ? errno : 0;
+}
+
+static HANDLE new_object(int fd)
+{
+	SmemPosixObject *object = (SmemPosixObject *)calloc(1, sizeof(SmemPosixObject));
+
+	if (object == NULL) {
+		close(fd);
+		errno = ENOMEM;
+		return NULL;
+	}
+	object->fd = fd;
+	return object;
+}
+
+// "Local\Name" becomes "/Local_Name"
+static void shm_name(LPCWSTR name, char *path)
+{
+	size_t i = 0;
+
+	path[i++] = '/';
+	for (; *name != 0 && i < SMEM_POSIX_NAME_MAX - 1; name++) {
+		path[i++] = *name == '\\' ? '_' : (char)*name;
+	}
+	path[i] = 0;
+}
+
+HANDLE WINAPI CreateFileA(LPCSTR lpFileName, DWORD dwDesiredAccess, DWORD dwShareMode, LPSECURITY_ATTRIBUTES lpSecurityAttributes, DWORD dwCreationDisposition, DWORD dwFlagsAndAttributes, HANDLE hTemplateFile)
+{
+	int flags = (dwDesiredAccess & GENERIC_WRITE) ? O_RDWR : O_RDONLY;
+	int fd = open(lpFileName, flags);
+
+	if (fd < 0) {
+		return INVALID_HANDLE_VALUE;
+	}
+	HANDLE object = new_object(fd);
+	return object == NULL ? INVALID_HANDLE_VALUE : object;
+}
+
+BOOL WINAPI GetFileSizeEx(HANDLE hFile, PLARGE_INTEGER lpFileSize)
+{
+	struct stat st;
+
+	if (fstat(((SmemPosixObject *)hFile)->fd, &st) != 0) {
+		return FALSE;
+	}
+	lpFileSize->QuadPart = st.st_size;
+	return TRUE;
+}
+
+BOOL WINAPI CloseHandle(HANDLE hObject)
+{
+	SmemPosixObject *object = (SmemPosixObject *)hObject;
+
+	if (object->is_thread) {
+		if (!object->joined) {
+			pthread_detach(object->thread);
+		}
+	} else {
+		close(object->fd);
+		if (object->name[0] != 0) {
+			shm_unlink(object->name);
+		}
+	}
+	free(object);
+	return TRUE;
+}
+
+DWORD WINAPI GetLastError(VOID)
+{
+	return (DWORD)errno;
+}
+
+HANDLE WINAPI CreateFileMappingW(HANDLE hFile, LPSECURITY_ATTRIBUTES lpFileMappingAttributes, DWORD flProtect, DWORD dwMaximumSizeHigh, DWORD dwMaximumSizeLow, LPCWSTR lpName)
+{
+	if (hFile != INVALID_HANDLE_VALUE) {
+		// The mapping outlives the handle of the file
+		int fd = dup(((SmemPosixObject *)hFile)->fd);
+		return fd < 0 ? NULL : new_object(fd);
+	}
+
+	char name[SMEM_POSIX_NAME_MAX];
+	off_t size = ((off_t)dwMaximumSizeHigh << 32) | dwMaximumSizeLow;
+	shm_name(lpName, name);
+	int fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+	if (fd < 0) {
+		return NULL;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (st.st_size < size && ftruncate(fd, size) != 0)) {
+		close(fd);
+		return NULL;
+	}
+	SmemPosixObject *object = (SmemPosixObject *)new_object(fd);
+	if (object != NULL) {
+		memcpy(object->name, name, sizeof(name));
+	}
+	return object;
+}
+
+HANDLE WINAPI OpenFileMappingW(DWORD dwDesiredAccess, BOOL bInheritHandle, LPCWSTR lpName)
+{
+	char name[SMEM_POSIX_NAME_MAX];
+
+	shm_name(lpName, name);
+	int fd = shm_open(name, (dwDesiredAccess & FILE_MAP_WRITE) ? O_RDWR : O_RDONLY, 0);
+	return fd < 0 ? NULL : new_object(fd);
+}
+
+LPVOID WINAPI MapViewOfFile(HANDLE hFileMappingObject, DWORD dwDesiredAccess, DWORD dwFileOffsetHigh, DWORD dwFileOffsetLow, SIZE_T dwNumberOfBytesToMap)
+{
+	int fd = ((SmemPosixObject *)hFileMappingObject)->fd;
+	off_t offset = ((off_t)dwFileOffsetHigh << 32) | dwFileOffsetLow;
+	size_t size = dwNumberOfBytesToMap;
+
+	// 0 maps up to the end of the file
+	if (size == 0) {
+		struct stat st;
+		if (fstat(fd, &st) != 0) {
+			return NULL;
+		}
+		size = (size_t)(st.st_size - offset);
+	}
+	void *view = mmap(NULL, size, (dwDesiredAccess & FILE_MAP_WRITE) ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, offset);
+	if (view == MAP_FAILED) {
+		return NULL;
+	}
+	pthread_mutex_lock(&views_lock);
+	views[view] = size;
+	pthread_mutex_unlock(&views_lock);
+	return view;
+}
+
+BOOL WINAPI UnmapViewOfFile(LPCVOID lpBaseAddress)
+{
+	pthread_mutex_lock(&views_lock);
+	std::map<LPCVOID, size_t>::iterator view = views.find(lpBaseAddress);
+	bool found = view != views.end();
+	if (found) {
+		munmap((void *)lpBaseAddress, view->second);
+		views.erase(view);
+	}
+	pthread_mutex_unlock(&views_lock);
+	return found;
+}
+
+// No control driver out of the phone
+BOOL WINAPI DeviceIoControl(HANDLE hDevice, DWORD dwIoControlCode, LPVOID lpInBuffer, DWORD nInBufferSize, LPVOID lpOutBuffer, DWORD nOutBufferSize, LPDWORD lpBytesReturned, LPOVERLAPPED lpOverlapped)
+{
+	errno = ENODEV;
+	return FALSE;
+}
+
+static void *start_thread(void *parameter)
+{
+	SmemPosixObject *object = (SmemPosixObject *)parameter;
+
+	object->start(object->parameter);
+	pthread_mutex_lock(&threads_lock);
+	object->ended = TRUE;
+	pthread_cond_broadcast(&thread_ended);
+	pthread_mutex_unlock(&threads_lock);
+	return NULL;
+}
+
+HANDLE WINAPI CreateThread(LPSECURITY_ATTRIBUTES lpThreadAttributes, SIZE_T dwStackSize, LPTHREAD_START_ROUTINE lpStartAddress, LPVOID lpParameter, DWORD dwCreationFlags, LPDWORD lpThreadId)
+{
+	SmemPosixObject *object = (SmemPosixObject *)calloc(1, sizeof(SmemPosixObject));
+
+	if (object == NULL) {
+		return NULL;
+	}
+	object->is_thread = TRUE;
+	object->start = lpStartAddress;
+	object->parameter = lpParameter;
+	int error = pthread_create(&object->thread, NULL, start_thread, object);
+	if (error != 0) {
+		free(object);
+		errno = error;
+		return NULL;
+	}
+	return object;
+}
+
+static bool all_ended(DWORD nCount, CONST HANDLE *lpHandles)
+{
+	for (DWORD i = 0; i < nCount; i++) {
+		if (!((SmemPosixObject *)lpHandles[i])->ended) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+// Waits for all the threads (the tool never waits for one of them), 0 once they ended
+DWORD WINAPI WaitForMultipleObjectsEx(DWORD nCount, CONST HANDLE *lpHandles, BOOL bWaitAll, DWORD dwMilliseconds, BOOL bAlertable)
+{
+	struct timespec deadline;
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += dwMilliseconds / 1000;
+	deadline.tv_nsec += (long)(dwMilliseconds % 1000) * 1000000;
+	if (deadline.tv_nsec >= 1000000000) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000;
+	}
+
+	pthread_mutex_lock(&threads_lock);
+	while (!all_ended(nCount, lpHandles)) {
+		if (dwMilliseconds == INFINITE) {
+			pthread_cond_wait(&thread_ended, &threads_lock);
+		} else if (pthread_cond_timedwait(&thread_ended, &threads_lock, &deadline) == ETIMEDOUT) {
+			pthread_mutex_unlock(&threads_lock);
+			return WAIT_TIMEOUT;
+		}
+	}
+	pthread_mutex_unlock(&threads_lock);
+
+	for (DWORD i = 0; i < nCount; i++) {
+		SmemPosixObject *object = (SmemPosixObject *)lpHandles[i];
+		if (!object->joined) {
+			pthread_join(object->thread, NULL);
+			object->joined = TRUE;
+		}
+	}
+	return 0;
+}
+
+static void on_signal(int signal)
+{
+	if (console_handler != NULL) {
+		console_handler(CTRL_C_EVENT);
+	}
+}
+
+// Ctrl+C only, the handler replaced by the next one
+BOOL WINAPI SetConsoleCtrlHandler(PHANDLER_ROUTINE HandlerRoutine, BOOL Add)
+{
+	struct sigaction action;
+
+	console_handler = Add ? HandlerRoutine : NULL;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = on_signal;
+	sigemptyset(&action.sa_mask);
+	return sigaction(SIGINT, &action, NULL) == 0;
+}
+
+VOID WINAPI Sleep(DWORD dwMilliseconds)
+{
+	struct timespec duration;
+
+	duration.tv_sec = dwMilliseconds / 1000;
+	duration.tv_nsec = (long)(dwMilliseconds % 1000) * 1000000;
+	while (nanosleep(&duration, &duration) != 0 && errno == EINTR) {
+	}
+}
+
+DWORD WINAPI GetTickCount(VOID)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (DWORD)((uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000);
+}
+
+// Nanoseconds
+BOOL WINAPI QueryPerformanceCounter(LARGE_INTEGER *lpPerformanceCount)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	lpPerformanceCount->QuadPart = (long long)now.tv_sec * 1000000000 + now.tv_nsec;
+	return TRUE;
+}
+
+BOOL WINAPI QueryPerformanceFrequency(LARGE_INTEGER *lpFrequency)
+{
+	lpFrequency->QuadPart = 1000000000;
+	return TRUE;
+}
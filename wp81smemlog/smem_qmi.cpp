@@ -0,0 +1,273 @@
+#include "stdafx.h"
+#include "smem_parse.h"
+#include "smem_chunk.h"
+#include "smem_input.h"
+#include "smem_histo.h"
+#include "smem_qmi.h"
+
+void qmi_tracker_init(SmemQmiTracker *tracker, uint32_t clock_rate)
+{
+	memset(tracker, 0, sizeof(*tracker));
+	timebase_init(&tracker->timebase, clock_rate);
+	for (unsigned int b = 0; b < SMEM_QMI_BUCKETS; b++) {
+		tracker->buckets[b] = SMEM_QMI_NONE;
+	}
+	histogram_init(&tracker->other.latency);
+	histogram_init(&tracker->latency);
+}
+
+static unsigned int pending_bucket(uint32_t svc_id, uint16_t txn, uint16_t msg_id)
+{
+	uint32_t hash = (svc_id * 31 + ((uint32_t)msg_id << 16 | txn)) * 2654435761u;
+	return (hash >> 16) & (SMEM_QMI_BUCKETS - 1);
+}
+
+// Removes a pending request from the chain of its bucket
+static void unlink_pending(SmemQmiTracker *tracker, uint32_t index)
+{
+	SmemQmiPending *entry = &tracker->pending[index];
+	uint32_t *link = &tracker->buckets[pending_bucket(entry->svc_id, entry->txn, entry->msg_id)];
+
+	while (*link != index) {
+		link = &tracker->pending[*link].next;
+	}
+	*link = entry->next;
+	entry->used = FALSE;
+}
+
+// Counters of a message of a service, the shared ones when the table is full
+static SmemQmiMessageStats *find_message(SmemQmiTracker *tracker, uint32_t svc_id, uint16_t msg_id)
+{
+	unsigned int slot = ((svc_id * 31 + msg_id) * 2654435761u) >> 21;
+
+	// Linear probing, SMEM_QMI_MESSAGE_SLOTS is 2^11
+	for (;;) {
+		SmemQmiMessageStats *stats = &tracker->messages[slot];
+		if (stats->used) {
+			if (stats->svc_id == svc_id && stats->msg_id == msg_id) {
+				return stats;
+			}
+		}
+		else if (tracker->nb_messages >= SMEM_QMI_MESSAGE_SLOTS / 2) {
+			return &tracker->other;
+		}
+		else {
+			stats->used = TRUE;
+			stats->svc_id = svc_id;
+			stats->msg_id = msg_id;
+			histogram_init(&stats->latency);
+			tracker->nb_messages++;
+			return stats;
+		}
+		slot = (slot + 1) & (SMEM_QMI_MESSAGE_SLOTS - 1);
+	}
+}
+
+// Drops the requests waiting for too long, and the oldest one if the ring is full
+static void evict_pending(SmemQmiTracker *tracker, uint64_t time)
+{
+	uint64_t timeout = (uint64_t)SMEM_QMI_TIMEOUT * tracker->timebase.clock_rate;
+
+	while (tracker->pending_head < tracker->pending_tail) {
+		uint32_t index = (uint32_t)(tracker->pending_head & (SMEM_QMI_MAX_PENDING - 1));
+		SmemQmiPending *entry = &tracker->pending[index];
+		if (entry->used) {
+			bool full = tracker->pending_tail - tracker->pending_head == SMEM_QMI_MAX_PENDING;
+			if (!full && (time <= entry->time || time - entry->time <= timeout)) {
+				break;
+			}
+			find_message(tracker, entry->svc_id, entry->msg_id)->nb_timeout++;
+			unlink_pending(tracker, index);
+			tracker->nb_evicted++;
+		}
+		tracker->pending_head++;
+	}
+}
+
+static void add_request(SmemQmiTracker *tracker, const SmemQmiMessage *msg, uint32_t proc, uint64_t time)
+{
+	evict_pending(tracker, time);
+
+	uint32_t index = (uint32_t)(tracker->pending_tail++ & (SMEM_QMI_MAX_PENDING - 1));
+	SmemQmiPending *entry = &tracker->pending[index];
+	uint32_t *bucket = &tracker->buckets[pending_bucket(msg->svc_id, msg->txn, msg->msg_id)];
+
+	entry->svc_id = msg->svc_id;
+	entry->txn = msg->txn;
+	entry->msg_id = msg->msg_id;
+	entry->used = TRUE;
+	entry->proc = proc;
+	entry->time = time;
+	entry->next = *bucket;
+	*bucket = index;
+
+	find_message(tracker, msg->svc_id, msg->msg_id)->nb_req++;
+	tracker->nb_req++;
+}
+
+static void add_response(SmemQmiTracker *tracker, const SmemQmiMessage *msg, uint64_t time)
+{
+	uint32_t oldest = SMEM_QMI_NONE;
+
+	// The chain starts with the newest request
+	for (uint32_t index = tracker->buckets[pending_bucket(msg->svc_id, msg->txn, msg->msg_id)];
+		index != SMEM_QMI_NONE; index = tracker->pending[index].next) {
+		const SmemQmiPending *entry = &tracker->pending[index];
+		if (entry->svc_id == msg->svc_id && entry->txn == msg->txn && entry->msg_id == msg->msg_id) {
+			oldest = index;
+		}
+	}
+
+	tracker->nb_resp++;
+	if (oldest == SMEM_QMI_NONE) {
+		tracker->nb_unmatched_resp++;
+		return;
+	}
+
+	SmemQmiMessageStats *stats = find_message(tracker, msg->svc_id, msg->msg_id);
+	uint64_t req_time = tracker->pending[oldest].time;
+	uint64_t latency = time > req_time ? time - req_time : 0;
+	histogram_add(&stats->latency, latency);
+	histogram_add(&tracker->latency, latency);
+	stats->nb_resp++;
+	tracker->nb_matched++;
+	if (tracker->on_match != NULL) {
+		tracker->on_match(tracker->match_context, &tracker->pending[oldest], time);
+	}
+	unlink_pending(tracker, oldest);
+}
+
+void qmi_tracker_add(SmemQmiTracker *tracker, const SmemLogRecord *records, size_t nb_records)
+{
+	for (size_t i = 0; i < nb_records; i++) {
+		const SmemLogRecord *rec = &records[i];
+		if (rec->id == 0) {
+			continue;
+		}
+
+		uint64_t time = timebase_extend(&tracker->timebase, rec->timestamp);
+		if (!tracker->has_time) {
+			tracker->has_time = TRUE;
+			tracker->first_time = time;
+		}
+		tracker->last_time = time;
+
+		// Client side only: TX REQ then RX RESP
+		SmemQmiMessage msg;
+		if (!qmi_message(rec, &msg) || msg.server) {
+			continue;
+		}
+		if (!msg.rx && msg.cntl == SMEM_QMI_REQ) {
+			add_request(tracker, &msg, rec->id & 0xC0000000, time);
+		}
+		else if (msg.rx && msg.cntl == SMEM_QMI_RESP) {
+			add_response(tracker, &msg, time);
+		}
+	}
+}
+
+static double ticks_us(const SmemQmiTracker *tracker, uint64_t ticks)
+{
+	return (double)ticks * 1e6 / tracker->timebase.clock_rate;
+}
+
+// Most requested first
+static int compare_messages(const void *a, const void *b)
+{
+	uint64_t count_a = (*(const SmemQmiMessageStats *const *)a)->nb_req;
+	uint64_t count_b = (*(const SmemQmiMessageStats *const *)b)->nb_req;
+	return count_a < count_b ? 1 : count_a > count_b ? -1 : 0;
+}
+
+static void print_message(const SmemQmiTracker *tracker, const char *name, const SmemQmiMessageStats *stats)
+{
+	const SmemHistogram *latency = &stats->latency;
+
+	printf("%-28s %10llu %10llu %10llu %10.1f %10.1f %10.1f %10.1f\n", name,
+		(unsigned long long)stats->nb_req, (unsigned long long)stats->nb_resp, (unsigned long long)stats->nb_timeout,
+		ticks_us(tracker, histogram_percentile(latency, 0.5)), ticks_us(tracker, histogram_percentile(latency, 0.9)),
+		ticks_us(tracker, histogram_percentile(latency, 0.99)), ticks_us(tracker, latency->max));
+}
+
+void qmi_tracker_print(const SmemQmiTracker *tracker)
+{
+	const SmemHistogram *latency = &tracker->latency;
+	char name[32];
+
+	printf("QMI: %llu REQ, %llu RESP, %llu matched, %llu RESP without REQ, %llu REQ evicted, %llu REQ outstanding\n",
+		(unsigned long long)tracker->nb_req, (unsigned long long)tracker->nb_resp, (unsigned long long)tracker->nb_matched,
+		(unsigned long long)tracker->nb_unmatched_resp, (unsigned long long)tracker->nb_evicted,
+		(unsigned long long)(tracker->nb_req - tracker->nb_matched - tracker->nb_evicted));
+	if (latency->count > 0) {
+		printf("Latency: min %.1f us, median %.1f us, 90%% %.1f us, 99%% %.1f us, max %.1f us\n",
+			ticks_us(tracker, latency->min), ticks_us(tracker, histogram_percentile(latency, 0.5)),
+			ticks_us(tracker, histogram_percentile(latency, 0.9)), ticks_us(tracker, histogram_percentile(latency, 0.99)),
+			ticks_us(tracker, latency->max));
+	}
+
+	const SmemQmiMessageStats **messages = (const SmemQmiMessageStats **)malloc(SMEM_QMI_MESSAGE_SLOTS * sizeof(SmemQmiMessageStats *));
+	if (messages == NULL || tracker->nb_messages == 0) {
+		free(messages);
+		return;
+	}
+	unsigned int nb_messages = 0;
+	for (unsigned int m = 0; m < SMEM_QMI_MESSAGE_SLOTS; m++) {
+		if (tracker->messages[m].used) {
+			messages[nb_messages++] = &tracker->messages[m];
+		}
+	}
+	qsort(messages, nb_messages, sizeof(messages[0]), compare_messages);
+
+	printf("\n%-28s %10s %10s %10s %10s %10s %10s %10s\n",
+		"service message", "REQ", "RESP", "timeouts", "p50 us", "p90 us", "p99 us", "max us");
+	for (unsigned int m = 0; m < nb_messages && m < SMEM_QMI_TOP_MESSAGES; m++) {
+		// Ids as printed by qmi_cci_print
+		_snprintf_s(name, sizeof(name), _TRUNCATE, "svc:0x%x msg:0x%x", messages[m]->svc_id, messages[m]->msg_id);
+		print_message(tracker, name, messages[m]);
+	}
+	if (nb_messages > SMEM_QMI_TOP_MESSAGES) {
+		printf("%u other service messages\n", nb_messages - SMEM_QMI_TOP_MESSAGES);
+	}
+	if (tracker->other.nb_req > 0) {
+		print_message(tracker, "not tracked", &tracker->other);
+	}
+	free(messages);
+
+	// The ring keeps the requests in order, the oldest outstanding ones come first
+	unsigned int nb_listed = 0;
+	for (uint64_t p = tracker->pending_head; p < tracker->pending_tail && nb_listed < SMEM_QMI_TOP_OUTSTANDING; p++) {
+		const SmemQmiPending *entry = &tracker->pending[p & (SMEM_QMI_MAX_PENDING - 1)];
+		if (!entry->used) {
+			continue;
+		}
+		if (nb_listed++ == 0) {
+			printf("\n%-28s %10s %10s\n", "outstanding request", "Txn", "waiting ms");
+		}
+		_snprintf_s(name, sizeof(name), _TRUNCATE, "svc:0x%x msg:0x%x", entry->svc_id, entry->msg_id);
+		printf("%-28s %10x %10.1f\n", name, entry->txn,
+			ticks_us(tracker, tracker->last_time > entry->time ? tracker->last_time - entry->time : 0) / 1000.0);
+	}
+}
+
+static bool add_records(void *context, const SmemLogRecord *records, size_t nb_records, uint32_t nb_dropped)
+{
+	qmi_tracker_add((SmemQmiTracker *)context, records, nb_records);
+	return TRUE;
+}
+
+int qmi_file(const char *path, unsigned int nb_jobs, uint32_t clock_rate)
+{
+	SmemQmiTracker *tracker = (SmemQmiTracker *)malloc(sizeof(SmemQmiTracker));
+
+	if (tracker == NULL) {
+		fprintf(stderr, "Not enough memory for the QMI tracker\n");
+		return EXIT_FAILURE;
+	}
+	qmi_tracker_init(tracker, input_clock_rate(path, clock_rate));
+
+	int status = read_input_file(path, nb_jobs, add_records, tracker);
+
+	qmi_tracker_print(tracker);
+	free(tracker);
+	return status;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#define SMEM_QMI_MAX_PENDING 4096       // Requests waiting for their response, a power of 2: the oldest is evicted when full
+#define SMEM_QMI_BUCKETS 4096           // Hash buckets of the pending requests, a power of 2
+#define SMEM_QMI_MESSAGE_SLOTS 2048     // Hash table of the service messages, a power of 2, at most half used
+#define SMEM_QMI_TIMEOUT 10             // Seconds after which a request without response is evicted
+#define SMEM_QMI_TOP_MESSAGES 20        // Service messages listed in a summary, the most requested
+#define SMEM_QMI_TOP_OUTSTANDING 20     // Outstanding requests listed in a summary, the oldest
+#define SMEM_QMI_NONE 0xFFFFFFFF
+
+/**
+* @brief Client request waiting for its response.
+*/
+typedef struct {
+	uint32_t svc_id;
+	uint16_t txn;
+	uint16_t msg_id;
+	bool used;              // FALSE once answered or evicted
+	uint32_t proc;          // Processor flag of the request record (0xC0000000 mask)
+	uint64_t time;          // Extended timestamp of the request
+	uint32_t next;          // Next pending request of the same bucket, SMEM_QMI_NONE at the end
+} SmemQmiPending;
+
+/**
+* @brief Counters of the requests of one message of a service.
+*/
+typedef struct {
+	uint32_t svc_id;
+	uint16_t msg_id;
+	bool used;
+	uint64_t nb_req;
+	uint64_t nb_resp;       // Responses matched with a request
+	uint64_t nb_timeout;    // Requests evicted without response
+	SmemHistogram latency;  // From the request to the response, in ticks
+} SmemQmiMessageStats;
+
+/**
+* @brief Receives a request matched with its response.
+*
+* @param context The context of the tracker.
+* @param request The request.
+* @param time Extended timestamp of the response.
+*/
+typedef void (*SmemQmiMatchHandler)(void *context, const SmemQmiPending *request, uint64_t time);
+
+/**
+* @brief Matches the QCCI requests and responses of the clients, in bounded memory.
+*
+* A TX REQ waits in a hash table keyed by service id, transaction id and message id until
+* the RX RESP of the same key, the oldest waiting request of a key is matched first.
+*/
+typedef struct {
+	SmemTimebase timebase;
+	bool has_time;                  // FALSE until a record with an id
+	uint64_t first_time;
+	uint64_t last_time;
+	SmemQmiPending pending[SMEM_QMI_MAX_PENDING];  // Ring of the requests, in the order of the records
+	uint64_t pending_head;          // Oldest request which may still wait
+	uint64_t pending_tail;          // Next request
+	uint32_t buckets[SMEM_QMI_BUCKETS];  // Newest pending request of each bucket
+	SmemQmiMessageStats messages[SMEM_QMI_MESSAGE_SLOTS];
+	unsigned int nb_messages;
+	SmemQmiMessageStats other;      // Messages which did not fit in the table
+	SmemHistogram latency;          // All the matched requests
+	uint64_t nb_req;
+	uint64_t nb_resp;               // All the client responses, matched or not
+	uint64_t nb_matched;
+	uint64_t nb_unmatched_resp;     // Responses without a waiting request
+	uint64_t nb_evicted;            // Requests without response, too old or pushed out of a full table
+	SmemQmiMatchHandler on_match;   // Called for each matched request, NULL after qmi_tracker_init
+	void *match_context;
+} SmemQmiTracker;
+
+/**
+* @brief Initializes a tracker.
+*
+* @param tracker The tracker.
+* @param clock_rate Ticks per second of the record timestamps.
+*/
+void qmi_tracker_init(SmemQmiTracker *tracker, uint32_t clock_rate);
+
+/**
+* @brief Matches the client requests and responses of records, the other records only extend the timebase.
+*
+* @param tracker The tracker.
+* @param records The records.
+* @param nb_records Number of records.
+*/
+void qmi_tracker_add(SmemQmiTracker *tracker, const SmemLogRecord *records, size_t nb_records);
+
+/**
+* @brief Prints the request counts, the latency percentiles of the busiest service messages and the oldest outstanding requests.
+*
+* @param tracker The tracker.
+*/
+void qmi_tracker_print(const SmemQmiTracker *tracker);
+
+/**
+* @brief Matches the QMI requests of a raw dump, capture or archive file and prints the summary.
+*
+* @param path The file.
+* @param nb_jobs Threads parsing a raw dump or an archive.
+* @param clock_rate Ticks per second of the timestamps of a raw dump.
+* @return EXIT_SUCCESS, or EXIT_FAILURE if the file cannot be read.
+*/
+int qmi_file(const char *path, unsigned int nb_jobs, uint32_t clock_rate);
@@ -0,0 +1,51 @@
+#include "stdafx.h"
+#include "smem_source.h"
+#include "smem_ring.h"
+#include "smem_poll.h"
+#include "smem_histo.h"
+#include "smem_metrics.h"
+#include "smem_reader.h"
+
+bool read_loop_run(SmemReadLoop *loop)
+{
+	SmemRecordSource *source = loop->source;
+	SmemLogRecord *buffer = NULL;
+	bool ok = TRUE;
+
+	poll_init(&loop->poll, source->max_read);
+	if (loop->reserve == NULL) {
+		buffer = (SmemLogRecord *)malloc(source->max_read * sizeof(SmemLogRecord));
+		if (buffer == NULL) {
+			fprintf(stderr, "Not enough memory for the reads\n");
+			return FALSE;
+		}
+	}
+
+	while (ok && InterlockedExchangeAdd(loop->running, 0) != FALSE) {
+		uint32_t max_records = loop->poll.read_size;
+		SmemLogRecord *records = buffer != NULL ? buffer : loop->reserve(loop, &max_records);
+		if (records == NULL) {
+			break;
+		}
+
+		SmemReadResult result;
+		uint64_t start = loop->metrics != NULL ? metrics_clock() : 0;
+		ok = source->read(source, records, max_records, &result);
+		if (ok) {
+			if (loop->metrics != NULL) metrics_read(loop->metrics, start, &result);
+			ok = loop->consume(loop, records, &result);
+		}
+
+		DWORD interval = ok ? poll_next(&loop->poll, &result, GetTickCount()) : 0;
+		if (interval > 0) {
+			if (loop->sleep != NULL) {
+				loop->sleep(loop, interval);
+			}
+			else {
+				Sleep(interval);
+			}
+		}
+	}
+	free(buffer);
+	return ok;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+typedef struct SmemReadLoop SmemReadLoop;
+
+/**
+* @brief Reading thread of a source: reads, hands the records over, then sleeps as the scheduler tells.
+*
+* Shared by the reader of the pipeline, the readers of both log indexes and the
+* capture loop of main, which differ only by their callbacks.
+*/
+struct SmemReadLoop {
+	SmemRecordSource *source;
+	volatile LONG *running;     // Read until it turns FALSE (Ctrl-C or the other reader)
+	SmemMetrics *metrics;       // Times the reads, NULL when off
+	// Room for the next read, at most *max_records records which may be lowered; NULL to stop.
+	// NULL for a buffer of source->max_read records owned by the loop
+	SmemLogRecord *(*reserve)(SmemReadLoop *loop, uint32_t *max_records);
+	// Records of a read, which may be none; FALSE to stop
+	bool (*consume)(SmemReadLoop *loop, SmemLogRecord *records, const SmemReadResult *result);
+	// Sleep between two reads, NULL for Sleep
+	void (*sleep)(SmemReadLoop *loop, DWORD interval);
+	void *context;              // Of the callbacks
+	SmemPollScheduler poll;     // When the loop reads, and how many records
+};
+
+/**
+* @brief Reads the source of a loop until *running turns FALSE, the source ends or a callback stops.
+*
+* The scheduler starts from the max_read of the source.
+*
+* @param loop The loop, with its source, flag and callbacks.
+* @return FALSE if the read failed, the source ended or consume stopped, TRUE if stopped by *running or reserve.
+*/
+bool read_loop_run(SmemReadLoop *loop);
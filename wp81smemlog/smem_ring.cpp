@@ -0,0 +1,50 @@
+#include "stdafx.h"
+#include "smem_ring.h"
+
+// Reads an index of the ring, atomic with a full barrier like the writes
+static uint32_t load_index(volatile LONG *index)
+{
+	return (uint32_t)InterlockedExchangeAdd(index, 0);
+}
+
+void ring_init(SmemRing *ring, uint32_t size)
+{
+	ring->head = 0;
+	ring->tail = 0;
+	ring->size = size;
+	ring->nb_pushes = 0;
+	ring->used_sum = 0;
+	ring->max_used = 0;
+}
+
+uint32_t ring_free(SmemRing *ring, uint32_t *slot)
+{
+	uint32_t tail = load_index(&ring->tail);
+
+	*slot = tail & (ring->size - 1);
+	return ring->size - (tail - load_index(&ring->head));
+}
+
+void ring_push(SmemRing *ring, uint32_t nb_slots)
+{
+	uint32_t tail = load_index(&ring->tail) + nb_slots;
+	uint32_t used = tail - load_index(&ring->head);
+
+	ring->nb_pushes++;
+	ring->used_sum += used;
+	if (used > ring->max_used) ring->max_used = used;
+	InterlockedExchange(&ring->tail, (LONG)tail);
+}
+
+uint32_t ring_used(SmemRing *ring, uint32_t *slot)
+{
+	uint32_t head = load_index(&ring->head);
+
+	*slot = head & (ring->size - 1);
+	return load_index(&ring->tail) - head;
+}
+
+void ring_pop(SmemRing *ring, uint32_t nb_slots)
+{
+	InterlockedExchange(&ring->head, (LONG)(load_index(&ring->head) + nb_slots));
+}
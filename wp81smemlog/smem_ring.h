@@ -0,0 +1,59 @@
+#pragma once
+
+/**
+* @brief Indexes of a bounded ring of slots passed from one producer thread to one consumer thread, without lock.
+*
+* The slots themselves are an array of the user of the ring, of ring size entries.
+* The indexes run freely and wrap modulo 2^32, each one is written by a single thread
+* and every access to them is atomic, with a full barrier: the slots filled before
+* ring_push are seen by the consumer, the slots read before ring_pop are free for the producer.
+*/
+typedef struct {
+	volatile LONG head;         // Next slot to pop, written by the consumer
+	volatile LONG tail;         // Next slot to push, written by the producer
+	uint32_t size;              // Number of slots, a power of 2
+	// Occupancy seen by the producer, read once it has stopped
+	uint64_t nb_pushes;
+	uint64_t used_sum;          // Sum of the slots used after each push
+	uint32_t max_used;
+} SmemRing;
+
+/**
+* @brief Initializes an empty ring.
+*
+* @param ring The ring.
+* @param size Number of slots, a power of 2.
+*/
+void ring_init(SmemRing *ring, uint32_t size);
+
+/**
+* @brief Returns the number of free slots, from the producer thread.
+*
+* @param ring The ring.
+* @param slot Receives the index of the first free slot, the next ones follow it modulo the size.
+*/
+uint32_t ring_free(SmemRing *ring, uint32_t *slot);
+
+/**
+* @brief Gives filled slots to the consumer, from the producer thread.
+*
+* @param ring The ring.
+* @param nb_slots Number of slots filled from the first free slot, at most ring_free.
+*/
+void ring_push(SmemRing *ring, uint32_t nb_slots);
+
+/**
+* @brief Returns the number of filled slots, from the consumer thread.
+*
+* @param ring The ring.
+* @param slot Receives the index of the oldest filled slot, the next ones follow it modulo the size.
+*/
+uint32_t ring_used(SmemRing *ring, uint32_t *slot);
+
+/**
+* @brief Gives read slots back to the producer, from the consumer thread.
+*
+* @param ring The ring.
+* @param nb_slots Number of slots read from the oldest filled slot, at most ring_used.
+*/
+void ring_pop(SmemRing *ring, uint32_t nb_slots);
@@ -0,0 +1,270 @@
+#include "stdafx.h"
+#include "smem_parse.h"
+#include "smem_chunk.h"
+#include "smem_input.h"
+#include "smem_histo.h"
+#include "smem_router.h"
+
+void router_tracker_init(SmemRouterTracker *tracker, uint32_t clock_rate)
+{
+	memset(tracker, 0, sizeof(*tracker));
+	timebase_init(&tracker->timebase, clock_rate);
+	for (unsigned int b = 0; b < SMEM_ROUTER_BUCKETS; b++) {
+		tracker->buckets[b] = SMEM_ROUTER_NONE;
+	}
+	histogram_init(&tracker->other.latency);
+	histogram_init(&tracker->latency);
+}
+
+static unsigned int pending_bucket(uint32_t src, uint32_t dst, uint8_t type)
+{
+	uint32_t hash = (src * 31 + dst) * 2654435761u ^ type;
+	return (hash >> 16) & (SMEM_ROUTER_BUCKETS - 1);
+}
+
+// Removes a pending TX from the chain of its bucket
+static void unlink_pending(SmemRouterTracker *tracker, uint32_t index)
+{
+	SmemRouterPending *entry = &tracker->pending[index];
+	uint32_t *link = &tracker->buckets[pending_bucket(entry->src, entry->dst, entry->type)];
+
+	while (*link != index) {
+		link = &tracker->pending[*link].next;
+	}
+	*link = entry->next;
+	entry->used = FALSE;
+}
+
+// Counters of the messages from src to dst, the shared ones when the table is full
+static SmemRouterLink *find_link(SmemRouterTracker *tracker, uint32_t src, uint32_t dst)
+{
+	unsigned int slot = ((src * 31 + dst) * 2654435761u) >> 21;
+
+	// Linear probing, SMEM_ROUTER_LINK_SLOTS is 2^11
+	for (;;) {
+		SmemRouterLink *link = &tracker->links[slot];
+		if (link->used) {
+			if (link->src == src && link->dst == dst) {
+				return link;
+			}
+		}
+		else if (tracker->nb_links >= SMEM_ROUTER_LINK_SLOTS / 2) {
+			return &tracker->other;
+		}
+		else {
+			link->used = TRUE;
+			link->src = src;
+			link->dst = dst;
+			histogram_init(&link->latency);
+			tracker->nb_links++;
+			return link;
+		}
+		slot = (slot + 1) & (SMEM_ROUTER_LINK_SLOTS - 1);
+	}
+}
+
+// Drops the TX waiting for too long, and the oldest one if the ring is full
+static void evict_pending(SmemRouterTracker *tracker, uint64_t time)
+{
+	uint64_t timeout = (uint64_t)SMEM_ROUTER_TIMEOUT * tracker->timebase.clock_rate;
+
+	while (tracker->pending_head < tracker->pending_tail) {
+		uint32_t index = (uint32_t)(tracker->pending_head & (SMEM_ROUTER_MAX_PENDING - 1));
+		SmemRouterPending *entry = &tracker->pending[index];
+		if (entry->used) {
+			bool full = tracker->pending_tail - tracker->pending_head == SMEM_ROUTER_MAX_PENDING;
+			if (!full && (time <= entry->time || time - entry->time <= timeout)) {
+				break;
+			}
+			unlink_pending(tracker, index);
+			tracker->nb_evicted++;
+		}
+		tracker->pending_head++;
+	}
+}
+
+static void add_tx(SmemRouterTracker *tracker, const SmemRouterMessage *msg, uint32_t proc, uint64_t time)
+{
+	evict_pending(tracker, time);
+
+	uint32_t index = (uint32_t)(tracker->pending_tail++ & (SMEM_ROUTER_MAX_PENDING - 1));
+	SmemRouterPending *entry = &tracker->pending[index];
+	uint32_t *bucket = &tracker->buckets[pending_bucket(msg->src, msg->dst, msg->type)];
+
+	entry->src = msg->src;
+	entry->dst = msg->dst;
+	entry->type = msg->type;
+	entry->used = TRUE;
+	entry->proc = proc;
+	entry->time = time;
+	entry->next = *bucket;
+	*bucket = index;
+
+	SmemRouterLink *link = find_link(tracker, msg->src, msg->dst);
+	link->nb_tx++;
+	link->tx_bytes += msg->size;
+	tracker->nb_tx++;
+}
+
+static void add_rx(SmemRouterTracker *tracker, const SmemRouterMessage *msg, uint64_t time)
+{
+	uint32_t oldest = SMEM_ROUTER_NONE;
+
+	// The chain starts with the newest TX
+	for (uint32_t index = tracker->buckets[pending_bucket(msg->src, msg->dst, msg->type)];
+		index != SMEM_ROUTER_NONE; index = tracker->pending[index].next) {
+		const SmemRouterPending *entry = &tracker->pending[index];
+		if (entry->src == msg->src && entry->dst == msg->dst && entry->type == msg->type) {
+			oldest = index;
+		}
+	}
+
+	SmemRouterLink *link = find_link(tracker, msg->src, msg->dst);
+	link->nb_rx++;
+	tracker->nb_rx++;
+	if (oldest == SMEM_ROUTER_NONE) {
+		tracker->nb_unmatched_rx++;
+		return;
+	}
+
+	// RX logged a little before its TX by another processor count as 0
+	uint64_t tx_time = tracker->pending[oldest].time;
+	uint64_t latency = time > tx_time ? time - tx_time : 0;
+	histogram_add(&link->latency, latency);
+	histogram_add(&tracker->latency, latency);
+	tracker->nb_matched++;
+	if (tracker->on_match != NULL) {
+		tracker->on_match(tracker->match_context, &tracker->pending[oldest], msg, time);
+	}
+	unlink_pending(tracker, oldest);
+}
+
+void router_tracker_add(SmemRouterTracker *tracker, const SmemLogRecord *records, size_t nb_records)
+{
+	for (size_t i = 0; i < nb_records; i++) {
+		const SmemLogRecord *rec = &records[i];
+		if (rec->id == 0) {
+			continue;
+		}
+
+		uint64_t time = timebase_extend(&tracker->timebase, rec->timestamp);
+		if (!tracker->has_time) {
+			tracker->has_time = TRUE;
+			tracker->first_time = time;
+		}
+		tracker->last_time = time;
+
+		SmemRouterMessage msg;
+		if (!router_message(rec, &msg)) {
+			continue;
+		}
+		if (msg.rx) {
+			add_rx(tracker, &msg, time);
+		}
+		else {
+			add_tx(tracker, &msg, rec->id & 0xC0000000, time);
+		}
+	}
+}
+
+// Count per second of record timestamps
+static double tracker_rate(const SmemRouterTracker *tracker, uint64_t count)
+{
+	uint64_t span = tracker->has_time ? tracker->last_time - tracker->first_time : 0;
+	return span > 0 ? (double)count * tracker->timebase.clock_rate / (double)span : 0.0;
+}
+
+static double ticks_us(const SmemRouterTracker *tracker, uint64_t ticks)
+{
+	return (double)ticks * 1e6 / tracker->timebase.clock_rate;
+}
+
+// Busiest first
+static int compare_links(const void *a, const void *b)
+{
+	const SmemRouterLink *link_a = *(const SmemRouterLink *const *)a;
+	const SmemRouterLink *link_b = *(const SmemRouterLink *const *)b;
+	uint64_t count_a = link_a->nb_tx + link_a->nb_rx;
+	uint64_t count_b = link_b->nb_tx + link_b->nb_rx;
+	return count_a < count_b ? 1 : count_a > count_b ? -1 : 0;
+}
+
+static void print_link(const SmemRouterTracker *tracker, const char *name, const SmemRouterLink *link)
+{
+	const SmemHistogram *latency = &link->latency;
+
+	printf("%-22s %10.1f %10.1f %12.1f %10llu %10.1f %10.1f %10.1f %10.1f\n", name,
+		tracker_rate(tracker, link->nb_tx), tracker_rate(tracker, link->nb_rx), tracker_rate(tracker, link->tx_bytes),
+		(unsigned long long)latency->count, ticks_us(tracker, histogram_percentile(latency, 0.5)),
+		ticks_us(tracker, histogram_percentile(latency, 0.9)), ticks_us(tracker, histogram_percentile(latency, 0.99)),
+		ticks_us(tracker, latency->max));
+}
+
+void router_tracker_print(const SmemRouterTracker *tracker)
+{
+	const SmemHistogram *latency = &tracker->latency;
+	char name[32];
+
+	printf("IPC Router: %llu TX, %llu RX, %llu matched, %llu RX without TX, %llu TX evicted, %llu TX waiting\n",
+		(unsigned long long)tracker->nb_tx, (unsigned long long)tracker->nb_rx, (unsigned long long)tracker->nb_matched,
+		(unsigned long long)tracker->nb_unmatched_rx, (unsigned long long)tracker->nb_evicted,
+		(unsigned long long)(tracker->nb_tx - tracker->nb_matched - tracker->nb_evicted));
+	if (latency->count > 0) {
+		printf("Latency: min %.1f us, median %.1f us, 90%% %.1f us, 99%% %.1f us, max %.1f us\n",
+			ticks_us(tracker, latency->min), ticks_us(tracker, histogram_percentile(latency, 0.5)),
+			ticks_us(tracker, histogram_percentile(latency, 0.9)), ticks_us(tracker, histogram_percentile(latency, 0.99)),
+			ticks_us(tracker, latency->max));
+	}
+
+	const SmemRouterLink **links = (const SmemRouterLink **)malloc(SMEM_ROUTER_LINK_SLOTS * sizeof(SmemRouterLink *));
+	if (links == NULL || tracker->nb_links == 0) {
+		free(links);
+		return;
+	}
+	unsigned int nb_links = 0;
+	for (unsigned int l = 0; l < SMEM_ROUTER_LINK_SLOTS; l++) {
+		if (tracker->links[l].used) {
+			links[nb_links++] = &tracker->links[l];
+		}
+	}
+	qsort(links, nb_links, sizeof(links[0]), compare_links);
+
+	printf("\n%-22s %10s %10s %12s %10s %10s %10s %10s %10s\n",
+		"link", "TX/s", "RX/s", "bytes/s", "matched", "p50 us", "p90 us", "p99 us", "max us");
+	for (unsigned int l = 0; l < nb_links && l < SMEM_ROUTER_TOP_LINKS; l++) {
+		// Addresses as printed by ipc_router_print
+		_snprintf_s(name, sizeof(name), _TRUNCATE, "%02x:%06x->%02x:%06x", links[l]->src >> 24, links[l]->src & 0xFFFFFF,
+			links[l]->dst >> 24, links[l]->dst & 0xFFFFFF);
+		print_link(tracker, name, links[l]);
+	}
+	if (nb_links > SMEM_ROUTER_TOP_LINKS) {
+		printf("%u other links\n", nb_links - SMEM_ROUTER_TOP_LINKS);
+	}
+	if (tracker->other.nb_tx + tracker->other.nb_rx > 0) {
+		print_link(tracker, "not tracked", &tracker->other);
+	}
+	free(links);
+}
+
+static bool add_records(void *context, const SmemLogRecord *records, size_t nb_records, uint32_t nb_dropped)
+{
+	router_tracker_add((SmemRouterTracker *)context, records, nb_records);
+	return TRUE;
+}
+
+int router_file(const char *path, unsigned int nb_jobs, uint32_t clock_rate)
+{
+	SmemRouterTracker *tracker = (SmemRouterTracker *)malloc(sizeof(SmemRouterTracker));
+
+	if (tracker == NULL) {
+		fprintf(stderr, "Not enough memory for the IPC Router tracker\n");
+		return EXIT_FAILURE;
+	}
+	router_tracker_init(tracker, input_clock_rate(path, clock_rate));
+
+	int status = read_input_file(path, nb_jobs, add_records, tracker);
+
+	router_tracker_print(tracker);
+	free(tracker);
+	return status;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#define SMEM_ROUTER_MAX_PENDING 4096    // TX waiting for their RX, a power of 2: the oldest is evicted when full
+#define SMEM_ROUTER_BUCKETS 4096        // Hash buckets of the pending TX, a power of 2
+#define SMEM_ROUTER_LINK_SLOTS 2048     // Hash table of the links, a power of 2, at most half used
+#define SMEM_ROUTER_TIMEOUT 10          // Seconds after which a TX without RX is evicted
+#define SMEM_ROUTER_TOP_LINKS 20        // Links listed in a summary, the busiest
+#define SMEM_ROUTER_NONE 0xFFFFFFFF
+
+/**
+* @brief TX of a message waiting for its RX.
+*/
+typedef struct {
+	uint32_t src;           // Sending processor and port (see SmemRouterMessage)
+	uint32_t dst;
+	uint8_t type;
+	bool used;              // FALSE once matched or evicted
+	uint32_t proc;          // Processor flag of the TX record (0xC0000000 mask)
+	uint64_t time;          // Extended timestamp of the TX
+	uint32_t next;          // Next pending TX of the same bucket, SMEM_ROUTER_NONE at the end
+} SmemRouterPending;
+
+/**
+* @brief Counters of the messages from a port to another.
+*/
+typedef struct {
+	uint32_t src;
+	uint32_t dst;
+	bool used;
+	uint64_t nb_tx;
+	uint64_t nb_rx;
+	uint64_t tx_bytes;
+	SmemHistogram latency;  // From the TX to the RX of the matched messages, in ticks
+} SmemRouterLink;
+
+/**
+* @brief Receives a TX matched with its RX.
+*
+* @param context The context of the tracker.
+* @param tx The TX.
+* @param rx The fields of the RX.
+* @param time Extended timestamp of the RX.
+*/
+typedef void (*SmemRouterMatchHandler)(void *context, const SmemRouterPending *tx, const SmemRouterMessage *rx, uint64_t time);
+
+/**
+* @brief Matches the IPC Router TX and RX records of the same messages, in bounded memory.
+*
+* A TX waits in a hash table keyed by source, destination and message type until
+* the RX of the same key, the oldest waiting TX of a key is matched first.
+*/
+typedef struct {
+	SmemTimebase timebase;
+	bool has_time;                  // FALSE until a record with an id
+	uint64_t first_time;
+	uint64_t last_time;
+	SmemRouterPending pending[SMEM_ROUTER_MAX_PENDING];  // Ring of the TX, in the order of the records
+	uint64_t pending_head;          // Oldest TX which may still wait
+	uint64_t pending_tail;          // Next TX
+	uint32_t buckets[SMEM_ROUTER_BUCKETS];  // Newest pending TX of each bucket
+	SmemRouterLink links[SMEM_ROUTER_LINK_SLOTS];
+	unsigned int nb_links;
+	SmemRouterLink other;           // Links which did not fit in the table
+	SmemHistogram latency;          // All the matched messages
+	uint64_t nb_tx;
+	uint64_t nb_rx;
+	uint64_t nb_matched;
+	uint64_t nb_unmatched_rx;       // RX without a waiting TX
+	uint64_t nb_evicted;            // TX without RX, too old or pushed out of a full table
+	SmemRouterMatchHandler on_match;  // Called for each matched message, NULL after router_tracker_init
+	void *match_context;
+} SmemRouterTracker;
+
+/**
+* @brief Initializes a tracker.
+*
+* @param tracker The tracker.
+* @param clock_rate Ticks per second of the record timestamps.
+*/
+void router_tracker_init(SmemRouterTracker *tracker, uint32_t clock_rate);
+
+/**
+* @brief Matches the TX and RX of records, the other records only extend the timebase.
+*
+* @param tracker The tracker.
+* @param records The records.
+* @param nb_records Number of records.
+*/
+void router_tracker_add(SmemRouterTracker *tracker, const SmemLogRecord *records, size_t nb_records);
+
+/**
+* @brief Prints the message counts and the latency percentiles of all the messages and of the busiest links.
+*
+* @param tracker The tracker.
+*/
+void router_tracker_print(const SmemRouterTracker *tracker);
+
+/**
+* @brief Matches the IPC Router messages of a raw dump, capture or archive file and prints the summary.
+*
+* @param path The file.
+* @param nb_jobs Threads parsing a raw dump or an archive.
+* @param clock_rate Ticks per second of the timestamps of a raw dump.
+* @return EXIT_SUCCESS, or EXIT_FAILURE if the file cannot be read.
+*/
+int router_file(const char *path, unsigned int nb_jobs, uint32_t clock_rate);
@@ -0,0 +1,171 @@
+#include "stdafx.h"
+#include "smem_source.h"
+#include "smem_synth.h"
+#include "smem_shm.h"
+
+#define SHM_REPORT_PERIOD 1000          // Milliseconds between two reports of the producer
+
+// Number of records published by the producer; the mapping of a reader is read-only
+static uint32_t load_written(const SmemShmLog *log)
+{
+	uint32_t written = (uint32_t)log->written;
+	MemoryBarrier();
+	return written;
+}
+
+static bool start_shm(SmemRecordSource *source, bool verbose)
+{
+	SmemShmSource *shm = (SmemShmSource *)source;
+
+	// The get-functions and init IOCTLs of the device: find the logs and start at the oldest record
+	shm->mapping = OpenFileMappingW(FILE_MAP_READ, FALSE, SMEM_SHM_NAME);
+	if (shm->mapping == NULL) {
+		printf("No emulated SMEM log, start a producer with -P (error %u)\n", GetLastError());
+		return FALSE;
+	}
+	shm->area = (SmemShmArea *)MapViewOfFile(shm->mapping, FILE_MAP_READ, 0, 0, sizeof(SmemShmArea));
+	if (shm->area == NULL) {
+		printf("Failed to map the emulated SMEM log (error %u)\n", GetLastError());
+		CloseHandle(shm->mapping);
+		return FALSE;
+	}
+	if (shm->area->magic != SMEM_SHM_MAGIC || shm->area->nb_records != SMEM_SHM_RECORDS) {
+		printf("The emulated SMEM log is not ready or of another version\n");
+		source->stop(source);
+		return FALSE;
+	}
+
+	uint32_t written = load_written(&shm->area->logs[shm->log_index]);
+	shm->next = written - (written < SMEM_SHM_RECORDS ? written : SMEM_SHM_RECORDS);
+	if (verbose) {
+		printf("Emulated log %u: %u records written so far\n", shm->log_index, written);
+	}
+	return TRUE;
+}
+
+static void stop_shm(SmemRecordSource *source)
+{
+	SmemShmSource *shm = (SmemShmSource *)source;
+
+	UnmapViewOfFile(shm->area);
+	CloseHandle(shm->mapping);
+	shm->area = NULL;
+	shm->mapping = NULL;
+}
+
+// Same counters as SmemReadLogEvents
+static bool read_shm(SmemRecordSource *source, SmemLogRecord *records, uint32_t max_records, SmemReadResult *result)
+{
+	SmemShmSource *shm = (SmemShmSource *)source;
+	const SmemShmLog *log = &shm->area->logs[shm->log_index];
+	uint32_t written = load_written(log);
+	uint32_t available = written - shm->next;
+
+	result->nb_dropped = 0;
+	if (available > SMEM_SHM_RECORDS) {
+		// Overwritten before they could be read
+		result->nb_dropped = available - SMEM_SHM_RECORDS;
+		shm->next = written - SMEM_SHM_RECORDS;
+		available = SMEM_SHM_RECORDS;
+	}
+
+	uint32_t nb_read = available < max_records ? available : max_records;
+	if (nb_read > SMEM_SHM_MAX_READ) nb_read = SMEM_SHM_MAX_READ;
+	for (uint32_t i = 0; i < nb_read; i++) {
+		records[i] = log->records[(shm->next + i) % SMEM_SHM_RECORDS];
+	}
+
+	// The producer may have overwritten the first records meanwhile, or be writing over the oldest one.
+	// The barrier of load_written follows its load: this one keeps the copies above before it
+	MemoryBarrier();
+	written = load_written(log);
+	uint32_t torn = written + 1 - SMEM_SHM_RECORDS - shm->next;
+	if ((int32_t)torn > 0) {
+		if (torn > nb_read) torn = nb_read;
+		memmove(records, records + torn, (nb_read - torn) * sizeof(SmemLogRecord));
+		result->nb_dropped += torn;
+		shm->next += torn;
+		nb_read -= torn;
+	}
+	shm->next += nb_read;
+
+	result->nb_read = nb_read;
+	available = written - shm->next;
+	result->nb_available = available < SMEM_SHM_RECORDS ? available : SMEM_SHM_RECORDS;
+	return TRUE;
+}
+
+void shm_source_init(SmemShmSource *source, uint32_t log_index)
+{
+	source->base.start = start_shm;
+	source->base.read = read_shm;
+	source->base.stop = stop_shm;
+	source->base.max_read = SMEM_SHM_MAX_READ;
+	source->base.failed = FALSE;
+	source->log_index = log_index;
+	source->mapping = NULL;
+	source->area = NULL;
+	source->next = 0;
+}
+
+// Only the producer writes: the record is in its slot before it is published
+static void write_record(SmemShmLog *log, const SmemLogRecord *record)
+{
+	uint32_t written = (uint32_t)log->written;
+
+	log->records[written % SMEM_SHM_RECORDS] = *record;
+	InterlockedExchange(&log->written, (LONG)(written + 1));
+}
+
+int shm_produce(uint32_t rate, const SmemSynthConfig *config, uint32_t first_index, uint32_t last_index, volatile LONG *running)
+{
+	HANDLE mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(SmemShmArea), SMEM_SHM_NAME);
+	if (mapping == NULL) {
+		printf("Failed to create the emulated SMEM log (error %u)\n", GetLastError());
+		return EXIT_FAILURE;
+	}
+	SmemShmArea *area = (SmemShmArea *)MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, sizeof(SmemShmArea));
+	if (area == NULL) {
+		printf("Failed to map the emulated SMEM log (error %u)\n", GetLastError());
+		CloseHandle(mapping);
+		return EXIT_FAILURE;
+	}
+	// Left as they are when the logs already exist, their readers go on
+	area->nb_records = SMEM_SHM_RECORDS;
+	InterlockedExchange(&area->magic, SMEM_SHM_MAGIC);
+
+	SmemSynthSource synth;
+	synth_source_init(&synth, (uint64_t)-1, config);
+	uint32_t index = first_index;
+	uint64_t nb_written = 0;
+	uint64_t last_written = 0;
+	DWORD start = GetTickCount();
+	DWORD last_report = start;
+
+	printf("Writing %u records/s to the emulated SMEM log...Press Ctrl-C to stop.\n", rate);
+	while (InterlockedCompareExchange(running, TRUE, TRUE) != FALSE) {
+		DWORD now = GetTickCount();
+		uint64_t due = (uint64_t)rate * (now - start) / 1000;
+
+		for (; nb_written < due; nb_written++) {
+			SmemLogRecord record;
+			SmemReadResult result;
+			synth.base.read(&synth.base, &record, 1, &result);
+			write_record(&area->logs[index], &record);
+			// The records of an event stay in the same log
+			if (synth_event_start(&synth) && ++index > last_index) index = first_index;
+		}
+
+		if (now - last_report >= SHM_REPORT_PERIOD) {
+			printf("%llu records written, %.0f records/s\n", (unsigned long long)nb_written,
+				(double)(nb_written - last_written) * 1000.0 / (double)(now - last_report));
+			last_written = nb_written;
+			last_report = now;
+		}
+		Sleep(1);
+	}
+
+	UnmapViewOfFile(area);
+	CloseHandle(mapping);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#define SMEM_SHM_NAME L"Local\\Wp81SmemLogEmulated"
+#define SMEM_SHM_MAGIC 0x4C454D53       // "SMEL"
+#define SMEM_SHM_LOGS 2                 // Log indexes 0 and 1
+#define SMEM_SHM_RECORDS 2048           // Records of a log, a power of 2 close to the 2000 of an SMEM log
+#define SMEM_SHM_MAX_READ 5             // Records of a read, as the device
+
+/**
+* @brief Circular log of records in shared memory, written by a single producer.
+*
+* The producer writes a record in the slot of its index modulo SMEM_SHM_RECORDS,
+* then publishes it by incrementing written: the records older than the last
+* SMEM_SHM_RECORDS are overwritten, whether they were read or not.
+*/
+typedef struct {
+	volatile LONG written;      // Records written since the log was created, wraps modulo 2^32
+	SmemLogRecord records[SMEM_SHM_RECORDS];
+} SmemShmLog;
+
+/**
+* @brief Shared memory of the emulated SMEM logs.
+*/
+typedef struct {
+	volatile LONG magic;        // SMEM_SHM_MAGIC once the logs are ready
+	uint32_t nb_records;        // SMEM_SHM_RECORDS
+	SmemShmLog logs[SMEM_SHM_LOGS];
+} SmemShmArea;
+
+/**
+* @brief Log index of the emulated SMEM logs, read as SmemReadLogEvents reads a real one.
+*/
+typedef struct {
+	SmemRecordSource base;
+	uint32_t log_index;
+	HANDLE mapping;
+	SmemShmArea *area;
+	uint32_t next;              // Index of the next record to read
+} SmemShmSource;
+
+/**
+* @brief Initializes the source of a log index of the emulated logs, opened by start.
+*
+* @param source The source.
+* @param log_index The log read (0 or 1).
+*/
+void shm_source_init(SmemShmSource *source, uint32_t log_index);
+
+/**
+* @brief Creates the emulated logs and writes generated records into them until *running turns FALSE.
+*
+* The records are the ones of a synthetic source (see SmemSynthSource), paced
+* every millisecond to keep to the rate. The rate reached is printed every second.
+*
+* @param rate Records per second.
+* @param config The workload; its rate sets the timestamps, not the pace.
+* @param first_index First log written.
+* @param last_index Last log written, the events go to the logs in turn.
+* @param running Flag cleared to stop (Ctrl-C).
+* @return EXIT_SUCCESS, or EXIT_FAILURE when the shared memory cannot be created.
+*/
+int shm_produce(uint32_t rate, const SmemSynthConfig *config, uint32_t first_index, uint32_t last_index, volatile LONG *running);
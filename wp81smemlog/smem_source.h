@@ -0,0 +1,28 @@
+#pragma once
+
+/**
+* @brief Outcome of a read of a record source, as returned by IOCTL_MYDRV_READ_LOG_EVENTS.
+*/
+typedef struct {
+	uint32_t nb_dropped;        // Records overwritten in the log before they could be read
+	uint32_t nb_available;      // Records left in the log after this read
+	uint32_t nb_read;           // Records copied
+} SmemReadResult;
+
+typedef struct SmemRecordSource SmemRecordSource;
+
+/**
+* @brief Live records, read a few at a time as the log fills.
+*
+* A source is started before its first read and stopped after its last one.
+*/
+struct SmemRecordSource {
+	// Prepares the log for reading, as the get-functions and init IOCTLs do; FALSE when it cannot be read
+	bool (*start)(SmemRecordSource *source, bool verbose);
+	// Copies at most max_records records, which may be none; FALSE on a read error or at the end of a finite source
+	bool (*read)(SmemRecordSource *source, SmemLogRecord *records, uint32_t max_records, SmemReadResult *result);
+	// Releases what start took
+	void (*stop)(SmemRecordSource *source);
+	uint32_t max_read;          // Records of a read, at most
+	bool failed;                // Set on a read error
+};
@@ -0,0 +1,192 @@
+#include "stdafx.h"
+#include "smem_parse.h"
+#include "smem_chunk.h"
+#include "smem_input.h"
+#include "smem_stats.h"
+
+#define STATS_EVENT_MASK 0x0FFFFFFF   // Event base and event of an id
+#define STATS_USED_SLOT 0x80000000
+
+void stats_init(SmemStats *stats, uint32_t clock_rate)
+{
+	memset(stats, 0, sizeof(*stats));
+	timebase_init(&stats->timebase, clock_rate);
+}
+
+static void count_event(SmemStats *stats, uint32_t id)
+{
+	uint32_t key = (id & STATS_EVENT_MASK) | STATS_USED_SLOT;
+	unsigned int slot = (key * 2654435761u) >> 20;
+
+	// Linear probing, SMEM_STATS_EVENT_SLOTS is 2^12
+	while (stats->events[slot].key != key) {
+		if (stats->events[slot].key == 0) {
+			if (stats->nb_events >= SMEM_STATS_EVENT_SLOTS / 4 * 3) {
+				stats->nb_other_events++;
+				return;
+			}
+			stats->events[slot].key = key;
+			stats->nb_events++;
+			break;
+		}
+		slot = (slot + 1) & (SMEM_STATS_EVENT_SLOTS - 1);
+	}
+	stats->events[slot].count++;
+}
+
+void stats_add(SmemStats *stats, const SmemLogRecord *records, size_t nb_records, uint32_t nb_dropped)
+{
+	stats->nb_dropped += nb_dropped;
+
+	for (size_t i = 0; i < nb_records; i++) {
+		const SmemLogRecord *rec = &records[i];
+		uint32_t id = rec->id;
+		if (id == 0) {
+			stats->nb_empty++;
+			continue;
+		}
+
+		uint64_t time = timebase_extend(&stats->timebase, rec->timestamp);
+		if (!stats->has_time) {
+			stats->has_time = TRUE;
+			stats->first_time = time;
+			stats->min_gap = INT64_MAX;
+			stats->max_gap = INT64_MIN;
+		}
+		else {
+			int64_t gap = (int64_t)(time - stats->last_time);
+			if (gap < stats->min_gap) stats->min_gap = gap;
+			if (gap > stats->max_gap) stats->max_gap = gap;
+		}
+		stats->last_time = time;
+
+		stats->nb_records++;
+		stats->proc[id >> 30]++;
+		stats->base[(id >> 16) & 0xFFF]++;
+		if ((id & CONTINUE_MASK) != 0) {
+			stats->nb_continuations++;
+			continue;
+		}
+		count_event(stats, id);
+
+		SmemRouterMessage msg;
+		if (router_message(rec, &msg)) {
+			stats->router_type[msg.type]++;
+			stats->router_bytes[msg.type] += msg.size;
+			if (msg.conf_rx) stats->router_conf_rx++;
+		}
+	}
+}
+
+// Count per second of record timestamps
+static double stats_rate(const SmemStats *stats, uint64_t count)
+{
+	uint64_t span = stats->has_time ? stats->last_time - stats->first_time : 0;
+	return span > 0 ? (double)count * stats->timebase.clock_rate / (double)span : 0.0;
+}
+
+// Most frequent first
+static int compare_events(const void *a, const void *b)
+{
+	uint64_t count_a = ((const SmemStatsEvent *)a)->count;
+	uint64_t count_b = ((const SmemStatsEvent *)b)->count;
+	return count_a < count_b ? 1 : count_a > count_b ? -1 : 0;
+}
+
+void stats_print(const SmemStats *stats)
+{
+	printf("Records: %llu, %llu continuations, %llu empty, %llu dropped\n",
+		(unsigned long long)stats->nb_records, (unsigned long long)stats->nb_continuations,
+		(unsigned long long)stats->nb_empty, (unsigned long long)stats->nb_dropped);
+	if (!stats->has_time) {
+		return;
+	}
+	uint64_t span = stats->last_time - stats->first_time;
+	printf("Time: %.4f s, %.1f records/s, gaps from %lld to %lld ticks\n",
+		(double)span / stats->timebase.clock_rate, stats_rate(stats, stats->nb_records),
+		(long long)(stats->nb_records > 1 ? stats->min_gap : 0), (long long)(stats->nb_records > 1 ? stats->max_gap : 0));
+
+	printf("\n%-24s %12s %12s\n", "processor", "records", "records/s");
+	for (uint32_t p = 0; p < 4; p++) {
+		if (stats->proc[p] > 0) {
+			printf("%-24s %12llu %12.1f\n", proc_name(p << 30), (unsigned long long)stats->proc[p], stats_rate(stats, stats->proc[p]));
+		}
+	}
+
+	printf("\n%-24s %12s %12s\n", "base", "records", "records/s");
+	for (uint32_t b = 0; b < _countof(stats->base); b++) {
+		if (stats->base[b] > 0) {
+			printf("0x%03x %-18s %12llu %12.1f\n", b, find_decoder(b << 16)->name,
+				(unsigned long long)stats->base[b], stats_rate(stats, stats->base[b]));
+		}
+	}
+
+	SmemStatsEvent *events = (SmemStatsEvent *)malloc(SMEM_STATS_EVENT_SLOTS * sizeof(SmemStatsEvent));
+	if (events != NULL) {
+		unsigned int nb_events = 0;
+		for (unsigned int e = 0; e < SMEM_STATS_EVENT_SLOTS; e++) {
+			if (stats->events[e].key != 0) {
+				events[nb_events++] = stats->events[e];
+			}
+		}
+		qsort(events, nb_events, sizeof(SmemStatsEvent), compare_events);
+
+		printf("\n%-24s %12s %12s\n", "event", "events", "events/s");
+		uint64_t nb_other = stats->nb_other_events;
+		for (unsigned int e = 0; e < nb_events; e++) {
+			if (e >= SMEM_STATS_TOP_EVENTS) {
+				nb_other += events[e].count;
+				continue;
+			}
+			uint32_t id = events[e].key & STATS_EVENT_MASK;
+			const SmemLogDecoder *dec = find_decoder(id);
+			uint32_t event = id & 0xFFFF;
+			printf("%-8s 0x%04x %-8s %12llu %12.1f\n", dec->name, event, event < dec->table_size ? dec->table[event] : "",
+				(unsigned long long)events[e].count, stats_rate(stats, events[e].count));
+		}
+		if (nb_other > 0) {
+			printf("%-24s %12llu %12.1f\n", "others", (unsigned long long)nb_other, stats_rate(stats, nb_other));
+		}
+		free(events);
+	}
+
+	bool has_router = FALSE;
+	for (unsigned int t = 0; t < _countof(stats->router_type); t++) {
+		if (stats->router_type[t] == 0) {
+			continue;
+		}
+		if (!has_router) {
+			printf("\n%-24s %12s %12s %12s\n", "IPC Router message", "messages", "messages/s", "bytes/s");
+			has_router = TRUE;
+		}
+		printf("%-24s %12llu %12.1f %12.1f\n", router_type_name(t), (unsigned long long)stats->router_type[t],
+			stats_rate(stats, stats->router_type[t]), stats_rate(stats, stats->router_bytes[t]));
+	}
+	if (has_router) {
+		printf("%-24s %12llu\n", "*CONF_RX*", (unsigned long long)stats->router_conf_rx);
+	}
+}
+
+static bool add_records(void *context, const SmemLogRecord *records, size_t nb_records, uint32_t nb_dropped)
+{
+	stats_add((SmemStats *)context, records, nb_records, nb_dropped);
+	return TRUE;
+}
+
+int stats_file(const char *path, unsigned int nb_jobs, uint32_t clock_rate)
+{
+	SmemStats *stats = (SmemStats *)malloc(sizeof(SmemStats));
+
+	if (stats == NULL) {
+		fprintf(stderr, "Not enough memory for the counters\n");
+		return EXIT_FAILURE;
+	}
+	stats_init(stats, input_clock_rate(path, clock_rate));
+
+	int status = read_input_file(path, nb_jobs, add_records, stats);
+
+	// The records counted before an error are reported
+	stats_print(stats);
+	free(stats);
+	return status;
+}
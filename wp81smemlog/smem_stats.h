@@ -0,0 +1,74 @@
+#pragma once
+
+#define SMEM_STATS_EVENT_SLOTS 4096     // Hash table of the events, at most 3/4 used
+#define SMEM_STATS_TOP_EVENTS 20        // Events listed in a summary, the most frequent
+#define SMEM_STATS_PERIOD 10000         // Milliseconds between two summaries of a live session
+
+/**
+* @brief Count of the first records of one event: id without the processor and continuation flags.
+*/
+typedef struct {
+	uint32_t key;           // id & 0x0FFFFFFF with the top bit set, 0 for a free slot
+	uint64_t count;
+} SmemStatsEvent;
+
+/**
+* @brief Counters of a stream of records, updated without decoding them to text.
+*/
+typedef struct {
+	uint64_t nb_records;            // Records with an id
+	uint64_t nb_continuations;      // Records with an id continuing the previous one
+	uint64_t nb_empty;              // Records with id 0, skipped by print_event
+	uint64_t nb_dropped;            // Records lost by the driver
+	uint64_t proc[4];               // Records of each processor, indexed by id >> 30
+	uint64_t base[0x1000];          // Records of each event base, indexed by (id & BASE_MASK) >> 16
+	SmemStatsEvent events[SMEM_STATS_EVENT_SLOTS];
+	unsigned int nb_events;
+	uint64_t nb_other_events;       // First records not counted by event, the table is full
+	uint64_t router_type[256];      // IPC Router TX and RX data messages of each type (see router_message)
+	uint64_t router_bytes[256];     // Length of these messages
+	uint64_t router_conf_rx;        // Messages requesting a confirmation of reception
+	SmemTimebase timebase;
+	bool has_time;                  // FALSE until a record with an id
+	uint64_t first_time;            // Extended timestamp of the first record with an id
+	uint64_t last_time;             // Extended timestamp of the last record with an id
+	int64_t min_gap;                // Smallest difference between the timestamps of two consecutive records, may be negative
+	int64_t max_gap;
+} SmemStats;
+
+/**
+* @brief Initializes the counters.
+*
+* @param stats The counters.
+* @param clock_rate Ticks per second of the record timestamps.
+*/
+void stats_init(SmemStats *stats, uint32_t clock_rate);
+
+/**
+* @brief Counts records: a few increments per record, no text is formatted.
+*
+* @param stats The counters.
+* @param records The records.
+* @param nb_records Number of records.
+* @param nb_dropped Records lost before these ones.
+*/
+void stats_add(SmemStats *stats, const SmemLogRecord *records, size_t nb_records, uint32_t nb_dropped);
+
+/**
+* @brief Prints the counters and the rates per processor, event base and event, and the IPC Router messages.
+*
+* The rates are per second of record timestamps, from the first to the last record.
+*
+* @param stats The counters.
+*/
+void stats_print(const SmemStats *stats);
+
+/**
+* @brief Counts the records of a raw dump, capture or archive file and prints the summary.
+*
+* @param path The file.
+* @param nb_jobs Threads parsing a raw dump or an archive.
+* @param clock_rate Ticks per second of the timestamps of a raw dump, the other files have theirs.
+* @return EXIT_SUCCESS, or EXIT_FAILURE if the file cannot be read.
+*/
+int stats_file(const char *path, unsigned int nb_jobs, uint32_t clock_rate);
@@ -0,0 +1,375 @@
+#include "stdafx.h"
+#include "smem_source.h"
+#include "smem_synth.h"
+
+#define SYNTH_MAX_READ 64           // Records of a read, at most
+#define SYNTH_CONTINUE 0x10000000   // Flag of a continuation record
+
+static const char *SYNTH_KIND_NAMES[SMEM_SYNTH_KINDS] = { "qcci", "qcsi", "data", "control", "rpc", "tmc", "timetick" };
+static const char *SYNTH_PROC_NAMES[4] = { "modm", "qdsp", "apps", "wcns" };
+
+// Services and messages of the QMI transactions
+static const uint32_t SYNTH_QMI_SERVICES[] = { 0x01, 0x02, 0x03, 0x0B, 0x10, 0x22, 0x2A, 0x31 };
+static const uint32_t SYNTH_QMI_MESSAGES[] = { 0x0020, 0x0021, 0x0022, 0x0024, 0x002E, 0x0030, 0x5556 };
+
+// Interfaces and tasks of the IPC Router continuation records, 4 characters each
+static const uint32_t SYNTH_ROUTER_IFACES[] = { 0x30727472, 0x30646D73, 0x31646D73 };  // "rtr0", "smd0", "smd1"
+static const uint32_t SYNTH_ROUTER_TASKS[] = { 0x6B736174, 0x30736471, 0x6E6C7772 };   // "task", "qds0", "rwln"
+
+void synth_config_init(SmemSynthConfig *config, uint32_t clock_rate)
+{
+	static const uint32_t WEIGHTS[SMEM_SYNTH_KINDS] = { 3, 2, 4, 1, 1, 1, 2 };
+	static const uint32_t PROC_WEIGHTS[4] = { 3, 2, 4, 1 };
+
+	memcpy(config->weights, WEIGHTS, sizeof(WEIGHTS));
+	memcpy(config->proc_weights, PROC_WEIGHTS, sizeof(PROC_WEIGHTS));
+	config->rate = 2000;
+	config->burst = 0;
+	config->idle = 0;
+	config->latency = 500;
+	config->clock_rate = clock_rate;
+	config->seed = 1;
+}
+
+// Setting of a name, NULL if there is none
+static uint32_t *find_setting(SmemSynthConfig *config, const char *name, size_t length)
+{
+	static const struct {
+		const char *name;
+		size_t offset;
+	} SETTINGS[] = {
+		{ "rate", offsetof(SmemSynthConfig, rate) },
+		{ "burst", offsetof(SmemSynthConfig, burst) },
+		{ "idle", offsetof(SmemSynthConfig, idle) },
+		{ "latency", offsetof(SmemSynthConfig, latency) },
+		{ "seed", offsetof(SmemSynthConfig, seed) }
+	};
+
+	for (unsigned int k = 0; k < SMEM_SYNTH_KINDS; k++) {
+		if (strlen(SYNTH_KIND_NAMES[k]) == length && strncmp(SYNTH_KIND_NAMES[k], name, length) == 0) return &config->weights[k];
+	}
+	for (unsigned int p = 0; p < 4; p++) {
+		if (strlen(SYNTH_PROC_NAMES[p]) == length && strncmp(SYNTH_PROC_NAMES[p], name, length) == 0) return &config->proc_weights[p];
+	}
+	for (unsigned int s = 0; s < _countof(SETTINGS); s++) {
+		if (strlen(SETTINGS[s].name) == length && strncmp(SETTINGS[s].name, name, length) == 0) {
+			return (uint32_t *)((char *)config + SETTINGS[s].offset);
+		}
+	}
+	return NULL;
+}
+
+bool synth_config_parse(SmemSynthConfig *config, const char *text)
+{
+	const char *p = text;
+
+	while (*p != '\0') {
+		const char *name = p;
+		while (*p != '\0' && *p != '=' && *p != ',') p++;
+		uint32_t *setting = find_setting(config, name, p - name);
+		if (setting == NULL || *p != '=') {
+			fprintf(stderr, "Invalid workload \"%s\": unknown setting at column %u\n", text, (unsigned int)(name - text) + 1);
+			return FALSE;
+		}
+		p++;
+		char *end;
+		unsigned long value = strtoul(p, &end, 0);
+		if (end == p || (*end != '\0' && *end != ',')) {
+			fprintf(stderr, "Invalid workload \"%s\": number expected at column %u\n", text, (unsigned int)(p - text) + 1);
+			return FALSE;
+		}
+		*setting = (uint32_t)value;
+		p = *end == ',' ? end + 1 : end;
+	}
+
+	uint32_t weight_sum = 0;
+	uint32_t proc_weight_sum = 0;
+	for (unsigned int k = 0; k < SMEM_SYNTH_KINDS; k++) weight_sum += config->weights[k];
+	for (unsigned int q = 0; q < 4; q++) proc_weight_sum += config->proc_weights[q];
+	if (weight_sum == 0 || proc_weight_sum == 0 || config->rate == 0) {
+		fprintf(stderr, "Invalid workload \"%s\": no event, no processor or no rate\n", text);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+// 15 pseudo-random bits
+static uint32_t next_random(SmemSynthSource *synth)
+{
+	synth->lcg = synth->lcg * 1103515245 + 12345;
+	return (synth->lcg >> 16) & 0x7FFF;
+}
+
+// Pseudo-random number below limit, up to 2^30
+static uint32_t draw(SmemSynthSource *synth, uint32_t limit)
+{
+	uint32_t r = next_random(synth) << 15 | next_random(synth);
+	return limit > 0 ? r % limit : 0;
+}
+
+// Index of an entry drawn with the given weights
+static unsigned int draw_weighted(SmemSynthSource *synth, const uint32_t *weights, uint32_t weight_sum)
+{
+	uint32_t r = draw(synth, weight_sum);
+	unsigned int i = 0;
+
+	while (r >= weights[i]) {
+		r -= weights[i];
+		i++;
+	}
+	return i;
+}
+
+// Processor flag of the id of a record
+static uint32_t draw_proc(SmemSynthSource *synth)
+{
+	return (uint32_t)draw_weighted(synth, synth->config.proc_weights, synth->proc_weight_sum) << 30;
+}
+
+// Another processor when the workload has one, for the RX of a TX
+static uint32_t draw_other_proc(SmemSynthSource *synth, uint32_t proc)
+{
+	for (unsigned int tries = 0; tries < 8; tries++) {
+		uint32_t other = draw_proc(synth);
+		if (other != proc) return other;
+	}
+	return proc;
+}
+
+// Ticks from a request to its response, from half to one and a half times the latency
+static uint64_t draw_latency(SmemSynthSource *synth)
+{
+	uint64_t latency_us = synth->config.latency / 2 + draw(synth, synth->config.latency + 1);
+	return latency_us * synth->config.clock_rate / 1000000;
+}
+
+static void set_record(SmemLogRecord *rec, uint32_t id, uint32_t d1, uint32_t d2, uint32_t d3)
+{
+	rec->id = id;
+	rec->timestamp = 0;
+	rec->d1 = d1;
+	rec->d2 = d2;
+	rec->d3 = d3;
+}
+
+// Event due later, NULL when too many are waiting
+static SmemSynthEvent *add_pending(SmemSynthSource *synth, uint64_t time)
+{
+	if (synth->nb_pending == SMEM_SYNTH_MAX_PENDING) {
+		return NULL;
+	}
+	SmemSynthEvent *ev = &synth->pending[synth->nb_pending++];
+	ev->time = time;
+	return ev;
+}
+
+// QMI TX or RX: the transaction, then the address of the other end
+static void set_qmi_event(SmemSynthEvent *ev, uint32_t id, uint32_t cntl, uint32_t txn, uint32_t msg, uint32_t len, uint32_t svc, uint32_t node, uint32_t port)
+{
+	set_record(&ev->records[0], id, cntl << 16 | txn, msg << 16 | len, svc);
+	set_record(&ev->records[1], id | SYNTH_CONTINUE, node, port, 0);
+	ev->nb_records = 2;
+}
+
+// Request and response of a QMI client (QCCI) or service (QCSI), or an indication to a client
+static void make_qmi(SmemSynthSource *synth, SmemSynthEvent *ev, bool client)
+{
+	uint32_t proc = draw_proc(synth);
+	uint32_t base = client ? 0x000E0000 : 0x000F0000;
+	uint32_t svc = SYNTH_QMI_SERVICES[draw(synth, _countof(SYNTH_QMI_SERVICES))];
+	uint32_t msg = SYNTH_QMI_MESSAGES[draw(synth, _countof(SYNTH_QMI_MESSAGES))];
+	uint32_t node = draw(synth, 4);
+	uint32_t port = 1 + draw(synth, 64);
+
+	if (client && draw(synth, 8) == 0) {
+		// RX IND
+		set_qmi_event(ev, proc | base | 0x5, 4, 0, msg, 4 + draw(synth, 64), svc, node, port);
+		return;
+	}
+
+	synth->txn = (synth->txn + 1) & 0xFFFF;
+	// A client sends the request (TX) and receives the response (RX), a service the other way round
+	uint32_t request = client ? 0x4 : 0x5;
+	uint32_t response = client ? 0x5 : 0x4;
+	set_qmi_event(ev, proc | base | request, 0, synth->txn, msg, 7 + draw(synth, 256), svc, node, port);
+
+	SmemSynthEvent *resp = add_pending(synth, ev->time + draw_latency(synth));
+	if (resp != NULL) {
+		set_qmi_event(resp, proc | base | response, 2, synth->txn, msg, 7 + draw(synth, 64), svc, node, port);
+	}
+}
+
+// Router records of a DATA message on a processor
+static void set_data_event(SmemSynthSource *synth, SmemSynthEvent *ev, uint32_t id, uint32_t src, uint32_t dst, uint32_t d3, uint32_t iface)
+{
+	set_record(&ev->records[0], id, src, dst, d3);
+	set_record(&ev->records[1], id | SYNTH_CONTINUE, iface, draw(synth, 0x10000),
+		SYNTH_ROUTER_TASKS[draw(synth, _countof(SYNTH_ROUTER_TASKS))]);
+	ev->nb_records = 2;
+}
+
+// DATA message, TX on the processor of the source then RX on the one of the destination
+static void make_data(SmemSynthSource *synth, SmemSynthEvent *ev)
+{
+	uint32_t proc = draw_proc(synth);
+	uint32_t other = draw_other_proc(synth, proc);
+	uint32_t src = ((proc >> 30) + 1) << 24 | (0x4000 + draw(synth, 8));
+	uint32_t dst = ((other >> 30) + 1) << 24 | (0x4000 + draw(synth, 8));
+	uint32_t conf_rx = draw(synth, 16) == 0 ? 1 : 0;
+	uint32_t d3 = 1 << 24 | conf_rx << 16 | (16 + draw(synth, 1500));
+	uint32_t iface = SYNTH_ROUTER_IFACES[draw(synth, _countof(SYNTH_ROUTER_IFACES))];
+
+	set_data_event(synth, ev, proc | 0x000D0001, src, dst, d3, iface);
+
+	SmemSynthEvent *rx = add_pending(synth, ev->time + draw_latency(synth));
+	if (rx != NULL) {
+		set_data_event(synth, rx, other | 0x000D0002, src, dst, d3, iface);
+	}
+}
+
+// NEW_SERVER, REMOVE_SERVER, REMOVE_CLIENT or RESUME_TX, in one record
+static void make_control(SmemSynthSource *synth, SmemSynthEvent *ev)
+{
+	uint32_t proc = draw_proc(synth);
+	uint32_t cntl_type = 4 + draw(synth, 4);
+	uint32_t addr = ((proc >> 30) + 1) << 24 | (0x4000 + draw(synth, 8));
+
+	if (cntl_type <= 5) {
+		// Server: address, service, instance
+		set_record(&ev->records[0], proc | 0x000D0001 | cntl_type << 8, addr,
+			SYNTH_QMI_SERVICES[draw(synth, _countof(SYNTH_QMI_SERVICES))], 1 + draw(synth, 4));
+	}
+	else {
+		// Client: node, port
+		set_record(&ev->records[0], proc | 0x000D0001 | cntl_type << 8, addr >> 24, addr & 0xFFFFFF, 0);
+	}
+	ev->nb_records = 1;
+}
+
+// READ, WRITTEN, CNF REQ, CNF SNT or PING of the RPC router
+static void make_rpc(SmemSynthSource *synth, SmemSynthEvent *ev)
+{
+	static const uint32_t EVENTS[] = { 1, 2, 3, 4, 8 };
+
+	set_record(&ev->records[0], draw_proc(synth) | 0x00090000 | EVENTS[draw(synth, _countof(EVENTS))],
+		draw(synth, 0x10000000), 0x30000000 | draw(synth, 0x100), draw(synth, 0x10000));
+	ev->nb_records = 1;
+}
+
+// One record of the task controller or of the timetick
+static void make_simple(SmemSynthSource *synth, SmemSynthEvent *ev, uint32_t base)
+{
+	set_record(&ev->records[0], draw_proc(synth) | base | draw(synth, 3),
+		(uint32_t)(ev->time / 32), draw(synth, 0x100), draw(synth, 0x10000));
+	ev->nb_records = 1;
+}
+
+// Time of the next new event: a gap of the rate on average, and the idle time after a burst
+static void advance_time(SmemSynthSource *synth)
+{
+	const SmemSynthConfig *config = &synth->config;
+
+	synth->next_time += (uint64_t)config->clock_rate * draw(synth, 2001) / (1000ull * config->rate);
+	if (config->burst > 0 && ++synth->nb_burst >= config->burst) {
+		synth->nb_burst = 0;
+		synth->next_time += (uint64_t)config->clock_rate * config->idle / 1000;
+	}
+}
+
+// Makes the current event: the oldest one pending if it is due before the next new one
+static void next_event(SmemSynthSource *synth)
+{
+	unsigned int oldest = 0;
+
+	for (unsigned int p = 1; p < synth->nb_pending; p++) {
+		if (synth->pending[p].time < synth->pending[oldest].time) oldest = p;
+	}
+	// A full list holds the new events back, the timestamps never decrease
+	if (synth->nb_pending > 0 && (synth->pending[oldest].time <= synth->next_time || synth->nb_pending == SMEM_SYNTH_MAX_PENDING)) {
+		synth->current = synth->pending[oldest];
+		synth->pending[oldest] = synth->pending[--synth->nb_pending];
+		if (synth->current.time > synth->next_time) synth->next_time = synth->current.time;
+	}
+	else {
+		SmemSynthEvent *ev = &synth->current;
+		ev->time = synth->next_time;
+		switch (draw_weighted(synth, synth->config.weights, synth->weight_sum)) {
+		case SMEM_SYNTH_QCCI: make_qmi(synth, ev, TRUE); break;
+		case SMEM_SYNTH_QCSI: make_qmi(synth, ev, FALSE); break;
+		case SMEM_SYNTH_DATA: make_data(synth, ev); break;
+		case SMEM_SYNTH_CONTROL: make_control(synth, ev); break;
+		case SMEM_SYNTH_RPC: make_rpc(synth, ev); break;
+		case SMEM_SYNTH_TMC: make_simple(synth, ev, 0x00030000); break;
+		default: make_simple(synth, ev, 0x00040000); break;
+		}
+		advance_time(synth);
+	}
+
+	for (unsigned int r = 0; r < synth->current.nb_records; r++) {
+		synth->current.records[r].timestamp = (uint32_t)synth->current.time;
+	}
+	synth->record = 0;
+}
+
+static bool start_synth(SmemRecordSource *source, bool verbose)
+{
+	return TRUE;
+}
+
+static void stop_synth(SmemRecordSource *source)
+{
+}
+
+static bool read_synth(SmemRecordSource *source, SmemLogRecord *records, uint32_t max_records, SmemReadResult *result)
+{
+	SmemSynthSource *synth = (SmemSynthSource *)source;
+	uint64_t left = synth->nb_records - synth->next;
+
+	if (left == 0) {
+		return FALSE;
+	}
+	if (max_records > left) max_records = (uint32_t)left;
+	if (max_records > SYNTH_MAX_READ) max_records = SYNTH_MAX_READ;
+
+	for (uint32_t r = 0; r < max_records; r++) {
+		if (synth->record == synth->current.nb_records) {
+			next_event(synth);
+		}
+		records[r] = synth->current.records[synth->record++];
+	}
+	synth->next += max_records;
+
+	result->nb_dropped = 0;
+	result->nb_read = max_records;
+	left -= max_records;
+	result->nb_available = left < 0xFFFFFFFF ? (uint32_t)left : 0xFFFFFFFF;
+	return TRUE;
+}
+
+void synth_source_init(SmemSynthSource *source, uint64_t nb_records, const SmemSynthConfig *config)
+{
+	source->base.start = start_synth;
+	source->base.read = read_synth;
+	source->base.stop = stop_synth;
+	source->base.max_read = SYNTH_MAX_READ;
+	source->base.failed = FALSE;
+	source->config = *config;
+	source->nb_records = nb_records;
+	source->next = 0;
+	source->lcg = config->seed;
+	source->weight_sum = 0;
+	source->proc_weight_sum = 0;
+	for (unsigned int k = 0; k < SMEM_SYNTH_KINDS; k++) source->weight_sum += config->weights[k];
+	for (unsigned int p = 0; p < 4; p++) source->proc_weight_sum += config->proc_weights[p];
+	source->next_time = 0xFFFF0000;  // The timestamps wrap early in the stream
+	source->nb_burst = 0;
+	source->txn = 0;
+	source->current.nb_records = 0;
+	source->record = 0;
+	source->nb_pending = 0;
+}
+
+bool synth_event_start(const SmemSynthSource *source)
+{
+	return source->record == source->current.nb_records;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#define SMEM_SYNTH_MAX_PENDING 64       // Responses waiting for their time, at most
+
+/**
+* @brief Kinds of generated events.
+*/
+typedef enum {
+	SMEM_SYNTH_QCCI,            // QMI client request and response, or indication
+	SMEM_SYNTH_QCSI,            // QMI service request and response
+	SMEM_SYNTH_DATA,            // IPC Router DATA message, TX then RX on another processor
+	SMEM_SYNTH_CONTROL,         // IPC Router control message
+	SMEM_SYNTH_RPC,             // ONCRPC router record
+	SMEM_SYNTH_TMC,
+	SMEM_SYNTH_TIMETICK,
+	SMEM_SYNTH_KINDS
+} SmemSynthKind;
+
+/**
+* @brief Workload of a synthetic source.
+*/
+typedef struct {
+	uint32_t weights[SMEM_SYNTH_KINDS];     // Share of each kind of event
+	uint32_t proc_weights[4];   // Share of each processor, by processor flag: MODM, QDSP, APPS, WCNS
+	uint32_t rate;              // Events per second, within a burst
+	uint32_t burst;             // Events of a burst, 0 for a steady rate
+	uint32_t idle;              // Milliseconds between two bursts
+	uint32_t latency;           // Microseconds from a request to its response or a TX to its RX, on average
+	uint32_t clock_rate;        // Ticks per second of the timestamps
+	uint32_t seed;
+} SmemSynthConfig;
+
+/**
+* @brief Event of a generated stream, due at a time.
+*/
+typedef struct {
+	uint64_t time;              // Ticks
+	SmemLogRecord records[SMEM_LOG_EVENT_RECORDS];
+	unsigned int nb_records;
+} SmemSynthEvent;
+
+/**
+* @brief Finite stream of generated records, a record source which needs no device.
+*
+* The events are drawn with the weights of the configuration, each on a processor
+* drawn the same way. A request is followed by its response and a TX by its RX
+* after a latency, with the transaction ids, message ids, services, addresses and
+* sizes the trackers of --qmi and --router match. The records of an event follow
+* each other and the timestamps never decrease; they wrap during a long stream.
+* The same configuration gives the same records.
+*/
+typedef struct {
+	SmemRecordSource base;
+	SmemSynthConfig config;
+	uint64_t nb_records;        // Records of the stream
+	uint64_t next;              // Records already read
+	uint32_t lcg;               // State of the generator
+	uint32_t weight_sum;
+	uint32_t proc_weight_sum;
+	uint64_t next_time;         // Time of the next new event
+	uint32_t nb_burst;          // Events of the current burst
+	uint32_t txn;               // Last QMI transaction id
+	SmemSynthEvent current;     // Event being read
+	unsigned int record;        // Next record of that event, nb_records to make a new event
+	SmemSynthEvent pending[SMEM_SYNTH_MAX_PENDING];
+	unsigned int nb_pending;
+} SmemSynthSource;
+
+/**
+* @brief Sets the default workload: a mix of all the kinds on all the processors, at 2000 events/s.
+*
+* @param config The workload.
+* @param clock_rate Ticks per second of the timestamps.
+*/
+void synth_config_init(SmemSynthConfig *config, uint32_t clock_rate);
+
+/**
+* @brief Changes a workload with a comma separated list of name=value.
+*
+* The weights of the kinds are qcci, qcsi, data, control, rpc, tmc and timetick,
+* the ones of the processors modm, qdsp, apps and wcns; then rate, burst, idle,
+* latency and seed, e.g. "qcci=5,data=2,tmc=0,apps=1,modm=1,qdsp=0,wcns=0,burst=100,idle=500".
+*
+* @param config The workload.
+* @param text The list.
+* @return FALSE if the list is invalid, the error is printed on stderr.
+*/
+bool synth_config_parse(SmemSynthConfig *config, const char *text);
+
+/**
+* @brief Initializes a stream of generated records.
+*
+* @param source The source.
+* @param nb_records Records of the stream, at the end a read fails without setting failed.
+* @param config The workload, copied.
+*/
+void synth_source_init(SmemSynthSource *source, uint64_t nb_records, const SmemSynthConfig *config);
+
+/**
+* @brief Tells if the next record read starts an event.
+*
+* @param source The source.
+*/
+bool synth_event_start(const SmemSynthSource *source);
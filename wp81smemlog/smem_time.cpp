@@ -0,0 +1,106 @@
+#include "stdafx.h"
+
+void timebase_init(SmemTimebase *timebase, uint32_t clock_rate)
+{
+	timebase->clock_rate = clock_rate;
+	timebase->rate_shift = 0;
+	timebase->started = FALSE;
+	timebase->last = 0;
+
+	if (clock_rate > 1 && (clock_rate & (clock_rate - 1)) == 0) {
+		while ((1u << timebase->rate_shift) != clock_rate) {
+			timebase->rate_shift++;
+		}
+	}
+}
+
+uint64_t timebase_extend(SmemTimebase *timebase, uint32_t timestamp)
+{
+	if (!timebase->started) {
+		timebase->started = TRUE;
+		timebase->last = timestamp;
+	}
+	else {
+		// Signed distance modulo 2^32 to the previous timestamp
+		int32_t delta = (int32_t)(timestamp - (uint32_t)timebase->last);
+		if (delta < 0 && timebase->last < (uint64_t)(-(int64_t)delta)) {
+			// Never go below 0 at the start of a capture, the next records still follow the previous one
+			return 0;
+		}
+		timebase->last += (int64_t)delta;
+	}
+
+	return timebase->last;
+}
+
+void timebase_resume(SmemTimebase *timebase, uint64_t last)
+{
+	timebase->started = TRUE;
+	timebase->last = last;
+}
+
+void emit_seconds(SmemOutBuffer *out, const SmemTimebase *timebase, uint64_t ticks)
+{
+	uint64_t sec;
+	uint64_t scaled;
+	uint64_t micro;
+	uint64_t rem;
+	uint32_t rate = timebase->clock_rate;
+
+	if (rate == 0) {
+		// Fallback for division by zero (should not happen if constants are correct)
+		rate = 1;
+	}
+
+	if (timebase->rate_shift != 0) {
+		uint64_t mask = ((uint64_t)1 << timebase->rate_shift) - 1;
+		sec = ticks >> timebase->rate_shift;
+		scaled = (ticks & mask) * 1000000;
+		micro = scaled >> timebase->rate_shift;
+		rem = scaled & mask;
+	}
+	else {
+		sec = ticks / rate;
+		scaled = (ticks % rate) * 1000000;
+		micro = scaled / rate;
+		rem = scaled % rate;
+	}
+
+	// Round half away from zero, like the printf of the Visual Studio CRT
+	if (2 * rem >= rate) {
+		micro++;
+		if (micro == 1000000) {
+			micro = 0;
+			sec++;
+		}
+	}
+
+	// Built backwards: 6 decimals, the point, then the seconds
+	char tmp[32];
+	unsigned int len = 0;
+	uint32_t micro32 = (uint32_t)micro;
+	for (unsigned int i = 0; i < 6; i++) {
+		tmp[sizeof(tmp) - 1 - len++] = (char)('0' + micro32 % 10);
+		micro32 /= 10;
+	}
+	tmp[sizeof(tmp) - 1 - len++] = '.';
+	if (sec <= 0xFFFFFFFF) {
+		// 32-bit divisions are much cheaper on ARM
+		uint32_t sec32 = (uint32_t)sec;
+		do {
+			tmp[sizeof(tmp) - 1 - len++] = (char)('0' + sec32 % 10);
+			sec32 /= 10;
+		} while (sec32 != 0);
+	}
+	else {
+		do {
+			tmp[sizeof(tmp) - 1 - len++] = (char)('0' + sec % 10);
+			sec /= 10;
+		} while (sec != 0);
+	}
+	while (len < 14) {
+		tmp[sizeof(tmp) - 1 - len++] = ' ';
+	}
+
+	emit_mem(out, tmp + sizeof(tmp) - len, len);
+}
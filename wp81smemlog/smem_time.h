@@ -0,0 +1,66 @@
+#pragma once
+
+// Global variables defined in the Perl script for time conversion
+#define HT_TIMER_CLOCK_RATE 19200000 // HT Timer
+#define SLEEP_CLOCK_RATE 32768 // Sleep clock
+#define TIMESTAMP_CLOCK_RATE SLEEP_CLOCK_RATE // Windows phone 8.1
+
+/**
+* @brief Extension of the 32-bit record timestamps to a monotonic 64-bit tick count.
+*
+* The sleep clock counter wraps every 36 hours (and the HT timer every 223 seconds),
+* the timebase counts the wraps so that long captures keep increasing times.
+*/
+typedef struct {
+	uint32_t clock_rate;      // Ticks per second
+	unsigned int rate_shift;  // log2(clock_rate) when it is a power of two, 0 otherwise
+	bool started;             // FALSE until the first timestamp is extended
+	uint64_t last;            // Last extended timestamp
+} SmemTimebase;
+
+/**
+* @brief Initializes a timebase.
+*
+* @param timebase The timebase.
+* @param clock_rate Ticks per second of the record timestamps (SLEEP_CLOCK_RATE or HT_TIMER_CLOCK_RATE).
+*/
+void timebase_init(SmemTimebase *timebase, uint32_t clock_rate);
+
+/**
+* @brief Converts a 32-bit record timestamp to a 64-bit tick count.
+*
+* A timestamp is taken as the nearest value, forward or backward, of the previous one:
+* records slightly out of order between processors do not count as a wrap. The nearest
+* value is within 2^31 ticks, about 18 hours at the sleep clock but only 111 seconds at
+* the HT timer: two consecutive records further apart than that, as across a gap in a
+* capture, are placed a whole number of wraps too early or too late. A record older
+* than tick 0, at the start of a capture, is placed at 0 and the timebase is left as is.
+*
+* @param timebase The timebase.
+* @param timestamp The timestamp of the record.
+* @return The extended timestamp.
+*/
+uint64_t timebase_extend(SmemTimebase *timebase, uint32_t timestamp);
+
+/**
+* @brief Resumes the extension after a known extended timestamp.
+*
+* Used to decode a part of a capture when the extended timestamp of the
+* record preceding it is known.
+*
+* @param timebase The timebase.
+* @param last The extended timestamp of the previous record.
+*/
+void timebase_resume(SmemTimebase *timebase, uint64_t last);
+
+/**
+* @brief Prints a tick count as seconds, equivalent of printf("%14.6f", (double)ticks / clock_rate).
+*
+* Integer only: shift and mask when the clock rate is a power of two, integer division otherwise.
+* The microseconds are rounded half away from zero, as the printf of the Visual Studio CRT does.
+*
+* @param out The buffer receiving the text.
+* @param timebase The timebase giving the clock rate.
+* @param ticks The tick count.
+*/
+void emit_seconds(SmemOutBuffer *out, const SmemTimebase *timebase, uint64_t ticks);
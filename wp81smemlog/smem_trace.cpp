@@ -0,0 +1,253 @@
+#include "stdafx.h"
+#include "smem_parse.h"
+#include "smem_chunk.h"
+#include "smem_input.h"
+#include "smem_histo.h"
+#include "smem_qmi.h"
+#include "smem_router.h"
+#include "smem_trace.h"
+
+// Opens an event after the previous one, {"ph":"<phase>", once the buffered events are written if there are enough
+static void begin_event(SmemTraceWriter *writer, const char *phase)
+{
+	SmemOutBuffer *out = &writer->out;
+
+	if (out->size >= SMEM_TRACE_FLUSH) {
+		outbuf_flush(out, writer->stream);
+	}
+	emit_str(out, writer->nb_written++ == 0 ? "\n{\"ph\":\"" : ",\n{\"ph\":\"");
+	emit_str(out, phase);
+	emit_char(out, '"');
+}
+
+// "pid":<processor>,"tid":<thread>, the processes numbered from 1
+static void emit_track(SmemTraceWriter *writer, uint32_t proc, unsigned int tid)
+{
+	emit_str(&writer->out, ",\"pid\":");
+	emit_udec(&writer->out, (proc >> 30) + 1);
+	emit_str(&writer->out, ",\"tid\":");
+	emit_udec(&writer->out, tid);
+}
+
+// Microseconds since the first record, the unit of the trace, with 3 decimals
+static void emit_trace_time(SmemTraceWriter *writer, uint64_t time)
+{
+	SmemOutBuffer *out = &writer->out;
+	uint64_t rate = writer->timebase.clock_rate;
+	// A record of another processor may be a little older than the first one
+	uint64_t ticks = time > writer->first_time ? time - writer->first_time : 0;
+	uint64_t scaled = ticks % rate * 1000000;
+	uint32_t ns = (uint32_t)(scaled % rate * 1000 / rate);
+
+	emit_str(out, ",\"ts\":");
+	emit_udec64(out, ticks / rate * 1000000 + scaled / rate);
+	emit_char(out, '.');
+	emit_char(out, (char)('0' + ns / 100));
+	emit_char(out, (char)('0' + ns / 10 % 10));
+	emit_char(out, (char)('0' + ns % 10));
+}
+
+static void name_track(SmemTraceWriter *writer, const char *metadata, uint32_t proc, unsigned int tid, const char *name)
+{
+	SmemOutBuffer *out = &writer->out;
+
+	begin_event(writer, "M");
+	emit_str(out, ",\"name\":\"");
+	emit_str(out, metadata);
+	emit_char(out, '"');
+	emit_track(writer, proc, tid);
+	emit_str(out, ",\"args\":{\"name\":\"");
+	emit_str(out, name);
+	emit_str(out, "\"}}");
+}
+
+// Names the process of a processor and its threads, before its first event
+static void name_processor(SmemTraceWriter *writer, uint32_t proc)
+{
+	if (writer->named[proc >> 30]) {
+		return;
+	}
+	writer->named[proc >> 30] = TRUE;
+	name_track(writer, "process_name", proc, 0, proc_name(proc));
+	name_track(writer, "thread_name", proc, SMEM_TRACE_QMI_TID, "QMI");
+	name_track(writer, "thread_name", proc, SMEM_TRACE_ROUTER_TID, "IPC Router");
+	name_track(writer, "thread_name", proc, SMEM_TRACE_ERROR_TID, "Errors");
+}
+
+// Begin or end of an async span, without its arguments and the closing brace
+static void span_event(SmemTraceWriter *writer, const char *phase, const char *cat, const char *name, uint64_t id,
+	uint32_t proc, unsigned int tid, uint64_t time)
+{
+	SmemOutBuffer *out = &writer->out;
+
+	begin_event(writer, phase);
+	emit_str(out, ",\"cat\":\"");
+	emit_str(out, cat);
+	emit_str(out, "\",\"name\":\"");
+	emit_str(out, name);
+	emit_str(out, "\",\"id\":");
+	emit_udec64(out, id);
+	emit_track(writer, proc, tid);
+	emit_trace_time(writer, time);
+}
+
+static void qmi_span(void *context, const SmemQmiPending *request, uint64_t time)
+{
+	SmemTraceWriter *writer = (SmemTraceWriter *)context;
+	SmemOutBuffer *out = &writer->out;
+	uint64_t id = ++writer->nb_qmi_spans;
+	char name[32];
+
+	// Named as qmi_tracker_print names the service messages
+	_snprintf_s(name, sizeof(name), _TRUNCATE, "svc:0x%x msg:0x%x", request->svc_id, request->msg_id);
+	span_event(writer, "b", "qmi", name, id, request->proc, SMEM_TRACE_QMI_TID, request->time);
+	emit_str(out, ",\"args\":{\"svc_id\":");
+	emit_udec(out, request->svc_id);
+	emit_str(out, ",\"msg\":");
+	emit_udec(out, request->msg_id);
+	emit_str(out, ",\"txn\":");
+	emit_udec(out, request->txn);
+	emit_str(out, "}}");
+	span_event(writer, "e", "qmi", name, id, request->proc, SMEM_TRACE_QMI_TID, time);
+	emit_char(out, '}');
+}
+
+static void router_span(void *context, const SmemRouterPending *tx, const SmemRouterMessage *rx, uint64_t time)
+{
+	SmemTraceWriter *writer = (SmemTraceWriter *)context;
+	SmemOutBuffer *out = &writer->out;
+	uint64_t id = ++writer->nb_router_spans;
+	const char *name = router_type_name(tx->type);
+
+	span_event(writer, "b", "router", name, id, tx->proc, SMEM_TRACE_ROUTER_TID, tx->time);
+	emit_str(out, ",\"args\":{\"src_proc\":");
+	emit_udec(out, tx->src >> 24);
+	emit_str(out, ",\"src_port\":");
+	emit_udec(out, tx->src & 0xFFFFFF);
+	emit_str(out, ",\"dst_proc\":");
+	emit_udec(out, tx->dst >> 24);
+	emit_str(out, ",\"dst_port\":");
+	emit_udec(out, tx->dst & 0xFFFFFF);
+	emit_str(out, ",\"len\":");
+	emit_udec(out, rx->size);
+	emit_str(out, "}}");
+	span_event(writer, "e", "router", name, id, tx->proc, SMEM_TRACE_ROUTER_TID, time);
+	emit_char(out, '}');
+}
+
+// Instant event of the first record of an ERROR, its words as they are
+static void error_event(SmemTraceWriter *writer, const SmemLogRecord *rec, uint64_t time)
+{
+	SmemOutBuffer *out = &writer->out;
+
+	begin_event(writer, "i");
+	emit_str(out, ",\"s\":\"t\",\"cat\":\"error\",\"name\":\"");
+	emit_str(out, find_decoder(rec->id)->name);
+	emit_str(out, " ERROR\"");
+	emit_track(writer, rec->id & 0xC0000000, SMEM_TRACE_ERROR_TID);
+	emit_trace_time(writer, time);
+	emit_str(out, ",\"args\":{\"id\":");
+	emit_udec(out, rec->id);
+	emit_str(out, ",\"data\":[");
+	emit_udec(out, rec->d1);
+	emit_char(out, ',');
+	emit_udec(out, rec->d2);
+	emit_char(out, ',');
+	emit_udec(out, rec->d3);
+	emit_str(out, "]}}");
+}
+
+void trace_writer_init(SmemTraceWriter *writer, FILE *stream, uint32_t clock_rate)
+{
+	qmi_tracker_init(&writer->qmi, clock_rate);
+	writer->qmi.on_match = qmi_span;
+	writer->qmi.match_context = writer;
+	router_tracker_init(&writer->router, clock_rate);
+	writer->router.on_match = router_span;
+	writer->router.match_context = writer;
+	timebase_init(&writer->timebase, clock_rate);
+	outbuf_init(&writer->out, 2 * SMEM_TRACE_FLUSH);
+	writer->stream = stream;
+	writer->has_time = FALSE;
+	writer->first_time = 0;
+	memset(writer->named, 0, sizeof(writer->named));
+	writer->nb_written = 0;
+	writer->nb_qmi_spans = 0;
+	writer->nb_router_spans = 0;
+	writer->nb_errors = 0;
+
+	emit_str(&writer->out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+}
+
+void trace_writer_add(SmemTraceWriter *writer, const SmemLogRecord *records, size_t nb_records)
+{
+	for (size_t i = 0; i < nb_records; i++) {
+		const SmemLogRecord *rec = &records[i];
+		if (rec->id == 0) {
+			continue;
+		}
+
+		uint64_t time = timebase_extend(&writer->timebase, rec->timestamp);
+		if (!writer->has_time) {
+			writer->has_time = TRUE;
+			writer->first_time = time;
+		}
+		name_processor(writer, rec->id & 0xC0000000);
+		if (error_record(rec)) {
+			error_event(writer, rec, time);
+			writer->nb_errors++;
+		}
+	}
+
+	// The spans ended by these records
+	qmi_tracker_add(&writer->qmi, records, nb_records);
+	router_tracker_add(&writer->router, records, nb_records);
+}
+
+bool trace_writer_finish(SmemTraceWriter *writer)
+{
+	emit_str(&writer->out, "\n]}\n");
+	outbuf_flush(&writer->out, writer->stream);
+	outbuf_free(&writer->out);
+	return fflush(writer->stream) == 0 && !ferror(writer->stream);
+}
+
+static bool add_records(void *context, const SmemLogRecord *records, size_t nb_records, uint32_t nb_dropped)
+{
+	trace_writer_add((SmemTraceWriter *)context, records, nb_records);
+	return TRUE;
+}
+
+int trace_file(const char *path, const char *trace_path, unsigned int nb_jobs, uint32_t clock_rate)
+{
+	SmemTraceWriter *writer = (SmemTraceWriter *)malloc(sizeof(SmemTraceWriter));
+
+	if (writer == NULL) {
+		fprintf(stderr, "Not enough memory for the trace\n");
+		return EXIT_FAILURE;
+	}
+	FILE *stream = NULL;
+	if (fopen_s(&stream, trace_path, "wb") != 0) {
+		fprintf(stderr, "Failed to open %s\n", trace_path);
+		free(writer);
+		return EXIT_FAILURE;
+	}
+	trace_writer_init(writer, stream, input_clock_rate(path, clock_rate));
+
+	int status = read_input_file(path, nb_jobs, add_records, writer);
+
+	// The records read before an error still make a complete trace
+	if (!trace_writer_finish(writer)) {
+		fprintf(stderr, "Failed to write %s\n", trace_path);
+		status = EXIT_FAILURE;
+	}
+	fclose(stream);
+	printf("Trace: %llu QMI requests, %llu IPC Router messages and %llu errors written to %s\n",
+		(unsigned long long)writer->nb_qmi_spans, (unsigned long long)writer->nb_router_spans,
+		(unsigned long long)writer->nb_errors, trace_path);
+	printf("Not matched: %llu QMI requests, %llu IPC Router TX\n",
+		(unsigned long long)(writer->qmi.nb_req - writer->qmi.nb_matched),
+		(unsigned long long)(writer->router.nb_tx - writer->router.nb_matched));
+	free(writer);
+	return status;
+}
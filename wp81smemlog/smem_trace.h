@@ -0,0 +1,68 @@
+#pragma once
+
+#define SMEM_TRACE_FLUSH 65536          // Bytes of trace events buffered before they are written
+#define SMEM_TRACE_QMI_TID 1            // Thread of the QMI requests in the track of a processor
+#define SMEM_TRACE_ROUTER_TID 2         // Thread of the IPC Router messages
+#define SMEM_TRACE_ERROR_TID 3          // Thread of the ERROR records
+
+/**
+* @brief Converts records to Chrome trace events (JSON), as they are read.
+*
+* Each processor is a process of the trace, named as print_line_header names it, with
+* a thread for the QMI requests, one for the IPC Router messages and one for the errors.
+* A QMI client request matched with its response and an IPC Router TX matched with its
+* RX are an async span on the track of the processor which sent them, written when it
+* ends: the trace viewers sort the events, and the memory is the bounded one of the
+* trackers whatever the number of records. An ERROR record is an instant event.
+*/
+typedef struct {
+	SmemQmiTracker qmi;
+	SmemRouterTracker router;
+	SmemTimebase timebase;          // Of the errors, the trackers extend the same timestamps
+	SmemOutBuffer out;
+	FILE *stream;
+	bool has_time;                  // FALSE until a record with an id
+	uint64_t first_time;            // Extended timestamp of the first record with an id, time 0 of the trace
+	bool named[4];                  // Processors with their process and threads named, indexed by id >> 30
+	uint64_t nb_written;            // Trace events, the metadata included
+	uint64_t nb_qmi_spans;
+	uint64_t nb_router_spans;
+	uint64_t nb_errors;
+} SmemTraceWriter;
+
+/**
+* @brief Initializes a writer and writes the start of the trace.
+*
+* @param writer The writer.
+* @param stream Receives the trace.
+* @param clock_rate Ticks per second of the record timestamps.
+*/
+void trace_writer_init(SmemTraceWriter *writer, FILE *stream, uint32_t clock_rate);
+
+/**
+* @brief Adds records, in the order of the log, and writes the spans they end and their errors.
+*
+* @param writer The writer.
+* @param records The records.
+* @param nb_records Number of records.
+*/
+void trace_writer_add(SmemTraceWriter *writer, const SmemLogRecord *records, size_t nb_records);
+
+/**
+* @brief Writes the end of the trace and releases the buffer of the writer. The requests still waiting are not written.
+*
+* @param writer The writer.
+* @return FALSE if the trace could not be written.
+*/
+bool trace_writer_finish(SmemTraceWriter *writer);
+
+/**
+* @brief Converts a raw dump, capture or archive file to a Chrome trace, loadable in Perfetto or chrome://tracing.
+*
+* @param path The file.
+* @param trace_path The trace written.
+* @param nb_jobs Threads parsing a raw dump or an archive.
+* @param clock_rate Ticks per second of the timestamps of a raw dump.
+* @return EXIT_SUCCESS, or EXIT_FAILURE if the file cannot be read or the trace written.
+*/
+int trace_file(const char *path, const char *trace_path, unsigned int nb_jobs, uint32_t clock_rate);
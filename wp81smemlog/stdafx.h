@@ -5,9 +5,11 @@
 
 #pragma once
 
+#ifdef _WIN32
 #include "targetver.h"
 
 #include <windows.h>
+#endif
 #include <stdio.h>
 #include <stdint.h>
 
@@ -16,9 +18,16 @@
 // TODO: reference additional headers your program requires here
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <stddef.h>
+#ifndef _WIN32
+#include "smem_posix.h"
+#endif
+#include "smem_out.h"
+#include "smem_time.h"
 #include "smem_log.h"
 
+#ifdef _WIN32
 extern "C" {
 	WINBASEAPI HANDLE WINAPI CreateFileA(LPCSTR lpFileName, DWORD dwDesiredAccess, DWORD dwShareMode, LPSECURITY_ATTRIBUTES lpSecurityAttributes, DWORD dwCreationDisposition, DWORD dwFlagsAndAttributes, HANDLE hTemplateFile);
 	WINBASEAPI BOOL	WINAPI SetConsoleCtrlHandler(PHANDLER_ROUTINE HandlerRoutine, BOOL Add);
@@ -30,7 +39,13 @@ extern "C" {
 	WINBASEAPI HANDLE WINAPI CreateEventW(LPSECURITY_ATTRIBUTES lpEventAttributes, BOOL bManualReset, BOOL bInitialState, LPCWSTR lpName);
 	WINBASEAPI DWORD WINAPI WaitForSingleObject(HANDLE hHandle, DWORD dwMilliseconds);
 	WINBASEAPI DWORD WINAPI GetTickCount(VOID);
+	WINBASEAPI BOOL WINAPI GetFileSizeEx(HANDLE hFile, PLARGE_INTEGER lpFileSize);
+	WINBASEAPI HANDLE WINAPI CreateFileMappingW(HANDLE hFile, LPSECURITY_ATTRIBUTES lpFileMappingAttributes, DWORD flProtect, DWORD dwMaximumSizeHigh, DWORD dwMaximumSizeLow, LPCWSTR lpName);
+	WINBASEAPI HANDLE WINAPI OpenFileMappingW(DWORD dwDesiredAccess, BOOL bInheritHandle, LPCWSTR lpName);
+	WINBASEAPI LPVOID WINAPI MapViewOfFile(HANDLE hFileMappingObject, DWORD dwDesiredAccess, DWORD dwFileOffsetHigh, DWORD dwFileOffsetLow, SIZE_T dwNumberOfBytesToMap);
+	WINBASEAPI BOOL WINAPI UnmapViewOfFile(LPCVOID lpBaseAddress);
 }
+#endif
 
 #define METHOD_BUFFERED                 0
 #define METHOD_IN_DIRECT                1
@@ -2,20 +2,49 @@
 //
 
 #include "stdafx.h"
+#ifdef _WIN32
 #include "Getopt-for-Visual-Studio/getopt.h"
+#else
+#include <getopt.h>
+#endif
+#include "smem_bench.h"
+#include "smem_parse.h"
+#include "smem_chunk.h"
+#include "smem_dump.h"
+#include "smem_capture.h"
+#include "smem_archive.h"
+#include "smem_filter.h"
+#include "smem_stats.h"
+#include "smem_histo.h"
+#include "smem_router.h"
+#include "smem_qmi.h"
+#include "smem_trace.h"
+#include "smem_ring.h"
+#include "smem_merge.h"
+#include "smem_source.h"
+#include "smem_poll.h"
+#include "smem_device.h"
+#include "smem_synth.h"
+#include "smem_shm.h"
+#include "smem_metrics.h"
+#include "smem_reader.h"
+#include "smem_loss.h"
+#include "smem_pipe.h"
 
-#define IOCTL_MYDRV_GET_FUNCTIONS  CTL_CODE(FILE_DEVICE_UNKNOWN, 0x800, METHOD_BUFFERED, FILE_ANY_ACCESS)
-#define IOCTL_MYDRV_INIT_LOG_BUFFER CTL_CODE(FILE_DEVICE_UNKNOWN, 0x801, METHOD_BUFFERED, FILE_ANY_ACCESS)
-#define IOCTL_MYDRV_READ_LOG_EVENTS CTL_CODE(FILE_DEVICE_UNKNOWN, 0x802, METHOD_BUFFERED, FILE_ANY_ACCESS)
+// Cleared by Ctrl-C or a failed read, polled by the reader, pipe and producer threads
+volatile LONG isRunning = TRUE;
 
-BOOL isRunning = TRUE;
+static bool keep_running(void)
+{
+	return InterlockedCompareExchange(&isRunning, TRUE, TRUE) != FALSE;
+}
 
 BOOL WINAPI consoleHandler(DWORD signal)
 {
 	switch (signal)
 	{
 	case CTRL_C_EVENT:
-		isRunning = FALSE;
+		InterlockedExchange(&isRunning, FALSE);
 		// Signal is handled - don't pass it on to the next handler.
 		return TRUE;
 	default:
@@ -24,23 +53,316 @@ BOOL WINAPI consoleHandler(DWORD signal)
 	}
 }
 
+// Log indexes read, on the device, on the emulated logs or generated
+typedef struct {
+	HANDLE device;              // INVALID_HANDLE_VALUE for the emulated logs and the generated records
+	SmemDeviceSource devices[SMEM_MERGE_MAX_INPUTS];
+	SmemShmSource emulated[SMEM_MERGE_MAX_INPUTS];
+	SmemSynthSource synthetic[SMEM_MERGE_MAX_INPUTS];
+	SmemRecordSource *sources[SMEM_MERGE_MAX_INPUTS];  // NULL for an index not read
+} LogSources;
+
+// Opens the device, unless emulated or generated, and starts the sources of the indexes from first to last.
+// The generated records of an index are nb_synth records of the workload, seeded with the index.
+static bool open_sources(LogSources *logs, bool emulated, const SmemSynthConfig *synth, uint32_t nb_synth, int first, int last, bool verbose)
+{
+	memset(logs->sources, 0, sizeof(logs->sources));
+	logs->device = INVALID_HANDLE_VALUE;
+	if (!emulated && nb_synth == 0) {
+		logs->device = CreateFileA("\\\\.\\Wp81SmemLogControlDriver",
+			GENERIC_READ | GENERIC_WRITE,
+			0,
+			NULL,
+			OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL,
+			NULL);
+
+		if (logs->device == INVALID_HANDLE_VALUE) {
+			printf("Failed to open device (error %u)\n", GetLastError());
+			return FALSE;
+		}
+	}
+
+	for (int index = first; index <= last; index++) {
+		SmemRecordSource *source;
+		if (nb_synth > 0) {
+			SmemSynthConfig config = *synth;
+			config.seed += index;
+			synth_source_init(&logs->synthetic[index], nb_synth, &config);
+			source = &logs->synthetic[index].base;
+		}
+		else if (emulated) {
+			shm_source_init(&logs->emulated[index], index);
+			source = &logs->emulated[index].base;
+		}
+		else {
+			device_source_init(&logs->devices[index], logs->device, index);
+			source = &logs->devices[index].base;
+		}
+		if (!source->start(source, verbose)) {
+			for (int i = first; i < index; i++) logs->sources[i]->stop(logs->sources[i]);
+			if (logs->device != INVALID_HANDLE_VALUE) CloseHandle(logs->device);
+			return FALSE;
+		}
+		logs->sources[index] = source;
+	}
+	return TRUE;
+}
+
+static void close_sources(LogSources *logs)
+{
+	for (int index = 0; index < SMEM_MERGE_MAX_INPUTS; index++) {
+		if (logs->sources[index] != NULL) logs->sources[index]->stop(logs->sources[index]);
+	}
+	if (logs->device != INVALID_HANDLE_VALUE) CloseHandle(logs->device);
+}
+
+// Reader of one log index when both are merged
+typedef struct {
+	SmemMergeInput *input;
+	SmemReadLoop loop;
+} IndexReader;
+
+// Waits for the merge rather than dropping the records read
+static bool push_index_records(SmemReadLoop *loop, SmemLogRecord *records, const SmemReadResult *result)
+{
+	IndexReader *reader = (IndexReader *)loop->context;
+	const SmemLogRecord *next = records;
+	size_t nbRecords = result->nb_read;
+
+	reader->input->nb_dropped += result->nb_dropped;
+	for (;;) {
+		size_t nbPushed = merge_push(reader->input, next, nbRecords);
+		next += nbPushed;
+		nbRecords -= nbPushed;
+		if (nbRecords == 0 || !keep_running()) break;
+		Sleep(1);
+	}
+	return TRUE;
+}
+
+// The records of the other index can be printed meanwhile
+static void sleep_index(SmemReadLoop *loop, DWORD interval)
+{
+	IndexReader *reader = (IndexReader *)loop->context;
+
+	merge_set_idle(reader->input, TRUE);
+	Sleep(interval);
+	merge_set_idle(reader->input, FALSE);
+}
+
+static DWORD WINAPI read_index_thread(LPVOID param)
+{
+	IndexReader *reader = (IndexReader *)param;
+
+	if (!read_loop_run(&reader->loop)) {
+		// Stops the other reader too
+		InterlockedExchange(&isRunning, FALSE);
+	}
+	merge_close(reader->input);
+	return 0;
+}
+
+// Reads both log indexes on their own threads and prints their records merged in timestamp order
+static int read_both_indexes(SmemRecordSource **sources, uint32_t clockRate, const SmemFilter *recordFilter, bool raw, bool verbose, bool json)
+{
+	SmemMerge *merge = (SmemMerge *)malloc(sizeof(SmemMerge));
+	IndexReader readers[SMEM_MERGE_MAX_INPUTS];
+	HANDLE threads[SMEM_MERGE_MAX_INPUTS];
+	uint32_t nbThreads = 0;
+	int status = EXIT_SUCCESS;
+
+	if (merge == NULL) {
+		printf("Not enough memory for the merge\n");
+		return EXIT_FAILURE;
+	}
+	merge_init(merge, SMEM_MERGE_MAX_INPUTS, clockRate, recordFilter, raw, verbose, json);
+
+	SetConsoleCtrlHandler(consoleHandler, TRUE);
+
+	for (uint32_t i = 0; i < SMEM_MERGE_MAX_INPUTS; i++) {
+		readers[i].input = &merge->inputs[i];
+		memset(&readers[i].loop, 0, sizeof(readers[i].loop));
+		readers[i].loop.source = sources[i];
+		readers[i].loop.running = &isRunning;
+		readers[i].loop.consume = push_index_records;
+		readers[i].loop.sleep = sleep_index;
+		readers[i].loop.context = &readers[i];
+		if (nbThreads == i && (threads[i] = CreateThread(NULL, 0, read_index_thread, &readers[i], 0, NULL)) != NULL) {
+			nbThreads++;
+		}
+		else {
+			// Nothing to wait for from this index
+			merge_close(readers[i].input);
+		}
+	}
+	if (nbThreads < SMEM_MERGE_MAX_INPUTS) {
+		printf("Failed to create the reader threads (error %u)\n", GetLastError());
+		InterlockedExchange(&isRunning, FALSE);
+		status = EXIT_FAILURE;
+	}
+
+	// Until Ctrl-C or a failed read, then the records already read
+	while (merge_print(merge)) {
+		Sleep(1);
+	}
+	merge_finish(merge);
+
+	if (nbThreads > 0) {
+		WaitForMultipleObjectsEx(nbThreads, threads, TRUE, INFINITE, FALSE);
+	}
+	for (uint32_t i = 0; i < nbThreads; i++) {
+		CloseHandle(threads[i]);
+		if (readers[i].loop.source->failed) status = EXIT_FAILURE;
+		if (verbose) {
+			printf("Index %u: %llu records dropped\n", i, (unsigned long long)merge->inputs[i].nb_dropped);
+			poll_print_stats(&readers[i].loop.poll);
+		}
+	}
+	merge_free(merge);
+	return status;
+}
+
+// Where the records read by main go, the files and counters of the modes asked for, NULL when off
+typedef struct {
+	bool verbose;
+	SmemLossTracker *loss;
+	SmemOutBuffer *lossText;
+	SmemStats *stats;
+	SmemRouterTracker *tracker;
+	SmemQmiTracker *qmiTracker;
+	DWORD lastSummary;          // Last summary of the counters
+	const char *captureFile;
+	SmemCaptureWriter *capture;
+	const char *archiveFile;
+	SmemArchiveWriter *archive;
+} RecordSinks;
+
+static bool consume_records(SmemReadLoop *loop, SmemLogRecord *records, const SmemReadResult *result)
+{
+	RecordSinks *sinks = (RecordSinks *)loop->context;
+	SmemMetrics *metrics = loop->metrics;
+	bool ok = TRUE;
+
+	if (sinks->verbose) printf("READ_LOG_EVENTS succeeded: nbDropped=%u nbAvailable=%u nbRead=%u\n", result->nb_dropped, result->nb_available, result->nb_read);
+	loss_tracker_add(sinks->loss, records, result->nb_read, result->nb_dropped, sinks->lossText, FALSE);
+	if (sinks->lossText->size > 0) outbuf_flush(sinks->lossText, stdout);
+
+	// Records written or counted as they are, no text formatting
+	uint64_t start = metrics != NULL ? metrics_clock() : 0;
+	if (sinks->stats != NULL) {
+		stats_add(sinks->stats, records, result->nb_read, result->nb_dropped);
+	}
+	if (sinks->tracker != NULL) {
+		router_tracker_add(sinks->tracker, records, result->nb_read);
+	}
+	if (sinks->qmiTracker != NULL) {
+		qmi_tracker_add(sinks->qmiTracker, records, result->nb_read);
+	}
+	if (metrics != NULL) {
+		metrics_decode(metrics, start, result->nb_read);
+		start = metrics_clock();
+	}
+	if (sinks->capture != NULL && !capture_append(sinks->capture, records, result->nb_read, result->nb_dropped)) {
+		printf("Failed to write %s\n", sinks->captureFile);
+		ok = FALSE;
+	}
+	if (sinks->archive != NULL && !archive_append(sinks->archive, records, result->nb_read, result->nb_dropped)) {
+		printf("Failed to write %s\n", sinks->archiveFile);
+		ok = FALSE;
+	}
+	if (metrics != NULL && (sinks->capture != NULL || sinks->archive != NULL)) {
+		metrics_write(metrics, start, result->nb_read * sizeof(SmemLogRecord));
+	}
+	if (metrics != NULL) {
+		metrics_update(metrics, GetTickCount());
+	}
+
+	if ((sinks->stats != NULL || sinks->tracker != NULL || sinks->qmiTracker != NULL) && GetTickCount() - sinks->lastSummary >= SMEM_STATS_PERIOD) {
+		if (sinks->stats != NULL) stats_print(sinks->stats);
+		if (sinks->tracker != NULL) router_tracker_print(sinks->tracker);
+		if (sinks->qmiTracker != NULL) qmi_tracker_print(sinks->qmiTracker);
+		printf("\n");
+		sinks->lastSummary = GetTickCount();
+	}
+	return ok;
+}
+
+// Complete file while waiting for the next records
+static void sleep_synced(SmemReadLoop *loop, DWORD interval)
+{
+	RecordSinks *sinks = (RecordSinks *)loop->context;
+
+	if (sinks->capture != NULL) capture_sync(sinks->capture);
+	Sleep(interval);
+}
+
 static void usage(char *programName)
 {
 	printf("%s - Read event records from the SMEM_LOG_EVENTS circular buffer.\n"
 		"Usage:\n", programName);
 	printf("\t%s [options]n", programName);
 	printf("options:\n"
+		"\t-a, --archive            Write the records to a compressed archive, or convert the -f raw dump or capture file\n"
+		"\t-b, --bench              Time the decoders, and the records of the -f file if given\n"
+		"\t-B, --bench-json         Time the decoders as -b, then write the measures as JSON to this file\n"
+		"\t-c, --clock              Timestamp clock: sleep (32768 Hz, default), ht (19.2 MHz) or rate in Hz\n"
+		"\t-E, --emulated           Read the emulated SMEM logs written by -P instead of the device\n"
+		"\t-F, --filter             Print only the records matching an expression, e.g. \"proc=APPS & base=IPC_ROUTER | base=QCCI\"\n"
+		"\t                         on the fields proc, base, event, id, d1, d2 and d3, compared with = or !=\n"
+		"\t-g, --generate           Workload of -y and -P, e.g. \"qcci=5,data=2,tmc=0,apps=1,burst=100,idle=500,seed=7\"\n"
+		"\t                         with the weights qcci, qcsi, data, control, rpc, tmc, timetick, modm, qdsp, apps, wcns\n"
+		"\t                         and rate (events/s), burst (events), idle (ms), latency (us) and seed\n"
 		"\t-h, --help               Show help options\n"
-		"\t-i, --index              Log index (default is 0)\n"
+		"\t-i, --index              Log index: 0, 1 or both, merged in timestamp order (default is 0)\n"
+		"\t-J, --json               Print each decoded event as a JSON object on its own line (JSON Lines), with its typed fields\n"
+		"\t-j, --jobs               Threads decoding a raw dump file (default is 4)\n"
+		"\t-M, --metrics            Time the reads, the decoding and the output of a live session, reported on stderr\n"
+		"\t                         every 5 seconds and at the end (single index)\n"
+		"\t-m, --merge              Merge the records of this file, tagged [1], with the -f file, tagged [0]\n"
+		"\t-P, --produce            Write generated records to the emulated SMEM logs at this rate per second\n"
+		"\t-Q, --qmi                Match the QMI client requests and responses, print the latencies per service message\n"
 		"\t-r, --raw                Print only raw data\n"
-		"\t-v, --verbose            Increase verbosity\n");
+		"\t-R, --router             Match the IPC Router TX and RX of each message, print the rates and latencies per link\n"
+		"\t-s, --since              Decode a capture file from this time, in seconds\n"
+		"\t-S, --stats              Count the records per processor, event base and event instead of printing them\n"
+		"\t-t, --self-test          Check the decoding, the time base and the file formats on known values, then exit\n"
+		"\t-T, --trace              Convert the -f file to a Chrome trace of the QMI requests, IPC Router messages and errors\n"
+		"\t                         per processor, loadable in Perfetto or chrome://tracing\n"
+		"\t-u, --until              Decode a capture file up to this time, in seconds\n"
+		"\t-v, --verbose            Increase verbosity\n"
+		"\t-w, --write              Write the records to a binary capture file, without decoding them\n"
+		"\t-y, --synthetic          Read this number of generated records instead of the device, printed, raw with -r\n"
+		"\t                         or written with -w, -a, -S, -R and -Q as the records of the device\n");
 }
 
 static const struct option main_options[] = {
+	{ "archive",   required_argument, NULL, 'a' },
+	{ "bench",     no_argument,       NULL, 'b' },
+	{ "bench-json", required_argument, NULL, 'B' },
+	{ "clock",     required_argument, NULL, 'c' },
+	{ "emulated",  no_argument,       NULL, 'E' },
+	{ "file",      required_argument, NULL, 'f' },
+	{ "filter",    required_argument, NULL, 'F' },
+	{ "generate",  required_argument, NULL, 'g' },
 	{ "help",      no_argument,       NULL, 'h' },
 	{ "index",     required_argument, NULL, 'i' },
+	{ "jobs",      required_argument, NULL, 'j' },
+	{ "json",      no_argument,       NULL, 'J' },
+	{ "merge",     required_argument, NULL, 'm' },
+	{ "metrics",   no_argument,       NULL, 'M' },
+	{ "produce",   required_argument, NULL, 'P' },
+	{ "qmi",       no_argument,       NULL, 'Q' },
 	{ "raw",       no_argument,       NULL, 'r' },
+	{ "router",    no_argument,       NULL, 'R' },
+	{ "since",     required_argument, NULL, 's' },
+	{ "stats",     no_argument,       NULL, 'S' },
+	{ "self-test", no_argument,       NULL, 't' },
+	{ "trace",     required_argument, NULL, 'T' },
+	{ "until",     required_argument, NULL, 'u' },
 	{ "verbose",   no_argument,       NULL, 'v' },
+	{ "write",     required_argument, NULL, 'w' },
+	{ "synthetic", required_argument, NULL, 'y' },
 	{}
 };
 
@@ -49,12 +371,35 @@ int main(int argc, char* argv[])
 	BOOL verbose = FALSE;
 	BOOL raw = FALSE;
 	int logIndex = 0;
+	BOOL bothIndexes = FALSE;
+	const char *dumpFile = NULL;
+	const char *mergeFile = NULL;
+	int nbJobs = 4;
+	const char *captureFile = NULL;
+	const char *archiveFile = NULL;
+	SmemTimeWindow window = { 0.0, -1.0 };
+	uint32_t clockRate = TIMESTAMP_CLOCK_RATE;
+	SmemFilter filter;
+	const SmemFilter *recordFilter = NULL;
+	BOOL statsMode = FALSE;
+	BOOL routerMode = FALSE;
+	BOOL qmiMode = FALSE;
+	uint32_t synthRecords = 0;
+	BOOL emulated = FALSE;
+	BOOL benchMode = FALSE;
+	BOOL selfTest = FALSE;
+	const char *benchJson = NULL;
+	uint32_t produceRate = 0;
+	const char *workload = NULL;
+	BOOL metricsMode = FALSE;
+	BOOL jsonMode = FALSE;
+	const char *traceFile = NULL;
 
 	for (;;) {
 		int opt;
 
 		opt = getopt_long(argc, argv,
-			"hi:rv",
+			"a:bB:c:Ef:F:g:hi:j:Jm:MP:QrRs:StT:u:vw:y:",
 			main_options, NULL);
 
 		if (opt < 0) {
@@ -63,126 +408,353 @@ int main(int argc, char* argv[])
 		}
 
 		switch (opt) {
+		case 'a':
+			archiveFile = optarg;
+			break;
+		case 'b':
+			benchMode = TRUE;
+			break;
+		case 'B':
+			benchMode = TRUE;
+			benchJson = optarg;
+			break;
+		case 'E':
+			emulated = TRUE;
+			break;
+		case 'c':
+			if (strcmp(optarg, "sleep") == 0) {
+				clockRate = SLEEP_CLOCK_RATE;
+			}
+			else if (strcmp(optarg, "ht") == 0) {
+				clockRate = HT_TIMER_CLOCK_RATE;
+			}
+			else {
+				clockRate = strtoul(optarg, NULL, 0);
+				if (clockRate == 0)
+				{
+					printf("Clock must be sleep, ht or a rate in Hz.\n");
+					usage(argv[0]);
+					return EXIT_FAILURE;
+				}
+			}
+			break;
+		case 'f':
+			dumpFile = optarg;
+			break;
+		case 'F':
+			if (!filter_compile(&filter, optarg)) {
+				usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			recordFilter = &filter;
+			break;
+		case 'g':
+			workload = optarg;
+			break;
 		case 'h':
 			usage(argv[0]);
 			return EXIT_SUCCESS;
+		case 'Q':
+			qmiMode = TRUE;
+			break;
 		case 'r':
 			raw = TRUE;
 			break;
+		case 'R':
+			routerMode = TRUE;
+			break;
 		case 'i':
+			if (strcmp(optarg, "both") == 0) {
+				bothIndexes = TRUE;
+				break;
+			}
 			logIndex = atoi(optarg);
 			if (logIndex < 0 || logIndex > 1)
 			{
-				printf("Index must be 0 or 1.\n", optarg);
+				printf("Index must be 0, 1 or both.\n");
+				usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'j':
+			nbJobs = atoi(optarg);
+			if (nbJobs < 1 || nbJobs > 64)
+			{
+				printf("Jobs must be between 1 and 64.\n");
+				usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'J':
+			jsonMode = TRUE;
+			break;
+		case 'm':
+			mergeFile = optarg;
+			break;
+		case 'M':
+			metricsMode = TRUE;
+			break;
+		case 'P':
+			produceRate = strtoul(optarg, NULL, 0);
+			if (produceRate == 0)
+			{
+				printf("Produce needs a rate in records per second.\n");
 				usage(argv[0]);
 				return EXIT_FAILURE;
 			}
 			break;
+		case 's':
+			window.since = atof(optarg);
+			break;
+		case 'S':
+			statsMode = TRUE;
+			break;
+		case 't':
+			selfTest = TRUE;
+			break;
+		case 'T':
+			traceFile = optarg;
+			break;
+		case 'u':
+			window.until = atof(optarg);
+			break;
 		case 'v':
 			printf("Verbose mode\n");
 			verbose = TRUE;
 			break;
+		case 'w':
+			captureFile = optarg;
+			break;
+		case 'y':
+			synthRecords = strtoul(optarg, NULL, 0);
+			if (synthRecords == 0)
+			{
+				printf("Synthetic needs a number of records.\n");
+				usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
 		default:
 			usage(argv[0]);
 			return EXIT_FAILURE;
 		}
 	}
 
-    HANDLE h = CreateFileA("\\\\.\\Wp81SmemLogControlDriver",
-        GENERIC_READ | GENERIC_WRITE,
-        0,
-        NULL,
-        OPEN_EXISTING,
-        FILE_ATTRIBUTE_NORMAL,
-        NULL);
-
-    if (h == INVALID_HANDLE_VALUE) {
-        printf("Failed to open device (error %u)\n", GetLastError());
-        return 1;
-    }
-
-    DWORD bytes = 0;
-    BOOL ok;
-
-    // 1) GET FUNCTIONS
-    ok = DeviceIoControl(h, IOCTL_MYDRV_GET_FUNCTIONS, NULL, 0, NULL, 0, &bytes, NULL);
-    if (!ok) {
-        printf("IOCTL_GET_FUNCTIONS failed %u\n", GetLastError());
-    } else if (verbose) {
-        printf("IOCTL_GET_FUNCTIONS succeeded\n");
-    }
-
-    // 2) INIT_LOG_BUFFER
-	uint32_t in_init = logIndex;
-    uint32_t out_init = 0;
-    ok = DeviceIoControl(h, IOCTL_MYDRV_INIT_LOG_BUFFER, &in_init, sizeof(in_init), &out_init, sizeof(out_init), &bytes, NULL);
-    if (!ok) {
-        printf("IOCTL_INIT_LOG_BUFFER failed %u\n", GetLastError());
-    } else if (verbose) {
-        printf("IOCTL_INIT_LOG_BUFFER returned %d (bytes=%u)\n", (int)out_init, bytes);
-    }
+	// The timestamps of the generated records follow the clock, whichever option comes first
+	SmemSynthConfig synthConfig;
+	synth_config_init(&synthConfig, clockRate);
+	if (workload != NULL && !synth_config_parse(&synthConfig, workload)) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
 
-	SetConsoleCtrlHandler(consoleHandler, TRUE);
-	printf("Listening to SMEM_LOG_EVENTS...Press Ctrl-C to stop.\n");
+	if (jsonMode && (raw || verbose)) {
+		printf("JSON output excludes the raw and verbose output.\n");
+		return EXIT_FAILURE;
+	}
 
-    // 3) READ_LOG_EVENTS
-    uint32_t in_read[2];
-	in_read[0] = logIndex;
-    in_read[1] = 5;  // maxNbEntries
+	if (selfTest) {
+		return run_self_test();
+	}
+	if (benchMode) {
+		return run_bench(100000, dumpFile, nbJobs, clockRate, benchJson);
+	}
+
+	if (mergeFile != NULL && dumpFile == NULL) {
+		printf("Merge needs a -f file.\n");
+		return EXIT_FAILURE;
+	}
+	if (traceFile != NULL && dumpFile == NULL) {
+		printf("Trace needs a -f file.\n");
+		return EXIT_FAILURE;
+	}
+	if (dumpFile != NULL) {
+		if (mergeFile != NULL) {
+			const char *paths[SMEM_MERGE_MAX_INPUTS] = { dumpFile, mergeFile };
+			return merge_files(paths, SMEM_MERGE_MAX_INPUTS, nbJobs, clockRate, recordFilter, raw == TRUE, verbose == TRUE, jsonMode == TRUE);
+		}
+		if (traceFile != NULL) {
+			return trace_file(dumpFile, traceFile, nbJobs, clockRate);
+		}
+		if (statsMode || routerMode || qmiMode) {
+			int status = EXIT_SUCCESS;
+			if (statsMode) status = stats_file(dumpFile, nbJobs, clockRate);
+			if (routerMode && status == EXIT_SUCCESS) status = router_file(dumpFile, nbJobs, clockRate);
+			if (qmiMode && status == EXIT_SUCCESS) status = qmi_file(dumpFile, nbJobs, clockRate);
+			return status;
+		}
+		if (archiveFile != NULL) {
+			return archive_file(dumpFile, archiveFile, nbJobs, logIndex, clockRate);
+		}
+		if (is_capture_file(dumpFile)) {
+			return decode_capture_file(dumpFile, &window, recordFilter, verbose == TRUE, jsonMode == TRUE, stdout);
+		}
+		if (window.since != 0.0 || window.until >= 0.0) {
+			printf("Since and until need a capture file.\n");
+			return EXIT_FAILURE;
+		}
+		if (is_archive_file(dumpFile)) {
+			return decode_archive_file(dumpFile, nbJobs, recordFilter, verbose == TRUE, jsonMode == TRUE);
+		}
+		return decode_dump_file(dumpFile, nbJobs, clockRate, recordFilter, verbose == TRUE, jsonMode == TRUE);
+	}
 
+	if (bothIndexes && (captureFile != NULL || archiveFile != NULL || statsMode || routerMode || qmiMode)) {
+		printf("Capture, archive, stats, router and qmi modes need a single index.\n");
+		return EXIT_FAILURE;
+	}
+	if (bothIndexes && metricsMode) {
+		printf("Metrics need a single index.\n");
+		return EXIT_FAILURE;
+	}
 
+	if (produceRate > 0) {
+		// Stands for the phone: the logs read with -E
+		SetConsoleCtrlHandler(consoleHandler, TRUE);
+		return shm_produce(produceRate, &synthConfig, bothIndexes ? 0 : logIndex, bothIndexes ? 1 : logIndex, &isRunning);
+	}
 
-	uint32_t nbAvailable = 0;
-	uint32_t out_read[28];
-	do {
+	LogSources logs;
+	if (!open_sources(&logs, emulated == TRUE, &synthConfig, synthRecords, bothIndexes ? 0 : logIndex, bothIndexes ? 1 : logIndex, verbose == TRUE)) {
+		return EXIT_FAILURE;
+	}
 
-		memset(out_read, 0, sizeof(out_read));
-		ok = DeviceIoControl(h, IOCTL_MYDRV_READ_LOG_EVENTS, in_read, sizeof(in_read), out_read, sizeof(out_read), &bytes, NULL);
-		if (!ok) {
-			printf("IOCTL_READ_LOG_EVENTS failed %u\n", GetLastError());
-		}
-		else {
-			uint32_t nbDropped = *(uint32_t*)(out_read + 0);
-			nbAvailable = *(uint32_t*)(out_read + 1);
-			uint32_t nbRead = *(uint32_t*)(out_read + 2);
-			if (verbose) printf("IOCTL_READ_LOG_EVENTS succeeded: nbDropped=%u nbAvailable=%u nbRead=%u bytes=%u\n", nbDropped, nbAvailable, nbRead, bytes);
-			uint32_t base_time = 0;
-			bool relative_time = FALSE;
-
-			// 1. Calculate the base address: Skip 3 x uint32_t (12 bytes)
-			SmemLogRecord* base_record_ptr = (SmemLogRecord*)(out_read + 3);
-
-			SmemLogRecord record;
-			// (sizeof(out_read) / sizeof(uint32_t)) - 3 is the total number of uint32_t available 
-			// for records. Max records is that divided by (sizeof(SmemLogRecord) / sizeof(uint32_t)) = 5
-			unsigned int max_records_in_buffer = (sizeof(out_read) / sizeof(uint32_t) - 3) / (sizeof(SmemLogRecord) / sizeof(uint32_t));
-
-			for (unsigned int i = 0; i < nbRead && i < max_records_in_buffer; ++i) {
-				// 2. Access the i-th record using array indexing on the base pointer
-				record = base_record_ptr[i];
-
-				if (verbose) {
-					print_raw_event(record);
-					printf(" ");
-					print_event(&record, &base_time, &relative_time, FALSE, FALSE);
-					printf("\n");
-				}
-				else if (raw) {
-					print_raw_event(record);
-					printf("\n");
-				}
-				else {
-					print_event(&record, &base_time, &relative_time, FALSE, TRUE);
-				}
+	if (bothIndexes) {
+		if (synthRecords == 0 && !jsonMode) printf("Listening to SMEM_LOG_EVENTS and SMEM_LOG_POWER_EVENTS...Press Ctrl-C to stop.\n");
+		int status = read_both_indexes(logs.sources, clockRate, recordFilter, raw == TRUE, verbose == TRUE, jsonMode == TRUE);
+		close_sources(&logs);
+		return status;
+	}
+
+	SmemRecordSource *source = logs.sources[logIndex];
+
+	if (captureFile == NULL && archiveFile == NULL && !statsMode && !routerMode && !qmiMode) {
+		SetConsoleCtrlHandler(consoleHandler, TRUE);
+		// The generated records print alone, as a dump would, and the JSON lines alone
+		if (synthRecords == 0 && !jsonMode) printf("Listening to SMEM_LOG_EVENTS...Press Ctrl-C to stop.\n");
+		SmemMetrics *metrics = NULL;
+		if (metricsMode) {
+			metrics = (SmemMetrics *)malloc(sizeof(SmemMetrics));
+			if (metrics == NULL) {
+				printf("Not enough memory for the metrics\n");
+				close_sources(&logs);
+				return EXIT_FAILURE;
 			}
+			metrics_init(metrics);
 		}
+		// Read, decoded and printed on their own threads
+		int status = pipe_run(source, &isRunning, clockRate, recordFilter, raw == TRUE, verbose == TRUE, jsonMode == TRUE, metrics);
+		free(metrics);
+		close_sources(&logs);
+		return status;
+	}
 
-		if (nbAvailable == 0)
-			Sleep(500);
+	SmemCaptureWriter capture;
+	if (captureFile != NULL) {
+		if (!capture_open(&capture, captureFile, logIndex, clockRate)) {
+			printf("Failed to create %s\n", captureFile);
+			close_sources(&logs);
+			return EXIT_FAILURE;
+		}
+		printf("Writing records to %s\n", captureFile);
+	}
 
-	} while (ok && isRunning);
+	SmemArchiveWriter archive;
+	if (archiveFile != NULL) {
+		if (!archive_open(&archive, archiveFile, logIndex, clockRate)) {
+			printf("Failed to create %s\n", archiveFile);
+			if (captureFile != NULL) capture_close(&capture);
+			close_sources(&logs);
+			return EXIT_FAILURE;
+		}
+		printf("Archiving records to %s\n", archiveFile);
+	}
+
+	SmemStats *stats = NULL;
+	SmemRouterTracker *tracker = NULL;
+	SmemQmiTracker *qmiTracker = NULL;
+	SmemMetrics *metrics = NULL;
+	if (statsMode) stats = (SmemStats *)malloc(sizeof(SmemStats));
+	if (routerMode) tracker = (SmemRouterTracker *)malloc(sizeof(SmemRouterTracker));
+	if (qmiMode) qmiTracker = (SmemQmiTracker *)malloc(sizeof(SmemQmiTracker));
+	if (metricsMode) metrics = (SmemMetrics *)malloc(sizeof(SmemMetrics));
+	if ((statsMode && stats == NULL) || (routerMode && tracker == NULL) || (qmiMode && qmiTracker == NULL) || (metricsMode && metrics == NULL)) {
+		printf("Not enough memory for the counters\n");
+		free(stats);
+		free(tracker);
+		free(qmiTracker);
+		free(metrics);
+		if (captureFile != NULL) capture_close(&capture);
+		if (archiveFile != NULL) archive_close(&archive);
+		close_sources(&logs);
+		return EXIT_FAILURE;
+	}
+	if (stats != NULL) stats_init(stats, clockRate);
+	if (tracker != NULL) router_tracker_init(tracker, clockRate);
+	if (qmiTracker != NULL) qmi_tracker_init(qmiTracker, clockRate);
+	if (metrics != NULL) metrics_init(metrics);
+	SmemLossTracker loss;
+	SmemOutBuffer lossText;
+	loss_tracker_init(&loss, clockRate);
+	outbuf_init(&lossText, 256);
+
+	SetConsoleCtrlHandler(consoleHandler, TRUE);
+	if (synthRecords == 0) printf("Listening to SMEM_LOG_EVENTS...Press Ctrl-C to stop.\n");
 
-    CloseHandle(h);
+    // 3) READ_LOG_EVENTS
+	RecordSinks sinks;
+	sinks.verbose = verbose == TRUE;
+	sinks.loss = &loss;
+	sinks.lossText = &lossText;
+	sinks.stats = stats;
+	sinks.tracker = tracker;
+	sinks.qmiTracker = qmiTracker;
+	sinks.lastSummary = GetTickCount();
+	sinks.captureFile = captureFile;
+	sinks.capture = captureFile != NULL ? &capture : NULL;
+	sinks.archiveFile = archiveFile;
+	sinks.archive = archiveFile != NULL ? &archive : NULL;
+	SmemReadLoop loop;
+	memset(&loop, 0, sizeof(loop));
+	loop.source = source;
+	loop.running = &isRunning;
+	loop.metrics = metrics;
+	loop.consume = consume_records;
+	loop.sleep = sleep_synced;
+	loop.context = &sinks;
+	read_loop_run(&loop);
+
+	if (captureFile != NULL && !capture_close(&capture)) {
+		printf("Failed to write %s\n", captureFile);
+	}
+	if (archiveFile != NULL && !archive_close(&archive)) {
+		printf("Failed to write %s\n", archiveFile);
+	}
+	if (verbose) {
+		poll_print_stats(&loop.poll);
+	}
+	// Summaries of the whole session, also after Ctrl-C
+	if (stats != NULL) {
+		stats_print(stats);
+		free(stats);
+	}
+	if (tracker != NULL) {
+		router_tracker_print(tracker);
+		free(tracker);
+	}
+	if (qmiTracker != NULL) {
+		qmi_tracker_print(qmiTracker);
+		free(qmiTracker);
+	}
+	if (loss.nb_dropped > 0 || verbose) {
+		loss_tracker_print(&loss, stdout);
+	}
+	outbuf_free(&lossText);
+	if (metrics != NULL) {
+		metrics_print_total(metrics, GetTickCount());
+		free(metrics);
+	}
+	close_sources(&logs);
     return EXIT_SUCCESS;
 }
 